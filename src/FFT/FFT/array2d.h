@@ -0,0 +1,18 @@
+#pragma once
+
+template<typename T>
+T** alloc_array(int height, int width)
+{
+    T** array = new T*[height];
+    for (int i = 0; i < height; i++)
+        array[i] = new T[width]();
+    return array;
+}
+
+template<typename T>
+void free_array(T** array, int height)
+{
+    for (int i = 0; i < height; i++)
+        delete[] array[i];
+    delete[] array;
+}
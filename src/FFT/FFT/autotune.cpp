@@ -0,0 +1,260 @@
+#include "autotune.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "buffer2d.h"
+#include "fft_kernels.h"
+#include "thread_pool.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+template<typename Real>
+static const char* precision_name()
+{
+    return sizeof(Real) == sizeof(float) ? "float" : sizeof(Real) == sizeof(double) ? "double" : "long double";
+}
+
+static const FFTKernels* find_kernels(const std::string& name)
+{
+    for (const FFTKernels* kernels : fft_available_kernels())
+        if (name == kernels->name)
+            return kernels;
+    return nullptr;
+}
+
+template<typename Real>
+FFTPlanConfig fft_plan_config(const BasicFFTPlan<Real>& plan)
+{
+    FFTPlanConfig config;
+    config.radices = plan.radices();
+    config.columnPass = plan.columnPassMode();
+    config.rowAlgorithm = plan.rowAlgorithm();
+    config.columnAlgorithm = plan.columnAlgorithm();
+    config.kernels = plan.kernels() != nullptr ? plan.kernels()->name : "";
+    config.threads = plan.threadCount();
+    return config;
+}
+
+template<typename Real>
+void fft_apply_config(BasicFFTPlan<Real>& plan, const FFTPlanConfig& config)
+{
+    plan.setRadices(config.radices);
+    plan.setColumnPass(config.columnPass);
+    plan.setLineAlgorithms(config.rowAlgorithm, config.columnAlgorithm);
+    if (config.kernels.empty())
+        plan.setKernels(nullptr);
+    else if (const FFTKernels* kernels = find_kernels(config.kernels))
+        plan.setKernels(kernels);
+    plan.setThreadCount(config.threads);
+}
+
+std::string fft_config_string(const FFTPlanConfig& config)
+{
+    std::ostringstream text;
+    text << (config.radices == FFTRadices::Radix2 ? "radix2" : "radix4") << " "
+        << (config.columnPass == FFTColumnPass::Transposed ? "transposed" : "strided") << " "
+        << (config.rowAlgorithm == FFTLineAlgorithm::DFTMatrix ? "matrix" : "fft") << " "
+        << (config.columnAlgorithm == FFTLineAlgorithm::DFTMatrix ? "matrix" : "fft") << " "
+        << (config.kernels.empty() ? "default" : config.kernels) << " " << config.threads;
+    return text.str();
+}
+
+bool fft_parse_config(const std::string& text, FFTPlanConfig& config)
+{
+    std::istringstream in(text);
+    std::string radices, column_pass, rows, columns, kernels;
+    int threads;
+    if (!(in >> radices >> column_pass >> rows >> columns >> kernels >> threads) || threads < 0)
+        return false;
+    if ((radices != "radix2" && radices != "radix4") || (column_pass != "strided" && column_pass != "transposed")
+        || (rows != "fft" && rows != "matrix") || (columns != "fft" && columns != "matrix"))
+        return false;
+
+    config.radices = radices == "radix2" ? FFTRadices::Radix2 : FFTRadices::Radix4;
+    config.columnPass = column_pass == "transposed" ? FFTColumnPass::Transposed : FFTColumnPass::Strided;
+    config.rowAlgorithm = rows == "matrix" ? FFTLineAlgorithm::DFTMatrix : FFTLineAlgorithm::FFT;
+    config.columnAlgorithm = columns == "matrix" ? FFTLineAlgorithm::DFTMatrix : FFTLineAlgorithm::FFT;
+    config.kernels = kernels == "default" ? "" : kernels;
+    config.threads = threads;
+    return true;
+}
+
+static std::string wisdom_key(const std::string& cpu, const std::string& precision, int width, int height)
+{
+    return cpu + "\t" + precision + "\t" + std::to_string(width) + "\t" + std::to_string(height);
+}
+
+FFTWisdom::FFTWisdom(const std::string& path)
+    : file(path)
+{
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t split = line.rfind('\t');
+        FFTPlanConfig config;
+        if (split != std::string::npos && fft_parse_config(line.substr(split + 1), config))
+            entries[line.substr(0, split)] = line.substr(split + 1);
+    }
+}
+
+bool FFTWisdom::lookup(const std::string& cpu, const std::string& precision, int width, int height,
+    FFTPlanConfig& config) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entries.find(wisdom_key(cpu, precision, width, height));
+    return entry != entries.end() && fft_parse_config(entry->second, config);
+}
+
+void FFTWisdom::store(const std::string& cpu, const std::string& precision, int width, int height,
+    const FFTPlanConfig& config)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[wisdom_key(cpu, precision, width, height)] = fft_config_string(config);
+
+    std::string temporary = file + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        for (const auto& entry : entries)
+            out << entry.first << "\t" << entry.second << "\n";
+        if (!out)
+            throw std::runtime_error("Could not write the FFT wisdom file!");
+    }
+    // Replace the file in one step, so a reader never sees it missing or half written.
+#ifdef _WIN32
+    if (!MoveFileExA(temporary.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING))
+        throw std::runtime_error("Could not write the FFT wisdom file!");
+#else
+    if (rename(temporary.c_str(), file.c_str()) != 0)
+        throw std::runtime_error("Could not write the FFT wisdom file!");
+#endif
+}
+
+FFTWisdom& fft_wisdom()
+{
+    static FFTWisdom wisdom(getenv("FFT_WISDOM") != nullptr ? getenv("FFT_WISDOM") : "fft_wisdom.txt");
+    return wisdom;
+}
+
+template<typename Real>
+bool fft_apply_wisdom(BasicFFTPlan<Real>& plan, int width, int height)
+{
+    FFTPlanConfig config;
+    if (!fft_wisdom().lookup(cpu_model(), precision_name<Real>(), width, height, config))
+        return false;
+    fft_apply_config(plan, config);
+    return true;
+}
+
+template<typename Real>
+FFTPlanConfig fft_autotune(int width, int height, int runs, std::vector<FFTTuneTrial>* trials)
+{
+    Buffer2D<unsigned char> in(width, height);
+    Buffer2D<Real> re(width, height), im(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            in.row(x)[y] = rand() % 256;
+
+    BasicFFTPlan<Real> plan(width, height, FFTDirection::Forward);
+    auto measure = [&](const FFTPlanConfig& config) {
+        fft_apply_config(plan, config);
+        plan.execute(in, re, im);
+        double best = 1e30;
+        for (int i = 0; i < runs; i++) {
+            auto start = std::chrono::steady_clock::now();
+            plan.execute(in, re, im);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() < best)
+                best = elapsed.count();
+        }
+        if (trials != nullptr)
+            trials->push_back({ config, best });
+        return best;
+    };
+
+    FFTPlanConfig best = fft_plan_config(plan);
+    best.kernels = fft_kernels().name;
+    double best_seconds = measure(best);
+    auto consider = [&](const FFTPlanConfig& config) {
+        double seconds = measure(config);
+        if (seconds < best_seconds) {
+            best = config;
+            best_seconds = seconds;
+        }
+    };
+
+    const FFTPlanConfig start = best;
+    for (const FFTKernels* kernels : fft_available_kernels()) {
+        FFTPlanConfig config = start;
+        config.kernels = kernels->name;
+        if (config.kernels != start.kernels)
+            consider(config);
+    }
+
+    FFTPlanConfig radices = best;
+    radices.radices = best.radices == FFTRadices::Radix4 ? FFTRadices::Radix2 : FFTRadices::Radix4;
+    consider(radices);
+
+    // The matrix product only stands a chance on short lines that would otherwise run Bluestein.
+    const int matrix_limit = 1024;
+    if (!is_smooth(width) && width <= matrix_limit) {
+        FFTPlanConfig config = best;
+        config.rowAlgorithm = best.rowAlgorithm == FFTLineAlgorithm::FFT ? FFTLineAlgorithm::DFTMatrix
+                                                                         : FFTLineAlgorithm::FFT;
+        consider(config);
+    }
+    if (!is_smooth(height) && height <= matrix_limit) {
+        FFTPlanConfig config = best;
+        config.columnAlgorithm = best.columnAlgorithm == FFTLineAlgorithm::FFT ? FFTLineAlgorithm::DFTMatrix
+                                                                               : FFTLineAlgorithm::FFT;
+        consider(config);
+    }
+
+    FFTPlanConfig column_pass = best;
+    column_pass.columnPass = best.columnPass == FFTColumnPass::Strided ? FFTColumnPass::Transposed
+                                                                       : FFTColumnPass::Strided;
+    consider(column_pass);
+
+    int pool = ThreadPool::global().size();
+    if (best.threads == 0)
+        best.threads = pool;
+    for (int threads = 1; threads < pool; threads *= 2) {
+        FFTPlanConfig config = best;
+        config.threads = threads;
+        consider(config);
+    }
+    return best;
+}
+
+template<typename Real>
+FFTPlanConfig fft_tuned_config(int width, int height)
+{
+    FFTPlanConfig config;
+    if (!fft_wisdom().lookup(cpu_model(), precision_name<Real>(), width, height, config)) {
+        config = fft_autotune<Real>(width, height);
+        fft_wisdom().store(cpu_model(), precision_name<Real>(), width, height, config);
+    }
+    return config;
+}
+
+template FFTPlanConfig fft_plan_config<float>(const BasicFFTPlan<float>& plan);
+template FFTPlanConfig fft_plan_config<double>(const BasicFFTPlan<double>& plan);
+template FFTPlanConfig fft_plan_config<long double>(const BasicFFTPlan<long double>& plan);
+template void fft_apply_config<float>(BasicFFTPlan<float>& plan, const FFTPlanConfig& config);
+template void fft_apply_config<double>(BasicFFTPlan<double>& plan, const FFTPlanConfig& config);
+template void fft_apply_config<long double>(BasicFFTPlan<long double>& plan, const FFTPlanConfig& config);
+template bool fft_apply_wisdom<float>(BasicFFTPlan<float>& plan, int width, int height);
+template bool fft_apply_wisdom<double>(BasicFFTPlan<double>& plan, int width, int height);
+template bool fft_apply_wisdom<long double>(BasicFFTPlan<long double>& plan, int width, int height);
+template FFTPlanConfig fft_autotune<float>(int width, int height, int runs, std::vector<FFTTuneTrial>* trials);
+template FFTPlanConfig fft_autotune<double>(int width, int height, int runs, std::vector<FFTTuneTrial>* trials);
+template FFTPlanConfig fft_tuned_config<float>(int width, int height);
+template FFTPlanConfig fft_tuned_config<double>(int width, int height);
@@ -0,0 +1,74 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "fft.h"
+
+// Everything the autotuner varies on a BasicFFTPlan. kernels is an FFTKernels::name, empty for
+// fft_kernels(); threads 0 means the whole pool.
+struct FFTPlanConfig {
+    FFTRadices radices = FFTRadices::Radix4;
+    FFTColumnPass columnPass = FFTColumnPass::Strided;
+    FFTLineAlgorithm rowAlgorithm = FFTLineAlgorithm::FFT;
+    FFTLineAlgorithm columnAlgorithm = FFTLineAlgorithm::FFT;
+    std::string kernels;
+    int threads = 0;
+};
+
+template<typename Real>
+FFTPlanConfig fft_plan_config(const BasicFFTPlan<Real>& plan);
+
+// Kernel sets this CPU lacks are ignored, leaving the plan on its current set.
+template<typename Real>
+void fft_apply_config(BasicFFTPlan<Real>& plan, const FFTPlanConfig& config);
+
+// "radix4 transposed fft fft avx2 8", the form stored in wisdom files.
+std::string fft_config_string(const FFTPlanConfig& config);
+bool fft_parse_config(const std::string& text, FFTPlanConfig& config);
+
+// Tuned configurations keyed by CPU model, precision and size, one tab-separated line each:
+//   <cpu model> <precision> <width> <height> <config>
+// Entries for other CPU models are kept, so one file can serve a mixed fleet. store() rewrites
+// the file (through a temporary and a rename) so that it is never left half written.
+class FFTWisdom
+{
+public:
+    explicit FFTWisdom(const std::string& path);
+
+    const std::string& path() const { return file; }
+    bool lookup(const std::string& cpu, const std::string& precision, int width, int height,
+        FFTPlanConfig& config) const;
+    void store(const std::string& cpu, const std::string& precision, int width, int height,
+        const FFTPlanConfig& config);
+
+private:
+    std::string file;
+    std::map<std::string, std::string> entries;
+    mutable std::mutex mutex;
+};
+
+// Read once, from the file named by $FFT_WISDOM or fft_wisdom.txt in the working directory.
+// fft_plan_2d() configures each new plan from it when it has an entry for this CPU and size.
+FFTWisdom& fft_wisdom();
+
+template<typename Real>
+bool fft_apply_wisdom(BasicFFTPlan<Real>& plan, int width, int height);
+
+struct FFTTuneTrial {
+    FFTPlanConfig config;
+    double seconds;
+};
+
+// Times forward transforms of a random 8-bit width x height image under the candidate
+// configurations and returns the fastest. The knobs are tuned one after another (kernel set,
+// radices, line algorithms of non-smooth axes, column pass, thread count), each candidate
+// starting from the best so far, which costs a dozen or so timings instead of their product.
+// trials, when given, receives every timing.
+template<typename Real>
+FFTPlanConfig fft_autotune(int width, int height, int runs = 3, std::vector<FFTTuneTrial>* trials = nullptr);
+
+// The fft_wisdom() entry for this CPU and size, or a fresh fft_autotune() result stored there.
+template<typename Real>
+FFTPlanConfig fft_tuned_config(int width, int height);
@@ -0,0 +1,578 @@
+#include "benchmark.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "autotune.h"
+#include "buffer2d.h"
+#include "convolution.h"
+#include "distributed.h"
+#include "fft.h"
+#include "fft_kernels.h"
+#include "image_io.h"
+#include "pruned.h"
+#include "thread_pool.h"
+#include "workspace.h"
+
+template<typename F>
+static double best_seconds(int runs, F&& run)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+void benchmark_threads(int width, int height, int max_threads)
+{
+    if (max_threads <= 0)
+        max_threads = (int)std::thread::hardware_concurrency();
+    if (max_threads <= 0)
+        max_threads = 1;
+
+    Buffer2D<short> in(width, height);
+    Buffer2D<double> re(width, height), im(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            in.row(x)[y] = rand() % 256;
+    FFTPlan& plan = fft_plan_2d(width, height, FFTDirection::Forward);
+
+    std::vector<int> counts;
+    for (int threads = 1; threads < max_threads; threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(max_threads);
+
+    std::cout << "fft_2d " << width << "x" << height << ", kernels " << fft_kernels().name << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "ms" << std::setw(10) << "speedup"
+        << std::setw(12) << "efficiency" << std::endl;
+
+    double base = 0;
+    for (int threads : counts) {
+        ThreadPool::setGlobalThreadCount(threads);
+        plan.execute(in, re, im);
+        double seconds = best_seconds(3, [&] { plan.execute(in, re, im); });
+        if (threads == 1)
+            base = seconds;
+
+        double speedup = base / seconds;
+        std::cout << std::setw(8) << threads << std::setw(12) << std::fixed << std::setprecision(1)
+            << seconds * 1000.0 << std::setw(10) << std::setprecision(2) << speedup
+            << std::setw(11) << std::setprecision(0) << speedup / threads * 100.0 << "%" << std::endl;
+    }
+
+    ThreadPool::setGlobalThreadCount(0);
+}
+
+void benchmark_column_pass(int min_width, int max_width, int height)
+{
+    std::cout << "fft_2d column pass, kernels " << fft_kernels().name << ", " << ThreadPool::global().size()
+        << " threads" << std::endl;
+    std::cout << std::setw(8) << "width" << std::setw(8) << "height" << std::setw(12) << "strided" << std::setw(12)
+        << "transposed" << std::setw(10) << "speedup" << std::endl;
+
+    for (int width = min_width; width <= max_width; width *= 2) {
+        int rows = height > 0 ? height : width;
+        Buffer2D<short> in(width, rows);
+        Buffer2D<double> re(width, rows), im(width, rows);
+        for (int x = 0; x < rows; x++)
+            for (int y = 0; y < width; y++)
+                in.row(x)[y] = rand() % 256;
+
+        FFTPlan plan(width, rows, FFTDirection::Forward);
+        double seconds[2];
+        const FFTColumnPass modes[2] = { FFTColumnPass::Strided, FFTColumnPass::Transposed };
+        for (int i = 0; i < 2; i++) {
+            plan.setColumnPass(modes[i]);
+            plan.execute(in, re, im);
+            seconds[i] = best_seconds(3, [&] { plan.execute(in, re, im); });
+        }
+
+        std::cout << std::setw(8) << width << std::setw(8) << rows << std::fixed << std::setprecision(1)
+            << std::setw(12) << seconds[0] * 1000.0 << std::setw(12) << seconds[1] * 1000.0
+            << std::setw(10) << std::setprecision(2) << seconds[0] / seconds[1] << std::endl;
+    }
+}
+
+void benchmark_batch(int width, int height, int count)
+{
+    std::vector<Buffer2D<short>> in;
+    std::vector<Buffer2D<double>> re, im;
+    for (int i = 0; i < count; i++) {
+        in.emplace_back(width, height);
+        re.emplace_back(width, height);
+        im.emplace_back(width, height);
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                in[i].row(x)[y] = rand() % 256;
+    }
+    FFTPlan plan(width, height, FFTDirection::Forward);
+
+    auto single = [&] {
+        for (int i = 0; i < count; i++)
+            plan.execute(in[i], re[i], im[i]);
+    };
+    auto batch = [&] { plan.executeBatch(in.data(), re.data(), im.data(), count); };
+    single();
+    batch();
+    double single_seconds = best_seconds(3, single);
+    double batch_seconds = best_seconds(3, batch);
+
+    std::cout << count << " x fft_2d " << width << "x" << height << ", kernels " << fft_kernels().name << ", "
+        << ThreadPool::global().size() << " threads" << std::endl;
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << std::setw(10) << "execute" << std::setw(12) << count / single_seconds << " images/s" << std::endl;
+    std::cout << std::setw(10) << "batch" << std::setw(12) << count / batch_seconds << " images/s" << std::endl;
+}
+
+void benchmark_workspace(int width, int height)
+{
+    Buffer2D<unsigned char> in(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            in.row(x)[y] = rand() % 256;
+    Buffer2D<double> re(width, height), im(width, height);
+
+    std::cout << "fft_2d " << width << "x" << height << ", kernels " << fft_kernels().name << ", "
+        << ThreadPool::global().size() << " threads" << std::endl;
+    std::cout << std::setw(8) << "pages" << std::setw(12) << "first ms" << std::setw(12) << "best ms" << std::setw(12)
+        << "worst ms" << std::setw(14) << "reserved MB" << std::setw(14) << "explicit MB" << std::endl;
+    bool huge_pages = workspace_huge_pages();
+    for (bool huge : { false, true }) {
+        workspace_use_huge_pages(huge);
+        FFTPlan plan(width, height, FFTDirection::Forward);
+        auto start = std::chrono::steady_clock::now();
+        plan.execute(in, re, im);
+        std::chrono::duration<double> first = std::chrono::steady_clock::now() - start;
+
+        double best = 1e30, worst = 0;
+        for (int i = 0; i < 10; i++) {
+            start = std::chrono::steady_clock::now();
+            plan.execute(in, re, im);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+            worst = std::max(worst, elapsed.count());
+        }
+        WorkspaceStats stats = plan.workspaceStats();
+        std::cout << std::setw(8) << (huge ? "huge" : "normal") << std::fixed << std::setprecision(2) << std::setw(12)
+            << first.count() * 1000.0 << std::setw(12) << best * 1000.0 << std::setw(12) << worst * 1000.0
+            << std::setw(14) << stats.reserved / 1048576.0 << std::setw(14) << stats.hugePages / 1048576.0 << std::endl;
+    }
+    workspace_use_huge_pages(huge_pages);
+
+    WorkspaceStats totals = workspace_totals();
+    std::cout << "all workspaces: " << totals.reserved / 1048576.0 << " MB reserved, " << totals.peak / 1048576.0
+        << " MB peak, " << totals.blocks << " blocks mapped" << std::endl;
+}
+
+void benchmark_decode(const std::string& path)
+{
+    std::cout << path << ", " << ThreadPool::global().size() << " threads" << std::endl;
+    std::cout << std::setw(8) << "scale" << std::setw(14) << "size" << std::setw(12) << "decode ms" << std::setw(12)
+        << "fft ms" << std::setw(10) << "speedup" << std::endl;
+    double base = 0;
+    for (int scale = 1; scale <= 8; scale *= 2) {
+        Buffer2D<float> image = read_image(path, scale);
+        Buffer2D<float> re(image.width() / 2 + 1, image.height()), im(image.width() / 2 + 1, image.height());
+        FFTRealPlanf& plan = fft_plan_real_2d<float>(image.width(), image.height());
+        double decode = best_seconds(5, [&] { image = read_image(path, scale); });
+        double transform = best_seconds(5, [&] { plan.forward(image, re, im); });
+        if (scale == 1)
+            base = decode + transform;
+
+        std::string size = std::to_string(image.width()) + "x" + std::to_string(image.height());
+        std::cout << std::setw(8) << scale << std::setw(14) << size << std::fixed << std::setprecision(2)
+            << std::setw(12) << decode * 1000.0 << std::setw(12) << transform * 1000.0 << std::setw(10)
+            << base / (decode + transform) << std::endl;
+    }
+}
+
+// Rows of a random 8-bit image through the FFT (Bluestein) and through the DFT matrix product,
+// with the columns left to the FFT; returns { fft seconds, matrix seconds }.
+template<typename Real>
+static std::pair<double, double> time_dft_matrix(int width, int height)
+{
+    Buffer2D<unsigned char> in(width, height);
+    Buffer2D<Real> re(width, height), im(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            in.row(x)[y] = rand() % 256;
+
+    BasicFFTPlan<Real> plan(width, height, FFTDirection::Forward);
+    plan.setLineAlgorithms(FFTLineAlgorithm::FFT, FFTLineAlgorithm::FFT);
+    plan.execute(in, re, im);
+    double fft_seconds = best_seconds(3, [&] { plan.execute(in, re, im); });
+    plan.setLineAlgorithms(FFTLineAlgorithm::DFTMatrix, FFTLineAlgorithm::FFT);
+    plan.execute(in, re, im);
+    double matrix_seconds = best_seconds(3, [&] { plan.execute(in, re, im); });
+    return std::make_pair(fft_seconds, matrix_seconds);
+}
+
+void benchmark_dft_matrix(int height)
+{
+    const int widths[] = { 11, 23, 47, 97, 127, 197, 251, 397, 509, 797, 1021, 1597 };
+
+    std::cout << "fft_2d prime widths x " << height << ", kernels " << fft_kernels().name << ", "
+        << ThreadPool::global().size() << " threads" << std::endl;
+    std::cout << std::setw(8) << "width" << std::setw(12) << "float fft" << std::setw(12) << "matrix"
+        << std::setw(12) << "double fft" << std::setw(12) << "matrix" << std::endl;
+
+    for (int width : widths) {
+        std::pair<double, double> single = time_dft_matrix<float>(width, height);
+        std::pair<double, double> full = time_dft_matrix<double>(width, height);
+        std::cout << std::setw(8) << width << std::fixed << std::setprecision(2) << std::setw(12)
+            << single.first * 1000.0 << std::setw(12) << single.second * 1000.0 << std::setw(12)
+            << full.first * 1000.0 << std::setw(12) << full.second * 1000.0 << std::endl;
+    }
+}
+
+static const char* pruning_name(FFTPruning pruning)
+{
+    switch (pruning) {
+    case FFTPruning::Full:
+        return "full";
+    case FFTPruning::OutputPruned:
+        return "output";
+    case FFTPruning::InputPruned:
+        return "input";
+    case FFTPruning::Goertzel:
+        return "goertzel";
+    default:
+        return "auto";
+    }
+}
+
+void benchmark_pruned(int size, int input)
+{
+    Buffer2D<unsigned char> in(input, input), padded(size, size);
+    for (int x = 0; x < size; x++)
+        for (int y = 0; y < size; y++)
+            padded.row(x)[y] = x < input && y < input ? rand() % 256 : 0;
+    for (int x = 0; x < input; x++)
+        for (int y = 0; y < input; y++)
+            in.row(x)[y] = padded.row(x)[y];
+
+    std::cout << input << "x" << input << " zero-padded to " << size << "x" << size << ", kernels "
+        << fft_kernels().name << ", " << ThreadPool::global().size() << " threads" << std::endl;
+    Buffer2D<double> re(size, size), im(size, size);
+    FFTPlan& plan = fft_plan_2d(size, size, FFTDirection::Forward);
+    plan.execute(padded, re, im);
+    double full_seconds = best_seconds(3, [&] { plan.execute(padded, re, im); });
+    std::cout << std::setw(10) << "window" << std::setw(10) << "rows" << std::setw(10) << "columns" << std::setw(12)
+        << "ms" << std::setw(10) << "speedup" << std::endl;
+    std::cout << std::setw(10) << "FFTPlan" << std::setw(20) << "" << std::setw(12) << std::fixed
+        << std::setprecision(2) << full_seconds * 1000.0 << std::endl;
+
+    for (int window = 1; window <= size; window *= 4) {
+        FFTWindow bins = { -window / 2, window };
+        FFTPrunedPlan pruned(size, size, FFTDirection::Forward, input, input, bins, bins);
+        Buffer2D<double> out_re(window, window), out_im(window, window);
+        pruned.execute(in, out_re, out_im);
+        double seconds = best_seconds(3, [&] { pruned.execute(in, out_re, out_im); });
+        std::cout << std::setw(10) << window << std::setw(10) << pruning_name(pruned.rowPlan().pruning())
+            << std::setw(10) << pruning_name(pruned.columnPlan().pruning()) << std::setw(12) << seconds * 1000.0
+            << std::setw(10) << full_seconds / seconds << std::endl;
+    }
+
+    const int rows[] = { 0, 1, 7, size / 3 }, columns[] = { 0, 2, size - 5, size / 5 };
+    Complex bins[4];
+    double seconds = best_seconds(3, [&] { fft_2d_bins(padded, rows, columns, 4, bins); });
+    std::cout << std::setw(10) << "4 bins" << std::setw(20) << "goertzel" << std::setw(12) << seconds * 1000.0
+        << std::setw(10) << full_seconds / seconds << std::endl;
+}
+
+template<typename Real>
+struct PrecisionRun {
+    double complexSeconds;
+    double realSeconds;
+    Buffer2D<Real> re, im, reHalf, imHalf;
+};
+
+template<typename Real>
+static void tune_precision(const char* name, int width, int height)
+{
+    std::vector<FFTTuneTrial> trials;
+    FFTPlanConfig best = fft_autotune<Real>(width, height, 3, &trials);
+    std::cout << name << std::endl;
+    for (const FFTTuneTrial& trial : trials)
+        std::cout << std::setw(40) << fft_config_string(trial.config) << std::setw(12) << std::fixed
+            << std::setprecision(2) << trial.seconds * 1000.0 << std::endl;
+    std::cout << "best: " << fft_config_string(best) << std::endl;
+    fft_wisdom().store(cpu_model(), name, width, height, best);
+}
+
+void benchmark_autotune(int width, int height)
+{
+    std::cout << "Tuning the forward " << width << "x" << height << " FFTPlan on " << cpu_model() << ", "
+        << ThreadPool::global().size() << " threads" << std::endl;
+    tune_precision<float>("float", width, height);
+    tune_precision<double>("double", width, height);
+    std::cout << "Stored in " << fft_wisdom().path() << std::endl;
+}
+
+template<typename Real>
+static PrecisionRun<Real> run_precision(const Buffer2D<unsigned char>& in)
+{
+    int width = in.width(), height = in.height();
+    PrecisionRun<Real> run = { 0, 0, Buffer2D<Real>(width, height), Buffer2D<Real>(width, height),
+        Buffer2D<Real>(width / 2 + 1, height), Buffer2D<Real>(width / 2 + 1, height) };
+    BasicFFTPlan<Real> plan(width, height, FFTDirection::Forward);
+    BasicFFTRealPlan<Real> real_plan(width, height);
+    plan.execute(in, run.re, run.im);
+    real_plan.forward(in, run.reHalf, run.imHalf);
+    run.complexSeconds = best_seconds(3, [&] { plan.execute(in, run.re, run.im); });
+    run.realSeconds = best_seconds(3, [&] { real_plan.forward(in, run.reHalf, run.imHalf); });
+    return run;
+}
+
+template<typename Real>
+static double relative_error(const PrecisionRun<Real>& run, const PrecisionRun<long double>& reference)
+{
+    long double error = 0;
+    for (int x = 0; x < run.re.height(); x++) {
+        for (int y = 0; y < run.re.width(); y++) {
+            error = std::max(error, std::abs(run.re.row(x)[y] - reference.re.row(x)[y]));
+            error = std::max(error, std::abs(run.im.row(x)[y] - reference.im.row(x)[y]));
+        }
+        for (int y = 0; y < run.reHalf.width(); y++) {
+            error = std::max(error, std::abs(run.reHalf.row(x)[y] - reference.reHalf.row(x)[y]));
+            error = std::max(error, std::abs(run.imHalf.row(x)[y] - reference.imHalf.row(x)[y]));
+        }
+    }
+    return (double)(error / std::max(1.0L, reference.re.row(0)[0]));
+}
+
+template<typename Real>
+static void print_precision(const char* name, const PrecisionRun<Real>& run, double error)
+{
+    std::cout << std::setw(12) << name << std::fixed << std::setprecision(1) << std::setw(12)
+        << run.complexSeconds * 1000.0 << std::setw(12) << run.realSeconds * 1000.0 << std::scientific
+        << std::setprecision(2) << std::setw(12) << error << std::endl;
+}
+
+void benchmark_precision(int width, int height)
+{
+    Buffer2D<unsigned char> in(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            in.row(x)[y] = rand() % 256;
+
+    PrecisionRun<float> single = run_precision<float>(in);
+    PrecisionRun<double> full = run_precision<double>(in);
+    PrecisionRun<long double> extended = run_precision<long double>(in);
+
+    std::cout << "fft_2d " << width << "x" << height << ", kernels " << fft_kernels().name << ", "
+        << ThreadPool::global().size() << " threads" << std::endl;
+    std::cout << std::setw(12) << "precision" << std::setw(12) << "c2c ms" << std::setw(12) << "r2c ms"
+        << std::setw(12) << "error" << std::endl;
+    print_precision("float", single, relative_error(single, extended));
+    print_precision("double", full, relative_error(full, extended));
+    print_precision("long double", extended, 0.0);
+}
+
+void benchmark_convolution(int width, int height, int kernel)
+{
+    Buffer2D<float> image(width, height), weights(kernel, kernel), out(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            image.row(x)[y] = (float)(rand() % 256);
+    for (int i = 0; i < kernel; i++)
+        for (int j = 0; j < kernel; j++)
+            weights.row(i)[j] = (float)(rand() % 1000) / 1000.0f;
+
+    std::cout << width << "x" << height << " (*) " << kernel << "x" << kernel << ", kernels " << fft_kernels().name
+        << ", " << ThreadPool::global().size() << " threads" << std::endl;
+    std::cout << std::setw(14) << "method" << std::setw(14) << "transform" << std::setw(12) << "ms" << std::endl;
+
+    const FFTConvolutionMethod methods[] = { FFTConvolutionMethod::Full, FFTConvolutionMethod::OverlapSave,
+        FFTConvolutionMethod::OverlapAdd, FFTConvolutionMethod::Auto };
+    const char* names[] = { "full", "overlap-save", "overlap-add", "auto" };
+    for (int m = 0; m < 4; m++) {
+        FFTConvolutionf convolution(weights, width, height, methods[m]);
+        convolution.execute(image, out);
+        double seconds = best_seconds(3, [&] { convolution.execute(image, out); });
+        std::string transform = std::to_string(convolution.transformWidth()) + "x"
+            + std::to_string(convolution.transformHeight());
+        std::string name = names[m];
+        if (methods[m] == FFTConvolutionMethod::Auto)
+            name += convolution.method() == FFTConvolutionMethod::Full ? " (full)" : " (overlap-save)";
+        std::cout << std::setw(14) << name << std::setw(14) << transform << std::setw(12) << std::fixed
+            << std::setprecision(1) << seconds * 1000.0 << std::endl;
+    }
+}
+
+static unsigned char distributed_pixel(int x, int y)
+{
+    return (unsigned char)((x * 37 + y * 101 + x * y / 7) % 251);
+}
+
+// Every rank's share of a run_distributed(): the phases and verdicts go to every rank so that
+// rank 0 can report the slowest.
+static bool distributed_run(FFTTransport& transport, int width, int height, int runs, bool verify,
+    FFTDistributedTimes& slowest)
+{
+    FFTDistributedPlan plan(width, height, FFTDirection::Forward, transport);
+    FFTSlab rows = plan.inputSlab(), columns = plan.outputSlab();
+    Buffer2D<unsigned char> in(width, rows.count);
+    for (int r = 0; r < rows.count; r++)
+        for (int y = 0; y < width; y++)
+            in.row(r)[y] = distributed_pixel(rows.begin + r, y);
+    Buffer2D<double> re(height, columns.count), im(height, columns.count);
+
+    // total is the wall time from one barrier to the next, which is what the slowest rank takes.
+    FFTDistributedTimes best;
+    best.total = 1e30;
+    for (int i = 0; i <= runs; i++) {
+        transport.barrier();
+        auto start = std::chrono::steady_clock::now();
+        plan.execute(in, re, im);
+        transport.barrier();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (i > 0 && elapsed.count() < best.total) {
+            best = plan.lastTimes();
+            best.total = elapsed.count();
+        }
+    }
+
+    bool ok = true;
+    if (verify) {
+        Buffer2D<unsigned char> image(width, height);
+        Buffer2D<double> re_ref(width, height), im_ref(width, height);
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                image.row(x)[y] = distributed_pixel(x, y);
+        FFTPlan(width, height, FFTDirection::Forward).execute(image, re_ref, im_ref);
+        double error = 0;
+        for (int c = 0; c < columns.count; c++) {
+            for (int x = 0; x < height; x++) {
+                error = fmax(error, fabs(re.row(c)[x] - re_ref.row(x)[columns.begin + c]));
+                error = fmax(error, fabs(im.row(c)[x] - im_ref.row(x)[columns.begin + c]));
+            }
+        }
+        ok = error <= 1e-12 * fmax(1.0, re_ref.row(0)[0]);
+    }
+
+    struct Report {
+        FFTDistributedTimes times;
+        double ok;
+    };
+    std::vector<Report> sent(transport.size(), Report{ best, ok ? 1.0 : 0.0 }), received(transport.size());
+    transport.allToAll(sent.data(), received.data(), sizeof(Report));
+    slowest = FFTDistributedTimes();
+    for (const Report& report : received) {
+        slowest.rows = std::max(slowest.rows, report.times.rows);
+        slowest.exchange = std::max(slowest.exchange, report.times.exchange);
+        slowest.columns = std::max(slowest.columns, report.times.columns);
+        slowest.total = std::max(slowest.total, report.times.total);
+        ok = ok && report.ok != 0;
+    }
+    return ok;
+}
+
+int distributed_rank(const std::string& segment, int width, int height, int threads, int runs, bool verify, int rank)
+{
+    ThreadPool::setGlobalThreadCount(threads);
+    FFTSharedMemoryTransport transport(segment, rank);
+    FFTDistributedTimes times;
+    return distributed_run(transport, width, height, runs, verify, times) ? 0 : 1;
+}
+
+bool run_distributed(const std::string& executable, int processes, int width, int height, int threads, int runs,
+    bool verify, FFTDistributedTimes* times)
+{
+    int previous = ThreadPool::global().size();
+    ThreadPool::setGlobalThreadCount(threads);
+    FFTDistributedTimes slowest;
+    bool ok;
+    if (processes == 1) {
+        FFTLocalTransport transport;
+        ok = distributed_run(transport, width, height, runs, verify, slowest);
+    } else {
+        // Slots of up to 4 MB per pair of ranks; bigger blocks take several rounds.
+        size_t block = (size_t)fft_slab(height, processes, 0).count * fft_slab(width, processes, 0).count * sizeof(Complex);
+        std::string segment = FFTSharedMemoryTransport::uniqueName();
+        FFTSharedMemoryTransport transport(segment, processes, std::min(block, (size_t)4 << 20));
+        FFTLocalRanks ranks(executable,
+            { "distributed-rank", segment, std::to_string(width), std::to_string(height), std::to_string(threads),
+                std::to_string(runs), verify ? "1" : "0" },
+            processes);
+        ok = distributed_run(transport, width, height, runs, verify, slowest);
+        ok = ranks.wait() && ok;
+    }
+    ThreadPool::setGlobalThreadCount(previous);
+    if (times != nullptr)
+        *times = slowest;
+    return ok;
+}
+
+static void print_distributed(int processes, int threads, int width, int height, const FFTDistributedTimes& times,
+    double engine_seconds, double base_seconds)
+{
+    double total = times.total;
+    std::cout << std::setw(6) << processes << std::setw(8) << threads << std::setw(12)
+        << (std::to_string(width) + "x" + std::to_string(height)) << std::fixed << std::setprecision(1)
+        << std::setw(10) << times.rows * 1000.0 << std::setw(10) << times.exchange * 1000.0 << std::setw(10)
+        << times.columns * 1000.0 << std::setw(10) << total * 1000.0 << std::setw(10) << engine_seconds * 1000.0
+        << std::setw(11) << std::setprecision(0) << base_seconds / total * 100.0 << "%" << std::endl;
+}
+
+void benchmark_distributed(const std::string& executable, int size, int max_processes)
+{
+    int hardware = (int)std::thread::hardware_concurrency();
+    if (hardware <= 0)
+        hardware = 1;
+
+    // The single-process engine with every thread, on the same image.
+    auto engine = [&](int width, int height) {
+        Buffer2D<unsigned char> in(width, height);
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                in.row(x)[y] = distributed_pixel(x, y);
+        Buffer2D<double> re(width, height), im(width, height);
+        FFTPlan plan(width, height, FFTDirection::Forward);
+        plan.execute(in, re, im);
+        return best_seconds(3, [&] { plan.execute(in, re, im); });
+    };
+
+    std::cout << "distributed fft_2d over shared memory, kernels " << fft_kernels().name << ", " << hardware
+        << " hardware threads" << std::endl;
+    std::cout << std::setw(6) << "ranks" << std::setw(8) << "threads" << std::setw(12) << "size" << std::setw(10)
+        << "rows ms" << std::setw(10) << "a2a ms" << std::setw(10) << "cols ms" << std::setw(10) << "total"
+        << std::setw(10) << "FFTPlan" << std::setw(12) << "efficiency" << std::endl;
+
+    std::cout << "strong scaling" << std::endl;
+    double engine_seconds = engine(size, size), base = 0;
+    for (int processes = 1; processes <= max_processes; processes *= 2) {
+        int threads = std::max(1, hardware / processes);
+        FFTDistributedTimes times;
+        if (!run_distributed(executable, processes, size, size, threads, 3, false, &times))
+            throw std::runtime_error("Distributed FFT run failed!");
+        if (processes == 1)
+            base = times.total;
+        print_distributed(processes, threads, size, size, times, engine_seconds, base);
+    }
+
+    std::cout << "weak scaling" << std::endl;
+    for (int processes = 1; processes <= max_processes; processes *= 2) {
+        int threads = std::max(1, hardware / processes);
+        FFTDistributedTimes times;
+        if (!run_distributed(executable, processes, size, size * processes, threads, 3, false, &times))
+            throw std::runtime_error("Distributed FFT run failed!");
+        if (processes == 1)
+            base = times.total;
+        print_distributed(processes, threads, size, size * processes, times, engine(size, size * processes),
+            base * processes);
+    }
+}
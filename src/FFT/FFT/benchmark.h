@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+
+#include "distributed.h"
+
+// Times the cached forward FFTPlan on a random width x height image at 1, 2, 4, ... threads up to max_threads
+// (0: all hardware threads) and prints the speedup over one thread.
+void benchmark_threads(int width, int height, int max_threads);
+
+// Times the forward FFTPlan with strided and with transposed column passes on random images of
+// width min_width, 2 * min_width, ... max_width and the given height (0: square).
+void benchmark_column_pass(int min_width, int max_width, int height);
+
+// Throughput of count random width x height images through the forward FFTPlan, one execute()
+// per image against one executeBatch() call, in images per second.
+void benchmark_batch(int width, int height, int count);
+
+// Forward complex and real-input 2D FFT of a random 8-bit width x height image in float, double
+// and long double: time per transform and max error against long double, relative to the DC term.
+void benchmark_precision(int width, int height);
+
+// Forward FFTPlan in float and double on random images with prime widths from 11 to 1597 and
+// the given height, with the rows run through Bluestein and through the DFT matrix product.
+void benchmark_dft_matrix(int height);
+
+// Windows of 1, 4, 16, ... bins square around DC of the forward FFT of a random input x input
+// image zero-padded to size x size, by FFTPrunedPlan against the full FFTPlan, and four scattered
+// bins by fft_2d_bins on the padded image.
+void benchmark_pruned(int size, int input);
+
+// A random width x height image convolved with a random kernel x kernel kernel by each FFTConvolution
+// method, with the transform size each one picked and the method chosen by Auto.
+void benchmark_convolution(int width, int height, int kernel);
+
+// Autotunes the forward float and double FFTPlan for a width x height image, prints every trial
+// and the winner, and stores the winners in fft_wisdom() for later runs on this CPU.
+void benchmark_autotune(int width, int height);
+
+// The forward FFTPlan on a random width x height image with its workspace on ordinary and on
+// huge pages (explicit where the OS grants them, else transparent): first call (which maps the
+// workspace), best and worst of the following calls, and the workspace counters. Non-square
+// sizes keep the transposed planes in the workspace.
+void benchmark_workspace(int width, int height);
+
+// read_image() of a JPEG or PNG at scale 1, 2, 4 and 8, and the float r2c FFT of the result:
+// best of five runs each, and the speedup of decode plus transform over the full resolution.
+void benchmark_decode(const std::string& path);
+
+// One width x height forward transform split over processes ranks on this machine: rank 0 is the
+// calling process, the others are copies of executable started in the "distributed-rank" mode
+// (distributed_rank()), all talking through an FFTSharedMemoryTransport and each running threads
+// pool threads. The image is synthetic; each rank runs the plan runs times after a warm-up and,
+// with verify, checks its slab of the spectrum against FFTPlan. times gets the slowest rank's
+// phases of its fastest run, total being barrier to barrier. False if any rank failed.
+bool run_distributed(const std::string& executable, int processes, int width, int height, int threads, int runs,
+    bool verify, FFTDistributedTimes* times);
+int distributed_rank(const std::string& segment, int width, int height, int threads, int runs, bool verify, int rank);
+
+// Strong scaling (size x size over 1, 2, 4, ... max_processes processes) and weak scaling
+// (size x size rows per process) of the distributed plan against the single-process
+// multithreaded FFTPlan on the same size. The processes split the hardware threads, so on one
+// machine ideal strong scaling keeps the one-process time and ideal weak scaling grows it with
+// the process count; efficiency is measured against that.
+void benchmark_distributed(const std::string& executable, int size, int max_processes);
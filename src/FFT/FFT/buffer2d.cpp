@@ -0,0 +1,42 @@
+#include "buffer2d.h"
+
+#include <stdlib.h>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+void* aligned_malloc(size_t bytes, size_t alignment)
+{
+#ifdef _MSC_VER
+    void* pointer = _aligned_malloc(bytes, alignment);
+#else
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, alignment, bytes) != 0)
+        pointer = nullptr;
+#endif
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void aligned_free(void* pointer)
+{
+#ifdef _MSC_VER
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
+
+size_t padded_stride(int width, size_t element_size, bool avoid_aliasing)
+{
+    size_t bytes = (size_t)width * element_size;
+    bytes = (bytes + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+    if (avoid_aliasing && bytes > 0 && bytes % 4096 == 0)
+        bytes += BUFFER_ALIGNMENT;
+
+    // Element sizes that do not divide the cache line (e.g. 3-byte pixels) keep the exact width.
+    if (bytes % element_size != 0)
+        return (size_t)width;
+    return bytes / element_size;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+const size_t BUFFER_ALIGNMENT = 64;
+
+void* aligned_malloc(size_t bytes, size_t alignment);
+void aligned_free(void* pointer);
+
+// Row stride in elements for a row of width elements: rows start on a 64-byte boundary and,
+// with avoid_aliasing, a stride that is a multiple of 4 KiB gets one extra cache line so
+// that walking down a column does not map every row onto the same cache set.
+size_t padded_stride(int width, size_t element_size, bool avoid_aliasing);
+
+// Contiguous 2D image or spectrum plane: height rows of width elements, stride() elements
+// apart. Owning buffers are 64-byte aligned and zero-initialized; view() wraps memory owned
+// by someone else, e.g. a block carved from a WorkspaceArena, without copying it.
+template<typename T>
+class Buffer2D
+{
+public:
+    Buffer2D() = default;
+
+    Buffer2D(int width, int height, bool avoid_aliasing = true)
+        : numCols(width), numRows(height), rowStride(padded_stride(width, sizeof(T), avoid_aliasing)), owned(true)
+    {
+        if (width < 0 || height < 0)
+            throw std::runtime_error("Invalid buffer size!");
+        size_t bytes = rowStride * height * sizeof(T);
+        pixels = (T*)aligned_malloc(bytes > 0 ? bytes : BUFFER_ALIGNMENT, BUFFER_ALIGNMENT);
+        memset((void*)pixels, 0, bytes);
+    }
+
+    static Buffer2D view(T* data, int width, int height, size_t stride)
+    {
+        Buffer2D buffer;
+        buffer.pixels = data;
+        buffer.numCols = width;
+        buffer.numRows = height;
+        buffer.rowStride = stride;
+        buffer.owned = false;
+        return buffer;
+    }
+
+    Buffer2D(Buffer2D&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    Buffer2D& operator=(Buffer2D&& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            pixels = other.pixels;
+            numCols = other.numCols;
+            numRows = other.numRows;
+            rowStride = other.rowStride;
+            owned = other.owned;
+            other.pixels = nullptr;
+            other.owned = false;
+        }
+        return *this;
+    }
+
+    Buffer2D(const Buffer2D&) = delete;
+    Buffer2D& operator=(const Buffer2D&) = delete;
+
+    ~Buffer2D()
+    {
+        release();
+    }
+
+    int width() const { return numCols; }
+    int height() const { return numRows; }
+    size_t stride() const { return rowStride; }
+    bool isView() const { return !owned; }
+
+    T* data() { return pixels; }
+    const T* data() const { return pixels; }
+    T* row(int index) { return pixels + rowStride * index; }
+    const T* row(int index) const { return pixels + rowStride * index; }
+
+private:
+    void release()
+    {
+        if (owned && pixels != nullptr)
+            aligned_free(pixels);
+        pixels = nullptr;
+    }
+
+private:
+    T* pixels = nullptr;
+    int numCols = 0;
+    int numRows = 0;
+    size_t rowStride = 0;
+    bool owned = false;
+};
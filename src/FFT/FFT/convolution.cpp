@@ -0,0 +1,339 @@
+#include "convolution.h"
+
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include "thread_pool.h"
+
+// Working set of one tile (pixels, spectrum, kernel spectrum) that should stay in a core's L2.
+static const size_t tile_cache_bytes = 1 << 20;
+// Below this the per-tile loads, stores and plan calls outweigh the shorter transforms.
+static const int min_tile_size = 16;
+// A full-image transform streams from memory; bench-convolution puts its cost per point and
+// log2(points) at about 1.5 times that of a cache-resident tile.
+static const double full_transform_penalty = 1.5;
+
+// Proportional to the transform work for a width x height output: tiles times n log n per tile.
+static double transform_cost(int tile_width, int tile_height, int block_width, int block_height, int width,
+    int height)
+{
+    double tiles = (double)((width + block_width - 1) / block_width) * ((height + block_height - 1) / block_height);
+    double points = (double)tile_width * tile_height;
+    return tiles * points * log2(points > 2 ? points : 2);
+}
+
+// Cheapest good tile size with tile_width >= min_width and tile_height >= min_height whose working
+// set fits tile_cache_bytes, or the smallest legal one when none fits. Returns its cost.
+static double choose_tile(int width, int height, int kernel_width, int kernel_height, int min_width, int min_height,
+    size_t real_size, int& tile_width, int& tile_height)
+{
+    min_width = std::max(min_width, std::min(min_tile_size, width + kernel_width - 1));
+    min_height = std::max(min_height, std::min(min_tile_size, height + kernel_height - 1));
+    tile_width = fft_good_size(min_width);
+    tile_height = fft_good_size(min_height);
+    double best = -1.0;
+
+    int max_width = fft_good_size(width + kernel_width - 1), max_height = fft_good_size(height + kernel_height - 1);
+    for (int tw = fft_good_size(min_width); tw <= max_width; tw = fft_good_size(tw + 1)) {
+        for (int th = fft_good_size(min_height); th <= max_height; th = fft_good_size(th + 1)) {
+            size_t bytes = (size_t)tw * th * real_size + 2 * (size_t)(tw / 2 + 1) * th * 2 * real_size;
+            if (bytes > tile_cache_bytes)
+                break;
+            double cost = transform_cost(tw, th, tw - kernel_width + 1, th - kernel_height + 1, width, height);
+            if (best < 0.0 || cost < best) {
+                best = cost;
+                tile_width = tw;
+                tile_height = th;
+            }
+        }
+    }
+
+    if (best < 0.0)
+        best = transform_cost(tile_width, tile_height, tile_width - kernel_width + 1, tile_height - kernel_height + 1,
+            width, height);
+    return best;
+}
+
+template<typename Real>
+BasicFFTConvolution<Real>::BasicFFTConvolution(const Buffer2D<Real>& kernel, int width, int height,
+    FFTConvolutionMethod method, int tile)
+    : width(width), height(height), kernelWidth(kernel.width()), kernelHeight(kernel.height()),
+    convolutionMethod(method)
+{
+    if (width < 1 || height < 1 || kernelWidth < 1 || kernelHeight < 1)
+        throw std::runtime_error("Invalid convolution size!");
+
+    // Full: wide enough that the kernel's reach past the image edges only lands on zeros.
+    int full_width = fft_good_size(std::max(width + kernelWidth / 2, kernelWidth));
+    int full_height = fft_good_size(std::max(height + kernelHeight / 2, kernelHeight));
+    double full_cost = full_transform_penalty * transform_cost(full_width, full_height, width, height, width, height);
+
+    if (convolutionMethod != FFTConvolutionMethod::Full) {
+        bool add = convolutionMethod == FFTConvolutionMethod::OverlapAdd;
+        int min_width = add ? std::max(kernelWidth, 2 * kernelWidth - 2) : kernelWidth;
+        int min_height = add ? std::max(kernelHeight, 2 * kernelHeight - 2) : kernelHeight;
+        double tiled_cost;
+        if (tile > 0) {
+            if (tile < min_width || tile < min_height)
+                throw std::runtime_error("Convolution tile is too small for the kernel!");
+            transformW = transformH = tile;
+            tiled_cost = 0.0;
+        } else {
+            tiled_cost = choose_tile(width, height, kernelWidth, kernelHeight, min_width, min_height, sizeof(Real),
+                transformW, transformH);
+        }
+        if (convolutionMethod == FFTConvolutionMethod::Auto)
+            convolutionMethod = tiled_cost < full_cost ? FFTConvolutionMethod::OverlapSave : FFTConvolutionMethod::Full;
+    }
+
+    if (convolutionMethod == FFTConvolutionMethod::Full) {
+        transformW = full_width;
+        transformH = full_height;
+        prepareFull(kernel);
+    } else {
+        prepareTiles(kernel);
+    }
+}
+
+template<typename Real>
+void BasicFFTConvolution<Real>::prepareFull(const Buffer2D<Real>& kernel)
+{
+    int half = transformW / 2 + 1;
+    plan.reset(new BasicFFTRealPlan<Real>(transformW, transformH));
+    padded = Buffer2D<Real>(transformW, transformH);
+    result = Buffer2D<Real>(transformW, transformH);
+    spectrumRe = Buffer2D<Real>(half, transformH);
+    spectrumIm = Buffer2D<Real>(half, transformH);
+    kernelRe = Buffer2D<Real>(half, transformH);
+    kernelIm = Buffer2D<Real>(half, transformH);
+
+    // The kernel's centre goes to the origin, the rest wraps around.
+    Buffer2D<Real> wrapped(transformW, transformH);
+    for (int i = 0; i < kernelHeight; i++) {
+        Real* row = wrapped.row((i - kernelHeight / 2 + transformH) % transformH);
+        for (int j = 0; j < kernelWidth; j++)
+            row[(j - kernelWidth / 2 + transformW) % transformW] = kernel.row(i)[j];
+    }
+    plan->forward(wrapped, kernelRe, kernelIm);
+
+    Real scale = Real(1) / ((Real)transformW * transformH);
+    for (int x = 0; x < transformH; x++) {
+        for (int y = 0; y < half; y++) {
+            kernelRe.row(x)[y] *= scale;
+            kernelIm.row(x)[y] *= scale;
+        }
+    }
+}
+
+template<typename Real>
+void BasicFFTConvolution<Real>::prepareTiles(const Buffer2D<Real>& kernel)
+{
+    int half = transformW / 2 + 1;
+    tileRows.reset(new BasicFFTRealPlan1D<Real>(transformW));
+    tileColumnsForward.reset(new BasicFFTPlan1D<Real>(transformH, FFTDirection::Forward));
+    tileColumnsInverse.reset(new BasicFFTPlan1D<Real>(transformH, FFTDirection::Inverse));
+
+    // Kernel at the tile origin, transformed like a tile: rows, then columns kept by column.
+    TileWorkspace& work = tileWorkspace(0);
+    for (int x = 0; x < transformH; x++) {
+        Real* row = work.pixels.row(x);
+        for (int y = 0; y < transformW; y++)
+            row[y] = x < kernelHeight && y < kernelWidth ? kernel.row(x)[y] : Real(0);
+    }
+    ComplexType* scratch = work.line.data() + transformH;
+    for (int x = 0; x < transformH; x++)
+        tileRows->forward(work.pixels.row(x), work.spectrum.row(x), scratch);
+
+    Real scale = Real(1) / ((Real)transformW * transformH);
+    kernelColumns = Buffer2D<ComplexType>(transformH, half);
+    for (int y = 0; y < half; y++) {
+        ComplexType* column = kernelColumns.row(y);
+        for (int x = 0; x < transformH; x++)
+            column[x] = work.spectrum.row(x)[y];
+        tileColumnsForward->execute(column, scratch);
+        for (int x = 0; x < transformH; x++)
+            column[x] *= scale;
+    }
+}
+
+template<typename Real>
+typename BasicFFTConvolution<Real>::TileWorkspace& BasicFFTConvolution<Real>::tileWorkspace(int worker)
+{
+    if ((int)workspaces.size() <= worker)
+        workspaces.resize(worker + 1);
+    TileWorkspace& work = workspaces[worker];
+    if (work.pixels.height() != transformH) {
+        int scratch = tileRows->scratchSize();
+        if (tileColumnsForward->scratchSize() > scratch)
+            scratch = tileColumnsForward->scratchSize();
+        work.pixels = Buffer2D<Real>(transformW, transformH);
+        work.spectrum = Buffer2D<ComplexType>(transformW / 2 + 1, transformH);
+        work.line.resize(transformH + scratch);
+    }
+    return work;
+}
+
+// work.pixels = work.pixels (*) kernel, circularly over the tile. Each column is transformed,
+// multiplied by the kernel and transformed back while it is in the worker's line.
+template<typename Real>
+void BasicFFTConvolution<Real>::convolveTile(TileWorkspace& work) const
+{
+    int half = transformW / 2 + 1;
+    ComplexType* line = work.line.data();
+    ComplexType* scratch = line + transformH;
+
+    for (int x = 0; x < transformH; x++)
+        tileRows->forward(work.pixels.row(x), work.spectrum.row(x), scratch);
+
+    for (int y = 0; y < half; y++) {
+        const ComplexType* kernel = kernelColumns.row(y);
+        for (int x = 0; x < transformH; x++)
+            line[x] = work.spectrum.row(x)[y];
+        tileColumnsForward->execute(line, scratch);
+        for (int x = 0; x < transformH; x++)
+            line[x] *= kernel[x];
+        tileColumnsInverse->execute(line, scratch);
+        for (int x = 0; x < transformH; x++)
+            work.spectrum.row(x)[y] = line[x];
+    }
+
+    for (int x = 0; x < transformH; x++)
+        tileRows->inverse(work.spectrum.row(x), work.pixels.row(x), scratch);
+}
+
+template<typename Real>
+void BasicFFTConvolution<Real>::execute(const Buffer2D<Real>& image, Buffer2D<Real>& out)
+{
+    if (image.width() != width || image.height() != height || out.width() != width || out.height() != height)
+        throw std::runtime_error("Buffer size does not match the convolution!");
+
+    std::lock_guard<std::mutex> lock(executeMutex);
+    if (convolutionMethod == FFTConvolutionMethod::Full)
+        executeFull(image, out);
+    else if (convolutionMethod == FFTConvolutionMethod::OverlapSave)
+        executeOverlapSave(image, out);
+    else
+        executeOverlapAdd(image, out);
+}
+
+template<typename Real>
+void BasicFFTConvolution<Real>::executeFull(const Buffer2D<Real>& image, Buffer2D<Real>& out)
+{
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(0, height, 16, [&](int begin, int end, int) {
+        for (int x = begin; x < end; x++)
+            memcpy(padded.row(x), image.row(x), width * sizeof(Real));
+    });
+
+    plan->forward(padded, spectrumRe, spectrumIm);
+    pool.parallelFor(0, transformH, 16, [&](int begin, int end, int) {
+        for (int x = begin; x < end; x++) {
+            Real* re = spectrumRe.row(x);
+            Real* im = spectrumIm.row(x);
+            const Real* kernel_re = kernelRe.row(x);
+            const Real* kernel_im = kernelIm.row(x);
+            for (int y = 0; y < spectrumRe.width(); y++) {
+                Real a = re[y], b = im[y];
+                re[y] = a * kernel_re[y] - b * kernel_im[y];
+                im[y] = a * kernel_im[y] + b * kernel_re[y];
+            }
+        }
+    });
+    plan->inverse(spectrumRe, spectrumIm, result);
+
+    pool.parallelFor(0, height, 16, [&](int begin, int end, int) {
+        for (int x = begin; x < end; x++)
+            memcpy(out.row(x), result.row(x), width * sizeof(Real));
+    });
+}
+
+// Each output block of (tile - kernel + 1) pixels per side is the wrap-free part of a circular
+// convolution over the tile that starts kernel - 1 - kernel / 2 pixels before it.
+template<typename Real>
+void BasicFFTConvolution<Real>::executeOverlapSave(const Buffer2D<Real>& image, Buffer2D<Real>& out)
+{
+    int block_width = transformW - kernelWidth + 1, block_height = transformH - kernelHeight + 1;
+    int tiles_x = (width + block_width - 1) / block_width, tiles_y = (height + block_height - 1) / block_height;
+    int left = kernelWidth - 1 - kernelWidth / 2, top = kernelHeight - 1 - kernelHeight / 2;
+
+    ThreadPool& pool = ThreadPool::global();
+    for (int worker = 0; worker < pool.size(); worker++)
+        tileWorkspace(worker);
+
+    pool.parallelFor(0, tiles_x * tiles_y, 1, [&](int begin, int end, int worker) {
+        TileWorkspace& work = workspaces[worker];
+        for (int t = begin; t < end; t++) {
+            int ox = t / tiles_x * block_height, oy = t % tiles_x * block_width;
+            for (int p = 0; p < transformH; p++) {
+                int x = ox - top + p;
+                Real* row = work.pixels.row(p);
+                for (int q = 0; q < transformW; q++) {
+                    int y = oy - left + q;
+                    row[q] = x >= 0 && x < height && y >= 0 && y < width ? image.row(x)[y] : Real(0);
+                }
+            }
+
+            convolveTile(work);
+
+            int rows = std::min(block_height, height - ox), cols = std::min(block_width, width - oy);
+            for (int p = 0; p < rows; p++)
+                memcpy(out.row(ox + p) + oy, work.pixels.row(p + kernelHeight - 1) + kernelWidth - 1,
+                    cols * sizeof(Real));
+        }
+    });
+}
+
+// Each input block is zero-padded to a tile, convolved, and the whole tile added to the output,
+// kernel / 2 pixels up and left. Tiles overlap only their neighbours, so the four parities of
+// (tile row, tile column) run one after the other, each in parallel.
+template<typename Real>
+void BasicFFTConvolution<Real>::executeOverlapAdd(const Buffer2D<Real>& image, Buffer2D<Real>& out)
+{
+    int block_width = transformW - kernelWidth + 1, block_height = transformH - kernelHeight + 1;
+    int tiles_x = (width + block_width - 1) / block_width, tiles_y = (height + block_height - 1) / block_height;
+
+    ThreadPool& pool = ThreadPool::global();
+    for (int worker = 0; worker < pool.size(); worker++)
+        tileWorkspace(worker);
+    for (int x = 0; x < height; x++)
+        memset(out.row(x), 0, width * sizeof(Real));
+
+    for (int phase = 0; phase < 4; phase++) {
+        int first_y = phase / 2, first_x = phase % 2;
+        int count_y = (tiles_y - first_y + 1) / 2, count_x = (tiles_x - first_x + 1) / 2;
+        pool.parallelFor(0, count_x * count_y, 1, [&](int begin, int end, int worker) {
+            TileWorkspace& work = workspaces[worker];
+            for (int t = begin; t < end; t++) {
+                int bx = (first_y + 2 * (t / count_x)) * block_height;
+                int by = (first_x + 2 * (t % count_x)) * block_width;
+                for (int p = 0; p < transformH; p++) {
+                    int x = bx + p;
+                    Real* row = work.pixels.row(p);
+                    for (int q = 0; q < transformW; q++) {
+                        int y = by + q;
+                        bool inside = p < block_height && q < block_width && x < height && y < width;
+                        row[q] = inside ? image.row(x)[y] : Real(0);
+                    }
+                }
+
+                convolveTile(work);
+
+                for (int p = 0; p < transformH; p++) {
+                    int x = bx + p - kernelHeight / 2;
+                    if (x < 0 || x >= height)
+                        continue;
+                    const Real* row = work.pixels.row(p);
+                    Real* target = out.row(x);
+                    int y0 = by - kernelWidth / 2;
+                    int q_begin = std::max(0, -y0), q_end = std::min(transformW, width - y0);
+                    for (int q = q_begin; q < q_end; q++)
+                        target[y0 + q] += row[q];
+                }
+            }
+        });
+    }
+}
+
+template class BasicFFTConvolution<float>;
+template class BasicFFTConvolution<double>;
@@ -0,0 +1,88 @@
+#pragma once
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer2d.h"
+#include "fft.h"
+
+// How BasicFFTConvolution splits the work. Full transforms the whole zero-padded image at once;
+// OverlapSave and OverlapAdd run small cache-resident tiles, each worker transforming whole
+// tiles on its own. Auto compares the transform sizes of Full against the best tile size.
+enum class FFTConvolutionMethod {
+    Auto,
+    Full,
+    OverlapSave,
+    OverlapAdd
+};
+
+// Linear 2D convolution of width x height images with a fixed kernel, cropped to the image:
+//   out[x][y] = sum kernel[i][j] * image[x + kh / 2 - i][y + kw / 2 - j],
+// with zeros outside the image, i.e. the kernel's centre pixel lands on the output pixel. This is
+// the CPU counterpart of the Lens Flares FFT -> complex multiplication -> inverse FFT passes,
+// without their wrap-around. The kernel spectrum is computed once, scaled by the inverse
+// transform size, and reused by every execute().
+// Tiles are chosen so that a tile's pixels, its spectrum and the kernel spectrum fit a 1 MiB
+// cache budget, and among those the size that spends the fewest transform operations per output
+// pixel; tile (square) overrides the choice. OverlapAdd tiles must be at least 2 * (k - 1) on
+// each side so that only neighbouring tiles overlap.
+template<typename Real>
+class BasicFFTConvolution
+{
+public:
+    typedef std::complex<Real> ComplexType;
+
+    BasicFFTConvolution(const Buffer2D<Real>& kernel, int width, int height,
+        FFTConvolutionMethod method = FFTConvolutionMethod::Auto, int tile = 0);
+
+    void execute(const Buffer2D<Real>& image, Buffer2D<Real>& out);
+
+    FFTConvolutionMethod method() const { return convolutionMethod; }
+    int transformWidth() const { return transformW; }
+    int transformHeight() const { return transformH; }
+
+private:
+    struct TileWorkspace {
+        Buffer2D<Real> pixels;
+        Buffer2D<ComplexType> spectrum;
+        std::vector<ComplexType> line;
+    };
+
+    void prepareFull(const Buffer2D<Real>& kernel);
+    void prepareTiles(const Buffer2D<Real>& kernel);
+    void convolveTile(TileWorkspace& work) const;
+    void executeFull(const Buffer2D<Real>& image, Buffer2D<Real>& out);
+    void executeOverlapSave(const Buffer2D<Real>& image, Buffer2D<Real>& out);
+    void executeOverlapAdd(const Buffer2D<Real>& image, Buffer2D<Real>& out);
+    TileWorkspace& tileWorkspace(int worker);
+
+private:
+    int width;
+    int height;
+    int kernelWidth;
+    int kernelHeight;
+    FFTConvolutionMethod convolutionMethod;
+    int transformW;
+    int transformH;
+
+    // Full: the padded image, its half spectrum and the kernel's.
+    std::unique_ptr<BasicFFTRealPlan<Real>> plan;
+    Buffer2D<Real> padded;
+    Buffer2D<Real> result;
+    Buffer2D<Real> spectrumRe;
+    Buffer2D<Real> spectrumIm;
+    Buffer2D<Real> kernelRe;
+    Buffer2D<Real> kernelIm;
+
+    // Tiles: 1D plans run serially inside each worker, the kernel spectrum stored by column.
+    std::unique_ptr<BasicFFTRealPlan1D<Real>> tileRows;
+    std::unique_ptr<BasicFFTPlan1D<Real>> tileColumnsForward;
+    std::unique_ptr<BasicFFTPlan1D<Real>> tileColumnsInverse;
+    Buffer2D<ComplexType> kernelColumns;
+    std::vector<TileWorkspace> workspaces;
+    std::mutex executeMutex;
+};
+
+typedef BasicFFTConvolution<float> FFTConvolutionf;
+typedef BasicFFTConvolution<double> FFTConvolution;
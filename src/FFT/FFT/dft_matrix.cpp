@@ -0,0 +1,295 @@
+#include "dft_matrix.h"
+
+#include <math.h>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "fft_kernels.h"
+#include "thread_pool.h"
+
+#ifdef FFT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+static const long double PI_L = 3.141592653589793238462643383279502884L;
+
+// Each task computes an MC x NC block of C, walking K in KC steps so that the KC x NC panel of B
+// (re and im) stays in L2 while the rows of A stream past it two at a time.
+static const int gemm_mc = 32;
+static const int gemm_nc = 256;
+static const int gemm_kc = 128;
+
+// Element (i, j) at re[i * stride + j] and im[i * stride + j]; a null im reads as zero.
+template<typename Real>
+struct SplitMatrix {
+    const Real* re;
+    const Real* im;
+    size_t stride;
+};
+
+template<typename Real>
+struct SplitOutput {
+    Real* re;
+    Real* im;
+    size_t stride;
+};
+
+// C[i0, i1)[j0, j1) += A[i0, i1)[k0, k1) * B[k0, k1)[j0, j1). B is always complex.
+template<typename Real>
+static void gemm_block_scalar(const SplitMatrix<Real>& a, const SplitMatrix<Real>& b, const SplitOutput<Real>& c,
+    int i0, int i1, int j0, int j1, int k0, int k1)
+{
+    for (int i = i0; i < i1; i++) {
+        Real* c_re = c.re + i * c.stride;
+        Real* c_im = c.im + i * c.stride;
+        for (int k = k0; k < k1; k++) {
+            Real ar = a.re[i * a.stride + k];
+            Real ai = a.im != nullptr ? a.im[i * a.stride + k] : Real(0);
+            const Real* b_re = b.re + k * b.stride;
+            const Real* b_im = b.im + k * b.stride;
+            for (int j = j0; j < j1; j++) {
+                c_re[j] += ar * b_re[j] - ai * b_im[j];
+                c_im[j] += ar * b_im[j] + ai * b_re[j];
+            }
+        }
+    }
+}
+
+#ifdef FFT_ARCH_X86
+struct Avx2Double {
+    typedef double Real;
+    typedef __m256d Vec;
+    static const int width = 4;
+
+    FFT_TARGET("avx2,fma") static inline Vec zero() { return _mm256_setzero_pd(); }
+    FFT_TARGET("avx2,fma") static inline Vec load(const double* p) { return _mm256_loadu_pd(p); }
+    FFT_TARGET("avx2,fma") static inline void store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+    FFT_TARGET("avx2,fma") static inline Vec broadcast(double x) { return _mm256_set1_pd(x); }
+    FFT_TARGET("avx2,fma") static inline Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+    FFT_TARGET("avx2,fma") static inline Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+    FFT_TARGET("avx2,fma") static inline Vec fnmadd(Vec a, Vec b, Vec c) { return _mm256_fnmadd_pd(a, b, c); }
+};
+
+struct Avx2Float {
+    typedef float Real;
+    typedef __m256 Vec;
+    static const int width = 8;
+
+    FFT_TARGET("avx2,fma") static inline Vec zero() { return _mm256_setzero_ps(); }
+    FFT_TARGET("avx2,fma") static inline Vec load(const float* p) { return _mm256_loadu_ps(p); }
+    FFT_TARGET("avx2,fma") static inline void store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+    FFT_TARGET("avx2,fma") static inline Vec broadcast(float x) { return _mm256_set1_ps(x); }
+    FFT_TARGET("avx2,fma") static inline Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    FFT_TARGET("avx2,fma") static inline Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+    FFT_TARGET("avx2,fma") static inline Vec fnmadd(Vec a, Vec b, Vec c) { return _mm256_fnmadd_ps(a, b, c); }
+};
+
+// Rows x (2 vectors) block of C held in registers over k0..k1: 8 accumulators, 4 B vectors and
+// the broadcasts of A fit the 16 YMM registers.
+template<typename V, int Rows, bool ComplexA>
+FFT_TARGET("avx2,fma") static inline void gemm_micro_avx2(const SplitMatrix<typename V::Real>& a,
+    const SplitMatrix<typename V::Real>& b, const SplitOutput<typename V::Real>& c, int i, int j, int k0, int k1)
+{
+    typedef typename V::Real Real;
+    typedef typename V::Vec Vec;
+    const int w = V::width;
+
+    Vec c_re[Rows][2], c_im[Rows][2];
+    for (int r = 0; r < Rows; r++) {
+        for (int v = 0; v < 2; v++) {
+            c_re[r][v] = V::zero();
+            c_im[r][v] = V::zero();
+        }
+    }
+
+    for (int k = k0; k < k1; k++) {
+        const Real* b_re = b.re + k * b.stride + j;
+        const Real* b_im = b.im + k * b.stride + j;
+        Vec br0 = V::load(b_re), br1 = V::load(b_re + w);
+        Vec bi0 = V::load(b_im), bi1 = V::load(b_im + w);
+        for (int r = 0; r < Rows; r++) {
+            Vec ar = V::broadcast(a.re[(i + r) * a.stride + k]);
+            c_re[r][0] = V::fmadd(ar, br0, c_re[r][0]);
+            c_re[r][1] = V::fmadd(ar, br1, c_re[r][1]);
+            c_im[r][0] = V::fmadd(ar, bi0, c_im[r][0]);
+            c_im[r][1] = V::fmadd(ar, bi1, c_im[r][1]);
+            if (ComplexA) {
+                Vec ai = V::broadcast(a.im[(i + r) * a.stride + k]);
+                c_re[r][0] = V::fnmadd(ai, bi0, c_re[r][0]);
+                c_re[r][1] = V::fnmadd(ai, bi1, c_re[r][1]);
+                c_im[r][0] = V::fmadd(ai, br0, c_im[r][0]);
+                c_im[r][1] = V::fmadd(ai, br1, c_im[r][1]);
+            }
+        }
+    }
+
+    for (int r = 0; r < Rows; r++) {
+        for (int v = 0; v < 2; v++) {
+            Real* out_re = c.re + (i + r) * c.stride + j + v * w;
+            Real* out_im = c.im + (i + r) * c.stride + j + v * w;
+            V::store(out_re, V::add(V::load(out_re), c_re[r][v]));
+            V::store(out_im, V::add(V::load(out_im), c_im[r][v]));
+        }
+    }
+}
+
+template<typename V, bool ComplexA>
+FFT_TARGET("avx2,fma") static void gemm_block_avx2(const SplitMatrix<typename V::Real>& a,
+    const SplitMatrix<typename V::Real>& b, const SplitOutput<typename V::Real>& c, int i0, int i1, int j0, int j1,
+    int k0, int k1)
+{
+    const int step = 2 * V::width;
+    int j_end = j0 + (j1 - j0) / step * step;
+    int i = i0;
+    for (; i + 2 <= i1; i += 2)
+        for (int j = j0; j < j_end; j += step)
+            gemm_micro_avx2<V, 2, ComplexA>(a, b, c, i, j, k0, k1);
+    for (; i < i1; i++)
+        for (int j = j0; j < j_end; j += step)
+            gemm_micro_avx2<V, 1, ComplexA>(a, b, c, i, j, k0, k1);
+    if (j_end < j1)
+        gemm_block_scalar(a, b, c, i0, i1, j_end, j1, k0, k1);
+}
+#endif
+
+template<typename Real>
+static void gemm_block(const SplitMatrix<Real>& a, const SplitMatrix<Real>& b, const SplitOutput<Real>& c, int i0,
+    int i1, int j0, int j1, int k0, int k1)
+{
+    gemm_block_scalar(a, b, c, i0, i1, j0, j1, k0, k1);
+}
+
+#ifdef FFT_ARCH_X86
+// The YMM kernels follow the selected FFT kernel set, so the scalar and SSE sets stay scalar here.
+template<typename Real>
+static bool use_avx2_gemm()
+{
+    return sizeof(Real) <= sizeof(double) && cpu_features().avx2
+        && fft_kernel_set<Real>(fft_kernels()).lanes * sizeof(std::complex<Real>) >= 32;
+}
+
+static void gemm_block(const SplitMatrix<double>& a, const SplitMatrix<double>& b, const SplitOutput<double>& c,
+    int i0, int i1, int j0, int j1, int k0, int k1)
+{
+    if (!use_avx2_gemm<double>())
+        gemm_block_scalar(a, b, c, i0, i1, j0, j1, k0, k1);
+    else if (a.im != nullptr)
+        gemm_block_avx2<Avx2Double, true>(a, b, c, i0, i1, j0, j1, k0, k1);
+    else
+        gemm_block_avx2<Avx2Double, false>(a, b, c, i0, i1, j0, j1, k0, k1);
+}
+
+static void gemm_block(const SplitMatrix<float>& a, const SplitMatrix<float>& b, const SplitOutput<float>& c,
+    int i0, int i1, int j0, int j1, int k0, int k1)
+{
+    if (!use_avx2_gemm<float>())
+        gemm_block_scalar(a, b, c, i0, i1, j0, j1, k0, k1);
+    else if (a.im != nullptr)
+        gemm_block_avx2<Avx2Float, true>(a, b, c, i0, i1, j0, j1, k0, k1);
+    else
+        gemm_block_avx2<Avx2Float, false>(a, b, c, i0, i1, j0, j1, k0, k1);
+}
+#endif
+
+// C (m x n) = A (m x k) * B (k x n), blocks of C spread over ThreadPool::global().
+template<typename Real>
+static void complex_gemm(int m, int n, int k, const SplitMatrix<Real>& a, const SplitMatrix<Real>& b,
+    const SplitOutput<Real>& c)
+{
+    int blocks_m = (m + gemm_mc - 1) / gemm_mc, blocks_n = (n + gemm_nc - 1) / gemm_nc;
+    ThreadPool::global().parallelFor(0, blocks_m * blocks_n, 1, [&](int begin, int end, int) {
+        for (int t = begin; t < end; t++) {
+            int i0 = t / blocks_n * gemm_mc, j0 = t % blocks_n * gemm_nc;
+            int i1 = m - i0 < gemm_mc ? m : i0 + gemm_mc;
+            int j1 = n - j0 < gemm_nc ? n : j0 + gemm_nc;
+            for (int i = i0; i < i1; i++) {
+                for (int j = j0; j < j1; j++) {
+                    c.re[i * c.stride + j] = Real(0);
+                    c.im[i * c.stride + j] = Real(0);
+                }
+            }
+            for (int k0 = 0; k0 < k; k0 += gemm_kc)
+                gemm_block(a, b, c, i0, i1, j0, j1, k0, k - k0 < gemm_kc ? k : k0 + gemm_kc);
+        }
+    });
+}
+
+template<typename Real>
+BasicDFTMatrix<Real>::BasicDFTMatrix(int n, FFTDirection direction)
+    : length(n), matrixRe(n, n), matrixIm(n, n)
+{
+    if (n < 1)
+        throw std::runtime_error("FFT size must be positive!");
+
+    long double sign = direction == FFTDirection::Inverse ? 1.0L : -1.0L;
+    std::vector<Real> roots_re(n), roots_im(n);
+    for (int t = 0; t < n; t++) {
+        long double angle = sign * 2.0L * PI_L * t / n;
+        roots_re[t] = (Real)std::cos(angle);
+        roots_im[t] = (Real)std::sin(angle);
+    }
+    for (int j = 0; j < n; j++) {
+        for (int k = 0; k < n; k++) {
+            int t = (int)((long long)j * k % n);
+            matrixRe.row(j)[k] = roots_re[t];
+            matrixIm.row(j)[k] = roots_im[t];
+        }
+    }
+}
+
+template<typename Real>
+void BasicDFTMatrix<Real>::transformRows(const Buffer2D<Real>& re, const Buffer2D<Real>* im, Buffer2D<Real>& out_re,
+    Buffer2D<Real>& out_im) const
+{
+    int height = re.height();
+    if (re.width() != length || (im != nullptr && (im->width() != length || im->height() != height))
+        || out_re.width() != length || out_re.height() != height || out_im.width() != length
+        || out_im.height() != height)
+        throw std::runtime_error("Buffer size does not match the DFT matrix!");
+
+    SplitMatrix<Real> a = { re.data(), im != nullptr ? im->data() : nullptr, re.stride() };
+    SplitMatrix<Real> f = { matrixRe.data(), matrixIm.data(), matrixRe.stride() };
+    SplitOutput<Real> c = { out_re.data(), out_im.data(), out_re.stride() };
+    complex_gemm(height, length, length, a, f, c);
+}
+
+template<typename Real>
+void BasicDFTMatrix<Real>::transformColumns(const Buffer2D<Real>& re, const Buffer2D<Real>& im,
+    Buffer2D<Real>& out_re, Buffer2D<Real>& out_im) const
+{
+    int width = re.width();
+    if (re.height() != length || im.width() != width || im.height() != length || out_re.width() != width
+        || out_re.height() != length || out_im.width() != width || out_im.height() != length)
+        throw std::runtime_error("Buffer size does not match the DFT matrix!");
+
+    SplitMatrix<Real> f = { matrixRe.data(), matrixIm.data(), matrixRe.stride() };
+    SplitMatrix<Real> b = { re.data(), im.data(), re.stride() };
+    SplitOutput<Real> c = { out_re.data(), out_im.data(), out_re.stride() };
+    complex_gemm(length, width, length, f, b, c);
+}
+
+// Largest non-smooth length at which the product still beat Bluestein in bench-dft-matrix. The YMM
+// product wins up to about 120 points, where Bluestein has just doubled to 256 points; the scalar
+// product only up to about 32.
+static const int dft_matrix_crossover_avx2 = 120;
+static const int dft_matrix_crossover_scalar = 32;
+
+template<typename Real>
+bool fft_prefers_dft_matrix(int n)
+{
+    int crossover = dft_matrix_crossover_scalar;
+#ifdef FFT_ARCH_X86
+    if (use_avx2_gemm<Real>())
+        crossover = dft_matrix_crossover_avx2;
+#endif
+    return !is_smooth(n) && n <= crossover;
+}
+
+template class BasicDFTMatrix<float>;
+template class BasicDFTMatrix<double>;
+template class BasicDFTMatrix<long double>;
+
+template bool fft_prefers_dft_matrix<float>(int n);
+template bool fft_prefers_dft_matrix<double>(int n);
+template bool fft_prefers_dft_matrix<long double>(int n);
@@ -0,0 +1,36 @@
+#pragma once
+#include "buffer2d.h"
+#include "fft.h"
+
+// Dense n x n DFT matrix F[j][k] = exp(-+2 pi i j k / n) in split re/im planes, applied to all
+// lines of an image at once as one complex matrix product: rows as X * F, columns as F * X.
+// For an n with a large prime factor this is O(n) work per point against Bluestein's O(log m)
+// with m >= 2n - 1, but it runs as a register-blocked AVX2/FMA GEMM (scalar elsewhere) over
+// cache-sized panels and threads, so below the crossover in fft_prefers_dft_matrix() it wins.
+template<typename Real>
+class BasicDFTMatrix
+{
+public:
+    BasicDFTMatrix(int n, FFTDirection direction);
+
+    int size() const { return length; }
+
+    // out[x] = DFT of row x of (re, im) for every row; im == nullptr means a real input.
+    // re/im must be height x n, out_re/out_im the same size and distinct from the input.
+    void transformRows(const Buffer2D<Real>& re, const Buffer2D<Real>* im, Buffer2D<Real>& out_re,
+        Buffer2D<Real>& out_im) const;
+
+    // Column y of out = DFT of column y of (re, im), for n x width planes.
+    void transformColumns(const Buffer2D<Real>& re, const Buffer2D<Real>& im, Buffer2D<Real>& out_re,
+        Buffer2D<Real>& out_im) const;
+
+private:
+    int length;
+    Buffer2D<Real> matrixRe;
+    Buffer2D<Real> matrixIm;
+};
+
+// True when the dense product should beat Bluestein for lines of n points: n is not smooth and
+// at most the crossover measured with bench-dft-matrix.
+template<typename Real>
+bool fft_prefers_dft_matrix(int n);
@@ -0,0 +1,394 @@
+#include "distributed.h"
+
+#include <limits.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "thread_pool.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+#ifdef FFT_WITH_MPI
+#include <mpi.h>
+#endif
+
+void FFTLocalTransport::allToAll(const void* send, void* receive, size_t bytes)
+{
+    memcpy(receive, send, bytes);
+}
+
+struct FFTSharedMemoryTransport::Header {
+    std::atomic<int> arrived;
+    std::atomic<int> generation;
+    int ranks;
+    uint64_t slotSize;
+};
+
+// The slots start one cache line into the segment.
+static const size_t SEGMENT_HEADER_BYTES = 64;
+
+FFTSharedMemoryTransport::FFTSharedMemoryTransport(const std::string& name, int size, size_t capacity)
+    : segmentName(name), myRank(0), ranks(size)
+{
+    static_assert(sizeof(Header) <= SEGMENT_HEADER_BYTES, "Segment header outgrew its cache line");
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "Cross-process barriers need lock-free atomics");
+    if (size < 1 || capacity == 0)
+        throw std::runtime_error("Invalid shared memory transport!");
+
+    slotSize = (capacity + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+    map(SEGMENT_HEADER_BYTES + (size_t)size * size * slotSize, true);
+    new (header) Header();
+    header->arrived = 0;
+    header->generation = 0;
+    header->ranks = size;
+    header->slotSize = slotSize;
+}
+
+FFTSharedMemoryTransport::FFTSharedMemoryTransport(const std::string& name, int rank)
+    : segmentName(name), myRank(rank), ranks(0)
+{
+    map(0, false);
+    ranks = header->ranks;
+    slotSize = (size_t)header->slotSize;
+    if (rank < 0 || rank >= ranks)
+        throw std::runtime_error("Rank out of range for shared memory " + name + "!");
+}
+
+FFTSharedMemoryTransport::~FFTSharedMemoryTransport()
+{
+    if (header == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(header);
+    CloseHandle(mapping);
+#else
+    munmap(header, mappedBytes);
+    if (myRank == 0)
+        shm_unlink(segmentName.c_str());
+#endif
+}
+
+void FFTSharedMemoryTransport::map(size_t bytes, bool create)
+{
+#ifdef _WIN32
+    if (create)
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32),
+            (DWORD)bytes, segmentName.c_str());
+    else
+        mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, segmentName.c_str());
+    if (mapping == nullptr)
+        throw std::runtime_error("Failed to open shared memory " + segmentName + "!");
+    header = (Header*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (header == nullptr) {
+        CloseHandle(mapping);
+        throw std::runtime_error("Failed to map shared memory " + segmentName + "!");
+    }
+    mappedBytes = bytes;
+#else
+    int descriptor = create ? shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600)
+                            : shm_open(segmentName.c_str(), O_RDWR, 0600);
+    if (descriptor < 0)
+        throw std::runtime_error("Failed to open shared memory " + segmentName + "!");
+    if (create && ftruncate(descriptor, (off_t)bytes) != 0) {
+        close(descriptor);
+        shm_unlink(segmentName.c_str());
+        throw std::runtime_error("Failed to resize shared memory " + segmentName + "!");
+    }
+    if (!create) {
+        struct stat status;
+        fstat(descriptor, &status);
+        bytes = (size_t)status.st_size;
+    }
+    void* pointer = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (pointer == MAP_FAILED) {
+        if (create)
+            shm_unlink(segmentName.c_str());
+        throw std::runtime_error("Failed to map shared memory " + segmentName + "!");
+    }
+    header = (Header*)pointer;
+    mappedBytes = bytes;
+#endif
+}
+
+unsigned char* FFTSharedMemoryTransport::slot(int from, int to) const
+{
+    return (unsigned char*)header + SEGMENT_HEADER_BYTES + ((size_t)from * ranks + to) * slotSize;
+}
+
+// Central barrier: the last rank to arrive resets the count and bumps the generation the
+// others are waiting on.
+void FFTSharedMemoryTransport::barrier()
+{
+    int generation = header->generation.load();
+    if (header->arrived.fetch_add(1) == ranks - 1) {
+        header->arrived.store(0);
+        header->generation.fetch_add(1);
+        return;
+    }
+    for (int spin = 0; header->generation.load() == generation; spin++)
+        if (spin >= 64)
+            std::this_thread::yield();
+}
+
+void FFTSharedMemoryTransport::allToAll(const void* send, void* receive, size_t bytes)
+{
+    const unsigned char* from = (const unsigned char*)send;
+    unsigned char* to = (unsigned char*)receive;
+    for (size_t offset = 0; offset < bytes; offset += slotSize) {
+        size_t chunk = bytes - offset < slotSize ? bytes - offset : slotSize;
+        for (int rank = 0; rank < ranks; rank++)
+            if (rank != myRank)
+                memcpy(slot(myRank, rank), from + rank * bytes + offset, chunk);
+        memcpy(to + myRank * bytes + offset, from + myRank * bytes + offset, chunk);
+        barrier();
+        for (int rank = 0; rank < ranks; rank++)
+            if (rank != myRank)
+                memcpy(to + rank * bytes + offset, slot(rank, myRank), chunk);
+        barrier();
+    }
+}
+
+std::string FFTSharedMemoryTransport::uniqueName()
+{
+    static std::atomic<int> counter(0);
+#ifdef _WIN32
+    return "Local\\fft-" + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(counter++);
+#else
+    return "/fft-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+#endif
+}
+
+#ifdef FFT_WITH_MPI
+FFTMPITransport::FFTMPITransport()
+{
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+}
+
+// Counts are ints, so blocks past 2 GB go as 64-byte units (every block the plans send is a
+// multiple of the buffer alignment).
+void FFTMPITransport::allToAll(const void* send, void* receive, size_t bytes)
+{
+    if (bytes <= INT_MAX) {
+        MPI_Alltoall(send, (int)bytes, MPI_BYTE, receive, (int)bytes, MPI_BYTE, MPI_COMM_WORLD);
+        return;
+    }
+    if (bytes % BUFFER_ALIGNMENT != 0 || bytes / BUFFER_ALIGNMENT > INT_MAX)
+        throw std::runtime_error("All-to-all block too large for MPI!");
+    MPI_Datatype unit;
+    MPI_Type_contiguous((int)BUFFER_ALIGNMENT, MPI_BYTE, &unit);
+    MPI_Type_commit(&unit);
+    int count = (int)(bytes / BUFFER_ALIGNMENT);
+    MPI_Alltoall(send, count, unit, receive, count, unit, MPI_COMM_WORLD);
+    MPI_Type_free(&unit);
+}
+
+void FFTMPITransport::barrier()
+{
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+#endif
+
+FFTSlab fft_slab(int n, int size, int rank)
+{
+    int base = n / size, extra = n % size;
+    FFTSlab slab;
+    slab.begin = rank * base + (rank < extra ? rank : extra);
+    slab.count = base + (rank < extra ? 1 : 0);
+    return slab;
+}
+
+template<typename T>
+static void check_size(const Buffer2D<T>& buffer, int width, int height)
+{
+    if (buffer.width() != width || buffer.height() != height)
+        throw std::runtime_error("Buffer size does not match the FFT plan!");
+}
+
+template<typename Real>
+BasicFFTDistributedPlan<Real>::BasicFFTDistributedPlan(int width, int height, FFTDirection direction,
+    FFTTransport& transport)
+    : width(width), height(height), transport(transport), rowSlab(fft_slab(height, transport.size(), transport.rank())),
+    columnSlab(fft_slab(width, transport.size(), transport.rank())), maxRows(fft_slab(height, transport.size(), 0).count),
+    maxColumns(fft_slab(width, transport.size(), 0).count), rows(width, direction), columns(height, direction)
+{
+    int scratch = rows.scratchSize() > columns.scratchSize() ? rows.scratchSize() : columns.scratchSize();
+    lineSize = width > height ? width : height;
+    int workers = ThreadPool::global().size(), ranks = transport.size();
+    size_t block = (size_t)maxRows * maxColumns;
+    if (block > INT_MAX)
+        throw std::runtime_error("Distributed FFT slabs too large!");
+
+    workspace.reserve(WorkspaceArena::bufferBytes<ComplexType>(lineSize + scratch, workers)
+        + 2 * WorkspaceArena::bufferBytes<ComplexType>((int)block, ranks, false));
+    workspaces = workspace.buffer<ComplexType>(lineSize + scratch, workers);
+    sendBlocks = workspace.buffer<ComplexType>((int)block, ranks, false);
+    receiveBlocks = workspace.buffer<ComplexType>((int)block, ranks, false);
+}
+
+// Block d of sendBlocks holds this rank's rows of rank d's columns, column by column
+// (maxRows apart), so that every block received is a run of whole column pieces.
+template<typename Real>
+template<typename Load>
+void BasicFFTDistributedPlan<Real>::executeImpl(Load load, Buffer2D<Real>& out_re, Buffer2D<Real>& out_im)
+{
+    check_size(out_re, height, columnSlab.count);
+    check_size(out_im, height, columnSlab.count);
+    ThreadPool& pool = ThreadPool::global();
+    if (workspaces.height() < pool.size())
+        throw std::runtime_error("Thread pool resized under a distributed FFT plan!");
+    int ranks = transport.size();
+    int line_offset = lineSize;
+
+    auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(0, rowSlab.count, 4, [&](int begin, int end, int worker) {
+        ComplexType* line = workspaces.row(worker);
+        ComplexType* scratch = line + line_offset;
+        for (int r = begin; r < end; r++) {
+            load(r, line);
+            rows.execute(line, scratch);
+            for (int rank = 0; rank < ranks; rank++) {
+                FFTSlab slab = fft_slab(width, ranks, rank);
+                ComplexType* block = sendBlocks.row(rank) + r;
+                for (int c = 0; c < slab.count; c++)
+                    block[(size_t)c * maxRows] = line[slab.begin + c];
+            }
+        }
+    });
+    auto rows_done = std::chrono::steady_clock::now();
+
+    transport.allToAll(sendBlocks.data(), receiveBlocks.data(), sendBlocks.stride() * sizeof(ComplexType));
+    auto exchange_done = std::chrono::steady_clock::now();
+
+    pool.parallelFor(0, columnSlab.count, 4, [&](int begin, int end, int worker) {
+        ComplexType* line = workspaces.row(worker);
+        ComplexType* scratch = line + line_offset;
+        for (int c = begin; c < end; c++) {
+            for (int rank = 0; rank < ranks; rank++) {
+                FFTSlab slab = fft_slab(height, ranks, rank);
+                const ComplexType* block = receiveBlocks.row(rank) + (size_t)c * maxRows;
+                for (int r = 0; r < slab.count; r++)
+                    line[slab.begin + r] = block[r];
+            }
+            columns.execute(line, scratch);
+            Real* re_row = out_re.row(c);
+            Real* im_row = out_im.row(c);
+            for (int x = 0; x < height; x++) {
+                re_row[x] = line[x].real();
+                im_row[x] = line[x].imag();
+            }
+        }
+    });
+    auto columns_done = std::chrono::steady_clock::now();
+
+    times.rows = std::chrono::duration<double>(rows_done - start).count();
+    times.exchange = std::chrono::duration<double>(exchange_done - rows_done).count();
+    times.columns = std::chrono::duration<double>(columns_done - exchange_done).count();
+    times.total = std::chrono::duration<double>(columns_done - start).count();
+}
+
+template<typename Real>
+void BasicFFTDistributedPlan<Real>::execute(const Buffer2D<unsigned char>& in, Buffer2D<Real>& out_re,
+    Buffer2D<Real>& out_im)
+{
+    check_size(in, width, rowSlab.count);
+    executeImpl([&](int r, ComplexType* line) {
+        const unsigned char* row = in.row(r);
+        for (int y = 0; y < width; y++)
+            line[y] = ComplexType((Real)row[y], Real(0));
+    }, out_re, out_im);
+}
+
+template<typename Real>
+void BasicFFTDistributedPlan<Real>::execute(const Buffer2D<Real>& re, const Buffer2D<Real>& im,
+    Buffer2D<Real>& out_re, Buffer2D<Real>& out_im)
+{
+    check_size(re, width, rowSlab.count);
+    check_size(im, width, rowSlab.count);
+    executeImpl([&](int r, ComplexType* line) {
+        const Real* re_row = re.row(r);
+        const Real* im_row = im.row(r);
+        for (int y = 0; y < width; y++)
+            line[y] = ComplexType(re_row[y], im_row[y]);
+    }, out_re, out_im);
+}
+
+template class BasicFFTDistributedPlan<float>;
+template class BasicFFTDistributedPlan<double>;
+
+FFTLocalRanks::FFTLocalRanks(const std::string& executable, const std::vector<std::string>& arguments, int size)
+{
+    for (int rank = 1; rank < size; rank++) {
+        std::vector<std::string> words;
+#ifdef _WIN32
+        words.push_back("\"" + executable + "\"");
+#else
+        words.push_back(executable);
+#endif
+        words.insert(words.end(), arguments.begin(), arguments.end());
+        words.push_back(std::to_string(rank));
+        std::vector<char*> argv;
+        for (std::string& word : words)
+            argv.push_back(&word[0]);
+        argv.push_back(nullptr);
+
+#ifdef _WIN32
+        intptr_t process = _spawnv(_P_NOWAIT, executable.c_str(), argv.data());
+        if (process == -1) {
+            wait();
+            throw std::runtime_error("Failed to start " + executable + "!");
+        }
+        processes.push_back(process);
+#else
+        pid_t pid;
+        if (posix_spawnp(&pid, executable.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+            wait();
+            throw std::runtime_error("Failed to start " + executable + "!");
+        }
+        processes.push_back((intptr_t)pid);
+#endif
+    }
+}
+
+FFTLocalRanks::~FFTLocalRanks()
+{
+    wait();
+}
+
+bool FFTLocalRanks::wait()
+{
+    bool passed = true;
+    for (intptr_t process : processes) {
+        int status = -1;
+#ifdef _WIN32
+        if (_cwait(&status, process, 0) == -1)
+            status = -1;
+#else
+        if (waitpid((pid_t)process, &status, 0) < 0 || !WIFEXITED(status))
+            status = -1;
+        else
+            status = WEXITSTATUS(status);
+#endif
+        passed = passed && status == 0;
+    }
+    processes.clear();
+    return passed;
+}
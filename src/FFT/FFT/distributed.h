@@ -0,0 +1,175 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <complex>
+#include <string>
+#include <vector>
+
+#include "buffer2d.h"
+#include "fft.h"
+#include "workspace.h"
+
+// How the ranks of a distributed transform talk to each other. allToAll() is collective: every
+// rank calls it with the same bytes, block d of send (bytes long) goes to rank d and block s of
+// receive comes from rank s.
+class FFTTransport
+{
+public:
+    virtual ~FFTTransport() = default;
+
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+    virtual void allToAll(const void* send, void* receive, size_t bytes) = 0;
+    virtual void barrier() = 0;
+};
+
+// A single rank: allToAll() is a copy.
+class FFTLocalTransport : public FFTTransport
+{
+public:
+    int rank() const override { return 0; }
+    int size() const override { return 1; }
+    void allToAll(const void* send, void* receive, size_t bytes) override;
+    void barrier() override {}
+};
+
+// Ranks in separate processes on one machine, exchanging through a named shared memory segment
+// (shm_open, or a named file mapping on Windows) with a slot of capacity bytes per pair of
+// ranks; larger blocks go through in slot-sized rounds. Rank 0 creates the segment before the
+// other ranks start, they open it by name; the segment goes away with rank 0's transport.
+// Barriers spin (yielding) on a counter in the segment, so a rank that dies hangs the others.
+class FFTSharedMemoryTransport : public FFTTransport
+{
+public:
+    FFTSharedMemoryTransport(const std::string& name, int size, size_t capacity);
+    FFTSharedMemoryTransport(const std::string& name, int rank);
+    FFTSharedMemoryTransport(const FFTSharedMemoryTransport&) = delete;
+    FFTSharedMemoryTransport& operator=(const FFTSharedMemoryTransport&) = delete;
+    ~FFTSharedMemoryTransport() override;
+
+    int rank() const override { return myRank; }
+    int size() const override { return ranks; }
+    void allToAll(const void* send, void* receive, size_t bytes) override;
+    void barrier() override;
+
+    // A name no other run on this machine uses.
+    static std::string uniqueName();
+
+private:
+    struct Header;
+
+    unsigned char* slot(int from, int to) const;
+    void map(size_t bytes, bool create);
+
+private:
+    std::string segmentName;
+    int myRank;
+    int ranks;
+    size_t slotSize = 0;
+    size_t mappedBytes = 0;
+    Header* header = nullptr;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
+};
+
+#ifdef FFT_WITH_MPI
+// MPI_COMM_WORLD; MPI_Init() is the caller's business.
+class FFTMPITransport : public FFTTransport
+{
+public:
+    FFTMPITransport();
+
+    int rank() const override { return myRank; }
+    int size() const override { return ranks; }
+    void allToAll(const void* send, void* receive, size_t bytes) override;
+    void barrier() override;
+
+private:
+    int myRank;
+    int ranks;
+};
+#endif
+
+// Rows (or columns) [begin, begin + count) of a length-n axis split over size ranks: the first
+// n % size ranks get one extra.
+struct FFTSlab {
+    int begin;
+    int count;
+};
+
+FFTSlab fft_slab(int n, int size, int rank);
+
+// Seconds spent in each phase of the last execute(), on this rank, and in all of it.
+struct FFTDistributedTimes {
+    double rows = 0;
+    double exchange = 0;
+    double columns = 0;
+    double total = 0;
+};
+
+// 2D transform of a width x height image split into slabs of rows over the ranks of transport.
+// Each rank transforms the rows of its input slab (on ThreadPool::global()), the ranks swap
+// blocks in one all-to-all so that each ends up with whole columns of its output slab, and
+// transforms those. Like FFTW's transposed-out layout, the output stays transposed: out row j
+// is spectrum column outputSlab().begin + j, height values long, which saves a second
+// all-to-all; a caller that wants rows back runs the exchange in reverse.
+template<typename Real>
+class BasicFFTDistributedPlan
+{
+public:
+    typedef std::complex<Real> ComplexType;
+
+    BasicFFTDistributedPlan(int width, int height, FFTDirection direction, FFTTransport& transport);
+
+    // The input rows this rank holds (inputSlab().count x width) and the spectrum columns it
+    // gets back (outputSlab().count x height).
+    FFTSlab inputSlab() const { return rowSlab; }
+    FFTSlab outputSlab() const { return columnSlab; }
+
+    void execute(const Buffer2D<unsigned char>& in, Buffer2D<Real>& out_re, Buffer2D<Real>& out_im);
+    void execute(const Buffer2D<Real>& re, const Buffer2D<Real>& im, Buffer2D<Real>& out_re, Buffer2D<Real>& out_im);
+
+    const FFTDistributedTimes& lastTimes() const { return times; }
+
+private:
+    template<typename Load>
+    void executeImpl(Load load, Buffer2D<Real>& out_re, Buffer2D<Real>& out_im);
+
+private:
+    int width;
+    int height;
+    FFTTransport& transport;
+    FFTSlab rowSlab;
+    FFTSlab columnSlab;
+    int maxRows;
+    int maxColumns;
+    BasicFFTPlan1D<Real> rows;
+    BasicFFTPlan1D<Real> columns;
+    int lineSize;
+    WorkspaceArena workspace;
+    Buffer2D<ComplexType> workspaces;
+    Buffer2D<ComplexType> sendBlocks;
+    Buffer2D<ComplexType> receiveBlocks;
+    FFTDistributedTimes times;
+};
+
+typedef BasicFFTDistributedPlan<float> FFTDistributedPlanf;
+typedef BasicFFTDistributedPlan<double> FFTDistributedPlan;
+
+// Ranks 1 .. size - 1 of a run on this machine, each started as
+//   executable arguments... <rank>
+// and waited for by wait(), which is true when all of them exited with status 0.
+class FFTLocalRanks
+{
+public:
+    FFTLocalRanks(const std::string& executable, const std::vector<std::string>& arguments, int size);
+    FFTLocalRanks(const FFTLocalRanks&) = delete;
+    FFTLocalRanks& operator=(const FFTLocalRanks&) = delete;
+    ~FFTLocalRanks();
+
+    bool wait();
+
+private:
+    std::vector<intptr_t> processes;
+};
@@ -0,0 +1,1164 @@
+#include "fft.h"
+#include "autotune.h"
+#include "dft_matrix.h"
+#include "fft_codelets.h"
+#include "fft_kernels.h"
+#include "thread_pool.h"
+#include "transpose.h"
+
+#include <math.h>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+static const long double PI_L = 3.141592653589793238462643383279502884L;
+
+// Precision used to build plan tables that are rounded to the plan's own precision afterwards.
+template<typename Real>
+struct TablePrecision {
+    typedef double type;
+};
+
+template<>
+struct TablePrecision<long double> {
+    typedef long double type;
+};
+
+template<typename Real>
+static std::complex<Real> unit_root(long double angle)
+{
+    return std::complex<Real>((Real)std::cos(angle), (Real)std::sin(angle));
+}
+
+bool is_power_of_two(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+std::vector<int> fft_factorize(int n, FFTRadices factors)
+{
+    std::vector<int> radices;
+    if (n < 1)
+        return radices;
+
+    int remaining = n;
+    while (factors == FFTRadices::Radix2 && remaining % 2 == 0) {
+        radices.push_back(2);
+        remaining /= 2;
+    }
+    while (remaining % 4 == 0) {
+        radices.push_back(4);
+        remaining /= 4;
+    }
+    if (remaining % 2 == 0) {
+        radices.insert(radices.begin(), 2);
+        remaining /= 2;
+    }
+    for (int radix : { 3, 5, 7 }) {
+        while (remaining % radix == 0) {
+            radices.push_back(radix);
+            remaining /= radix;
+        }
+    }
+
+    if (remaining != 1)
+        radices.clear();
+    return radices;
+}
+
+bool is_smooth(int n)
+{
+    return n == 1 || !fft_factorize(n).empty();
+}
+
+int fft_good_size(int n)
+{
+    if (n <= 1)
+        return 1;
+    int size = n + n % 2;
+    while (!is_smooth(size))
+        size += 2;
+    return size;
+}
+
+// Position q * L + i of the permuted sequence holds input r * P[i] + q, where P is
+// the permutation of the first stages: each stage then only touches contiguous blocks.
+static std::vector<int> digit_reversal(const std::vector<int>& radices)
+{
+    std::vector<int> perm(1, 0);
+
+    for (int radix : radices) {
+        int length = (int)perm.size();
+        std::vector<int> next(length * radix);
+        for (int q = 0; q < radix; q++)
+            for (int i = 0; i < length; i++)
+                next[q * length + i] = radix * perm[i] + q;
+        perm.swap(next);
+    }
+
+    return perm;
+}
+
+template<typename Real>
+static inline std::complex<Real> rotate(const std::complex<Real>& c, Real sign)
+{
+    return std::complex<Real>(-sign * c.imag(), sign * c.real());
+}
+
+template<typename Real>
+static void stage_twiddles(std::vector<std::complex<Real>>& twiddles, int radix, int length, double sign)
+{
+    twiddles.resize((radix - 1) * length);
+    for (int q = 1; q < radix; q++) {
+        for (int j = 0; j < length; j++) {
+            long double angle = sign * 2.0L * PI_L * q * j / (radix * length);
+            twiddles[(q - 1) * length + j] = unit_root<Real>(angle);
+        }
+    }
+}
+
+// Odd radices multiply the twiddles in with the vector kernels, then run their butterflies.
+template<typename Real>
+static void apply_twiddles(std::complex<Real>* data, int n, int radix, int length, const std::complex<Real>* twiddles,
+    const FFTKernelSet<Real>& kernels)
+{
+    if (length == 1)
+        return;
+
+    for (int b = 0; b < n; b += radix * length) {
+        for (int q = 1; q < radix; q++) {
+            std::complex<Real>* x = data + b + q * length;
+            kernels.complex_multiply(x, x, twiddles + (q - 1) * length, length);
+        }
+    }
+}
+
+template<typename Real>
+static void radix3_stage(std::complex<Real>* data, int n, int length, double sign)
+{
+    typedef std::complex<Real> C;
+    const Real s3 = (Real)(sign * 0.86602540378443864676L);
+    const Real half = 0.5;
+
+    for (int j = 0; j < length; j++) {
+        for (int k = j; k < n; k += 3 * length) {
+            C c0 = data[k];
+            C c1 = data[k + length];
+            C c2 = data[k + 2 * length];
+
+            C t1 = c1 + c2;
+            C t2 = c0 - half * t1;
+            C t3 = rotate(s3 * (c1 - c2), Real(1));
+
+            data[k] = c0 + t1;
+            data[k + length] = t2 + t3;
+            data[k + 2 * length] = t2 - t3;
+        }
+    }
+}
+
+template<typename Real>
+static void radix5_stage(std::complex<Real>* data, int n, int length, double sign)
+{
+    typedef std::complex<Real> C;
+    const Real cos1 = (Real)0.30901699437494742410L, cos2 = (Real)-0.80901699437494742410L;
+    const Real sin1 = (Real)(sign * 0.95105651629515357212L), sin2 = (Real)(sign * 0.58778525229247312917L);
+
+    for (int j = 0; j < length; j++) {
+        for (int k = j; k < n; k += 5 * length) {
+            C c0 = data[k];
+            C c1 = data[k + length];
+            C c2 = data[k + 2 * length];
+            C c3 = data[k + 3 * length];
+            C c4 = data[k + 4 * length];
+
+            C t1 = c1 + c4, t2 = c2 + c3;
+            C t3 = c1 - c4, t4 = c2 - c3;
+            C a1 = c0 + cos1 * t1 + cos2 * t2;
+            C a2 = c0 + cos2 * t1 + cos1 * t2;
+            C b1 = rotate(sin1 * t3 + sin2 * t4, Real(1));
+            C b2 = rotate(sin2 * t3 - sin1 * t4, Real(1));
+
+            data[k] = c0 + t1 + t2;
+            data[k + length] = a1 + b1;
+            data[k + 2 * length] = a2 + b2;
+            data[k + 3 * length] = a2 - b2;
+            data[k + 4 * length] = a1 - b1;
+        }
+    }
+}
+
+template<typename Real>
+static void radix7_stage(std::complex<Real>* data, int n, int length, double sign)
+{
+    typedef std::complex<Real> C;
+    const Real cosines[3] = { (Real)0.62348980185873353053L, (Real)-0.22252093395631440429L,
+        (Real)-0.90096886790241912624L };
+    const Real sines[3] = { (Real)0.78183148246802980871L, (Real)0.97492791218182360702L,
+        (Real)0.43388373911755812048L };
+    const Real s = (Real)sign;
+
+    for (int j = 0; j < length; j++) {
+        for (int k = j; k < n; k += 7 * length) {
+            C c[7], sums[3], diffs[3];
+            for (int q = 0; q < 7; q++)
+                c[q] = data[k + q * length];
+            for (int q = 0; q < 3; q++) {
+                sums[q] = c[q + 1] + c[6 - q];
+                diffs[q] = c[q + 1] - c[6 - q];
+            }
+
+            data[k] = c[0] + sums[0] + sums[1] + sums[2];
+            for (int p = 1; p <= 3; p++) {
+                C a = c[0], b = Real(0);
+                for (int q = 1; q <= 3; q++) {
+                    int index = (p * q) % 7;
+                    Real sin_pq = index <= 3 ? sines[index - 1] : -sines[6 - index];
+                    a += cosines[(index <= 3 ? index : 7 - index) - 1] * sums[q - 1];
+                    b += s * sin_pq * diffs[q - 1];
+                }
+                data[k + p * length] = a + rotate(b, Real(1));
+                data[k + (7 - p) * length] = a - rotate(b, Real(1));
+            }
+        }
+    }
+}
+
+// Every value repeated batch times, matching the element-interleaved layout of batched plans.
+template<typename Real>
+static void interleave_copies(std::vector<std::complex<Real>>& values, int batch)
+{
+    if (batch == 1)
+        return;
+    std::vector<std::complex<Real>> copies(values.size() * batch);
+    for (size_t i = 0; i < values.size(); i++)
+        for (int b = 0; b < batch; b++)
+            copies[i * batch + b] = values[i];
+    values.swap(copies);
+}
+
+template<typename Real>
+BasicFFTPlan1D<Real>::BasicFFTPlan1D(int n, FFTDirection direction, int batch, FFTRadices factors)
+    : length(n), batch(batch), sign(direction == FFTDirection::Inverse ? 1.0 : -1.0)
+{
+    if (n < 1)
+        throw std::runtime_error("FFT size must be positive!");
+    if (batch < 1)
+        throw std::runtime_error("FFT batch must be positive!");
+
+    radices = fft_factorize(n, factors);
+    if (n == 1 || !radices.empty()) {
+        permutation = digit_reversal(radices);
+        int stage_length = 1;
+        for (int radix : radices) {
+            twiddles.emplace_back();
+            stage_twiddles(twiddles.back(), radix, stage_length, sign);
+            interleave_copies(twiddles.back(), batch);
+            stage_length *= radix;
+        }
+
+        // The longest run of leading stages that a codelet covers, 8 to 64 points. Codelets expect
+        // the default split of their size, so a radix-2 plan never matches.
+        if (batch == 1) {
+            int product = 1;
+            for (int s = 0; s < (int)radices.size() && radices[s] <= 4; s++) {
+                product *= radices[s];
+                FFTCodelet<Real> codelet = fft_codelet<Real>(product, direction == FFTDirection::Inverse);
+                if (codelet != nullptr
+                    && fft_factorize(product) == std::vector<int>(radices.begin(), radices.begin() + s + 1)) {
+                    leafSize = product;
+                    leafStages = s + 1;
+                    leaf = codelet;
+                }
+            }
+        }
+        return;
+    }
+
+    // Chirp-z: X[k] = c[k] * sum_j (x[j] c[j]) conj(c[k - j]), with c[j] = exp(sign i pi j^2 / n),
+    // evaluated as a power-of-two circular convolution of length >= 2n - 1.
+    convolutionSize = 1;
+    while (convolutionSize < 2 * n - 1)
+        convolutionSize *= 2;
+    int m = convolutionSize;
+
+    typedef typename TablePrecision<Real>::type Table;
+    std::vector<std::complex<Table>> exact_chirp(n);
+    for (int j = 0; j < n; j++) {
+        long long j2 = (long long)j * j % (2LL * n);
+        exact_chirp[j] = unit_root<Table>(sign * PI_L * j2 / n);
+    }
+
+    convolutionForward.reset(new BasicFFTPlan1D(m, FFTDirection::Forward, batch, factors));
+    convolutionInverse.reset(new BasicFFTPlan1D(m, FFTDirection::Inverse, batch, factors));
+
+    std::vector<std::complex<Table>> spectrum(m, Table(0));
+    spectrum[0] = conj(exact_chirp[0]);
+    for (int j = 1; j < n; j++)
+        spectrum[j] = spectrum[m - j] = conj(exact_chirp[j]);
+    BasicFFTPlan1D<Table> kernel_plan(m, FFTDirection::Forward);
+    std::vector<std::complex<Table>> scratch(kernel_plan.scratchSize());
+    kernel_plan.execute(spectrum.data(), scratch.data());
+
+    chirp.resize(n);
+    for (int j = 0; j < n; j++)
+        chirp[j] = ComplexType((Real)exact_chirp[j].real(), (Real)exact_chirp[j].imag());
+    kernelSpectrum.resize(m);
+    for (int i = 0; i < m; i++)
+        kernelSpectrum[i] = ComplexType((Real)(spectrum[i].real() / m), (Real)(spectrum[i].imag() / m));
+
+    interleave_copies(chirp, batch);
+    interleave_copies(kernelSpectrum, batch);
+}
+
+template<typename Real>
+void BasicFFTPlan1D<Real>::setKernels(const FFTKernels* kernels)
+{
+    selectedKernels = kernels;
+    if (convolutionForward) {
+        convolutionForward->setKernels(kernels);
+        convolutionInverse->setKernels(kernels);
+    }
+}
+
+template<typename Real>
+int BasicFFTPlan1D<Real>::scratchSize() const
+{
+    if (convolutionSize > 0)
+        return convolutionSize * batch + convolutionForward->scratchSize();
+    return length * batch;
+}
+
+template<typename Real>
+void BasicFFTPlan1D<Real>::execute(ComplexType* data, ComplexType* scratch) const
+{
+    if (length == 1)
+        return;
+    if (convolutionSize > 0)
+        executeBluestein(data, scratch);
+    else
+        executeMixedRadix(data, scratch);
+}
+
+// A batched plan runs every stage over batch * n values with batch * length long butterfly
+// legs: element j of transform b sits at j * batch + b, so the twiddles, repeated batch times,
+// line up and the vector kernels work on one transform per lane.
+template<typename Real>
+void BasicFFTPlan1D<Real>::executeMixedRadix(ComplexType* data, ComplexType* scratch) const
+{
+    int n = length * batch;
+    for (int i = 0; i < n; i++)
+        scratch[i] = data[i];
+    if (leaf != nullptr) {
+        // Each block is gathered and transformed while it is still in L1.
+        for (int b = 0; b < n; b += leafSize) {
+            for (int i = 0; i < leafSize; i++)
+                data[b + i] = scratch[permutation[b + i]];
+            leaf(data + b);
+        }
+    } else if (batch == 1) {
+        for (int i = 0; i < n; i++)
+            data[i] = scratch[permutation[i]];
+    } else {
+        for (int i = 0; i < length; i++)
+            for (int b = 0; b < batch; b++)
+                data[i * batch + b] = scratch[permutation[i] * batch + b];
+    }
+
+    const FFTKernelSet<Real>& kernels = fft_kernel_set<Real>(selectedKernels ? *selectedKernels : fft_kernels());
+    int stage_length = leaf != nullptr ? leafSize : batch;
+    for (size_t s = leafStages; s < radices.size(); s++) {
+        int radix = radices[s];
+        const ComplexType* stage = twiddles[s].data();
+        if (radix != 2 && radix != 4)
+            apply_twiddles(data, n, radix, stage_length, stage, kernels);
+
+        switch (radix) {
+        case 2: kernels.radix2(data, n, stage_length, stage); break;
+        case 3: radix3_stage(data, n, stage_length, sign); break;
+        case 4: kernels.radix4(data, n, stage_length, stage, sign); break;
+        case 5: radix5_stage(data, n, stage_length, sign); break;
+        case 7: radix7_stage(data, n, stage_length, sign); break;
+        }
+        stage_length *= radix;
+    }
+}
+
+template<typename Real>
+void BasicFFTPlan1D<Real>::executeBluestein(ComplexType* data, ComplexType* scratch) const
+{
+    const FFTKernelSet<Real>& kernels = fft_kernel_set<Real>(selectedKernels ? *selectedKernels : fft_kernels());
+    int n = length * batch, m = convolutionSize * batch;
+    ComplexType* a = scratch;
+
+    kernels.complex_multiply(a, data, chirp.data(), n);
+    for (int i = n; i < m; i++)
+        a[i] = Real(0);
+
+    convolutionForward->execute(a, scratch + m);
+    kernels.complex_multiply(a, a, kernelSpectrum.data(), m);
+    convolutionInverse->execute(a, scratch + m);
+    kernels.complex_multiply(data, a, chirp.data(), n);
+}
+
+template<typename Real>
+BasicFFTRealPlan1D<Real>::BasicFFTRealPlan1D(int n)
+    : length(n),
+    complexForward(n % 2 == 0 ? n / 2 : n, FFTDirection::Forward),
+    complexInverse(n % 2 == 0 ? n / 2 : n, FFTDirection::Inverse)
+{
+    if (n % 2 == 0) {
+        twiddles.resize(n / 2);
+        for (int k = 0; k < n / 2; k++)
+            twiddles[k] = unit_root<Real>(-2.0L * PI_L * k / n);
+    }
+}
+
+template<typename Real>
+int BasicFFTRealPlan1D<Real>::scratchSize() const
+{
+    int half = complexForward.size();
+    return half + complexForward.scratchSize();
+}
+
+template<typename Real>
+template<typename T>
+void BasicFFTRealPlan1D<Real>::forwardImpl(const T* in, ComplexType* out, ComplexType* scratch) const
+{
+    typedef ComplexType C;
+    const Real half = 0.5;
+    int n = length;
+    if (n % 2 == 1) {
+        for (int i = 0; i < n; i++)
+            scratch[i] = C((Real)in[i], Real(0));
+        complexForward.execute(scratch, scratch + n);
+        for (int k = 0; k <= n / 2; k++)
+            out[k] = scratch[k];
+        return;
+    }
+
+    // Z = FFT(x[2k] + i x[2k+1]); X[k] = E[k] + w^k O[k] with E = (Z[k] + conj Z[h-k]) / 2
+    // and O = (Z[k] - conj Z[h-k]) / 2i. Bins k and h - k share their inputs, so it runs in place.
+    int h = n / 2;
+    for (int k = 0; k < h; k++)
+        out[k] = C((Real)in[2 * k], (Real)in[2 * k + 1]);
+    complexForward.execute(out, scratch);
+
+    C z0 = out[0];
+    out[0] = C(z0.real() + z0.imag(), Real(0));
+    out[h] = C(z0.real() - z0.imag(), Real(0));
+    for (int k = 1; k <= h / 2; k++) {
+        C zk = out[k], zm = out[h - k];
+        C even_k = half * (zk + conj(zm)), odd_k = C(Real(0), -half) * (zk - conj(zm));
+        C even_m = half * (zm + conj(zk)), odd_m = C(Real(0), -half) * (zm - conj(zk));
+        out[k] = even_k + twiddles[k] * odd_k;
+        out[h - k] = even_m + twiddles[h - k] * odd_m;
+    }
+}
+
+template<typename Real>
+void BasicFFTRealPlan1D<Real>::forward(const unsigned char* in, ComplexType* out, ComplexType* scratch) const
+{
+    forwardImpl(in, out, scratch);
+}
+
+template<typename Real>
+void BasicFFTRealPlan1D<Real>::forward(const short* in, ComplexType* out, ComplexType* scratch) const
+{
+    forwardImpl(in, out, scratch);
+}
+
+template<typename Real>
+void BasicFFTRealPlan1D<Real>::forward(const Real* in, ComplexType* out, ComplexType* scratch) const
+{
+    forwardImpl(in, out, scratch);
+}
+
+template<typename Real>
+void BasicFFTRealPlan1D<Real>::inverse(const ComplexType* in, Real* out, ComplexType* scratch) const
+{
+    typedef ComplexType C;
+    int n = length;
+    if (n % 2 == 1) {
+        scratch[0] = in[0];
+        for (int k = 1; k <= n / 2; k++) {
+            scratch[k] = in[k];
+            scratch[n - k] = conj(in[k]);
+        }
+        complexInverse.execute(scratch, scratch + n);
+        for (int i = 0; i < n; i++)
+            out[i] = scratch[i].real();
+        return;
+    }
+
+    // Undo the forward split: Z[k] = 2E[k] + 2i O[k], then z = IFFT(Z) = n * (x[2k] + i x[2k+1]).
+    int h = n / 2;
+    C* z = scratch;
+    for (int k = 0; k < h; k++) {
+        C xk = in[k], xm = conj(in[h - k]);
+        z[k] = (xk + xm) + C(Real(0), Real(1)) * (xk - xm) * conj(twiddles[k]);
+    }
+    complexInverse.execute(z, scratch + h);
+    for (int k = 0; k < h; k++) {
+        out[2 * k] = z[k].real();
+        out[2 * k + 1] = z[k].imag();
+    }
+}
+
+template<typename T>
+static void check_size(const Buffer2D<T>& buffer, int width, int height)
+{
+    if (buffer.width() != width || buffer.height() != height)
+        throw std::runtime_error("Buffer size does not match the FFT plan!");
+}
+
+// Rows [0, height): load(x, line) fills the worker's line, the plan transforms it and the
+// result goes to row x of the re/im planes. The worker's scratch follows its line.
+template<typename Real, typename Load>
+static void row_pass(const BasicFFTPlan1D<Real>& plan, Load load, Buffer2D<Real>& re, Buffer2D<Real>& im,
+    Buffer2D<std::complex<Real>>& workspaces, int scratch_offset)
+{
+    int width = plan.size();
+    ThreadPool::global().parallelFor(0, re.height(), 8, [&](int begin, int end, int worker) {
+        std::complex<Real>* line = workspaces.row(worker);
+        std::complex<Real>* scratch = line + scratch_offset;
+        for (int x = begin; x < end; x++) {
+            load(x, line);
+            plan.execute(line, scratch);
+            Real* re_row = re.row(x);
+            Real* im_row = im.row(x);
+            for (int y = 0; y < width; y++) {
+                re_row[y] = line[y].real();
+                im_row[y] = line[y].imag();
+            }
+        }
+    });
+}
+
+// Columns [0, re.width()) gathered into the worker's line, transformed and scattered back.
+template<typename Real>
+static void column_pass(const BasicFFTPlan1D<Real>& plan, Buffer2D<Real>& re, Buffer2D<Real>& im,
+    Buffer2D<std::complex<Real>>& workspaces, int scratch_offset)
+{
+    int height = plan.size();
+    ThreadPool::global().parallelFor(0, re.width(), 8, [&](int begin, int end, int worker) {
+        std::complex<Real>* line = workspaces.row(worker);
+        std::complex<Real>* scratch = line + scratch_offset;
+        for (int y = begin; y < end; y++) {
+            for (int x = 0; x < height; x++)
+                line[x] = std::complex<Real>(re.row(x)[y], im.row(x)[y]);
+            plan.execute(line, scratch);
+            for (int x = 0; x < height; x++) {
+                re.row(x)[y] = line[x].real();
+                im.row(x)[y] = line[x].imag();
+            }
+        }
+    });
+}
+
+// Same result as column_pass: the planes are transposed in cache-sized tiles so that every
+// column becomes a contiguous row, transformed by a row pass and transposed back. Square planes
+// are transposed in place; otherwise re_t/im_t (re.height() x re.width()) hold the transposed planes.
+template<typename Real>
+static void transposed_column_pass(const BasicFFTPlan1D<Real>& plan, Buffer2D<Real>& re, Buffer2D<Real>& im,
+    Buffer2D<Real>& re_t, Buffer2D<Real>& im_t, Buffer2D<std::complex<Real>>& workspaces, int scratch_offset)
+{
+    bool square = re.width() == re.height();
+    Buffer2D<Real>* columns_re = &re;
+    Buffer2D<Real>* columns_im = &im;
+    if (square) {
+        transpose_in_place(re);
+        transpose_in_place(im);
+    } else {
+        transpose(re, re_t);
+        transpose(im, im_t);
+        columns_re = &re_t;
+        columns_im = &im_t;
+    }
+
+    auto load = [&](int x, std::complex<Real>* line) {
+        const Real* re_row = columns_re->row(x);
+        const Real* im_row = columns_im->row(x);
+        for (int y = 0; y < plan.size(); y++)
+            line[y] = std::complex<Real>(re_row[y], im_row[y]);
+    };
+    row_pass(plan, load, *columns_re, *columns_im, workspaces, scratch_offset);
+
+    if (square) {
+        transpose_in_place(re);
+        transpose_in_place(im);
+    } else {
+        transpose(re_t, re);
+        transpose(im_t, im);
+    }
+}
+
+// bench-transpose: the two extra transposes pay for themselves from about 256 rows on, where a
+// strided gather starts missing the lines it loaded for the neighbouring columns.
+static FFTColumnPass default_column_pass(int height)
+{
+    return height >= 256 ? FFTColumnPass::Transposed : FFTColumnPass::Strided;
+}
+
+template<typename Real>
+BasicFFTPlan<Real>::BasicFFTPlan(int width, int height, FFTDirection direction)
+    : width(width), height(height), direction(direction), rows(width, direction), columns(height, direction),
+    columnPass(default_column_pass(height))
+{
+    scratchOffset = width > height ? width : height;
+    int scratch = rows.scratchSize() > columns.scratchSize() ? rows.scratchSize() : columns.scratchSize();
+    workspaceSize = scratchOffset + scratch;
+
+    setLineAlgorithms(fft_prefers_dft_matrix<Real>(width) ? FFTLineAlgorithm::DFTMatrix : FFTLineAlgorithm::FFT,
+        fft_prefers_dft_matrix<Real>(height) ? FFTLineAlgorithm::DFTMatrix : FFTLineAlgorithm::FFT);
+}
+
+template<typename Real>
+BasicFFTPlan<Real>::~BasicFFTPlan()
+{
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::setColumnPass(FFTColumnPass mode)
+{
+    std::lock_guard<std::mutex> lock(executeMutex);
+    columnPass = mode;
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::setLineAlgorithms(FFTLineAlgorithm rows, FFTLineAlgorithm columns)
+{
+    std::lock_guard<std::mutex> lock(executeMutex);
+    if (rows != FFTLineAlgorithm::DFTMatrix)
+        rowsMatrix.reset();
+    else if (!rowsMatrix)
+        rowsMatrix.reset(new BasicDFTMatrix<Real>(width, direction));
+    if (columns != FFTLineAlgorithm::DFTMatrix)
+        columnsMatrix.reset();
+    else if (!columnsMatrix)
+        columnsMatrix.reset(new BasicDFTMatrix<Real>(height, direction));
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::setRadices(FFTRadices radices)
+{
+    std::lock_guard<std::mutex> lock(executeMutex);
+    if (radices == factors)
+        return;
+    const FFTKernels* kernels = rows.kernels();
+    factors = radices;
+    rows = BasicFFTPlan1D<Real>(width, direction, 1, factors);
+    columns = BasicFFTPlan1D<Real>(height, direction, 1, factors);
+    rows.setKernels(kernels);
+    columns.setKernels(kernels);
+    batchRows.reset();
+    batchColumns.reset();
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::setKernels(const FFTKernels* kernels)
+{
+    std::lock_guard<std::mutex> lock(executeMutex);
+    rows.setKernels(kernels);
+    columns.setKernels(kernels);
+    if (batchRows) {
+        batchRows->setKernels(kernels);
+        batchColumns->setKernels(kernels);
+    }
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::setThreadCount(int count)
+{
+    std::lock_guard<std::mutex> lock(executeMutex);
+    threads = count;
+}
+
+template<typename Real>
+WorkspaceStats BasicFFTPlan<Real>::workspaceStats() const
+{
+    WorkspaceStats stats = workspace.stats(), batch = batchWorkspace.stats();
+    stats.reserved += batch.reserved;
+    stats.used += batch.used;
+    stats.peak += batch.peak;
+    stats.hugePages += batch.hugePages;
+    stats.blocks += batch.blocks;
+    return stats;
+}
+
+// Lays out the planes the current configuration needs in one pass over the arena; a configuration
+// that needs the same planes as the last one keeps them.
+template<typename Real>
+void BasicFFTPlan<Real>::reserveWorkspace()
+{
+    int workers = ThreadPool::global().size();
+    bool transposed = !columnsMatrix && columnPass == FFTColumnPass::Transposed && width != height;
+    bool matrix = rowsMatrix || columnsMatrix;
+    if (workspaces.height() == workers && transposedRe.height() == (transposed ? width : 0)
+        && matrixRe.height() == (matrix ? height : 0))
+        return;
+
+    workspace.reset();
+    workspace.reserve(WorkspaceArena::bufferBytes<ComplexType>(workspaceSize, workers)
+        + (transposed ? 2 * WorkspaceArena::bufferBytes<Real>(height, width) : 0)
+        + (matrix ? 2 * WorkspaceArena::bufferBytes<Real>(width, height) : 0));
+    workspaces = workspace.buffer<ComplexType>(workspaceSize, workers);
+    transposedRe = transposed ? workspace.buffer<Real>(height, width) : Buffer2D<Real>();
+    transposedIm = transposed ? workspace.buffer<Real>(height, width) : Buffer2D<Real>();
+    matrixRe = matrix ? workspace.buffer<Real>(width, height) : Buffer2D<Real>();
+    matrixIm = matrix ? workspace.buffer<Real>(width, height) : Buffer2D<Real>();
+}
+
+// Converts (or copies) a plane into the matrix path's input plane.
+template<typename Real, typename T>
+static void load_matrix_plane(const Buffer2D<T>& from, Buffer2D<Real>& to)
+{
+    int width = from.width();
+    ThreadPool::global().parallelFor(0, from.height(), 16, [&](int begin, int end, int) {
+        for (int x = begin; x < end; x++) {
+            const T* source = from.row(x);
+            Real* target = to.row(x);
+            for (int y = 0; y < width; y++)
+                target[y] = (Real)source[y];
+        }
+    });
+}
+
+template<typename Real>
+template<typename T>
+void BasicFFTPlan<Real>::executeReal(const Buffer2D<T>& in, Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    check_size(in, width, height);
+    check_size(re, width, height);
+    check_size(im, width, height);
+
+    std::lock_guard<std::mutex> lock(executeMutex);
+    ThreadPool::Limit limit(threads);
+    reserveWorkspace();
+
+    if (rowsMatrix) {
+        load_matrix_plane(in, matrixRe);
+        rowsMatrix->transformRows(matrixRe, nullptr, re, im);
+    } else {
+        auto load = [&](int x, ComplexType* line) {
+            const T* row = in.row(x);
+            for (int y = 0; y < width; y++)
+                line[y] = ComplexType((Real)row[y], Real(0));
+        };
+        row_pass(rows, load, re, im, workspaces, scratchOffset);
+    }
+    executeColumns(re, im);
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::executeColumns(Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    if (columnsMatrix) {
+        load_matrix_plane(re, matrixRe);
+        load_matrix_plane(im, matrixIm);
+        columnsMatrix->transformColumns(matrixRe, matrixIm, re, im);
+    } else if (columnPass == FFTColumnPass::Transposed) {
+        transposed_column_pass(columns, re, im, transposedRe, transposedIm, workspaces, scratchOffset);
+    } else {
+        column_pass(columns, re, im, workspaces, scratchOffset);
+    }
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::execute(const Buffer2D<unsigned char>& in, Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    executeReal(in, re, im);
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::execute(const Buffer2D<short>& in, Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    executeReal(in, re, im);
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::execute(Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    check_size(re, width, height);
+    check_size(im, width, height);
+
+    std::lock_guard<std::mutex> lock(executeMutex);
+    ThreadPool::Limit limit(threads);
+    reserveWorkspace();
+
+    if (rowsMatrix) {
+        load_matrix_plane(re, matrixRe);
+        load_matrix_plane(im, matrixIm);
+        rowsMatrix->transformRows(matrixRe, &matrixIm, re, im);
+    } else {
+        auto load = [&](int x, ComplexType* line) {
+            const Real* re_row = re.row(x);
+            const Real* im_row = im.row(x);
+            for (int y = 0; y < width; y++)
+                line[y] = ComplexType(re_row[y], im_row[y]);
+        };
+        row_pass(rows, load, re, im, workspaces, scratchOffset);
+    }
+    executeColumns(re, im);
+}
+
+template<typename Real>
+template<typename Load>
+void BasicFFTPlan<Real>::executeBatchImpl(int count, Load load, Buffer2D<Real>* re, Buffer2D<Real>* im)
+{
+    for (int i = 0; i < count; i++) {
+        check_size(re[i], width, height);
+        check_size(im[i], width, height);
+    }
+
+    std::lock_guard<std::mutex> lock(executeMutex);
+    ThreadPool::Limit limit(threads);
+    const int lanes = batchLanes;
+    if (!batchRows) {
+        batchRows.reset(new BasicFFTPlan1D<Real>(width, direction, lanes, factors));
+        batchColumns.reset(new BasicFFTPlan1D<Real>(height, direction, lanes, factors));
+        batchRows->setKernels(rows.kernels());
+        batchColumns->setKernels(rows.kernels());
+        batchScratchOffset = (width > height ? width : height) * lanes;
+    }
+    ThreadPool& pool = ThreadPool::global();
+    int scratch = batchRows->scratchSize();
+    if (batchColumns->scratchSize() > scratch)
+        scratch = batchColumns->scratchSize();
+    if (batchWorkspaces.height() != pool.size() || batchWorkspaces.width() != batchScratchOffset + scratch) {
+        batchWorkspace.reset();
+        batchWorkspace.reserve(WorkspaceArena::bufferBytes<ComplexType>(batchScratchOffset + scratch, pool.size())
+            + pool.size() * WorkspaceArena::bufferBytes<ComplexType>(width * lanes, height));
+        batchWorkspaces = batchWorkspace.buffer<ComplexType>(batchScratchOffset + scratch, pool.size());
+        batchPlanes.clear();
+        for (int worker = 0; worker < pool.size(); worker++)
+            batchPlanes.push_back(batchWorkspace.buffer<ComplexType>(width * lanes, height));
+    }
+
+    int groups = (count + lanes - 1) / lanes;
+    pool.parallelFor(0, groups, 1, [&](int begin, int end, int worker) {
+        Buffer2D<ComplexType>& plane = batchPlanes[worker];
+        ComplexType* line = batchWorkspaces.row(worker);
+        ComplexType* scratch = line + batchScratchOffset;
+
+        for (int group = begin; group < end; group++) {
+            int first = group * lanes;
+            int items = count - first < lanes ? count - first : lanes;
+
+            // Lanes past the end of the batch transform zeros.
+            for (int x = 0; x < height; x++) {
+                ComplexType* row = plane.row(x);
+                for (int b = 0; b < lanes; b++) {
+                    if (b < items) {
+                        load(first + b, x, row + b, lanes);
+                    } else {
+                        for (int y = 0; y < width; y++)
+                            row[y * lanes + b] = Real(0);
+                    }
+                }
+                batchRows->execute(row, scratch);
+            }
+
+            for (int y = 0; y < width; y++) {
+                for (int x = 0; x < height; x++)
+                    for (int b = 0; b < lanes; b++)
+                        line[x * lanes + b] = plane.row(x)[y * lanes + b];
+                batchColumns->execute(line, scratch);
+                for (int x = 0; x < height; x++)
+                    for (int b = 0; b < lanes; b++)
+                        plane.row(x)[y * lanes + b] = line[x * lanes + b];
+            }
+
+            for (int b = 0; b < items; b++) {
+                for (int x = 0; x < height; x++) {
+                    const ComplexType* row = plane.row(x);
+                    Real* re_row = re[first + b].row(x);
+                    Real* im_row = im[first + b].row(x);
+                    for (int y = 0; y < width; y++) {
+                        re_row[y] = row[y * lanes + b].real();
+                        im_row[y] = row[y * lanes + b].imag();
+                    }
+                }
+            }
+        }
+    });
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::executeBatch(const Buffer2D<unsigned char>* in, Buffer2D<Real>* re, Buffer2D<Real>* im,
+    int count)
+{
+    for (int i = 0; i < count; i++)
+        check_size(in[i], width, height);
+    auto load = [&](int item, int x, ComplexType* out, int step) {
+        const unsigned char* row = in[item].row(x);
+        for (int y = 0; y < width; y++)
+            out[y * step] = ComplexType((Real)row[y], Real(0));
+    };
+    executeBatchImpl(count, load, re, im);
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::executeBatch(const Buffer2D<short>* in, Buffer2D<Real>* re, Buffer2D<Real>* im, int count)
+{
+    for (int i = 0; i < count; i++)
+        check_size(in[i], width, height);
+    auto load = [&](int item, int x, ComplexType* out, int step) {
+        const short* row = in[item].row(x);
+        for (int y = 0; y < width; y++)
+            out[y * step] = ComplexType((Real)row[y], Real(0));
+    };
+    executeBatchImpl(count, load, re, im);
+}
+
+template<typename Real>
+void BasicFFTPlan<Real>::executeBatch(Buffer2D<Real>* re, Buffer2D<Real>* im, int count)
+{
+    auto load = [&](int item, int x, ComplexType* out, int step) {
+        const Real* re_row = re[item].row(x);
+        const Real* im_row = im[item].row(x);
+        for (int y = 0; y < width; y++)
+            out[y * step] = ComplexType(re_row[y], im_row[y]);
+    };
+    executeBatchImpl(count, load, re, im);
+}
+
+template<typename Real>
+BasicFFTRealPlan<Real>::BasicFFTRealPlan(int width, int height)
+    : width(width), height(height), spectrumWidth(width / 2 + 1), rows(width),
+    columnsForward(height, FFTDirection::Forward), columnsInverse(height, FFTDirection::Inverse),
+    columnPass(default_column_pass(height))
+{
+    scratchOffset = spectrumWidth > height ? spectrumWidth : height;
+    int scratch = rows.scratchSize();
+    if (columnsForward.scratchSize() > scratch)
+        scratch = columnsForward.scratchSize();
+    workspaceSize = scratchOffset + scratch;
+}
+
+template<typename Real>
+void BasicFFTRealPlan<Real>::setColumnPass(FFTColumnPass mode)
+{
+    std::lock_guard<std::mutex> lock(executeMutex);
+    columnPass = mode;
+}
+
+template<typename Real>
+void BasicFFTRealPlan<Real>::reserveWorkspace()
+{
+    int workers = ThreadPool::global().size();
+    bool transposed = columnPass == FFTColumnPass::Transposed && spectrumWidth != height;
+    if (workspaces.height() == workers && transposedRe.height() == (transposed ? spectrumWidth : 0))
+        return;
+
+    workspace.reset();
+    workspace.reserve(WorkspaceArena::bufferBytes<ComplexType>(workspaceSize, workers)
+        + (transposed ? 2 * WorkspaceArena::bufferBytes<Real>(height, spectrumWidth) : 0));
+    workspaces = workspace.buffer<ComplexType>(workspaceSize, workers);
+    transposedRe = transposed ? workspace.buffer<Real>(height, spectrumWidth) : Buffer2D<Real>();
+    transposedIm = transposed ? workspace.buffer<Real>(height, spectrumWidth) : Buffer2D<Real>();
+}
+
+template<typename Real>
+template<typename T>
+void BasicFFTRealPlan<Real>::forwardImpl(const Buffer2D<T>& in, Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    check_size(in, width, height);
+    check_size(re, spectrumWidth, height);
+    check_size(im, spectrumWidth, height);
+
+    std::lock_guard<std::mutex> lock(executeMutex);
+    ThreadPool& pool = ThreadPool::global();
+    reserveWorkspace();
+
+    pool.parallelFor(0, height, 8, [&](int begin, int end, int worker) {
+        ComplexType* line = workspaces.row(worker);
+        ComplexType* scratch = line + scratchOffset;
+        for (int x = begin; x < end; x++) {
+            rows.forward(in.row(x), line, scratch);
+            Real* re_row = re.row(x);
+            Real* im_row = im.row(x);
+            for (int y = 0; y < spectrumWidth; y++) {
+                re_row[y] = line[y].real();
+                im_row[y] = line[y].imag();
+            }
+        }
+    });
+
+    executeColumns(columnsForward, re, im);
+}
+
+template<typename Real>
+void BasicFFTRealPlan<Real>::executeColumns(const BasicFFTPlan1D<Real>& plan, Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    if (columnPass == FFTColumnPass::Transposed)
+        transposed_column_pass(plan, re, im, transposedRe, transposedIm, workspaces, scratchOffset);
+    else
+        column_pass(plan, re, im, workspaces, scratchOffset);
+}
+
+template<typename Real>
+void BasicFFTRealPlan<Real>::forward(const Buffer2D<unsigned char>& in, Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    forwardImpl(in, re, im);
+}
+
+template<typename Real>
+void BasicFFTRealPlan<Real>::forward(const Buffer2D<short>& in, Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    forwardImpl(in, re, im);
+}
+
+template<typename Real>
+void BasicFFTRealPlan<Real>::forward(const Buffer2D<Real>& in, Buffer2D<Real>& re, Buffer2D<Real>& im)
+{
+    forwardImpl(in, re, im);
+}
+
+template<typename Real>
+void BasicFFTRealPlan<Real>::inverse(Buffer2D<Real>& re, Buffer2D<Real>& im, Buffer2D<Real>& out)
+{
+    check_size(re, spectrumWidth, height);
+    check_size(im, spectrumWidth, height);
+    check_size(out, width, height);
+
+    std::lock_guard<std::mutex> lock(executeMutex);
+    ThreadPool& pool = ThreadPool::global();
+    reserveWorkspace();
+
+    executeColumns(columnsInverse, re, im);
+
+    pool.parallelFor(0, height, 8, [&](int begin, int end, int worker) {
+        ComplexType* line = workspaces.row(worker);
+        ComplexType* scratch = line + scratchOffset;
+        for (int x = begin; x < end; x++) {
+            const Real* re_row = re.row(x);
+            const Real* im_row = im.row(x);
+            for (int y = 0; y < spectrumWidth; y++)
+                line[y] = ComplexType(re_row[y], im_row[y]);
+            rows.inverse(line, out.row(x), scratch);
+        }
+    });
+}
+
+template class BasicFFTPlan1D<float>;
+template class BasicFFTPlan1D<double>;
+template class BasicFFTPlan1D<long double>;
+template class BasicFFTPlan<float>;
+template class BasicFFTPlan<double>;
+template class BasicFFTPlan<long double>;
+template class BasicFFTRealPlan1D<float>;
+template class BasicFFTRealPlan1D<double>;
+template class BasicFFTRealPlan1D<long double>;
+template class BasicFFTRealPlan<float>;
+template class BasicFFTRealPlan<double>;
+template class BasicFFTRealPlan<long double>;
+
+static std::mutex plan_cache_mutex;
+
+template<typename Real>
+const BasicFFTPlan1D<Real>& fft_plan_1d(int n, FFTDirection direction)
+{
+    static std::map<std::pair<int, FFTDirection>, std::unique_ptr<BasicFFTPlan1D<Real>>> cache;
+    std::lock_guard<std::mutex> lock(plan_cache_mutex);
+    auto& plan = cache[std::make_pair(n, direction)];
+    if (!plan)
+        plan.reset(new BasicFFTPlan1D<Real>(n, direction));
+    return *plan;
+}
+
+template<typename Real>
+BasicFFTPlan<Real>& fft_plan_2d(int width, int height, FFTDirection direction)
+{
+    static std::map<std::tuple<int, int, FFTDirection>, std::unique_ptr<BasicFFTPlan<Real>>> cache;
+    std::lock_guard<std::mutex> lock(plan_cache_mutex);
+    auto& plan = cache[std::make_tuple(width, height, direction)];
+    if (!plan) {
+        plan.reset(new BasicFFTPlan<Real>(width, height, direction));
+        fft_apply_wisdom(*plan, width, height);
+    }
+    return *plan;
+}
+
+template<typename Real>
+BasicFFTRealPlan<Real>& fft_plan_real_2d(int width, int height)
+{
+    static std::map<std::pair<int, int>, std::unique_ptr<BasicFFTRealPlan<Real>>> cache;
+    std::lock_guard<std::mutex> lock(plan_cache_mutex);
+    auto& plan = cache[std::make_pair(width, height)];
+    if (!plan)
+        plan.reset(new BasicFFTRealPlan<Real>(width, height));
+    return *plan;
+}
+
+template const FFTPlan1Df& fft_plan_1d<float>(int n, FFTDirection direction);
+template const FFTPlan1D& fft_plan_1d<double>(int n, FFTDirection direction);
+template const BasicFFTPlan1D<long double>& fft_plan_1d<long double>(int n, FFTDirection direction);
+template FFTPlanf& fft_plan_2d<float>(int width, int height, FFTDirection direction);
+template FFTPlan& fft_plan_2d<double>(int width, int height, FFTDirection direction);
+template BasicFFTPlan<long double>& fft_plan_2d<long double>(int width, int height, FFTDirection direction);
+template FFTRealPlanf& fft_plan_real_2d<float>(int width, int height);
+template FFTRealPlan& fft_plan_real_2d<double>(int width, int height);
+template BasicFFTRealPlan<long double>& fft_plan_real_2d<long double>(int width, int height);
+
+void fft_1d(Complex* data, int n, bool inverse)
+{
+    const FFTPlan1D& plan = fft_plan_1d(n, inverse ? FFTDirection::Inverse : FFTDirection::Forward);
+    thread_local std::vector<Complex> scratch;
+    if ((int)scratch.size() < plan.scratchSize())
+        scratch.resize(plan.scratchSize());
+    plan.execute(data, scratch.data());
+}
+
+// The copies live in the calling thread's workspace, so repeated calls do not allocate.
+template<typename T>
+static Buffer2D<T> copy_from_array(T** array, int height, int width)
+{
+    Buffer2D<T> buffer = thread_workspace().buffer<T>(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            buffer.row(x)[y] = array[x][y];
+    return buffer;
+}
+
+template<typename T>
+static void copy_to_array(const Buffer2D<T>& buffer, T** array)
+{
+    for (int x = 0; x < buffer.height(); x++)
+        for (int y = 0; y < buffer.width(); y++)
+            array[x][y] = buffer.row(x)[y];
+}
+
+void fft_2d(short** in_array, double** re_array, double** im_array, int height, int width)
+{
+    WorkspaceScope scope(thread_workspace());
+    Buffer2D<short> in = copy_from_array(in_array, height, width);
+    Buffer2D<double> re = thread_workspace().buffer<double>(width, height);
+    Buffer2D<double> im = thread_workspace().buffer<double>(width, height);
+    fft_plan_2d(width, height, FFTDirection::Forward).execute(in, re, im);
+    copy_to_array(re, re_array);
+    copy_to_array(im, im_array);
+}
+
+void fft_2d_r2c(short** in_array, double** re_array, double** im_array, int height, int width)
+{
+    WorkspaceScope scope(thread_workspace());
+    Buffer2D<short> in = copy_from_array(in_array, height, width);
+    Buffer2D<double> re = thread_workspace().buffer<double>(width / 2 + 1, height);
+    Buffer2D<double> im = thread_workspace().buffer<double>(width / 2 + 1, height);
+    fft_plan_real_2d(width, height).forward(in, re, im);
+    copy_to_array(re, re_array);
+    copy_to_array(im, im_array);
+}
+
+void fft_2d_c2r(double** re_array, double** im_array, double** out_array, int height, int width)
+{
+    WorkspaceScope scope(thread_workspace());
+    Buffer2D<double> re = copy_from_array(re_array, height, width / 2 + 1);
+    Buffer2D<double> im = copy_from_array(im_array, height, width / 2 + 1);
+    Buffer2D<double> out = thread_workspace().buffer<double>(width, height);
+    fft_plan_real_2d(width, height).inverse(re, im, out);
+    copy_to_array(out, out_array);
+}
@@ -0,0 +1,306 @@
+#pragma once
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer2d.h"
+#include "workspace.h"
+
+typedef std::complex<double> Complex;
+typedef std::complex<float> ComplexF;
+
+enum class FFTDirection {
+    Forward,
+    Inverse
+};
+
+bool is_power_of_two(int n);
+bool is_smooth(int n);
+
+// Smallest size >= n that is smooth and, above 1, even, so that r2c plans take their fast path.
+int fft_good_size(int n);
+
+// How the power-of-two part of a length is split into stages: radix 4 with at most one leading
+// radix 2, or radix 2 throughout. Which is faster depends on the machine (see autotune.h).
+enum class FFTRadices {
+    Radix4,
+    Radix2
+};
+
+// Radices 2/3/4/5/7 in stage order, or empty when n has a larger prime factor.
+std::vector<int> fft_factorize(int n, FFTRadices factors = FFTRadices::Radix4);
+
+struct FFTKernels;
+
+// The plans below are templates over the scalar type and are instantiated for float, double
+// and long double. float halves the memory traffic and doubles the SIMD width, which is plenty
+// for 8-bit images; double is the default; long double runs the scalar kernels and serves as
+// the reference when validating the other two. Twiddles are computed in long double and
+// rounded once, whatever the plan's precision.
+
+// Precomputed 1D transform of any length, unnormalized in both directions. Smooth sizes keep
+// their digit-reversal permutation and per-stage twiddles; other sizes keep the Bluestein chirp
+// and the spectrum of its convolution kernel. execute() does no trig and no allocation.
+// Single-sequence smooth plans run their leading stages as one unrolled 8- to 64-point codelet
+// per block (fft_codelets.h). A plan with batch > 1 transforms batch sequences at once,
+// interleaved element by element: data[j * batch + b] is element j of sequence b.
+template<typename Real>
+class BasicFFTPlan1D
+{
+public:
+    typedef std::complex<Real> ComplexType;
+
+    BasicFFTPlan1D(int n, FFTDirection direction, int batch = 1, FFTRadices factors = FFTRadices::Radix4);
+
+    int size() const { return length; }
+    int batchSize() const { return batch; }
+    int scratchSize() const;
+    void execute(ComplexType* data, ComplexType* scratch) const;
+
+    // Kernel set used by execute(); nullptr follows fft_kernels().
+    const FFTKernels* kernels() const { return selectedKernels; }
+    void setKernels(const FFTKernels* kernels);
+
+private:
+    void executeMixedRadix(ComplexType* data, ComplexType* scratch) const;
+    void executeBluestein(ComplexType* data, ComplexType* scratch) const;
+
+private:
+    int length;
+    int batch;
+    double sign;
+    const FFTKernels* selectedKernels = nullptr;
+    std::vector<int> radices;
+    std::vector<int> permutation;
+    std::vector<std::vector<ComplexType>> twiddles;
+    int leafSize = 0;
+    int leafStages = 0;
+    void (*leaf)(ComplexType* data) = nullptr;
+
+    int convolutionSize = 0;
+    std::vector<ComplexType> chirp;
+    std::vector<ComplexType> kernelSpectrum;
+    std::unique_ptr<BasicFFTPlan1D> convolutionForward;
+    std::unique_ptr<BasicFFTPlan1D> convolutionInverse;
+};
+
+typedef BasicFFTPlan1D<float> FFTPlan1Df;
+typedef BasicFFTPlan1D<double> FFTPlan1D;
+
+// How the 2D plans run their column transforms: gathered straight out of the row-major planes,
+// or as contiguous rows between two cache-blocked transposes.
+enum class FFTColumnPass {
+    Strided,
+    Transposed
+};
+
+// How the 2D plans transform the lines of one direction: the factored FFT (Bluestein for
+// lengths with a large prime factor), or one product with the dense DFT matrix (dft_matrix.h).
+enum class FFTLineAlgorithm {
+    FFT,
+    DFTMatrix
+};
+
+template<typename Real>
+class BasicDFTMatrix;
+
+// 2D transform of a width x height image: row pass, then column pass, each spread over
+// ThreadPool::global(). Every worker has its own line and scratch row; those rows and the planes
+// of the transposed and matrix paths are carved from the plan's WorkspaceArena the first time
+// the plan runs in a configuration (pool size, column pass, line algorithms) and reused until it
+// changes, so execute() itself never allocates. Plans
+// with columns of 256 or more points default to the transposed column pass. Rows or columns of
+// a length for which fft_prefers_dft_matrix() holds default to the DFT matrix product; batches
+// always run the FFT.
+template<typename Real>
+class BasicFFTPlan
+{
+public:
+    typedef std::complex<Real> ComplexType;
+
+    BasicFFTPlan(int width, int height, FFTDirection direction);
+    ~BasicFFTPlan();
+
+    void execute(const Buffer2D<unsigned char>& in, Buffer2D<Real>& re, Buffer2D<Real>& im);
+    void execute(const Buffer2D<short>& in, Buffer2D<Real>& re, Buffer2D<Real>& im);
+    void execute(Buffer2D<Real>& re, Buffer2D<Real>& im);
+
+    // count images (or channel planes) in one call. Groups of batchLanes images are interleaved
+    // element by element and run through batched 1D plans, one image per vector lane; the groups
+    // are spread over the pool, each worker transforming whole groups in its own
+    // width * batchLanes x height plane. This pays off for small frames; batches of fewer than
+    // batchLanes * threads images, or frames whose plane outgrows the cache (about 1024 x 1024),
+    // are better served by execute().
+    void executeBatch(const Buffer2D<unsigned char>* in, Buffer2D<Real>* re, Buffer2D<Real>* im, int count);
+    void executeBatch(const Buffer2D<short>* in, Buffer2D<Real>* re, Buffer2D<Real>* im, int count);
+    void executeBatch(Buffer2D<Real>* re, Buffer2D<Real>* im, int count);
+
+    FFTColumnPass columnPassMode() const { return columnPass; }
+    void setColumnPass(FFTColumnPass mode);
+
+    FFTLineAlgorithm rowAlgorithm() const
+    {
+        return rowsMatrix ? FFTLineAlgorithm::DFTMatrix : FFTLineAlgorithm::FFT;
+    }
+    FFTLineAlgorithm columnAlgorithm() const
+    {
+        return columnsMatrix ? FFTLineAlgorithm::DFTMatrix : FFTLineAlgorithm::FFT;
+    }
+    void setLineAlgorithms(FFTLineAlgorithm rows, FFTLineAlgorithm columns);
+
+    // Knobs for the autotuner (autotune.h): the radix split of both axes, the kernel set (nullptr
+    // follows fft_kernels()) and how many pool threads execute() uses (0: all of them).
+    FFTRadices radices() const { return factors; }
+    void setRadices(FFTRadices radices);
+    const FFTKernels* kernels() const { return rows.kernels(); }
+    void setKernels(const FFTKernels* kernels);
+    int threadCount() const { return threads; }
+    void setThreadCount(int count);
+
+    // Scratch of execute() and executeBatch() together.
+    WorkspaceStats workspaceStats() const;
+
+    static const int batchLanes = 4;
+
+private:
+    void reserveWorkspace();
+    template<typename T>
+    void executeReal(const Buffer2D<T>& in, Buffer2D<Real>& re, Buffer2D<Real>& im);
+    void executeColumns(Buffer2D<Real>& re, Buffer2D<Real>& im);
+    template<typename Load>
+    void executeBatchImpl(int count, Load load, Buffer2D<Real>* re, Buffer2D<Real>* im);
+
+private:
+    int width;
+    int height;
+    FFTDirection direction;
+    FFTRadices factors = FFTRadices::Radix4;
+    int threads = 0;
+    BasicFFTPlan1D<Real> rows;
+    BasicFFTPlan1D<Real> columns;
+    FFTColumnPass columnPass;
+    int scratchOffset;
+    int workspaceSize;
+    WorkspaceArena workspace;
+    Buffer2D<ComplexType> workspaces;
+    Buffer2D<Real> transposedRe;
+    Buffer2D<Real> transposedIm;
+
+    // The matrix path reads a copy of its input from these planes and writes into re/im.
+    std::unique_ptr<BasicDFTMatrix<Real>> rowsMatrix;
+    std::unique_ptr<BasicDFTMatrix<Real>> columnsMatrix;
+    Buffer2D<Real> matrixRe;
+    Buffer2D<Real> matrixIm;
+
+    std::unique_ptr<BasicFFTPlan1D<Real>> batchRows;
+    std::unique_ptr<BasicFFTPlan1D<Real>> batchColumns;
+    int batchScratchOffset = 0;
+    WorkspaceArena batchWorkspace;
+    Buffer2D<ComplexType> batchWorkspaces;
+    std::vector<Buffer2D<ComplexType>> batchPlanes;
+    std::mutex executeMutex;
+};
+
+typedef BasicFFTPlan<float> FFTPlanf;
+typedef BasicFFTPlan<double> FFTPlan;
+
+// Real-input transform of length n producing the n / 2 + 1 non-redundant bins, and its inverse.
+// Even lengths run as a half-length complex FFT on packed (even, odd) sample pairs plus one
+// twiddle pass; odd lengths run the full complex transform. inverse() returns n * x.
+template<typename Real>
+class BasicFFTRealPlan1D
+{
+public:
+    typedef std::complex<Real> ComplexType;
+
+    explicit BasicFFTRealPlan1D(int n);
+
+    int size() const { return length; }
+    int spectrumSize() const { return length / 2 + 1; }
+    int scratchSize() const;
+    void forward(const unsigned char* in, ComplexType* out, ComplexType* scratch) const;
+    void forward(const short* in, ComplexType* out, ComplexType* scratch) const;
+    void forward(const Real* in, ComplexType* out, ComplexType* scratch) const;
+    void inverse(const ComplexType* in, Real* out, ComplexType* scratch) const;
+
+private:
+    template<typename T>
+    void forwardImpl(const T* in, ComplexType* out, ComplexType* scratch) const;
+
+private:
+    int length;
+    BasicFFTPlan1D<Real> complexForward;
+    BasicFFTPlan1D<Real> complexInverse;
+    std::vector<ComplexType> twiddles;
+};
+
+typedef BasicFFTRealPlan1D<float> FFTRealPlan1Df;
+typedef BasicFFTRealPlan1D<double> FFTRealPlan1D;
+
+// r2c / c2r over a width x height image. The spectrum planes are height x (width / 2 + 1);
+// the other half follows from X[x][y] = conj(X[-x][-y]). inverse() overwrites the spectrum
+// with its column transforms and returns width * height * image.
+template<typename Real>
+class BasicFFTRealPlan
+{
+public:
+    typedef std::complex<Real> ComplexType;
+
+    BasicFFTRealPlan(int width, int height);
+
+    void forward(const Buffer2D<unsigned char>& in, Buffer2D<Real>& re, Buffer2D<Real>& im);
+    void forward(const Buffer2D<short>& in, Buffer2D<Real>& re, Buffer2D<Real>& im);
+    void forward(const Buffer2D<Real>& in, Buffer2D<Real>& re, Buffer2D<Real>& im);
+    void inverse(Buffer2D<Real>& re, Buffer2D<Real>& im, Buffer2D<Real>& out);
+
+    FFTColumnPass columnPassMode() const { return columnPass; }
+    void setColumnPass(FFTColumnPass mode);
+
+    WorkspaceStats workspaceStats() const { return workspace.stats(); }
+
+private:
+    void reserveWorkspace();
+    template<typename T>
+    void forwardImpl(const Buffer2D<T>& in, Buffer2D<Real>& re, Buffer2D<Real>& im);
+    void executeColumns(const BasicFFTPlan1D<Real>& plan, Buffer2D<Real>& re, Buffer2D<Real>& im);
+
+private:
+    int width;
+    int height;
+    int spectrumWidth;
+    BasicFFTRealPlan1D<Real> rows;
+    BasicFFTPlan1D<Real> columnsForward;
+    BasicFFTPlan1D<Real> columnsInverse;
+    FFTColumnPass columnPass;
+    int scratchOffset;
+    int workspaceSize;
+    WorkspaceArena workspace;
+    Buffer2D<ComplexType> workspaces;
+    Buffer2D<Real> transposedRe;
+    Buffer2D<Real> transposedIm;
+    std::mutex executeMutex;
+};
+
+typedef BasicFFTRealPlan<float> FFTRealPlanf;
+typedef BasicFFTRealPlan<double> FFTRealPlan;
+
+// Plans built on first use and cached per (precision, size, direction). New 2D plans take the
+// configuration stored for their size in fft_wisdom() (autotune.h), if any.
+template<typename Real = double>
+const BasicFFTPlan1D<Real>& fft_plan_1d(int n, FFTDirection direction);
+template<typename Real = double>
+BasicFFTPlan<Real>& fft_plan_2d(int width, int height, FFTDirection direction);
+template<typename Real = double>
+BasicFFTRealPlan<Real>& fft_plan_real_2d(int width, int height);
+
+// In-place 1D transform of any length through the cached plan.
+void fft_1d(Complex* data, int n, bool inverse);
+
+// Same inputs and outputs as dft(), in O(N^2 log N), through the cached forward plan. The
+// jagged-array entry points copy through Buffer2D; new code should use the plans directly.
+void fft_2d(short** in_array, double** re_array, double** im_array, int height, int width);
+
+// Half-spectrum versions: re/im planes are height x (width / 2 + 1).
+void fft_2d_r2c(short** in_array, double** re_array, double** im_array, int height, int width);
+void fft_2d_c2r(double** re_array, double** im_array, double** out_array, int height, int width);
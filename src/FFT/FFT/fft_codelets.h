@@ -0,0 +1,161 @@
+#pragma once
+#include <complex>
+
+// Straight-line DFTs of 8, 16, 32 and 64 points. Stages, butterflies and twiddles are unrolled
+// by template recursion and the twiddles are constexpr, so a leaf transform compiles to a block
+// of adds and multiplies by immediates: no loops, no index arithmetic, no twiddle loads.
+// The input is in the digit-reversed order that the plan's permutation produces for its leading
+// stages: a radix-2 stage then radix-4 stages for 8 and 32 points, radix-4 stages for 16 and 64.
+namespace fft_codelets {
+
+constexpr long double pi = 3.141592653589793238462643383279502884L;
+
+// Taylor series of cos (odd = false) or sin (odd = true); |x| <= pi converges well within 30 terms.
+constexpr long double series(long double x, bool odd)
+{
+    long double term = odd ? x : 1.0L, sum = 0.0L;
+    for (int i = odd ? 1 : 0; i < 60; i += 2) {
+        sum += term;
+        term *= -x * x / ((i + 1) * (i + 2));
+    }
+    return sum;
+}
+
+// 2 pi k / n reduced to [-pi, pi).
+constexpr long double root_angle(int k, int n)
+{
+    k %= n;
+    if (2 * k >= n)
+        k -= n;
+    return 2.0L * pi * k / n;
+}
+
+// x * w^K with w = exp(-+2 pi i / N). Multiples of a quarter turn are exact swaps and negations.
+template<typename Real, bool Inverse, int K, int N>
+inline std::complex<Real> twiddle(const std::complex<Real>& x)
+{
+    typedef std::complex<Real> C;
+    constexpr long double c = series(root_angle(K, N), false);
+    constexpr long double s = Inverse ? series(root_angle(K, N), true) : -series(root_angle(K, N), true);
+
+    if (K % N == 0)
+        return x;
+    if (2 * K == N)
+        return -x;
+    if (4 * K == N)
+        return Inverse ? C(-x.imag(), x.real()) : C(x.imag(), -x.real());
+    if (4 * K == 3 * N)
+        return Inverse ? C(x.imag(), -x.real()) : C(-x.imag(), x.real());
+
+    const Real wr = (Real)c, wi = (Real)s;
+    return C(x.real() * wr - x.imag() * wi, x.real() * wi + x.imag() * wr);
+}
+
+// Column J of a radix-Radix stage of length Length: x points at its first element.
+template<typename Real, bool Inverse, int Radix, int Length, int J>
+struct Butterfly;
+
+template<typename Real, bool Inverse, int Length, int J>
+struct Butterfly<Real, Inverse, 2, Length, J> {
+    static inline void run(std::complex<Real>* x)
+    {
+        std::complex<Real> a = x[0];
+        std::complex<Real> t = twiddle<Real, Inverse, J, 2 * Length>(x[Length]);
+        x[0] = a + t;
+        x[Length] = a - t;
+    }
+};
+
+template<typename Real, bool Inverse, int Length, int J>
+struct Butterfly<Real, Inverse, 4, Length, J> {
+    static inline void run(std::complex<Real>* x)
+    {
+        typedef std::complex<Real> C;
+        C c0 = x[0];
+        C c1 = twiddle<Real, Inverse, J, 4 * Length>(x[Length]);
+        C c2 = twiddle<Real, Inverse, 2 * J, 4 * Length>(x[2 * Length]);
+        C c3 = twiddle<Real, Inverse, 3 * J, 4 * Length>(x[3 * Length]);
+
+        C s0 = c0 + c2, d0 = c0 - c2;
+        C s1 = c1 + c3, d = c1 - c3;
+        C d1 = Inverse ? C(-d.imag(), d.real()) : C(d.imag(), -d.real());
+
+        x[0] = s0 + s1;
+        x[Length] = d0 + d1;
+        x[2 * Length] = s0 - s1;
+        x[3 * Length] = d0 - d1;
+    }
+};
+
+// All N / Radix butterflies of one stage, Index running over (block, column) pairs.
+template<typename Real, bool Inverse, int N, int Radix, int Length, int Index = 0, bool Done = (Index == N / Radix)>
+struct Stage {
+    static inline void run(std::complex<Real>* x)
+    {
+        Butterfly<Real, Inverse, Radix, Length, Index % Length>::run(
+            x + Index / Length * Radix * Length + Index % Length);
+        Stage<Real, Inverse, N, Radix, Length, Index + 1>::run(x);
+    }
+};
+
+template<typename Real, bool Inverse, int N, int Radix, int Length, int Index>
+struct Stage<Real, Inverse, N, Radix, Length, Index, true> {
+    static inline void run(std::complex<Real>*) {}
+};
+
+// The radix-4 stages from length Length up to N.
+template<typename Real, bool Inverse, int N, int Length, bool Done = (Length >= N)>
+struct Radix4Stages {
+    static inline void run(std::complex<Real>* x)
+    {
+        Stage<Real, Inverse, N, 4, Length>::run(x);
+        Radix4Stages<Real, Inverse, N, Length * 4>::run(x);
+    }
+};
+
+template<typename Real, bool Inverse, int N, int Length>
+struct Radix4Stages<Real, Inverse, N, Length, true> {
+    static inline void run(std::complex<Real>*) {}
+};
+
+template<typename Real, bool Inverse, int N, bool LeadingTwo = (N == 8 || N == 32)>
+struct Codelet {
+    static inline void run(std::complex<Real>* x)
+    {
+        Stage<Real, Inverse, N, 2, 1>::run(x);
+        Radix4Stages<Real, Inverse, N, 2>::run(x);
+    }
+};
+
+template<typename Real, bool Inverse, int N>
+struct Codelet<Real, Inverse, N, false> {
+    static inline void run(std::complex<Real>* x)
+    {
+        Radix4Stages<Real, Inverse, N, 1>::run(x);
+    }
+};
+
+template<typename Real, bool Inverse, int N>
+void run(std::complex<Real>* x)
+{
+    Codelet<Real, Inverse, N>::run(x);
+}
+
+}
+
+// In-place N-point transform of one digit-reversed block.
+template<typename Real>
+using FFTCodelet = void (*)(std::complex<Real>* data);
+
+// The codelet for n points (8, 16, 32 or 64) and the given direction, or nullptr.
+template<typename Real>
+FFTCodelet<Real> fft_codelet(int n, bool inverse)
+{
+    switch (n) {
+    case 8: return inverse ? fft_codelets::run<Real, true, 8> : fft_codelets::run<Real, false, 8>;
+    case 16: return inverse ? fft_codelets::run<Real, true, 16> : fft_codelets::run<Real, false, 16>;
+    case 32: return inverse ? fft_codelets::run<Real, true, 32> : fft_codelets::run<Real, false, 32>;
+    case 64: return inverse ? fft_codelets::run<Real, true, 64> : fft_codelets::run<Real, false, 64>;
+    }
+    return nullptr;
+}
@@ -0,0 +1,219 @@
+#include "fft_kernels.h"
+
+#include <atomic>
+#include <fstream>
+#include <string.h>
+
+#ifdef FFT_ARCH_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+template<typename Real>
+static void radix2_scalar(std::complex<Real>* data, int n, int length, const std::complex<Real>* twiddles)
+{
+    for (int b = 0; b < n; b += 2 * length) {
+        for (int j = 0; j < length; j++) {
+            std::complex<Real> t = twiddles[j] * data[b + j + length];
+            data[b + j + length] = data[b + j] - t;
+            data[b + j] += t;
+        }
+    }
+}
+
+template<typename Real>
+static void radix4_scalar(std::complex<Real>* data, int n, int length, const std::complex<Real>* twiddles,
+    double sign)
+{
+    typedef std::complex<Real> C;
+    const Real s = (Real)sign;
+
+    for (int b = 0; b < n; b += 4 * length) {
+        for (int j = 0; j < length; j++) {
+            C* x = data + b + j;
+            C c0 = x[0];
+            C c1 = twiddles[j] * x[length];
+            C c2 = twiddles[length + j] * x[2 * length];
+            C c3 = twiddles[2 * length + j] * x[3 * length];
+
+            C s0 = c0 + c2, d0 = c0 - c2;
+            C s1 = c1 + c3, d = c1 - c3;
+            C d1(-s * d.imag(), s * d.real());
+
+            x[0] = s0 + s1;
+            x[length] = d0 + d1;
+            x[2 * length] = s0 - s1;
+            x[3 * length] = d0 - d1;
+        }
+    }
+}
+
+template<typename Real>
+static void complex_multiply_scalar(std::complex<Real>* out, const std::complex<Real>* a,
+    const std::complex<Real>* b, int count)
+{
+    for (int i = 0; i < count; i++)
+        out[i] = a[i] * b[i];
+}
+
+template<typename Real>
+FFTKernelSet<Real> fft_scalar_kernel_set()
+{
+    FFTKernelSet<Real> set = { 1, radix2_scalar<Real>, radix4_scalar<Real>, complex_multiply_scalar<Real> };
+    return set;
+}
+
+template FFTKernelSet<float> fft_scalar_kernel_set<float>();
+template FFTKernelSet<double> fft_scalar_kernel_set<double>();
+template FFTKernelSet<long double> fft_scalar_kernel_set<long double>();
+
+const FFTKernels& fft_kernels_scalar()
+{
+    static const FFTKernels kernels = { "scalar", fft_scalar_kernel_set<float>(), fft_scalar_kernel_set<double>(),
+        fft_scalar_kernel_set<long double>() };
+    return kernels;
+}
+
+#ifdef FFT_ARCH_X86
+static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++)
+        regs[i] = (unsigned int)info[i];
+#else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]))
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+static unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+static CpuFeatures detect_cpu_features()
+{
+    CpuFeatures features;
+
+#ifdef FFT_ARCH_X86
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    unsigned int max_leaf = regs[0];
+
+    cpuid(1, 0, regs);
+    features.sse42 = (regs[2] >> 20) & 1;
+    bool fma = (regs[2] >> 12) & 1;
+    bool osxsave = (regs[2] >> 27) & 1;
+    bool avx = (regs[2] >> 28) & 1;
+
+    unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+    bool ymm_state = (xcr0 & 0x6) == 0x6;
+    bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, regs);
+        bool avx2 = (regs[1] >> 5) & 1;
+        bool avx512f = (regs[1] >> 16) & 1;
+        bool avx512dq = (regs[1] >> 17) & 1;
+
+        features.avx2 = avx && avx2 && fma && ymm_state;
+        features.avx512 = features.avx2 && avx512f && avx512dq && zmm_state;
+    }
+#endif
+
+#ifdef FFT_ARCH_ARM64
+    features.neon = true;
+#endif
+
+    return features;
+}
+
+const CpuFeatures& cpu_features()
+{
+    static const CpuFeatures features = detect_cpu_features();
+    return features;
+}
+
+static std::string detect_cpu_model()
+{
+    std::string model;
+#ifdef FFT_ARCH_X86
+    unsigned int regs[4];
+    cpuid(0x80000000, 0, regs);
+    if (regs[0] >= 0x80000004) {
+        char brand[49] = {};
+        for (int i = 0; i < 3; i++) {
+            cpuid(0x80000002 + i, 0, regs);
+            memcpy(brand + 16 * i, regs, 16);
+        }
+        model = brand;
+    }
+#elif defined(__linux__)
+    // No brand string on Arm: the implementer and part numbers of the first core identify it.
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line) && line.find("CPU revision") != 0)
+        if (line.find("CPU implementer") == 0 || line.find("CPU part") == 0)
+            model += (model.empty() ? "" : " ") + line.substr(line.find(':') + 2);
+#endif
+
+    size_t begin = model.find_first_not_of(' '), end = model.find_last_not_of(' ');
+    return begin == std::string::npos ? "unknown" : model.substr(begin, end - begin + 1);
+}
+
+const std::string& cpu_model()
+{
+    static const std::string model = detect_cpu_model();
+    return model;
+}
+
+std::vector<const FFTKernels*> fft_available_kernels()
+{
+    const CpuFeatures& features = cpu_features();
+    std::vector<const FFTKernels*> kernels = { &fft_kernels_scalar() };
+
+#ifdef FFT_ARCH_X86
+    if (features.sse42)
+        kernels.push_back(&fft_kernels_sse42());
+    if (features.avx2)
+        kernels.push_back(&fft_kernels_avx2());
+    if (features.avx512)
+        kernels.push_back(&fft_kernels_avx512());
+#endif
+#ifdef FFT_ARCH_ARM64
+    if (features.neon)
+        kernels.push_back(&fft_kernels_neon());
+#endif
+
+    (void)features;
+    return kernels;
+}
+
+static std::atomic<const FFTKernels*> active_kernels(nullptr);
+
+const FFTKernels& fft_kernels()
+{
+    const FFTKernels* kernels = active_kernels.load(std::memory_order_acquire);
+    if (kernels == nullptr) {
+        kernels = fft_available_kernels().back();
+        active_kernels.store(kernels, std::memory_order_release);
+    }
+    return *kernels;
+}
+
+void fft_use_kernels(const FFTKernels& kernels)
+{
+    active_kernels.store(&kernels, std::memory_order_release);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <complex>
+#include <string>
+#include <vector>
+
+#include "fft.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FFT_ARCH_X86
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define FFT_ARCH_ARM64
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FFT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FFT_TARGET(isa)
+#endif
+
+struct CpuFeatures {
+    bool sse42 = false;
+    bool avx2 = false;      // AVX2 + FMA, YMM state enabled by the OS
+    bool avx512 = false;    // AVX-512 F + DQ, ZMM state enabled by the OS
+    bool neon = false;
+};
+
+// Stage twiddles are laid out per power: twiddles[(q - 1) * length + j] = w^(q * j).
+// lanes is the number of complex values per vector register.
+template<typename Real>
+struct FFTKernelSet {
+    int lanes;
+    void (*radix2)(std::complex<Real>* data, int n, int length, const std::complex<Real>* twiddles);
+    void (*radix4)(std::complex<Real>* data, int n, int length, const std::complex<Real>* twiddles, double sign);
+    void (*complex_multiply)(std::complex<Real>* out, const std::complex<Real>* a, const std::complex<Real>* b,
+        int count);
+};
+
+// One instruction set's kernels for each precision. long double always runs the scalar kernels.
+struct FFTKernels {
+    const char* name;
+    FFTKernelSet<float> float32;
+    FFTKernelSet<double> float64;
+    FFTKernelSet<long double> extended;
+};
+
+template<typename Real>
+const FFTKernelSet<Real>& fft_kernel_set(const FFTKernels& kernels);
+
+template<>
+inline const FFTKernelSet<float>& fft_kernel_set<float>(const FFTKernels& kernels)
+{
+    return kernels.float32;
+}
+
+template<>
+inline const FFTKernelSet<double>& fft_kernel_set<double>(const FFTKernels& kernels)
+{
+    return kernels.float64;
+}
+
+template<>
+inline const FFTKernelSet<long double>& fft_kernel_set<long double>(const FFTKernels& kernels)
+{
+    return kernels.extended;
+}
+
+// Plain C++ kernels for one precision; the vector sets fall back to them for short stages.
+template<typename Real>
+FFTKernelSet<Real> fft_scalar_kernel_set();
+
+const CpuFeatures& cpu_features();
+
+// Name of the running CPU model, e.g. the CPUID brand string; "unknown" when it cannot be read.
+const std::string& cpu_model();
+
+// The widest kernel set the running CPU supports, unless overridden by fft_use_kernels().
+const FFTKernels& fft_kernels();
+void fft_use_kernels(const FFTKernels& kernels);
+std::vector<const FFTKernels*> fft_available_kernels();
+
+const FFTKernels& fft_kernels_scalar();
+#ifdef FFT_ARCH_X86
+const FFTKernels& fft_kernels_sse42();
+const FFTKernels& fft_kernels_avx2();
+const FFTKernels& fft_kernels_avx512();
+#endif
+#ifdef FFT_ARCH_ARM64
+const FFTKernels& fft_kernels_neon();
+#endif
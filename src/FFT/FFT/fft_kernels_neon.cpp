@@ -0,0 +1,152 @@
+#include "fft_kernels.h"
+
+#ifdef FFT_ARCH_ARM64
+#include <arm_neon.h>
+
+// One complex double or two complex floats per register.
+
+static const double conj_signs[2] = { -1.0, 1.0 };
+
+static inline float64x2_t cmul_neon(float64x2_t a, float64x2_t b, float64x2_t signs)
+{
+    float64x2_t br = vdupq_laneq_f64(b, 0);
+    float64x2_t bi = vmulq_f64(vdupq_laneq_f64(b, 1), signs);
+    float64x2_t as = vextq_f64(a, a, 1);
+    return vfmaq_f64(vmulq_f64(a, br), as, bi);
+}
+
+static void radix2_neon(Complex* data, int n, int length, const Complex* twiddles)
+{
+    const double* tw = (const double*)twiddles;
+    const float64x2_t signs = vld1q_f64(conj_signs);
+
+    for (int b = 0; b < n; b += 2 * length) {
+        double* x = (double*)(data + b);
+        for (int j = 0; j < length; j++) {
+            float64x2_t a = vld1q_f64(x + 2 * j);
+            float64x2_t t = cmul_neon(vld1q_f64(x + 2 * (j + length)), vld1q_f64(tw + 2 * j), signs);
+            vst1q_f64(x + 2 * j, vaddq_f64(a, t));
+            vst1q_f64(x + 2 * (j + length), vsubq_f64(a, t));
+        }
+    }
+}
+
+static void radix4_neon(Complex* data, int n, int length, const Complex* twiddles, double sign)
+{
+    const double* tw = (const double*)twiddles;
+    const float64x2_t signs = vld1q_f64(conj_signs);
+    const float64x2_t rot_sign = vmulq_n_f64(signs, sign);
+
+    for (int b = 0; b < n; b += 4 * length) {
+        double* x = (double*)(data + b);
+        for (int j = 0; j < length; j++) {
+            float64x2_t c0 = vld1q_f64(x + 2 * j);
+            float64x2_t c1 = cmul_neon(vld1q_f64(x + 2 * (j + length)), vld1q_f64(tw + 2 * j), signs);
+            float64x2_t c2 = cmul_neon(vld1q_f64(x + 2 * (j + 2 * length)), vld1q_f64(tw + 2 * (length + j)), signs);
+            float64x2_t c3 = cmul_neon(vld1q_f64(x + 2 * (j + 3 * length)), vld1q_f64(tw + 2 * (2 * length + j)), signs);
+
+            float64x2_t s0 = vaddq_f64(c0, c2), d0 = vsubq_f64(c0, c2);
+            float64x2_t s1 = vaddq_f64(c1, c3), d = vsubq_f64(c1, c3);
+            float64x2_t d1 = vmulq_f64(vextq_f64(d, d, 1), rot_sign);
+
+            vst1q_f64(x + 2 * j, vaddq_f64(s0, s1));
+            vst1q_f64(x + 2 * (j + length), vaddq_f64(d0, d1));
+            vst1q_f64(x + 2 * (j + 2 * length), vsubq_f64(s0, s1));
+            vst1q_f64(x + 2 * (j + 3 * length), vsubq_f64(d0, d1));
+        }
+    }
+}
+
+static void complex_multiply_neon(Complex* out, const Complex* a, const Complex* b, int count)
+{
+    double* o = (double*)out;
+    const double* x = (const double*)a;
+    const double* y = (const double*)b;
+    const float64x2_t signs = vld1q_f64(conj_signs);
+
+    for (int i = 0; i < count; i++)
+        vst1q_f64(o + 2 * i, cmul_neon(vld1q_f64(x + 2 * i), vld1q_f64(y + 2 * i), signs));
+}
+
+static const float conj_signs_f32[4] = { -1.0f, 1.0f, -1.0f, 1.0f };
+
+static inline float32x4_t cmul_neon_f32(float32x4_t a, float32x4_t b, float32x4_t signs)
+{
+    float32x4_t br = vtrn1q_f32(b, b);
+    float32x4_t bi = vmulq_f32(vtrn2q_f32(b, b), signs);
+    float32x4_t as = vrev64q_f32(a);
+    return vfmaq_f32(vmulq_f32(a, br), as, bi);
+}
+
+static void radix2_neon_f32(ComplexF* data, int n, int length, const ComplexF* twiddles)
+{
+    if (length % 2 != 0) {
+        fft_kernels_scalar().float32.radix2(data, n, length, twiddles);
+        return;
+    }
+    const float* tw = (const float*)twiddles;
+    const float32x4_t signs = vld1q_f32(conj_signs_f32);
+
+    for (int b = 0; b < n; b += 2 * length) {
+        float* x = (float*)(data + b);
+        for (int j = 0; j < length; j += 2) {
+            float32x4_t a = vld1q_f32(x + 2 * j);
+            float32x4_t t = cmul_neon_f32(vld1q_f32(x + 2 * (j + length)), vld1q_f32(tw + 2 * j), signs);
+            vst1q_f32(x + 2 * j, vaddq_f32(a, t));
+            vst1q_f32(x + 2 * (j + length), vsubq_f32(a, t));
+        }
+    }
+}
+
+static void radix4_neon_f32(ComplexF* data, int n, int length, const ComplexF* twiddles, double sign)
+{
+    if (length % 2 != 0) {
+        fft_kernels_scalar().float32.radix4(data, n, length, twiddles, sign);
+        return;
+    }
+    const float* tw = (const float*)twiddles;
+    const float32x4_t signs = vld1q_f32(conj_signs_f32);
+    const float32x4_t rot_sign = vmulq_n_f32(signs, (float)sign);
+
+    for (int b = 0; b < n; b += 4 * length) {
+        float* x = (float*)(data + b);
+        for (int j = 0; j < length; j += 2) {
+            float32x4_t c0 = vld1q_f32(x + 2 * j);
+            float32x4_t c1 = cmul_neon_f32(vld1q_f32(x + 2 * (j + length)), vld1q_f32(tw + 2 * j), signs);
+            float32x4_t c2 = cmul_neon_f32(vld1q_f32(x + 2 * (j + 2 * length)), vld1q_f32(tw + 2 * (length + j)), signs);
+            float32x4_t c3 = cmul_neon_f32(vld1q_f32(x + 2 * (j + 3 * length)), vld1q_f32(tw + 2 * (2 * length + j)), signs);
+
+            float32x4_t s0 = vaddq_f32(c0, c2), d0 = vsubq_f32(c0, c2);
+            float32x4_t s1 = vaddq_f32(c1, c3), d = vsubq_f32(c1, c3);
+            float32x4_t d1 = vmulq_f32(vrev64q_f32(d), rot_sign);
+
+            vst1q_f32(x + 2 * j, vaddq_f32(s0, s1));
+            vst1q_f32(x + 2 * (j + length), vaddq_f32(d0, d1));
+            vst1q_f32(x + 2 * (j + 2 * length), vsubq_f32(s0, s1));
+            vst1q_f32(x + 2 * (j + 3 * length), vsubq_f32(d0, d1));
+        }
+    }
+}
+
+static void complex_multiply_neon_f32(ComplexF* out, const ComplexF* a, const ComplexF* b, int count)
+{
+    float* o = (float*)out;
+    const float* x = (const float*)a;
+    const float* y = (const float*)b;
+    const float32x4_t signs = vld1q_f32(conj_signs_f32);
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        vst1q_f32(o + 2 * i, cmul_neon_f32(vld1q_f32(x + 2 * i), vld1q_f32(y + 2 * i), signs));
+    for (; i < count; i++)
+        out[i] = a[i] * b[i];
+}
+
+const FFTKernels& fft_kernels_neon()
+{
+    static const FFTKernels kernels = { "neon", { 2, radix2_neon_f32, radix4_neon_f32, complex_multiply_neon_f32 },
+        { 1, radix2_neon, radix4_neon, complex_multiply_neon }, fft_scalar_kernel_set<long double>() };
+    return kernels;
+}
+
+#endif
@@ -0,0 +1,447 @@
+#include "fft_kernels.h"
+
+#ifdef FFT_ARCH_X86
+#include <immintrin.h>
+
+// SSE4.2: one complex double per register.
+
+FFT_TARGET("sse4.2") static inline __m128d cmul_sse(__m128d a, __m128d b)
+{
+    __m128d br = _mm_movedup_pd(b);
+    __m128d bi = _mm_unpackhi_pd(b, b);
+    __m128d as = _mm_shuffle_pd(a, a, 1);
+    return _mm_addsub_pd(_mm_mul_pd(a, br), _mm_mul_pd(as, bi));
+}
+
+FFT_TARGET("sse4.2") static void radix2_sse42(Complex* data, int n, int length, const Complex* twiddles)
+{
+    const double* tw = (const double*)twiddles;
+
+    for (int b = 0; b < n; b += 2 * length) {
+        double* x = (double*)(data + b);
+        for (int j = 0; j < length; j++) {
+            __m128d a = _mm_loadu_pd(x + 2 * j);
+            __m128d t = cmul_sse(_mm_loadu_pd(x + 2 * (j + length)), _mm_loadu_pd(tw + 2 * j));
+            _mm_storeu_pd(x + 2 * j, _mm_add_pd(a, t));
+            _mm_storeu_pd(x + 2 * (j + length), _mm_sub_pd(a, t));
+        }
+    }
+}
+
+FFT_TARGET("sse4.2") static void radix4_sse42(Complex* data, int n, int length, const Complex* twiddles, double sign)
+{
+    const double* tw = (const double*)twiddles;
+    const __m128d rot_sign = _mm_setr_pd(-sign, sign);
+
+    for (int b = 0; b < n; b += 4 * length) {
+        double* x = (double*)(data + b);
+        for (int j = 0; j < length; j++) {
+            __m128d c0 = _mm_loadu_pd(x + 2 * j);
+            __m128d c1 = cmul_sse(_mm_loadu_pd(x + 2 * (j + length)), _mm_loadu_pd(tw + 2 * j));
+            __m128d c2 = cmul_sse(_mm_loadu_pd(x + 2 * (j + 2 * length)), _mm_loadu_pd(tw + 2 * (length + j)));
+            __m128d c3 = cmul_sse(_mm_loadu_pd(x + 2 * (j + 3 * length)), _mm_loadu_pd(tw + 2 * (2 * length + j)));
+
+            __m128d s0 = _mm_add_pd(c0, c2), d0 = _mm_sub_pd(c0, c2);
+            __m128d s1 = _mm_add_pd(c1, c3), d = _mm_sub_pd(c1, c3);
+            __m128d d1 = _mm_mul_pd(_mm_shuffle_pd(d, d, 1), rot_sign);
+
+            _mm_storeu_pd(x + 2 * j, _mm_add_pd(s0, s1));
+            _mm_storeu_pd(x + 2 * (j + length), _mm_add_pd(d0, d1));
+            _mm_storeu_pd(x + 2 * (j + 2 * length), _mm_sub_pd(s0, s1));
+            _mm_storeu_pd(x + 2 * (j + 3 * length), _mm_sub_pd(d0, d1));
+        }
+    }
+}
+
+FFT_TARGET("sse4.2") static void complex_multiply_sse42(Complex* out, const Complex* a, const Complex* b, int count)
+{
+    double* o = (double*)out;
+    const double* x = (const double*)a;
+    const double* y = (const double*)b;
+
+    for (int i = 0; i < count; i++)
+        _mm_storeu_pd(o + 2 * i, cmul_sse(_mm_loadu_pd(x + 2 * i), _mm_loadu_pd(y + 2 * i)));
+}
+
+// SSE4.2 single precision: two complex floats per register.
+
+FFT_TARGET("sse4.2") static inline __m128 cmul_sse_ps(__m128 a, __m128 b)
+{
+    __m128 br = _mm_moveldup_ps(b);
+    __m128 bi = _mm_movehdup_ps(b);
+    __m128 as = _mm_shuffle_ps(a, a, 0xb1);
+    return _mm_addsub_ps(_mm_mul_ps(a, br), _mm_mul_ps(as, bi));
+}
+
+FFT_TARGET("sse4.2") static void radix2_sse42_ps(ComplexF* data, int n, int length, const ComplexF* twiddles)
+{
+    if (length % 2 != 0) {
+        fft_kernels_scalar().float32.radix2(data, n, length, twiddles);
+        return;
+    }
+    const float* tw = (const float*)twiddles;
+
+    for (int b = 0; b < n; b += 2 * length) {
+        float* x = (float*)(data + b);
+        for (int j = 0; j < length; j += 2) {
+            __m128 a = _mm_loadu_ps(x + 2 * j);
+            __m128 t = cmul_sse_ps(_mm_loadu_ps(x + 2 * (j + length)), _mm_loadu_ps(tw + 2 * j));
+            _mm_storeu_ps(x + 2 * j, _mm_add_ps(a, t));
+            _mm_storeu_ps(x + 2 * (j + length), _mm_sub_ps(a, t));
+        }
+    }
+}
+
+FFT_TARGET("sse4.2") static void radix4_sse42_ps(ComplexF* data, int n, int length, const ComplexF* twiddles,
+    double sign)
+{
+    if (length % 2 != 0) {
+        fft_kernels_scalar().float32.radix4(data, n, length, twiddles, sign);
+        return;
+    }
+    const float* tw = (const float*)twiddles;
+    const float s = (float)sign;
+    const __m128 rot_sign = _mm_setr_ps(-s, s, -s, s);
+
+    for (int b = 0; b < n; b += 4 * length) {
+        float* x = (float*)(data + b);
+        for (int j = 0; j < length; j += 2) {
+            __m128 c0 = _mm_loadu_ps(x + 2 * j);
+            __m128 c1 = cmul_sse_ps(_mm_loadu_ps(x + 2 * (j + length)), _mm_loadu_ps(tw + 2 * j));
+            __m128 c2 = cmul_sse_ps(_mm_loadu_ps(x + 2 * (j + 2 * length)), _mm_loadu_ps(tw + 2 * (length + j)));
+            __m128 c3 = cmul_sse_ps(_mm_loadu_ps(x + 2 * (j + 3 * length)), _mm_loadu_ps(tw + 2 * (2 * length + j)));
+
+            __m128 s0 = _mm_add_ps(c0, c2), d0 = _mm_sub_ps(c0, c2);
+            __m128 s1 = _mm_add_ps(c1, c3), d = _mm_sub_ps(c1, c3);
+            __m128 d1 = _mm_mul_ps(_mm_shuffle_ps(d, d, 0xb1), rot_sign);
+
+            _mm_storeu_ps(x + 2 * j, _mm_add_ps(s0, s1));
+            _mm_storeu_ps(x + 2 * (j + length), _mm_add_ps(d0, d1));
+            _mm_storeu_ps(x + 2 * (j + 2 * length), _mm_sub_ps(s0, s1));
+            _mm_storeu_ps(x + 2 * (j + 3 * length), _mm_sub_ps(d0, d1));
+        }
+    }
+}
+
+FFT_TARGET("sse4.2") static void complex_multiply_sse42_ps(ComplexF* out, const ComplexF* a, const ComplexF* b,
+    int count)
+{
+    float* o = (float*)out;
+    const float* x = (const float*)a;
+    const float* y = (const float*)b;
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        _mm_storeu_ps(o + 2 * i, cmul_sse_ps(_mm_loadu_ps(x + 2 * i), _mm_loadu_ps(y + 2 * i)));
+    for (; i < count; i++)
+        out[i] = a[i] * b[i];
+}
+
+const FFTKernels& fft_kernels_sse42()
+{
+    static const FFTKernels kernels = { "sse4.2", { 2, radix2_sse42_ps, radix4_sse42_ps, complex_multiply_sse42_ps },
+        { 1, radix2_sse42, radix4_sse42, complex_multiply_sse42 }, fft_scalar_kernel_set<long double>() };
+    return kernels;
+}
+
+// AVX2 + FMA: two complex doubles or four complex floats per register. Stages shorter than that
+// fall back to the narrower set.
+
+FFT_TARGET("avx2,fma") static inline __m256d cmul_avx2(__m256d a, __m256d b)
+{
+    __m256d br = _mm256_movedup_pd(b);
+    __m256d bi = _mm256_permute_pd(b, 0xf);
+    __m256d as = _mm256_permute_pd(a, 0x5);
+    return _mm256_fmaddsub_pd(a, br, _mm256_mul_pd(as, bi));
+}
+
+FFT_TARGET("avx2,fma") static void radix2_avx2(Complex* data, int n, int length, const Complex* twiddles)
+{
+    if (length % 2 != 0) {
+        fft_kernels_scalar().float64.radix2(data, n, length, twiddles);
+        return;
+    }
+    const double* tw = (const double*)twiddles;
+
+    for (int b = 0; b < n; b += 2 * length) {
+        double* x = (double*)(data + b);
+        for (int j = 0; j < length; j += 2) {
+            __m256d a = _mm256_loadu_pd(x + 2 * j);
+            __m256d t = cmul_avx2(_mm256_loadu_pd(x + 2 * (j + length)), _mm256_loadu_pd(tw + 2 * j));
+            _mm256_storeu_pd(x + 2 * j, _mm256_add_pd(a, t));
+            _mm256_storeu_pd(x + 2 * (j + length), _mm256_sub_pd(a, t));
+        }
+    }
+}
+
+FFT_TARGET("avx2,fma") static void radix4_avx2(Complex* data, int n, int length, const Complex* twiddles, double sign)
+{
+    if (length % 2 != 0) {
+        fft_kernels_scalar().float64.radix4(data, n, length, twiddles, sign);
+        return;
+    }
+    const double* tw = (const double*)twiddles;
+    const __m256d rot_sign = _mm256_setr_pd(-sign, sign, -sign, sign);
+
+    for (int b = 0; b < n; b += 4 * length) {
+        double* x = (double*)(data + b);
+        for (int j = 0; j < length; j += 2) {
+            __m256d c0 = _mm256_loadu_pd(x + 2 * j);
+            __m256d c1 = cmul_avx2(_mm256_loadu_pd(x + 2 * (j + length)), _mm256_loadu_pd(tw + 2 * j));
+            __m256d c2 = cmul_avx2(_mm256_loadu_pd(x + 2 * (j + 2 * length)), _mm256_loadu_pd(tw + 2 * (length + j)));
+            __m256d c3 = cmul_avx2(_mm256_loadu_pd(x + 2 * (j + 3 * length)), _mm256_loadu_pd(tw + 2 * (2 * length + j)));
+
+            __m256d s0 = _mm256_add_pd(c0, c2), d0 = _mm256_sub_pd(c0, c2);
+            __m256d s1 = _mm256_add_pd(c1, c3), d = _mm256_sub_pd(c1, c3);
+            __m256d d1 = _mm256_mul_pd(_mm256_permute_pd(d, 0x5), rot_sign);
+
+            _mm256_storeu_pd(x + 2 * j, _mm256_add_pd(s0, s1));
+            _mm256_storeu_pd(x + 2 * (j + length), _mm256_add_pd(d0, d1));
+            _mm256_storeu_pd(x + 2 * (j + 2 * length), _mm256_sub_pd(s0, s1));
+            _mm256_storeu_pd(x + 2 * (j + 3 * length), _mm256_sub_pd(d0, d1));
+        }
+    }
+}
+
+FFT_TARGET("avx2,fma") static void complex_multiply_avx2(Complex* out, const Complex* a, const Complex* b, int count)
+{
+    double* o = (double*)out;
+    const double* x = (const double*)a;
+    const double* y = (const double*)b;
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        _mm256_storeu_pd(o + 2 * i, cmul_avx2(_mm256_loadu_pd(x + 2 * i), _mm256_loadu_pd(y + 2 * i)));
+    for (; i < count; i++)
+        out[i] = a[i] * b[i];
+}
+
+FFT_TARGET("avx2,fma") static inline __m256 cmul_avx2_ps(__m256 a, __m256 b)
+{
+    __m256 br = _mm256_moveldup_ps(b);
+    __m256 bi = _mm256_movehdup_ps(b);
+    __m256 as = _mm256_permute_ps(a, 0xb1);
+    return _mm256_fmaddsub_ps(a, br, _mm256_mul_ps(as, bi));
+}
+
+FFT_TARGET("avx2,fma") static void radix2_avx2_ps(ComplexF* data, int n, int length, const ComplexF* twiddles)
+{
+    if (length % 4 != 0) {
+        radix2_sse42_ps(data, n, length, twiddles);
+        return;
+    }
+    const float* tw = (const float*)twiddles;
+
+    for (int b = 0; b < n; b += 2 * length) {
+        float* x = (float*)(data + b);
+        for (int j = 0; j < length; j += 4) {
+            __m256 a = _mm256_loadu_ps(x + 2 * j);
+            __m256 t = cmul_avx2_ps(_mm256_loadu_ps(x + 2 * (j + length)), _mm256_loadu_ps(tw + 2 * j));
+            _mm256_storeu_ps(x + 2 * j, _mm256_add_ps(a, t));
+            _mm256_storeu_ps(x + 2 * (j + length), _mm256_sub_ps(a, t));
+        }
+    }
+}
+
+FFT_TARGET("avx2,fma") static void radix4_avx2_ps(ComplexF* data, int n, int length, const ComplexF* twiddles,
+    double sign)
+{
+    if (length % 4 != 0) {
+        radix4_sse42_ps(data, n, length, twiddles, sign);
+        return;
+    }
+    const float* tw = (const float*)twiddles;
+    const float s = (float)sign;
+    const __m256 rot_sign = _mm256_setr_ps(-s, s, -s, s, -s, s, -s, s);
+
+    for (int b = 0; b < n; b += 4 * length) {
+        float* x = (float*)(data + b);
+        for (int j = 0; j < length; j += 4) {
+            __m256 c0 = _mm256_loadu_ps(x + 2 * j);
+            __m256 c1 = cmul_avx2_ps(_mm256_loadu_ps(x + 2 * (j + length)), _mm256_loadu_ps(tw + 2 * j));
+            __m256 c2 = cmul_avx2_ps(_mm256_loadu_ps(x + 2 * (j + 2 * length)), _mm256_loadu_ps(tw + 2 * (length + j)));
+            __m256 c3 = cmul_avx2_ps(_mm256_loadu_ps(x + 2 * (j + 3 * length)), _mm256_loadu_ps(tw + 2 * (2 * length + j)));
+
+            __m256 s0 = _mm256_add_ps(c0, c2), d0 = _mm256_sub_ps(c0, c2);
+            __m256 s1 = _mm256_add_ps(c1, c3), d = _mm256_sub_ps(c1, c3);
+            __m256 d1 = _mm256_mul_ps(_mm256_permute_ps(d, 0xb1), rot_sign);
+
+            _mm256_storeu_ps(x + 2 * j, _mm256_add_ps(s0, s1));
+            _mm256_storeu_ps(x + 2 * (j + length), _mm256_add_ps(d0, d1));
+            _mm256_storeu_ps(x + 2 * (j + 2 * length), _mm256_sub_ps(s0, s1));
+            _mm256_storeu_ps(x + 2 * (j + 3 * length), _mm256_sub_ps(d0, d1));
+        }
+    }
+}
+
+FFT_TARGET("avx2,fma") static void complex_multiply_avx2_ps(ComplexF* out, const ComplexF* a, const ComplexF* b,
+    int count)
+{
+    float* o = (float*)out;
+    const float* x = (const float*)a;
+    const float* y = (const float*)b;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_ps(o + 2 * i, cmul_avx2_ps(_mm256_loadu_ps(x + 2 * i), _mm256_loadu_ps(y + 2 * i)));
+    complex_multiply_sse42_ps(out + i, a + i, b + i, count - i);
+}
+
+const FFTKernels& fft_kernels_avx2()
+{
+    static const FFTKernels kernels = { "avx2", { 4, radix2_avx2_ps, radix4_avx2_ps, complex_multiply_avx2_ps },
+        { 2, radix2_avx2, radix4_avx2, complex_multiply_avx2 }, fft_scalar_kernel_set<long double>() };
+    return kernels;
+}
+
+// AVX-512: four complex doubles or eight complex floats per register. Shorter stages use the
+// AVX2 kernels.
+
+FFT_TARGET("avx512f,avx512dq") static inline __m512d cmul_avx512(__m512d a, __m512d b)
+{
+    __m512d br = _mm512_movedup_pd(b);
+    __m512d bi = _mm512_permute_pd(b, 0xff);
+    __m512d as = _mm512_permute_pd(a, 0x55);
+    return _mm512_fmaddsub_pd(a, br, _mm512_mul_pd(as, bi));
+}
+
+FFT_TARGET("avx512f,avx512dq") static void radix2_avx512(Complex* data, int n, int length, const Complex* twiddles)
+{
+    if (length % 4 != 0) {
+        radix2_avx2(data, n, length, twiddles);
+        return;
+    }
+    const double* tw = (const double*)twiddles;
+
+    for (int b = 0; b < n; b += 2 * length) {
+        double* x = (double*)(data + b);
+        for (int j = 0; j < length; j += 4) {
+            __m512d a = _mm512_loadu_pd(x + 2 * j);
+            __m512d t = cmul_avx512(_mm512_loadu_pd(x + 2 * (j + length)), _mm512_loadu_pd(tw + 2 * j));
+            _mm512_storeu_pd(x + 2 * j, _mm512_add_pd(a, t));
+            _mm512_storeu_pd(x + 2 * (j + length), _mm512_sub_pd(a, t));
+        }
+    }
+}
+
+FFT_TARGET("avx512f,avx512dq") static void radix4_avx512(Complex* data, int n, int length, const Complex* twiddles, double sign)
+{
+    if (length % 4 != 0) {
+        radix4_avx2(data, n, length, twiddles, sign);
+        return;
+    }
+    const double* tw = (const double*)twiddles;
+    const __m512d rot_sign = _mm512_setr_pd(-sign, sign, -sign, sign, -sign, sign, -sign, sign);
+
+    for (int b = 0; b < n; b += 4 * length) {
+        double* x = (double*)(data + b);
+        for (int j = 0; j < length; j += 4) {
+            __m512d c0 = _mm512_loadu_pd(x + 2 * j);
+            __m512d c1 = cmul_avx512(_mm512_loadu_pd(x + 2 * (j + length)), _mm512_loadu_pd(tw + 2 * j));
+            __m512d c2 = cmul_avx512(_mm512_loadu_pd(x + 2 * (j + 2 * length)), _mm512_loadu_pd(tw + 2 * (length + j)));
+            __m512d c3 = cmul_avx512(_mm512_loadu_pd(x + 2 * (j + 3 * length)), _mm512_loadu_pd(tw + 2 * (2 * length + j)));
+
+            __m512d s0 = _mm512_add_pd(c0, c2), d0 = _mm512_sub_pd(c0, c2);
+            __m512d s1 = _mm512_add_pd(c1, c3), d = _mm512_sub_pd(c1, c3);
+            __m512d d1 = _mm512_mul_pd(_mm512_permute_pd(d, 0x55), rot_sign);
+
+            _mm512_storeu_pd(x + 2 * j, _mm512_add_pd(s0, s1));
+            _mm512_storeu_pd(x + 2 * (j + length), _mm512_add_pd(d0, d1));
+            _mm512_storeu_pd(x + 2 * (j + 2 * length), _mm512_sub_pd(s0, s1));
+            _mm512_storeu_pd(x + 2 * (j + 3 * length), _mm512_sub_pd(d0, d1));
+        }
+    }
+}
+
+FFT_TARGET("avx512f,avx512dq") static void complex_multiply_avx512(Complex* out, const Complex* a, const Complex* b, int count)
+{
+    double* o = (double*)out;
+    const double* x = (const double*)a;
+    const double* y = (const double*)b;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm512_storeu_pd(o + 2 * i, cmul_avx512(_mm512_loadu_pd(x + 2 * i), _mm512_loadu_pd(y + 2 * i)));
+    complex_multiply_avx2(out + i, a + i, b + i, count - i);
+}
+
+FFT_TARGET("avx512f,avx512dq") static inline __m512 cmul_avx512_ps(__m512 a, __m512 b)
+{
+    __m512 br = _mm512_moveldup_ps(b);
+    __m512 bi = _mm512_movehdup_ps(b);
+    __m512 as = _mm512_permute_ps(a, 0xb1);
+    return _mm512_fmaddsub_ps(a, br, _mm512_mul_ps(as, bi));
+}
+
+FFT_TARGET("avx512f,avx512dq") static void radix2_avx512_ps(ComplexF* data, int n, int length, const ComplexF* twiddles)
+{
+    if (length % 8 != 0) {
+        radix2_avx2_ps(data, n, length, twiddles);
+        return;
+    }
+    const float* tw = (const float*)twiddles;
+
+    for (int b = 0; b < n; b += 2 * length) {
+        float* x = (float*)(data + b);
+        for (int j = 0; j < length; j += 8) {
+            __m512 a = _mm512_loadu_ps(x + 2 * j);
+            __m512 t = cmul_avx512_ps(_mm512_loadu_ps(x + 2 * (j + length)), _mm512_loadu_ps(tw + 2 * j));
+            _mm512_storeu_ps(x + 2 * j, _mm512_add_ps(a, t));
+            _mm512_storeu_ps(x + 2 * (j + length), _mm512_sub_ps(a, t));
+        }
+    }
+}
+
+FFT_TARGET("avx512f,avx512dq") static void radix4_avx512_ps(ComplexF* data, int n, int length, const ComplexF* twiddles,
+    double sign)
+{
+    if (length % 8 != 0) {
+        radix4_avx2_ps(data, n, length, twiddles, sign);
+        return;
+    }
+    const float* tw = (const float*)twiddles;
+    const float s = (float)sign;
+    const __m512 rot_sign = _mm512_setr_ps(-s, s, -s, s, -s, s, -s, s, -s, s, -s, s, -s, s, -s, s);
+
+    for (int b = 0; b < n; b += 4 * length) {
+        float* x = (float*)(data + b);
+        for (int j = 0; j < length; j += 8) {
+            __m512 c0 = _mm512_loadu_ps(x + 2 * j);
+            __m512 c1 = cmul_avx512_ps(_mm512_loadu_ps(x + 2 * (j + length)), _mm512_loadu_ps(tw + 2 * j));
+            __m512 c2 = cmul_avx512_ps(_mm512_loadu_ps(x + 2 * (j + 2 * length)), _mm512_loadu_ps(tw + 2 * (length + j)));
+            __m512 c3 = cmul_avx512_ps(_mm512_loadu_ps(x + 2 * (j + 3 * length)), _mm512_loadu_ps(tw + 2 * (2 * length + j)));
+
+            __m512 s0 = _mm512_add_ps(c0, c2), d0 = _mm512_sub_ps(c0, c2);
+            __m512 s1 = _mm512_add_ps(c1, c3), d = _mm512_sub_ps(c1, c3);
+            __m512 d1 = _mm512_mul_ps(_mm512_permute_ps(d, 0xb1), rot_sign);
+
+            _mm512_storeu_ps(x + 2 * j, _mm512_add_ps(s0, s1));
+            _mm512_storeu_ps(x + 2 * (j + length), _mm512_add_ps(d0, d1));
+            _mm512_storeu_ps(x + 2 * (j + 2 * length), _mm512_sub_ps(s0, s1));
+            _mm512_storeu_ps(x + 2 * (j + 3 * length), _mm512_sub_ps(d0, d1));
+        }
+    }
+}
+
+FFT_TARGET("avx512f,avx512dq") static void complex_multiply_avx512_ps(ComplexF* out, const ComplexF* a,
+    const ComplexF* b, int count)
+{
+    float* o = (float*)out;
+    const float* x = (const float*)a;
+    const float* y = (const float*)b;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm512_storeu_ps(o + 2 * i, cmul_avx512_ps(_mm512_loadu_ps(x + 2 * i), _mm512_loadu_ps(y + 2 * i)));
+    complex_multiply_avx2_ps(out + i, a + i, b + i, count - i);
+}
+
+const FFTKernels& fft_kernels_avx512()
+{
+    static const FFTKernels kernels = { "avx512",
+        { 8, radix2_avx512_ps, radix4_avx512_ps, complex_multiply_avx512_ps },
+        { 4, radix2_avx512, radix4_avx512, complex_multiply_avx512 }, fft_scalar_kernel_set<long double>() };
+    return kernels;
+}
+
+#endif
@@ -0,0 +1,27 @@
+#include "image_io.h"
+
+#include <string.h>
+#include <stdexcept>
+
+#include "jpeg_decode.h"
+#include "mapped_file.h"
+#include "png_codec.h"
+
+Buffer2D<float> read_image(const std::string& path, int scale)
+{
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+        throw std::runtime_error("Image scale must be 1, 2, 4 or 8!");
+
+    MappedFile file(path, MappedFile::Access::Read);
+    if (file.size() < 8)
+        throw std::runtime_error("Unsupported image format!");
+    MappedRegion region = file.map(0, (size_t)file.size());
+    const unsigned char* data = (const unsigned char*)region.data();
+
+    static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (data[0] == 0xFF && data[1] == 0xD8)
+        return decode_jpeg(data, region.size(), scale);
+    if (memcmp(data, PNG_SIGNATURE, 8) == 0)
+        return decode_png(data, region.size(), scale);
+    throw std::runtime_error("Unsupported image format!");
+}
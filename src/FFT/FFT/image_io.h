@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+#include "buffer2d.h"
+
+// Grey levels (0 - 255) of a JPEG or PNG file, told apart by their signatures, at 1 / scale of
+// the full resolution (scale 1, 2, 4 or 8, sizes rounded up). A JPEG is decoded from its luma
+// alone and shrunk in the DCT domain, so a reduced decode skips most of the entropy decoding and
+// inverse transform work; a PNG is decoded in full and box-averaged. EXIF orientation is not
+// applied.
+Buffer2D<float> read_image(const std::string& path, int scale = 1);
@@ -0,0 +1,913 @@
+#include "jpeg_decode.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Natural (row-major) position of the k-th coefficient in zigzag order; the tail catches the
+// out-of-range k of a corrupt run.
+static const int ZIGZAG[64 + 16] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+    63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63
+};
+
+static const int FAST_BITS = 9;
+
+// Canonical Huffman table: codes of up to FAST_BITS bits resolve with one lookup.
+struct HuffmanTable {
+    unsigned char fast[1 << FAST_BITS];
+    // AC tables: a short code and its value bits that fit FAST_BITS together, as
+    // value << 8 | run << 4 | bits used; 0 where they don't.
+    short fastAC[1 << FAST_BITS];
+    unsigned short codes[256];
+    unsigned char sizes[257];
+    unsigned char values[256];
+    uint32_t maxCode[18];
+    int delta[17];
+    bool defined = false;
+};
+
+static void build_huffman(HuffmanTable& table, const unsigned char* counts, const unsigned char* values)
+{
+    int k = 0;
+    for (int length = 1; length <= 16; length++)
+        for (int i = 0; i < counts[length - 1]; i++)
+            table.sizes[k++] = (unsigned char)length;
+    table.sizes[k] = 0;
+
+    int code = 0;
+    k = 0;
+    for (int length = 1; length <= 16; length++) {
+        table.delta[length] = k - code;
+        while (table.sizes[k] == length)
+            table.codes[k++] = (unsigned short)code++;
+        if (code - 1 >= (1 << length) && table.delta[length] != k - code)
+            throw std::runtime_error("Corrupt JPEG Huffman table!");
+        table.maxCode[length] = (uint32_t)code << (16 - length);
+        code <<= 1;
+    }
+    table.maxCode[17] = 0xffffffff;
+
+    memset(table.fast, 255, sizeof(table.fast));
+    for (int i = 0; i < k; i++) {
+        int size = table.sizes[i];
+        if (size <= FAST_BITS) {
+            int first = table.codes[i] << (FAST_BITS - size);
+            for (int j = 0; j < (1 << (FAST_BITS - size)); j++)
+                table.fast[first + j] = (unsigned char)i;
+        }
+    }
+    memcpy(table.values, values, k);
+
+    for (int i = 0; i < (1 << FAST_BITS); i++) {
+        table.fastAC[i] = 0;
+        int index = table.fast[i];
+        if (index == 255)
+            continue;
+        int run = table.values[index] >> 4, magnitude = table.values[index] & 15, length = table.sizes[index];
+        if (magnitude == 0 || length + magnitude > FAST_BITS)
+            continue;
+        int value = (i << length) & ((1 << FAST_BITS) - 1);
+        value >>= FAST_BITS - magnitude;
+        if (value < (1 << (magnitude - 1)))
+            value += 1 - (1 << magnitude);
+        if (value >= -128 && value <= 127)
+            table.fastAC[i] = (short)(value * 256 + (run << 4) + length + magnitude);
+    }
+    table.defined = true;
+}
+
+// Entropy-coded segment reader: bits come MSB first out of a 32-bit window, stuffed zero bytes
+// are dropped, and from the first marker on the stream reads as zeros.
+class BitReader
+{
+public:
+    BitReader(const unsigned char* begin, const unsigned char* end)
+        : position(begin), end(end)
+    {
+    }
+
+    int bit()
+    {
+        return bits(1);
+    }
+
+    int bits(int count)
+    {
+        if (count == 0)
+            return 0;
+        if (available < count)
+            fill();
+        int value = (int)(window >> (32 - count));
+        window <<= count;
+        available -= count;
+        return value;
+    }
+
+    // JPEG's EXTEND: count bits read as a signed magnitude category.
+    int extend(int count)
+    {
+        if (count == 0)
+            return 0;
+        int value = bits(count);
+        return value < (1 << (count - 1)) ? value - (1 << count) + 1 : value;
+    }
+
+    // The value of a run/size symbol resolved with fastAC, or 0 (the caller decodes it then);
+    // skips the symbol's run into run.
+    int fastAC(const HuffmanTable& table, int& run)
+    {
+        if (available < 16)
+            fill();
+        int entry = table.fastAC[window >> (32 - FAST_BITS)];
+        if (entry == 0)
+            return 0;
+        run = (entry >> 4) & 15;
+        window <<= entry & 15;
+        available -= entry & 15;
+        return entry >> 8;
+    }
+
+    int decode(const HuffmanTable& table)
+    {
+        if (available < 16)
+            fill();
+        int index = table.fast[window >> (32 - FAST_BITS)];
+        if (index < 255) {
+            int size = table.sizes[index];
+            window <<= size;
+            available -= size;
+            return table.values[index];
+        }
+
+        uint32_t top = window >> 16;
+        int length = FAST_BITS + 1;
+        while (top >= table.maxCode[length])
+            length++;
+        if (length > 16)
+            throw std::runtime_error("Corrupt JPEG data!");
+        int code = (int)(window >> (32 - length)) + table.delta[length];
+        window <<= length;
+        available -= length;
+        if (code < 0 || code > 255)
+            throw std::runtime_error("Corrupt JPEG data!");
+        return table.values[code];
+    }
+
+private:
+    void fill()
+    {
+        while (available <= 24) {
+            unsigned int byte = 0;
+            if (!markerHit && position < end) {
+                byte = *position++;
+                if (byte == 0xFF) {
+                    while (position < end && *position == 0xFF)
+                        position++;
+                    if (position < end && *position == 0x00) {
+                        position++;
+                    } else {
+                        markerHit = true;
+                        byte = 0;
+                    }
+                }
+            }
+            window |= byte << (24 - available);
+            available += 8;
+        }
+    }
+
+private:
+    const unsigned char* position;
+    const unsigned char* end;
+    uint32_t window = 0;
+    int available = 0;
+    bool markerHit = false;
+};
+
+struct Component {
+    int id;
+    int h, v;
+    int quantization;
+    int dcTable = 0, acTable = 0;
+};
+
+// What each scan needs to know to decode one interval.
+struct Scan {
+    int components[4];
+    int count;
+    int start, end;     // spectral selection
+    int high, low;      // successive approximation
+    int mcus;           // MCUs in the scan
+};
+
+class JpegDecoder
+{
+public:
+    JpegDecoder(const unsigned char* data, size_t size, int scale)
+        : data(data), size(size), n(8 / scale)
+    {
+        if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+            throw std::runtime_error("JPEG scale must be 1, 2, 4 or 8!");
+    }
+
+    Buffer2D<float> decode();
+
+private:
+    int byteAt(size_t offset) const
+    {
+        if (offset >= size)
+            throw std::runtime_error("Truncated JPEG!");
+        return data[offset];
+    }
+    int word(size_t offset) const { return (byteAt(offset) << 8) | byteAt(offset + 1); }
+
+    void readQuantization(size_t offset, size_t length);
+    void readHuffman(size_t offset, size_t length);
+    void readFrame(size_t offset, size_t length, bool progressive_frame);
+    size_t readScan(size_t offset, size_t length);
+    size_t entropyEnd(size_t offset, std::vector<size_t>* restarts) const;
+    void planScans(size_t offset);
+    bool scanNeeded(const Scan& scan) const;
+    void decodeInterval(const Scan& scan, const unsigned char* begin, const unsigned char* end, int first_mcu,
+        int mcu_count);
+    void decodeBlock(const Scan& scan, BitReader& reader, int component, short* block, int* predictors,
+        int& eob_run) const;
+    Buffer2D<float> inverseTransform();
+
+private:
+    const unsigned char* data;
+    size_t size;
+    int n;
+
+    unsigned short quantization[4][64];
+    HuffmanTable dcTables[4];
+    HuffmanTable acTables[4];
+    std::vector<Component> components;
+    int width = 0, height = 0;
+    int hMax = 1, vMax = 1;
+    int mcusX = 0, mcusY = 0;
+    bool progressive = false;
+    bool frameRead = false;
+    int restartInterval = 0;
+    int adobeTransform = -1;
+
+    // Coefficients of component 0 only, blocksX x blocksY blocks of coefficientStride shorts:
+    // all 64 for progressive files (refinement scans need every coefficient's history), the
+    // n x n the scaled inverse DCT reads otherwise. slot[k] is where zigzag k goes, -1 if nowhere.
+    std::vector<short> coefficients;
+    int blocksX = 0, blocksY = 0;
+    int coefficientStride = 64;
+    int coefficientRow = 8;
+    int slot[64];
+    // Zigzag indices of component 0 that have to be decoded: the n x n corner, plus the bands of
+    // refinement scans that touch it, which need the history of every coefficient they refine.
+    bool needed[64];
+    bool planned = false;
+};
+
+void JpegDecoder::readQuantization(size_t offset, size_t length)
+{
+    size_t end = offset + length;
+    while (offset < end) {
+        int precision = byteAt(offset) >> 4, index = byteAt(offset) & 15;
+        if (index > 3)
+            throw std::runtime_error("Corrupt JPEG quantization table!");
+        offset++;
+        for (int k = 0; k < 64; k++) {
+            quantization[index][ZIGZAG[k]] = (unsigned short)(precision ? word(offset) : byteAt(offset));
+            offset += precision ? 2 : 1;
+        }
+    }
+}
+
+void JpegDecoder::readHuffman(size_t offset, size_t length)
+{
+    size_t end = offset + length;
+    while (offset < end) {
+        int table_class = byteAt(offset) >> 4, index = byteAt(offset) & 15;
+        if (table_class > 1 || index > 3)
+            throw std::runtime_error("Corrupt JPEG Huffman table!");
+        unsigned char counts[16];
+        int total = 0;
+        for (int i = 0; i < 16; i++) {
+            counts[i] = (unsigned char)byteAt(offset + 1 + i);
+            total += counts[i];
+        }
+        if (total > 256 || offset + 17 + total > size)
+            throw std::runtime_error("Corrupt JPEG Huffman table!");
+        build_huffman(table_class ? acTables[index] : dcTables[index], counts, data + offset + 17);
+        offset += 17 + total;
+    }
+}
+
+void JpegDecoder::readFrame(size_t offset, size_t length, bool progressive_frame)
+{
+    if (frameRead)
+        throw std::runtime_error("JPEG with more than one frame!");
+    if (byteAt(offset) != 8)
+        throw std::runtime_error("Only 8-bit JPEGs are supported!");
+    height = word(offset + 1);
+    width = word(offset + 3);
+    int count = byteAt(offset + 5);
+    if (width == 0 || height == 0)
+        throw std::runtime_error("JPEG without a height (DNL) is not supported!");
+    if ((count != 1 && count != 3) || length < 6 + 3 * (size_t)count)
+        throw std::runtime_error("Only grayscale and YCbCr JPEGs are supported!");
+
+    for (int i = 0; i < count; i++) {
+        Component component;
+        component.id = byteAt(offset + 6 + 3 * i);
+        component.h = byteAt(offset + 7 + 3 * i) >> 4;
+        component.v = byteAt(offset + 7 + 3 * i) & 15;
+        component.quantization = byteAt(offset + 8 + 3 * i) & 3;
+        if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4)
+            throw std::runtime_error("Corrupt JPEG frame!");
+        hMax = component.h > hMax ? component.h : hMax;
+        vMax = component.v > vMax ? component.v : vMax;
+        components.push_back(component);
+    }
+    if (components[0].h != hMax || components[0].v != vMax)
+        throw std::runtime_error("JPEGs with subsampled luma are not supported!");
+
+    progressive = progressive_frame;
+    frameRead = true;
+    mcusX = (width + 8 * hMax - 1) / (8 * hMax);
+    mcusY = (height + 8 * vMax - 1) / (8 * vMax);
+    blocksX = mcusX * hMax;
+    blocksY = mcusY * vMax;
+
+    coefficientStride = progressive ? 64 : n * n;
+    coefficientRow = progressive ? 8 : n;
+    for (int k = 0; k < 64; k++) {
+        int row = ZIGZAG[k] / 8, column = ZIGZAG[k] % 8;
+        slot[k] = progressive ? ZIGZAG[k] : row < n && column < n ? row * n + column : -1;
+    }
+    coefficients.assign((size_t)blocksX * blocksY * coefficientStride, 0);
+}
+
+// End of the entropy-coded data from offset (the next marker other than a restart), with the
+// offsets just past each restart marker on the way.
+size_t JpegDecoder::entropyEnd(size_t offset, std::vector<size_t>* restarts) const
+{
+    while (offset + 1 < size) {
+        const unsigned char* next = (const unsigned char*)memchr(data + offset, 0xFF, size - offset - 1);
+        if (next == nullptr)
+            return size;
+        offset = next - data;
+        int marker = data[offset + 1];
+        if (marker == 0x00 || marker == 0xFF) {
+            offset += marker == 0x00 ? 2 : 1;
+        } else if (marker >= 0xD0 && marker <= 0xD7) {
+            offset += 2;
+            if (restarts != nullptr)
+                restarts->push_back(offset);
+        } else {
+            return offset;
+        }
+    }
+    return size;
+}
+
+// Walks the scan headers from the first scan at offset to fill needed[].
+void JpegDecoder::planScans(size_t offset)
+{
+    struct Band {
+        int start, end;
+        bool refine;
+    };
+    std::vector<Band> bands;
+    while (offset + 4 <= size) {
+        if (data[offset] != 0xFF || data[offset + 1] == 0xFF) {
+            offset++;
+            continue;
+        }
+        int marker = data[offset + 1];
+        if (marker == 0xD9)
+            break;
+        size_t length = (size_t)word(offset + 2);
+        if (marker != 0xDA) {
+            offset += 2 + length;
+            continue;
+        }
+        size_t body = offset + 4;
+        int count = byteAt(body);
+        bool luma = false;
+        for (int i = 0; i < count; i++)
+            luma = luma || byteAt(body + 1 + 2 * i) == components[0].id;
+        size_t tail = body + 1 + 2 * count;
+        if (luma && byteAt(tail) > 0)
+            bands.push_back({ byteAt(tail), byteAt(tail + 1), (byteAt(tail + 2) >> 4) != 0 });
+        offset = entropyEnd(offset + 2 + length, nullptr);
+    }
+
+    for (int k = 0; k < 64; k++)
+        needed[k] = ZIGZAG[k] / 8 < n && ZIGZAG[k] % 8 < n;
+    for (bool grown = true; grown;) {
+        grown = false;
+        for (const Band& band : bands) {
+            if (!band.refine || band.end > 63)
+                continue;
+            bool touches = false;
+            for (int k = band.start; k <= band.end; k++)
+                touches = touches || needed[k];
+            for (int k = band.start; touches && k <= band.end; k++) {
+                grown = grown || !needed[k];
+                needed[k] = true;
+            }
+        }
+    }
+    planned = true;
+}
+
+// A scan matters when it carries component 0 and, for the AC bands of a scaled decode, at least
+// one coefficient in needed[]; DC scans also carry the other components' DC, which is decoded
+// and dropped.
+bool JpegDecoder::scanNeeded(const Scan& scan) const
+{
+    bool luma = false;
+    for (int i = 0; i < scan.count; i++)
+        luma = luma || scan.components[i] == 0;
+    if (!luma)
+        return false;
+    if (!progressive || scan.start == 0)
+        return true;
+    for (int k = scan.start; k <= scan.end; k++)
+        if (needed[k])
+            return true;
+    return false;
+}
+
+size_t JpegDecoder::readScan(size_t offset, size_t length)
+{
+    if (!frameRead)
+        throw std::runtime_error("JPEG scan before its frame!");
+    Scan scan;
+    scan.count = byteAt(offset);
+    if (scan.count < 1 || scan.count > (int)components.size() || length < 4 + 2 * (size_t)scan.count)
+        throw std::runtime_error("Corrupt JPEG scan!");
+    for (int i = 0; i < scan.count; i++) {
+        int id = byteAt(offset + 1 + 2 * i), tables = byteAt(offset + 2 + 2 * i);
+        int index = -1;
+        for (int c = 0; c < (int)components.size(); c++)
+            if (components[c].id == id)
+                index = c;
+        if (index < 0 || (tables >> 4) > 3 || (tables & 15) > 3)
+            throw std::runtime_error("Corrupt JPEG scan!");
+        components[index].dcTable = tables >> 4;
+        components[index].acTable = tables & 15;
+        scan.components[i] = index;
+    }
+    size_t tail = offset + 1 + 2 * scan.count;
+    scan.start = byteAt(tail);
+    scan.end = byteAt(tail + 1);
+    scan.high = byteAt(tail + 2) >> 4;
+    scan.low = byteAt(tail + 2) & 15;
+    if (progressive) {
+        if (scan.start > scan.end || scan.end > 63 || (scan.start == 0 && scan.end != 0)
+            || (scan.start > 0 && scan.count != 1) || scan.low > 13)
+            throw std::runtime_error("Corrupt progressive JPEG scan!");
+    } else {
+        scan.start = 0;
+        scan.end = 63;
+        scan.high = scan.low = 0;
+    }
+
+    if (scan.count > 1) {
+        scan.mcus = mcusX * mcusY;
+    } else {
+        const Component& component = components[scan.components[0]];
+        int columns = (width * component.h + hMax - 1) / hMax, rows = (height * component.v + vMax - 1) / vMax;
+        scan.mcus = ((columns + 7) / 8) * ((rows + 7) / 8);
+    }
+
+    for (int i = 0; i < scan.count; i++) {
+        const Component& component = components[scan.components[i]];
+        bool dc = scan.start == 0 && scan.high == 0;
+        bool ac = scan.end > 0;
+        if ((dc && !dcTables[component.dcTable].defined) || (ac && !acTables[component.acTable].defined))
+            throw std::runtime_error("JPEG scan uses an undefined Huffman table!");
+    }
+
+    if (progressive && !planned)
+        planScans(offset - 4);
+
+    size_t begin = offset + length;
+    std::vector<size_t> restarts;
+    size_t end = entropyEnd(begin, restartInterval > 0 ? &restarts : nullptr);
+    if (!scanNeeded(scan))
+        return end;
+
+    // Restart intervals are independent (predictors and end-of-band runs reset), so they
+    // decode in parallel, each into its own MCUs.
+    if (restarts.empty()) {
+        decodeInterval(scan, data + begin, data + end, 0, scan.mcus);
+        return end;
+    }
+    restarts.insert(restarts.begin(), begin);
+    int intervals = (int)restarts.size();
+    ThreadPool::global().parallelFor(0, intervals, 1, [&](int first, int last, int) {
+        for (int i = first; i < last; i++) {
+            int first_mcu = i * restartInterval;
+            if (first_mcu >= scan.mcus)
+                continue;
+            int count = scan.mcus - first_mcu < restartInterval ? scan.mcus - first_mcu : restartInterval;
+            size_t stop = i + 1 < intervals ? restarts[i + 1] - 2 : end;
+            decodeInterval(scan, data + restarts[i], data + stop, first_mcu, count);
+        }
+    });
+    return end;
+}
+
+void JpegDecoder::decodeInterval(const Scan& scan, const unsigned char* begin, const unsigned char* end,
+    int first_mcu, int mcu_count)
+{
+    BitReader reader(begin, end);
+    int predictors[4] = { 0, 0, 0, 0 };
+    int eob_run = 0;
+    short discard[64];
+
+    for (int mcu = first_mcu; mcu < first_mcu + mcu_count; mcu++) {
+        if (scan.count == 1) {
+            int component = scan.components[0];
+            const Component& info = components[component];
+            int columns = (width * info.h + hMax - 1) / hMax;
+            int per_row = (columns + 7) / 8;
+            int bx = mcu % per_row, by = mcu / per_row;
+            short* block = discard;
+            if (component == 0)
+                block = &coefficients[((size_t)by * blocksX + bx) * coefficientStride];
+            else
+                memset(discard, 0, sizeof(discard));
+            decodeBlock(scan, reader, component, block, predictors, eob_run);
+            continue;
+        }
+
+        int mx = mcu % mcusX, my = mcu / mcusX;
+        for (int i = 0; i < scan.count; i++) {
+            int component = scan.components[i];
+            const Component& info = components[component];
+            for (int y = 0; y < info.v; y++) {
+                for (int x = 0; x < info.h; x++) {
+                    short* block = discard;
+                    if (component == 0) {
+                        int bx = mx * info.h + x, by = my * info.v + y;
+                        block = &coefficients[((size_t)by * blocksX + bx) * coefficientStride];
+                    } else {
+                        memset(discard, 0, sizeof(discard));
+                    }
+                    decodeBlock(scan, reader, component, block, predictors, eob_run);
+                }
+            }
+        }
+    }
+}
+
+void JpegDecoder::decodeBlock(const Scan& scan, BitReader& reader, int component, short* block, int* predictors,
+    int& eob_run) const
+{
+    const Component& info = components[component];
+    const int* positions = component == 0 ? slot : ZIGZAG;
+
+    if (!progressive) {
+        int category = reader.decode(dcTables[info.dcTable]);
+        predictors[component] += reader.extend(category);
+        if (positions[0] >= 0)
+            block[positions[0]] = (short)predictors[component];
+        const HuffmanTable& ac = acTables[info.acTable];
+        for (int k = 1; k < 64; k++) {
+            int run;
+            int value = reader.fastAC(ac, run);
+            if (value == 0) {
+                int symbol = reader.decode(ac);
+                run = symbol >> 4;
+                int size = symbol & 15;
+                if (size == 0) {
+                    if (run != 15)
+                        break;
+                    k += 15;
+                    continue;
+                }
+                value = reader.extend(size);
+            }
+            k += run;
+            if (k > 63)
+                throw std::runtime_error("Corrupt JPEG data!");
+            if (positions[k] >= 0)
+                block[positions[k]] = (short)value;
+        }
+        return;
+    }
+
+    if (scan.start == 0) {
+        if (scan.high == 0) {
+            int category = reader.decode(dcTables[info.dcTable]);
+            predictors[component] += reader.extend(category);
+            block[0] = (short)(predictors[component] * (1 << scan.low));
+        } else if (reader.bit()) {
+            block[0] = (short)(block[0] | (1 << scan.low));
+        }
+        return;
+    }
+
+    const HuffmanTable& ac = acTables[info.acTable];
+    if (scan.high == 0) {
+        if (eob_run > 0) {
+            eob_run--;
+            return;
+        }
+        for (int k = scan.start; k <= scan.end;) {
+            int symbol = reader.decode(ac);
+            int run = symbol >> 4, size = symbol & 15;
+            if (size == 0) {
+                if (run < 15) {
+                    eob_run = (1 << run) - 1 + reader.bits(run);
+                    break;
+                }
+                k += 16;
+                continue;
+            }
+            k += run;
+            if (k > 63)
+                throw std::runtime_error("Corrupt JPEG data!");
+            block[ZIGZAG[k]] = (short)(reader.extend(size) * (1 << scan.low));
+            k++;
+        }
+        return;
+    }
+
+    // Refinement: one more bit for every coefficient already nonzero, new coefficients of +-1
+    // placed after the given number of zero ones (libjpeg's decode_mcu_AC_refine).
+    int plus = 1 << scan.low, minus = -1 * (1 << scan.low);
+    auto refine = [&](short& coefficient) {
+        if (reader.bit() && (coefficient & plus) == 0)
+            coefficient = (short)(coefficient + (coefficient >= 0 ? plus : minus));
+    };
+    int k = scan.start;
+    if (eob_run == 0) {
+        for (; k <= scan.end; k++) {
+            int symbol = reader.decode(ac);
+            int run = symbol >> 4, size = symbol & 15;
+            int value = 0;
+            if (size != 0) {
+                value = reader.bit() ? plus : minus;
+            } else if (run != 15) {
+                eob_run = (1 << run) + reader.bits(run);
+                break;
+            }
+            while (k <= scan.end) {
+                short& coefficient = block[ZIGZAG[k]];
+                if (coefficient != 0) {
+                    refine(coefficient);
+                } else {
+                    if (run == 0)
+                        break;
+                    run--;
+                }
+                k++;
+            }
+            if (value != 0 && k <= scan.end)
+                block[ZIGZAG[k]] = (short)value;
+        }
+    }
+    if (eob_run > 0) {
+        for (; k <= scan.end; k++) {
+            short& coefficient = block[ZIGZAG[k]];
+            if (coefficient != 0)
+                refine(coefficient);
+        }
+        eob_run--;
+    }
+}
+
+Buffer2D<float> JpegDecoder::decode()
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        throw std::runtime_error("Not a JPEG file!");
+
+    size_t offset = 2;
+    bool scanned = false;
+    while (offset + 4 <= size) {
+        if (data[offset] != 0xFF) {
+            offset++;
+            continue;
+        }
+        int marker = data[offset + 1];
+        if (marker == 0xFF || marker == 0x00 || (marker >= 0xD0 && marker <= 0xD7)) {
+            offset++;
+            continue;
+        }
+        if (marker == 0xD9)
+            break;
+        size_t length = (size_t)word(offset + 2);
+        if (length < 2 || offset + 2 + length > size)
+            throw std::runtime_error("Truncated JPEG!");
+        size_t body = offset + 4, body_length = length - 2;
+
+        switch (marker) {
+        case 0xDB:
+            readQuantization(body, body_length);
+            break;
+        case 0xC4:
+            readHuffman(body, body_length);
+            break;
+        case 0xC0:
+        case 0xC1:
+        case 0xC2:
+            readFrame(body, body_length, marker == 0xC2);
+            break;
+        case 0xDD:
+            restartInterval = word(body);
+            break;
+        case 0xEE:
+            if (body_length >= 12 && memcmp(data + body, "Adobe", 5) == 0)
+                adobeTransform = data[body + 11];
+            break;
+        case 0xDA:
+            if (components.size() == 3 && adobeTransform == 0)
+                throw std::runtime_error("RGB JPEGs are not supported!");
+            offset = readScan(body, body_length);
+            scanned = true;
+            continue;
+        default:
+            if ((marker >= 0xC3 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+                throw std::runtime_error("Only baseline and progressive Huffman JPEGs are supported!");
+            break;
+        }
+        offset += 2 + length;
+    }
+    if (!scanned)
+        throw std::runtime_error("JPEG without image data!");
+    return inverseTransform();
+}
+
+Buffer2D<float> JpegDecoder::inverseTransform()
+{
+    int scale = 8 / n;
+    int out_width = (width + scale - 1) / scale, out_height = (height + scale - 1) / scale;
+    Buffer2D<float> out(out_width, out_height);
+    float table[128];
+    jpeg_idct_table(quantization[components[0].quantization], n, table);
+
+    // Block rows of component 0 that reach into the image, each n output rows.
+    int rows = (out_height + n - 1) / n, columns = (out_width + n - 1) / n;
+    ThreadPool::global().parallelFor(0, rows, 4, [&](int begin, int end, int) {
+        float pixels[64];
+        for (int by = begin; by < end; by++) {
+            int y0 = by * n, row_count = out_height - y0 < n ? out_height - y0 : n;
+            for (int bx = 0; bx < columns; bx++) {
+                const short* block = &coefficients[((size_t)by * blocksX + bx) * coefficientStride];
+                int x0 = bx * n, column_count = out_width - x0 < n ? out_width - x0 : n;
+                if (row_count == n && column_count == n) {
+                    jpeg_idct(block, coefficientRow, table, n, out.row(y0) + x0, out.stride());
+                    continue;
+                }
+                jpeg_idct(block, coefficientRow, table, n, pixels, n);
+                for (int y = 0; y < row_count; y++)
+                    memcpy(out.row(y0 + y) + x0, pixels + y * n, column_count * sizeof(float));
+            }
+        }
+    });
+    return out;
+}
+
+Buffer2D<float> decode_jpeg(const unsigned char* data, size_t size, int scale)
+{
+    return JpegDecoder(data, size, scale).decode();
+}
+
+static const double PI = 3.14159265358979323846;
+
+// n = 8: the AAN factorization (libjpeg's jidctflt), whose per-coefficient scale factors and the
+// final division by 8 are folded into the dequantization. Smaller n: the n-point transform of
+// the top-left n x n coefficients, g(x, y) = sum c(u) c(v) / 4 F(u, v) cos((2x + 1) u pi / 2n)
+// cos((2y + 1) v pi / 2n), which is the box-filtered image at 1 / (8 / n) scale; the basis goes
+// in table[64 ..].
+void jpeg_idct_table(const unsigned short* quantization, int n, float* table)
+{
+    if (n == 8) {
+        double factors[8] = { 1.0 };
+        for (int k = 1; k < 8; k++)
+            factors[k] = cos(k * PI / 16) * sqrt(2.0);
+        for (int row = 0; row < 8; row++)
+            for (int column = 0; column < 8; column++)
+                table[row * 8 + column] = (float)(quantization[row * 8 + column] * factors[row] * factors[column] / 8);
+        return;
+    }
+    for (int i = 0; i < 64; i++)
+        table[i] = quantization[i];
+    for (int x = 0; x < n; x++)
+        for (int u = 0; u < n; u++)
+            table[64 + x * n + u] = (float)(0.5 * (u == 0 ? sqrt(0.5) : 1.0) * cos((2 * x + 1) * u * PI / (2 * n)));
+}
+
+static inline float clamp_pixel(float value)
+{
+    value += 128.0f;
+    return value < 0.0f ? 0.0f : value > 255.0f ? 255.0f : value;
+}
+
+void jpeg_idct(const short* coefficients, int stride, const float* table, int n, float* out, size_t out_stride)
+{
+    if (n == 1) {
+        out[0] = clamp_pixel(coefficients[0] * table[0] * 0.125f);
+        return;
+    }
+
+    if (n < 8) {
+        const float* basis = table + 64;
+        float rows[4][4];
+        for (int v = 0; v < n; v++) {
+            for (int x = 0; x < n; x++) {
+                float sum = 0.0f;
+                for (int u = 0; u < n; u++)
+                    sum += basis[x * n + u] * coefficients[v * stride + u] * table[v * 8 + u];
+                rows[v][x] = sum;
+            }
+        }
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                float sum = 0.0f;
+                for (int v = 0; v < n; v++)
+                    sum += basis[y * n + v] * rows[v][x];
+                out[y * out_stride + x] = clamp_pixel(sum);
+            }
+        }
+        return;
+    }
+
+    // Columns into the workspace, then rows into the output.
+    float workspace[64];
+    for (int column = 0; column < 8; column++) {
+        const short* in = coefficients + column;
+        const float* q = table + column;
+        float* ws = workspace + column;
+        if (in[8] == 0 && in[16] == 0 && in[24] == 0 && in[32] == 0 && in[40] == 0 && in[48] == 0 && in[56] == 0) {
+            float dc = in[0] * q[0];
+            for (int row = 0; row < 8; row++)
+                ws[row * 8] = dc;
+            continue;
+        }
+
+        float tmp0 = in[0] * q[0], tmp1 = in[16] * q[16], tmp2 = in[32] * q[32], tmp3 = in[48] * q[48];
+        float tmp10 = tmp0 + tmp2, tmp11 = tmp0 - tmp2;
+        float tmp13 = tmp1 + tmp3, tmp12 = (tmp1 - tmp3) * 1.414213562f - tmp13;
+        tmp0 = tmp10 + tmp13;
+        tmp3 = tmp10 - tmp13;
+        tmp1 = tmp11 + tmp12;
+        tmp2 = tmp11 - tmp12;
+
+        float tmp4 = in[8] * q[8], tmp5 = in[24] * q[24], tmp6 = in[40] * q[40], tmp7 = in[56] * q[56];
+        float z13 = tmp6 + tmp5, z10 = tmp6 - tmp5, z11 = tmp4 + tmp7, z12 = tmp4 - tmp7;
+        tmp7 = z11 + z13;
+        tmp11 = (z11 - z13) * 1.414213562f;
+        float z5 = (z10 + z12) * 1.847759065f;
+        tmp10 = 1.082392200f * z12 - z5;
+        tmp12 = -2.613125930f * z10 + z5;
+        tmp6 = tmp12 - tmp7;
+        tmp5 = tmp11 - tmp6;
+        tmp4 = tmp10 + tmp5;
+
+        ws[0] = tmp0 + tmp7;
+        ws[56] = tmp0 - tmp7;
+        ws[8] = tmp1 + tmp6;
+        ws[48] = tmp1 - tmp6;
+        ws[16] = tmp2 + tmp5;
+        ws[40] = tmp2 - tmp5;
+        ws[32] = tmp3 + tmp4;
+        ws[24] = tmp3 - tmp4;
+    }
+
+    for (int row = 0; row < 8; row++) {
+        const float* ws = workspace + row * 8;
+        float* o = out + row * out_stride;
+
+        float tmp10 = ws[0] + ws[4], tmp11 = ws[0] - ws[4];
+        float tmp13 = ws[2] + ws[6], tmp12 = (ws[2] - ws[6]) * 1.414213562f - tmp13;
+        float tmp0 = tmp10 + tmp13, tmp3 = tmp10 - tmp13, tmp1 = tmp11 + tmp12, tmp2 = tmp11 - tmp12;
+
+        float z13 = ws[5] + ws[3], z10 = ws[5] - ws[3], z11 = ws[1] + ws[7], z12 = ws[1] - ws[7];
+        float tmp7 = z11 + z13;
+        tmp11 = (z11 - z13) * 1.414213562f;
+        float z5 = (z10 + z12) * 1.847759065f;
+        tmp10 = 1.082392200f * z12 - z5;
+        tmp12 = -2.613125930f * z10 + z5;
+        float tmp6 = tmp12 - tmp7, tmp5 = tmp11 - tmp6, tmp4 = tmp10 + tmp5;
+
+        o[0] = clamp_pixel(tmp0 + tmp7);
+        o[7] = clamp_pixel(tmp0 - tmp7);
+        o[1] = clamp_pixel(tmp1 + tmp6);
+        o[6] = clamp_pixel(tmp1 - tmp6);
+        o[2] = clamp_pixel(tmp2 + tmp5);
+        o[5] = clamp_pixel(tmp2 - tmp5);
+        o[4] = clamp_pixel(tmp3 + tmp4);
+        o[3] = clamp_pixel(tmp3 - tmp4);
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <stddef.h>
+
+#include "buffer2d.h"
+
+// Luma of a JPEG held in memory, shrunk by scale (1, 2, 4 or 8) in the DCT domain; see read_image().
+Buffer2D<float> decode_jpeg(const unsigned char* data, size_t size, int scale);
+
+// Inverse DCT of one block of quantized coefficients in natural order, rows stride apart
+// (8, or n for blocks stored cropped), to n x n pixels (n = 8, 4, 2 or 1) clamped to [0, 255].
+// table (128 floats) is what jpeg_idct_table() made for the block's quantization table
+// (natural order) and n.
+void jpeg_idct_table(const unsigned short* quantization, int n, float* table);
+void jpeg_idct(const short* coefficients, int stride, const float* table, int n, float* out, size_t out_stride);
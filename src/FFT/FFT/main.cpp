@@ -1,9 +1,28 @@
 #include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
-#include "opencv2/core.hpp"
-#include "opencv2/opencv.hpp"
-#include "opencv2/highgui.hpp"
+#include <string>
+#include <vector>
+
+#include "array2d.h"
+#include "autotune.h"
+#include "benchmark.h"
+#include "convolution.h"
+#include "fft.h"
+#include "fft_kernels.h"
+#include "image_io.h"
+#include "jpeg_decode.h"
+#include "out_of_core.h"
+#include "png_codec.h"
+#include "pruned.h"
+#include "spectrum.h"
+#include "thread_pool.h"
+#include "workspace.h"
 
 const float PI = 3.14159265f;
 
@@ -31,38 +50,1015 @@ void dft(short** in_array, double** re_array, double** im_array, float height, f
     }
 }
 
-void fre_spectrum(char** in_array, char** out_array, float height, float width)
+// Centered log-magnitude spectrum of an 8-bit image, 0..255, through the r2c plan.
+void fre_spectrum(unsigned char** in_array, unsigned char** out_array, int height, int width)
 {
-    double re, im, temp;
-    int move;
+    Buffer2D<unsigned char> in(width, height), out(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            in.row(x)[y] = in_array[x][y];
 
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            re = 0;
-            im = 0;
+    Buffer2D<float> re(width / 2 + 1, height), im(width / 2 + 1, height);
+    fft_plan_real_2d<float>(width, height).forward(in, re, im);
+    fft_spectrum_image(re, im, out);
+
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            out_array[x][y] = out.row(x)[y];
+}
+
+bool check_fft_2d()
+{
+    const int sizes[][2] = { { 1, 1 }, { 2, 2 }, { 4, 4 }, { 8, 16 }, { 16, 8 }, { 2, 32 }, { 32, 32 },
+        { 3, 5 }, { 6, 10 }, { 7, 9 }, { 12, 14 }, { 25, 20 }, { 11, 13 }, { 17, 1 }, { 22, 31 } };
+    bool passed = true;
+
+    srand(1);
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1];
+        short** in_array = alloc_array<short>(height, width);
+        double** re_ref = alloc_array<double>(height, width);
+        double** im_ref = alloc_array<double>(height, width);
+        double** re_array = alloc_array<double>(height, width);
+        double** im_array = alloc_array<double>(height, width);
+
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                in_array[x][y] = rand() % 256;
+
+        dft(in_array, re_ref, im_ref, height, width);
+        fft_2d(in_array, re_array, im_array, height, width);
+
+        double error = 0, scale = 1;
+        for (int x = 0; x < height; x++) {
+            for (int y = 0; y < width; y++) {
+                error = fmax(error, fabs(re_ref[x][y] - re_array[x][y]));
+                error = fmax(error, fabs(im_ref[x][y] - im_array[x][y]));
+                scale = fmax(scale, fabs(re_ref[x][y]));
+            }
+        }
+
+        bool ok = error <= 1e-5 * scale;
+        passed = passed && ok;
+        std::cout << height << "x" << width << ": max error " << error << (ok ? " ok" : " FAILED") << std::endl;
+
+        free_array(in_array, height);
+        free_array(re_ref, height);
+        free_array(im_ref, height);
+        free_array(re_array, height);
+        free_array(im_array, height);
+    }
+
+    return passed;
+}
+
+bool check_fft_real()
+{
+    const int sizes[][2] = { { 1, 1 }, { 1, 2 }, { 4, 4 }, { 8, 16 }, { 6, 10 }, { 7, 9 }, { 12, 14 }, { 11, 13 }, { 25, 20 } };
+    bool passed = true;
+
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1], half = width / 2 + 1;
+        short** in_array = alloc_array<short>(height, width);
+        double** re_full = alloc_array<double>(height, width);
+        double** im_full = alloc_array<double>(height, width);
+        double** re_half = alloc_array<double>(height, half);
+        double** im_half = alloc_array<double>(height, half);
+        double** out_array = alloc_array<double>(height, width);
+
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                in_array[x][y] = rand() % 256;
+
+        fft_2d(in_array, re_full, im_full, height, width);
+        fft_2d_r2c(in_array, re_half, im_half, height, width);
+
+        double error = 0, scale = 1;
+        for (int x = 0; x < height; x++) {
+            for (int y = 0; y < half; y++) {
+                error = fmax(error, fabs(re_full[x][y] - re_half[x][y]));
+                error = fmax(error, fabs(im_full[x][y] - im_half[x][y]));
+                scale = fmax(scale, fabs(re_full[x][y]));
+            }
+        }
 
+        fft_2d_c2r(re_half, im_half, out_array, height, width);
+        double round_trip = 0;
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                round_trip = fmax(round_trip, fabs(out_array[x][y] / (width * height) - in_array[x][y]));
+
+        bool ok = error <= 1e-9 * scale && round_trip <= 1e-9;
+        passed = passed && ok;
+        std::cout << height << "x" << width << " r2c: max error " << error << ", c2r round trip " << round_trip
+            << (ok ? " ok" : " FAILED") << std::endl;
+
+        free_array(in_array, height);
+        free_array(re_full, height);
+        free_array(im_full, height);
+        free_array(re_half, height);
+        free_array(im_half, height);
+        free_array(out_array, height);
+    }
+
+    return passed;
+}
+
+// The transposed column pass does the same arithmetic as the strided one, so both must agree
+// exactly. The sizes cover square (in-place) and rectangular planes with partial tiles.
+bool check_fft_column_pass()
+{
+    const int sizes[][2] = { { 4, 4 }, { 37, 37 }, { 100, 100 }, { 33, 70 }, { 64, 48 }, { 129, 17 } };
+    bool passed = true;
+
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1], half = width / 2 + 1;
+        Buffer2D<short> in(width, height);
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                in.row(x)[y] = rand() % 256;
+
+        FFTPlan plan(width, height, FFTDirection::Forward);
+        FFTRealPlan real_plan(width, height);
+        Buffer2D<double> re[2] = { { width, height }, { width, height } };
+        Buffer2D<double> im[2] = { { width, height }, { width, height } };
+        Buffer2D<double> re_half[2] = { { half, height }, { half, height } };
+        Buffer2D<double> im_half[2] = { { half, height }, { half, height } };
+        const FFTColumnPass modes[2] = { FFTColumnPass::Strided, FFTColumnPass::Transposed };
+        for (int i = 0; i < 2; i++) {
+            plan.setColumnPass(modes[i]);
+            plan.execute(in, re[i], im[i]);
+            real_plan.setColumnPass(modes[i]);
+            real_plan.forward(in, re_half[i], im_half[i]);
+        }
+
+        bool ok = true;
+        for (int x = 0; x < height; x++) {
+            ok = ok && memcmp(re[0].row(x), re[1].row(x), width * sizeof(double)) == 0;
+            ok = ok && memcmp(im[0].row(x), im[1].row(x), width * sizeof(double)) == 0;
+            ok = ok && memcmp(re_half[0].row(x), re_half[1].row(x), half * sizeof(double)) == 0;
+            ok = ok && memcmp(im_half[0].row(x), im_half[1].row(x), half * sizeof(double)) == 0;
+        }
+        passed = passed && ok;
+        std::cout << height << "x" << width << " transposed columns" << (ok ? " ok" : " FAILED") << std::endl;
+    }
+
+    return passed;
+}
+
+// Batches that fill several lane groups plus a partial one, against one execute() per image.
+bool check_fft_batch()
+{
+    const int sizes[][3] = { { 8, 8, 9 }, { 12, 10, 4 }, { 7, 9, 6 }, { 11, 16, 3 }, { 32, 24, 13 } };
+    bool passed = true;
+
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1], count = size[2];
+        std::vector<Buffer2D<short>> in;
+        std::vector<Buffer2D<double>> re, im, re_batch, im_batch;
+        for (int i = 0; i < count; i++) {
+            in.emplace_back(width, height);
+            re.emplace_back(width, height);
+            im.emplace_back(width, height);
+            re_batch.emplace_back(width, height);
+            im_batch.emplace_back(width, height);
+            for (int x = 0; x < height; x++)
+                for (int y = 0; y < width; y++)
+                    in[i].row(x)[y] = rand() % 256;
+        }
+
+        FFTPlan plan(width, height, FFTDirection::Forward);
+        for (int i = 0; i < count; i++)
+            plan.execute(in[i], re[i], im[i]);
+        plan.executeBatch(in.data(), re_batch.data(), im_batch.data(), count);
+
+        double error = 0, scale = 1;
+        for (int i = 0; i < count; i++) {
             for (int x = 0; x < height; x++) {
                 for (int y = 0; y < width; y++) {
-                    temp = (double)i * x / (double)height +
-                        (double)j * y / (double)width;
-                    move = (x + y) % 2 == 0 ? 1 : -1;
-                    re += in_array[x][y] * cos(-2.0 * PI * temp) * move;
-                    im += in_array[x][y] * sin(-2.0 * PI * temp) * move;
+                    error = fmax(error, fabs(re[i].row(x)[y] - re_batch[i].row(x)[y]));
+                    error = fmax(error, fabs(im[i].row(x)[y] - im_batch[i].row(x)[y]));
+                    scale = fmax(scale, fabs(re[i].row(x)[y]));
                 }
             }
+        }
+
+        bool ok = error <= 1e-9 * scale;
+        passed = passed && ok;
+        std::cout << count << " x " << height << "x" << width << " batch: max error " << error
+            << (ok ? " ok" : " FAILED") << std::endl;
+    }
+
+    return passed;
+}
+
+// Path of this executable, for the checks that start copies of it as distributed ranks.
+static std::string executable_path;
+
+// Distributed plans over one, two, three and four ranks, with sizes the ranks do not divide;
+// every rank compares its slab of the spectrum with FFTPlan.
+bool check_fft_distributed()
+{
+    const int sizes[][3] = { { 1, 40, 24 }, { 2, 37, 50 }, { 3, 48, 30 }, { 4, 64, 64 }, { 3, 97, 5 } };
+    bool passed = true;
+    for (const auto& size : sizes) {
+        int processes = size[0], width = size[1], height = size[2];
+        bool ok = run_distributed(executable_path, processes, width, height, 1, 1, true, nullptr);
+        passed = passed && ok;
+        std::cout << processes << " ranks " << width << "x" << height << " distributed" << (ok ? " ok" : " FAILED")
+            << std::endl;
+    }
+    return passed;
+}
+
+// Arena pieces are aligned and reused after a rewind, a multi-block arena collapses into one
+// block, and plans and the jagged-array entry points stop mapping blocks after their first call.
+bool check_fft_workspace()
+{
+    WorkspaceArena arena;
+    bool aligned = true;
+    for (int round = 0; round < 2; round++) {
+        size_t mark = arena.mark();
+        for (size_t bytes = 1; bytes <= (size_t)1 << 20; bytes *= 3)
+            aligned = aligned && (uintptr_t)arena.allocate(bytes) % BUFFER_ALIGNMENT == 0;
+        arena.rewind(mark);
+    }
+    WorkspaceStats stats = arena.stats();
+    bool ok = aligned && stats.used == 0 && stats.peak > 0 && stats.reserved >= stats.peak && stats.blocks >= 2;
+    arena.reserve(stats.reserved);
+    size_t blocks = arena.stats().blocks;
+    for (size_t bytes = 1; bytes <= (size_t)1 << 20; bytes *= 3)
+        arena.allocate(bytes);
+    ok = ok && arena.stats().blocks == blocks;
+    std::cout << "workspace arena: " << stats.peak << " bytes peak in " << stats.blocks << " blocks"
+        << (ok ? " ok" : " FAILED") << std::endl;
+    bool passed = ok;
+
+    const int width = 300, height = 200;
+    Buffer2D<unsigned char> in(width, height);
+    Buffer2D<double> re(width, height), im(width, height);
+    FFTPlan plan(width, height, FFTDirection::Forward);
+    plan.setColumnPass(FFTColumnPass::Transposed);
+    plan.execute(in, re, im);
+    blocks = plan.workspaceStats().blocks;
+    plan.execute(in, re, im);
+    plan.execute(re, im);
+    ok = plan.workspaceStats().blocks == blocks && plan.workspaceStats().reserved > 0;
+    passed = passed && ok;
+    std::cout << "plan workspace: " << plan.workspaceStats().reserved << " bytes reserved"
+        << (ok ? " ok" : " FAILED") << std::endl;
+
+    std::vector<short> pixels(width * height);
+    std::vector<double> spectrum(2 * width * height);
+    std::vector<short*> in_rows(height);
+    std::vector<double*> re_rows(height), im_rows(height);
+    for (int x = 0; x < height; x++) {
+        in_rows[x] = &pixels[x * width];
+        re_rows[x] = &spectrum[x * width];
+        im_rows[x] = &spectrum[(height + x) * width];
+    }
+    fft_2d(in_rows.data(), re_rows.data(), im_rows.data(), height, width);
+    blocks = thread_workspace().stats().blocks;
+    fft_2d(in_rows.data(), re_rows.data(), im_rows.data(), height, width);
+    ok = thread_workspace().stats().blocks == blocks && thread_workspace().stats().used == 0;
+    passed = passed && ok;
+    std::cout << "fft_2d thread workspace" << (ok ? " ok" : " FAILED") << std::endl;
+    return passed;
+}
+
+// Max |a - b| over the spectrum, against the long double reference.
+template<typename Real>
+static double spectrum_error(const Buffer2D<Real>& re, const Buffer2D<Real>& im, const Buffer2D<long double>& re_ref,
+    const Buffer2D<long double>& im_ref)
+{
+    double error = 0;
+    for (int x = 0; x < re.height(); x++) {
+        for (int y = 0; y < re.width(); y++) {
+            error = fmax(error, (double)fabsl(re.row(x)[y] - re_ref.row(x)[y]));
+            error = fmax(error, (double)fabsl(im.row(x)[y] - im_ref.row(x)[y]));
+        }
+    }
+    return error;
+}
+
+// float and double plans, complex and real-input, against long double plans of the same sizes.
+// Errors are relative to the DC term, which bounds every bin of a non-negative image.
+bool check_fft_precision()
+{
+    const int sizes[][2] = { { 16, 16 }, { 12, 30 }, { 31, 17 }, { 64, 48 }, { 100, 100 } };
+    bool passed = true;
+
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1], half = width / 2 + 1;
+        Buffer2D<unsigned char> in(width, height);
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                in.row(x)[y] = rand() % 256;
+
+        Buffer2D<long double> re_ref(width, height), im_ref(width, height);
+        Buffer2D<long double> re_half_ref(half, height), im_half_ref(half, height);
+        BasicFFTPlan<long double>(width, height, FFTDirection::Forward).execute(in, re_ref, im_ref);
+        BasicFFTRealPlan<long double>(width, height).forward(in, re_half_ref, im_half_ref);
+        double scale = fmax(1.0, (double)re_ref.row(0)[0]);
+
+        Buffer2D<float> re_f(width, height), im_f(width, height), re_half_f(half, height), im_half_f(half, height);
+        FFTPlanf(width, height, FFTDirection::Forward).execute(in, re_f, im_f);
+        FFTRealPlanf(width, height).forward(in, re_half_f, im_half_f);
+        double error_f = fmax(spectrum_error(re_f, im_f, re_ref, im_ref),
+            spectrum_error(re_half_f, im_half_f, re_half_ref, im_half_ref)) / scale;
+
+        Buffer2D<double> re_d(width, height), im_d(width, height), re_half_d(half, height), im_half_d(half, height);
+        FFTPlan(width, height, FFTDirection::Forward).execute(in, re_d, im_d);
+        FFTRealPlan(width, height).forward(in, re_half_d, im_half_d);
+        double error_d = fmax(spectrum_error(re_d, im_d, re_ref, im_ref),
+            spectrum_error(re_half_d, im_half_d, re_half_ref, im_half_ref)) / scale;
+
+        bool ok = error_f <= 1e-5 && error_d <= 1e-13;
+        passed = passed && ok;
+        std::cout << height << "x" << width << " precision: float " << error_f << ", double " << error_d
+            << (ok ? " ok" : " FAILED") << std::endl;
+    }
+
+    return passed;
+}
+
+// The DFT matrix product against the FFT of the same plan, rows and columns both ways, for real
+// and complex input in float and double. Sizes include smooth ones and widths that leave a
+// partial vector after the micro-kernel's columns.
+template<typename Real>
+static double dft_matrix_error(int width, int height, FFTDirection direction, const Buffer2D<unsigned char>& in,
+    const Buffer2D<Real>& in_im)
+{
+    BasicFFTPlan<Real> plan(width, height, direction);
+    Buffer2D<Real> re[2] = { { width, height }, { width, height } };
+    Buffer2D<Real> im[2] = { { width, height }, { width, height } };
+    Buffer2D<Real> re_real[2] = { { width, height }, { width, height } };
+    Buffer2D<Real> im_real[2] = { { width, height }, { width, height } };
+    const FFTLineAlgorithm algorithms[2] = { FFTLineAlgorithm::FFT, FFTLineAlgorithm::DFTMatrix };
+    for (int i = 0; i < 2; i++) {
+        plan.setLineAlgorithms(algorithms[i], algorithms[i]);
+        for (int x = 0; x < height; x++) {
+            for (int y = 0; y < width; y++) {
+                re[i].row(x)[y] = (Real)in.row(x)[y];
+                im[i].row(x)[y] = in_im.row(x)[y];
+            }
+        }
+        plan.execute(re[i], im[i]);
+        plan.execute(in, re_real[i], im_real[i]);
+    }
+
+    double error = 0, scale = 1;
+    for (int x = 0; x < height; x++) {
+        for (int y = 0; y < width; y++) {
+            scale = fmax(scale, fabs((double)re[0].row(x)[y]));
+            error = fmax(error, fabs((double)(re[0].row(x)[y] - re[1].row(x)[y])));
+            error = fmax(error, fabs((double)(im[0].row(x)[y] - im[1].row(x)[y])));
+            error = fmax(error, fabs((double)(re_real[0].row(x)[y] - re_real[1].row(x)[y])));
+            error = fmax(error, fabs((double)(im_real[0].row(x)[y] - im_real[1].row(x)[y])));
+        }
+    }
+    return error / scale;
+}
+
+bool check_fft_dft_matrix()
+{
+    const int sizes[][2] = { { 1, 1 }, { 17, 23 }, { 16, 24 }, { 37, 41 }, { 8, 61 }, { 101, 12 }, { 5, 257 } };
+    bool passed = true;
+
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1];
+        Buffer2D<unsigned char> in(width, height);
+        Buffer2D<float> im_f(width, height);
+        Buffer2D<double> im_d(width, height);
+        for (int x = 0; x < height; x++) {
+            for (int y = 0; y < width; y++) {
+                in.row(x)[y] = rand() % 256;
+                im_d.row(x)[y] = im_f.row(x)[y] = (float)(rand() % 256);
+            }
+        }
 
-            out_array[i][j] = (char)(sqrt(re * re + im * im) / sqrt(double(width) * height));
-            if (out_array[i][j] > 0xff)
-                out_array[i][j] = 0xff;
-            else if (out_array[i][j] < 0)
-                out_array[i][j] = 0;
+        double error_f = 0, error_d = 0;
+        const FFTDirection directions[2] = { FFTDirection::Forward, FFTDirection::Inverse };
+        for (FFTDirection direction : directions) {
+            error_f = fmax(error_f, dft_matrix_error(width, height, direction, in, im_f));
+            error_d = fmax(error_d, dft_matrix_error(width, height, direction, in, im_d));
         }
+
+        bool ok = error_f <= 1e-5 && error_d <= 1e-13;
+        passed = passed && ok;
+        std::cout << height << "x" << width << " dft matrix: float " << error_f << ", double " << error_d
+            << (ok ? " ok" : " FAILED") << std::endl;
     }
+
+    return passed;
 }
 
-int main()
+// A pruned 1D plan with the given method against the window of the full transform of the
+// zero-padded input, relative to the largest bin.
+template<typename Real>
+static double pruned_error(int n, int inputs, FFTWindow window, FFTPruning pruning, FFTDirection direction)
 {
-    cv::Mat image = cv::imread("D:\Document\Vulkan\FFT\FFT\1.png");
-    std::cout << image.size << std::endl;
+    typedef std::complex<Real> C;
+    std::vector<C> in(inputs), full(n), out(window.count);
+    for (int t = 0; t < inputs; t++)
+        full[t] = in[t] = C((Real)(rand() % 256), (Real)(rand() % 256));
+
+    BasicFFTPlan1D<Real> plan(n, direction);
+    std::vector<C> scratch(plan.scratchSize());
+    plan.execute(full.data(), scratch.data());
+    BasicFFTPrunedPlan1D<Real> pruned(n, direction, inputs, window, pruning);
+    std::vector<C> pruned_scratch(pruned.scratchSize());
+    pruned.execute(in.data(), out.data(), pruned_scratch.data());
+
+    double error = 0, scale = 1;
+    for (int k = 0; k < n; k++)
+        scale = fmax(scale, (double)std::abs(full[k]));
+    for (int i = 0; i < window.count; i++)
+        error = fmax(error, (double)std::abs(out[i] - full[((window.start + i) % n + n) % n]));
+    return error / scale;
+}
+
+// Every pruning method and Auto on 1D windows, then the 2D pruned plan and fft_2d_bins against
+// FFTPlan on the zero-padded image.
+bool check_fft_pruned()
+{
+    const int cases[][4] = { { 1, 1, 0, 1 }, { 12, 5, -3, 7 }, { 64, 64, 0, 64 }, { 64, 20, -4, 9 },
+        { 97, 40, 10, 3 }, { 120, 30, -10, 21 }, { 256, 100, -8, 17 }, { 256, 256, 5, 1 } };
+    const FFTPruning methods[] = { FFTPruning::Auto, FFTPruning::Full, FFTPruning::OutputPruned,
+        FFTPruning::InputPruned, FFTPruning::Goertzel };
+    const FFTDirection directions[2] = { FFTDirection::Forward, FFTDirection::Inverse };
+    bool passed = true;
+
+    for (const auto& c : cases) {
+        FFTWindow window = { c[2], c[3] };
+        double error_f = 0, error_d = 0;
+        for (FFTPruning pruning : methods) {
+            for (FFTDirection direction : directions) {
+                error_f = fmax(error_f, pruned_error<float>(c[0], c[1], window, pruning, direction));
+                error_d = fmax(error_d, pruned_error<double>(c[0], c[1], window, pruning, direction));
+            }
+        }
+        bool ok = error_f <= 1e-5 && error_d <= 1e-12;
+        passed = passed && ok;
+        std::cout << "n " << c[0] << ", " << c[1] << " inputs, bins " << c[2] << " + " << c[3] << " pruned: float "
+            << error_f << ", double " << error_d << (ok ? " ok" : " FAILED") << std::endl;
+    }
+
+    const int width = 48, height = 40, input_width = 30, input_height = 25;
+    const FFTWindow horizontal = { -4, 9 }, vertical = { -5, 11 };
+    Buffer2D<unsigned char> in(input_width, input_height), padded(width, height);
+    for (int x = 0; x < height; x++) {
+        for (int y = 0; y < width; y++) {
+            padded.row(x)[y] = x < input_height && y < input_width ? rand() % 256 : 0;
+            if (x < input_height && y < input_width)
+                in.row(x)[y] = padded.row(x)[y];
+        }
+    }
+    Buffer2D<double> re(width, height), im(width, height);
+    FFTPlan(width, height, FFTDirection::Forward).execute(padded, re, im);
+    Buffer2D<double> out_re(horizontal.count, vertical.count), out_im(horizontal.count, vertical.count);
+    FFTPrunedPlan(width, height, FFTDirection::Forward, input_width, input_height, horizontal, vertical)
+        .execute(in, out_re, out_im);
+
+    double error = 0, scale = fmax(1.0, re.row(0)[0]);
+    for (int i = 0; i < vertical.count; i++) {
+        for (int j = 0; j < horizontal.count; j++) {
+            int x = (vertical.start + i + height) % height, y = (horizontal.start + j + width) % width;
+            error = fmax(error, fabs(out_re.row(i)[j] - re.row(x)[y]));
+            error = fmax(error, fabs(out_im.row(i)[j] - im.row(x)[y]));
+        }
+    }
+
+    const int rows[] = { 0, 3, 39, 20, 7 }, columns[] = { 0, 5, 47, 5, -2 };
+    Complex bins[5];
+    fft_2d_bins(padded, rows, columns, 5, bins);
+    for (int i = 0; i < 5; i++) {
+        int y = (columns[i] + width) % width;
+        error = fmax(error, std::abs(bins[i] - Complex(re.row(rows[i])[y], im.row(rows[i])[y])));
+    }
+
+    bool ok = error <= 1e-12 * scale;
+    passed = passed && ok;
+    std::cout << height << "x" << width << " pruned window and bins: max error " << error
+        << (ok ? " ok" : " FAILED") << std::endl;
+    return passed;
+}
+
+// Every autotuner knob must leave the spectrum unchanged (within rounding, since the kernel sets
+// and radix splits round differently), and a wisdom entry must survive a round trip through its file.
+bool check_fft_tuning()
+{
+    const int width = 45, height = 64;
+    Buffer2D<unsigned char> in(width, height);
+    for (int x = 0; x < height; x++)
+        for (int y = 0; y < width; y++)
+            in.row(x)[y] = rand() % 256;
+
+    FFTPlan plan(width, height, FFTDirection::Forward);
+    Buffer2D<double> re_ref(width, height), im_ref(width, height), re(width, height), im(width, height);
+    plan.execute(in, re_ref, im_ref);
+
+    std::vector<FFTPlanConfig> configs(5);
+    configs[0].radices = FFTRadices::Radix2;
+    configs[1].columnPass = FFTColumnPass::Transposed;
+    configs[2].rowAlgorithm = FFTLineAlgorithm::DFTMatrix;
+    configs[3].kernels = "scalar";
+    configs[4].threads = 1;
+    bool passed = true;
+    for (const FFTPlanConfig& config : configs) {
+        fft_apply_config(plan, config);
+        plan.execute(in, re, im);
+        double error = 0;
+        for (int x = 0; x < height; x++) {
+            for (int y = 0; y < width; y++) {
+                error = fmax(error, fabs(re.row(x)[y] - re_ref.row(x)[y]));
+                error = fmax(error, fabs(im.row(x)[y] - im_ref.row(x)[y]));
+            }
+        }
+        bool ok = error <= 1e-12 * re_ref.row(0)[0];
+        passed = passed && ok;
+        std::cout << fft_config_string(config) << ": max error " << error << (ok ? " ok" : " FAILED") << std::endl;
+    }
+
+    const char* path = "fft_check_wisdom.txt";
+    FFTPlanConfig stored;
+    stored.radices = FFTRadices::Radix2;
+    stored.columnPass = FFTColumnPass::Transposed;
+    stored.kernels = "scalar";
+    stored.threads = 3;
+    FFTWisdom(path).store("Some CPU @ 2.00GHz", "float", width, height, stored);
+    FFTPlanConfig loaded;
+    bool ok = FFTWisdom(path).lookup("Some CPU @ 2.00GHz", "float", width, height, loaded)
+        && fft_config_string(loaded) == fft_config_string(stored)
+        && !FFTWisdom(path).lookup("Another CPU", "float", width, height, loaded);
+    remove(path);
+    passed = passed && ok;
+    std::cout << "wisdom round trip" << (ok ? " ok" : " FAILED") << std::endl;
+    return passed;
+}
+
+// fft_spectrum_image from full and half spectra against log1p / fftshift evaluated bin by bin,
+// within one gray level for the vectorized log.
+bool check_fft_spectrum_image()
+{
+    const int sizes[][2] = { { 1, 1 }, { 4, 4 }, { 8, 16 }, { 7, 9 }, { 12, 15 }, { 33, 70 }, { 64, 48 } };
+    bool passed = true;
+
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1], half = width / 2 + 1;
+        Buffer2D<unsigned char> in(width, height);
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                in.row(x)[y] = rand() % 256;
+
+        Buffer2D<double> re(width, height), im(width, height), re_half(half, height), im_half(half, height);
+        FFTPlan(width, height, FFTDirection::Forward).execute(in, re, im);
+        FFTRealPlan(width, height).forward(in, re_half, im_half);
+
+        Buffer2D<unsigned char> full(width, height), halved(width, height);
+        fft_spectrum_image(re, im, full);
+        fft_spectrum_image(re_half, im_half, halved);
+
+        double scale = 255.0 / log1p(fabs(re.row(0)[0]));
+        int error = 0;
+        for (int r = 0; r < height; r++) {
+            for (int c = 0; c < width; c++) {
+                int x = (r + height - height / 2) % height, y = (c + width - width / 2) % width;
+                double level = fmin(255.0, log1p(hypot(re.row(x)[y], im.row(x)[y])) * scale + 0.5);
+                error = std::max(error, abs((int)level - full.row(r)[c]));
+                error = std::max(error, abs((int)level - halved.row(r)[c]));
+            }
+        }
+
+        bool ok = error <= 1;
+        passed = passed && ok;
+        std::cout << height << "x" << width << " spectrum image: max error " << error << (ok ? " ok" : " FAILED")
+            << std::endl;
+    }
+
+    return passed;
+}
+
+// Every convolution method, with automatic and forced small tiles, against the direct sum.
+bool check_fft_convolution()
+{
+    // height, width, kernel height, kernel width, tile (0: automatic)
+    const int sizes[][5] = { { 37, 29, 5, 7, 0 }, { 37, 29, 5, 7, 16 }, { 64, 48, 9, 9, 20 }, { 50, 70, 1, 1, 0 },
+        { 10, 8, 15, 13, 0 }, { 33, 45, 4, 6, 12 }, { 100, 90, 16, 11, 36 } };
+    const FFTConvolutionMethod methods[] = { FFTConvolutionMethod::Auto, FFTConvolutionMethod::Full,
+        FFTConvolutionMethod::OverlapSave, FFTConvolutionMethod::OverlapAdd };
+    const char* names[] = { "auto", "full", "overlap-save", "overlap-add" };
+    bool passed = true;
+
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1], kernel_height = size[2], kernel_width = size[3], tile = size[4];
+        Buffer2D<float> image(width, height), kernel(kernel_width, kernel_height), out(width, height);
+        for (int x = 0; x < height; x++)
+            for (int y = 0; y < width; y++)
+                image.row(x)[y] = (float)(rand() % 256);
+        for (int i = 0; i < kernel_height; i++)
+            for (int j = 0; j < kernel_width; j++)
+                kernel.row(i)[j] = (float)(rand() % 1000) / 1000.0f;
+
+        std::vector<double> reference((size_t)width * height);
+        double scale = 1;
+        for (int x = 0; x < height; x++) {
+            for (int y = 0; y < width; y++) {
+                double sum = 0;
+                for (int i = 0; i < kernel_height; i++) {
+                    for (int j = 0; j < kernel_width; j++) {
+                        int sx = x + kernel_height / 2 - i, sy = y + kernel_width / 2 - j;
+                        if (sx >= 0 && sx < height && sy >= 0 && sy < width)
+                            sum += kernel.row(i)[j] * image.row(sx)[sy];
+                    }
+                }
+                reference[(size_t)x * width + y] = sum;
+                scale = fmax(scale, fabs(sum));
+            }
+        }
+
+        for (int m = 0; m < 4; m++) {
+            int method_tile = methods[m] == FFTConvolutionMethod::Full ? 0 : tile;
+            if (methods[m] == FFTConvolutionMethod::OverlapAdd && method_tile > 0
+                && (method_tile < 2 * kernel_width - 2 || method_tile < 2 * kernel_height - 2))
+                method_tile = 0;
+            FFTConvolutionf convolution(kernel, width, height, methods[m], method_tile);
+            convolution.execute(image, out);
+
+            double error = 0;
+            for (int x = 0; x < height; x++)
+                for (int y = 0; y < width; y++)
+                    error = fmax(error, fabs(out.row(x)[y] - reference[(size_t)x * width + y]));
+
+            bool ok = error <= 1e-5 * scale;
+            passed = passed && ok;
+            std::cout << height << "x" << width << " (*) " << kernel_height << "x" << kernel_width << " "
+                << names[m] << " " << convolution.transformHeight() << "x" << convolution.transformWidth()
+                << ": max error " << error << (ok ? " ok" : " FAILED") << std::endl;
+        }
+    }
+
+    return passed;
+}
+
+// Out-of-core spectra of small raw images, with budgets that force the four-step split
+// (48 = 6 * 8), the single-block path (prime height), column strips for a prime height whose rows
+// do not fit (61) and the Bluestein pass for heights no split fits (67 and 134 = 2 * 67), against
+// FFTPlan.
+bool check_fft_out_of_core()
+{
+    const int sizes[][3] = { { 48, 60, 15360 }, { 47, 33, 1 << 20 }, { 64, 20, 5120 }, { 61, 300, 1 << 18 },
+        { 67, 40, 1 << 14 }, { 134, 300, 1 << 18 } };
+    const char* input_path = "fft_check.raw";
+    const char* output_path = "fft_check.spectrum";
+    bool passed = true;
+
+    for (const auto& size : sizes) {
+        int height = size[0], width = size[1];
+        Buffer2D<unsigned char> in(width, height);
+        std::ofstream file(input_path, std::ios::binary);
+        for (int x = 0; x < height; x++) {
+            for (int y = 0; y < width; y++)
+                in.row(x)[y] = rand() % 256;
+            file.write((const char*)in.row(x), width);
+        }
+        file.close();
+
+        Buffer2D<double> re(width, height), im(width, height);
+        FFTPlan(width, height, FFTDirection::Forward).execute(in, re, im);
+        fft_2d_out_of_core(input_path, output_path, width, height, size[2]);
+
+        std::vector<Complex> spectrum((size_t)width * height);
+        std::ifstream(output_path, std::ios::binary).read((char*)spectrum.data(), spectrum.size() * sizeof(Complex));
+        double error = 0, scale = 1;
+        for (int x = 0; x < height; x++) {
+            for (int y = 0; y < width; y++) {
+                const Complex& value = spectrum[(size_t)x * width + y];
+                error = fmax(error, fabs(value.real() - re.row(x)[y]));
+                error = fmax(error, fabs(value.imag() - im.row(x)[y]));
+                scale = fmax(scale, fabs(re.row(x)[y]));
+            }
+        }
+
+        bool ok = error <= 1e-9 * scale;
+        passed = passed && ok;
+        std::cout << height << "x" << width << " out of core: max error " << error << (ok ? " ok" : " FAILED")
+            << std::endl;
+    }
+
+    remove(input_path);
+    remove(output_path);
+    return passed;
+}
+
+// A 64x64 gray baseline JPEG restarting after every MCU, so its intervals decode in parallel;
+// every block is flat (DC difference 0, end of block) except that corrupt_interval, if not -1,
+// runs its AC coefficients past the end of the block.
+std::vector<unsigned char> restart_jpeg(int corrupt_interval)
+{
+    std::vector<unsigned char> jpeg = { 0xFF, 0xD8, 0xFF, 0xDB, 0x00, 0x43, 0x00 };
+    jpeg.insert(jpeg.end(), 64, 1);
+    const unsigned char header[] = {
+        0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0x40, 0x00, 0x40, 0x01, 0x01, 0x11, 0x00,
+        // DC: category 0 is "0"; AC: end of block is "0", a run of 15 and a 1-bit value is "1"
+        0xFF, 0xC4, 0x00, 0x27,
+        0x00, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+        0x10, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00, 0xF1,
+        0xFF, 0xDD, 0x00, 0x04, 0x00, 0x01,
+        0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3F, 0x00
+    };
+    jpeg.insert(jpeg.end(), header, header + sizeof(header));
+    for (int i = 0; i < 64; i++) {
+        if (i > 0) {
+            jpeg.push_back(0xFF);
+            jpeg.push_back((unsigned char)(0xD0 + (i - 1) % 8));
+        }
+        if (i == corrupt_interval) {
+            // DC 0, then four runs of 15 take the coefficient index past 63
+            jpeg.push_back(0x55);
+            jpeg.push_back(0x7F);
+        } else {
+            jpeg.push_back(0x3F);
+        }
+    }
+    jpeg.push_back(0xFF);
+    jpeg.push_back(0xD9);
+    return jpeg;
+}
+
+// The JPEG inverse DCT at every scale against the direct formula, a PNG written and read back
+// at full and half resolution, restart intervals decoded in parallel (a corrupt one must throw
+// to the caller), and reduced decodes of the sample images against box-averaged full ones
+// (JPEG scaling works in the DCT domain, so they agree only roughly).
+bool check_image_io()
+{
+    bool passed = true;
+    const double pi = 3.14159265358979323846;
+
+    unsigned short quantization[64];
+    short coefficients[64];
+    for (int i = 0; i < 64; i++) {
+        quantization[i] = (unsigned short)(1 + rand() % 16);
+        coefficients[i] = (short)(i == 0 ? rand() % 64 - 32 : rand() % 9 - 4);
+    }
+    for (int n = 8; n >= 1; n /= 2) {
+        float table[128], out[64];
+        short cropped[64];
+        for (int v = 0; v < n; v++)
+            for (int u = 0; u < n; u++)
+                cropped[v * n + u] = coefficients[v * 8 + u];
+        jpeg_idct_table(quantization, n, table);
+        jpeg_idct(cropped, n, table, n, out, n);
+
+        double error = 0;
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                double sum = 0;
+                for (int v = 0; v < n; v++) {
+                    for (int u = 0; u < n; u++) {
+                        double cu = u == 0 ? sqrt(0.5) : 1.0, cv = v == 0 ? sqrt(0.5) : 1.0;
+                        sum += cu * cv / 4 * coefficients[v * 8 + u] * quantization[v * 8 + u]
+                            * cos((2 * x + 1) * u * pi / (2 * n)) * cos((2 * y + 1) * v * pi / (2 * n));
+                    }
+                }
+                double expected = fmin(fmax(sum + 128, 0.0), 255.0);
+                error = fmax(error, fabs(out[y * n + x] - expected));
+            }
+        }
+        bool ok = error <= 1e-3;
+        passed = passed && ok;
+        std::cout << n << "x" << n << " inverse DCT: max error " << error << (ok ? " ok" : " FAILED") << std::endl;
+    }
+
+    const char* png_path = "fft_check.png";
+    Buffer2D<unsigned char> picture(37, 23);
+    for (int y = 0; y < picture.height(); y++)
+        for (int x = 0; x < picture.width(); x++)
+            picture.row(y)[x] = (unsigned char)(rand() % 256);
+    write_png(png_path, picture);
+    for (int scale = 1; scale <= 2; scale++) {
+        Buffer2D<float> image = read_image(png_path, scale);
+        double error = image.width() == (picture.width() + scale - 1) / scale
+            && image.height() == (picture.height() + scale - 1) / scale ? 0 : 1e30;
+        for (int y = 0; error == 0 && y < image.height(); y++) {
+            for (int x = 0; x < image.width(); x++) {
+                double sum = 0;
+                int count = 0;
+                for (int r = y * scale; r < std::min(y * scale + scale, picture.height()); r++)
+                    for (int c = x * scale; c < std::min(x * scale + scale, picture.width()); c++, count++)
+                        sum += picture.row(r)[c];
+                error = fmax(error, fabs(image.row(y)[x] - sum / count));
+            }
+        }
+        bool ok = error <= 1e-3;
+        passed = passed && ok;
+        std::cout << "png 1/" << scale << ": max error " << error << (ok ? " ok" : " FAILED") << std::endl;
+    }
+    remove(png_path);
+
+    int threads = ThreadPool::global().size();
+    ThreadPool::setGlobalThreadCount(4);
+    std::vector<unsigned char> jpeg = restart_jpeg(-1);
+    Buffer2D<float> flat = decode_jpeg(jpeg.data(), jpeg.size(), 1);
+    double error = flat.width() == 64 && flat.height() == 64 ? 0 : 1e30;
+    for (int y = 0; error == 0 && y < flat.height(); y++)
+        for (int x = 0; x < flat.width(); x++)
+            error = fmax(error, fabs(flat.row(y)[x] - 128));
+    bool ok = error <= 1e-3;
+    passed = passed && ok;
+    std::cout << "jpeg restart intervals: max error " << error << (ok ? " ok" : " FAILED") << std::endl;
+    for (int corrupt : { 0, 37, 63 }) {
+        jpeg = restart_jpeg(corrupt);
+        std::string message;
+        try {
+            decode_jpeg(jpeg.data(), jpeg.size(), 1);
+        } catch (const std::exception& e) {
+            message = e.what();
+        }
+        ok = message == "Corrupt JPEG data!";
+        passed = passed && ok;
+        std::cout << "jpeg corrupt interval " << corrupt << ": " << (message.empty() ? "no error" : message)
+            << (ok ? " ok" : " FAILED") << std::endl;
+    }
+    ThreadPool::setGlobalThreadCount(threads);
+
+    for (const char* path : { "led.jpg", "1.png" }) {
+        if (!std::ifstream(path)) {
+            std::cout << path << ": skipped" << std::endl;
+            continue;
+        }
+        Buffer2D<float> full = read_image(path, 1);
+        for (int scale = 2; scale <= 8; scale *= 2) {
+            Buffer2D<float> reduced = read_image(path, scale);
+            double total = 0;
+            for (int y = 0; y < reduced.height(); y++) {
+                for (int x = 0; x < reduced.width(); x++) {
+                    double sum = 0;
+                    int count = 0;
+                    for (int r = y * scale; r < std::min(y * scale + scale, full.height()); r++)
+                        for (int c = x * scale; c < std::min(x * scale + scale, full.width()); c++, count++)
+                            sum += full.row(r)[c];
+                    total += fabs(reduced.row(y)[x] - sum / count);
+                }
+            }
+            double error = total / ((double)reduced.width() * reduced.height());
+            bool ok = reduced.width() == (full.width() + scale - 1) / scale
+                && reduced.height() == (full.height() + scale - 1) / scale && error <= 4.0;
+            passed = passed && ok;
+            std::cout << path << " 1/" << scale << " " << reduced.width() << "x" << reduced.height()
+                << ": mean difference " << error << (ok ? " ok" : " FAILED") << std::endl;
+        }
+    }
+
+    return passed;
+}
+
+bool check_fft()
+{
+    bool passed = true;
+    const FFTKernels& selected = fft_kernels();
+
+    for (const FFTKernels* kernels : fft_available_kernels()) {
+        std::cout << "kernels: " << kernels->name << std::endl;
+        fft_use_kernels(*kernels);
+        passed = check_fft_2d() && passed;
+        passed = check_fft_real() && passed;
+        passed = check_fft_column_pass() && passed;
+        passed = check_fft_batch() && passed;
+        passed = check_fft_precision() && passed;
+        passed = check_fft_dft_matrix() && passed;
+        passed = check_fft_pruned() && passed;
+        passed = check_fft_tuning() && passed;
+        passed = check_fft_spectrum_image() && passed;
+        passed = check_fft_convolution() && passed;
+    }
+
+    fft_use_kernels(selected);
+    passed = check_fft_workspace() && passed;
+    passed = check_fft_distributed() && passed;
+    passed = check_fft_out_of_core() && passed;
+    passed = check_image_io() && passed;
+    return passed;
+}
+
+static int run(int argc, char** argv)
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "check")
+        return check_fft() ? 0 : 1;
+    if (mode == "bench-threads") {
+        int width = argc > 2 ? atoi(argv[2]) : 4096;
+        int height = argc > 3 ? atoi(argv[3]) : width;
+        int max_threads = argc > 4 ? atoi(argv[4]) : 0;
+        benchmark_threads(width, height, max_threads);
+        return 0;
+    }
+    if (mode == "out-of-core" && argc > 5) {
+        int width = atoi(argv[3]), height = atoi(argv[4]);
+        size_t budget_mb = argc > 6 ? (size_t)atoi(argv[6]) : 1024;
+        auto start = std::chrono::steady_clock::now();
+        fft_2d_out_of_core(argv[2], argv[5], width, height, budget_mb << 20);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double gigabytes = (double)width * height * sizeof(Complex) / 1e9;
+        std::cout << width << "x" << height << " spectrum written to " << argv[5] << " in " << elapsed.count()
+            << " s (" << gigabytes / elapsed.count() << " GB/s)" << std::endl;
+        return 0;
+    }
+    if (mode == "bench-batch") {
+        int width = argc > 2 ? atoi(argv[2]) : 256;
+        int height = argc > 3 ? atoi(argv[3]) : width;
+        int count = argc > 4 ? atoi(argv[4]) : 256;
+        benchmark_batch(width, height, count);
+        return 0;
+    }
+    if (mode == "bench-precision") {
+        int width = argc > 2 ? atoi(argv[2]) : 1024;
+        int height = argc > 3 ? atoi(argv[3]) : width;
+        benchmark_precision(width, height);
+        return 0;
+    }
+    if (mode == "bench-dft-matrix") {
+        int height = argc > 2 ? atoi(argv[2]) : 512;
+        benchmark_dft_matrix(height);
+        return 0;
+    }
+    if (mode == "bench-pruned") {
+        int size = argc > 2 ? atoi(argv[2]) : 2048;
+        int input = argc > 3 ? atoi(argv[3]) : size / 2;
+        benchmark_pruned(size, input);
+        return 0;
+    }
+    if (mode == "distributed-rank" && argc > 8) {
+        return distributed_rank(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), atoi(argv[6]),
+            atoi(argv[7]) != 0, atoi(argv[8]));
+    }
+    if (mode == "bench-distributed") {
+        int size = argc > 2 ? atoi(argv[2]) : 2048;
+        int max_processes = argc > 3 ? atoi(argv[3]) : 4;
+        benchmark_distributed(executable_path, size, max_processes);
+        return 0;
+    }
+    if (mode == "bench-workspace") {
+        int width = argc > 2 ? atoi(argv[2]) : 4096;
+        int height = argc > 3 ? atoi(argv[3]) : width / 2;
+        benchmark_workspace(width, height);
+        return 0;
+    }
+    if (mode == "tune") {
+        int width = argc > 2 ? atoi(argv[2]) : 1024;
+        int height = argc > 3 ? atoi(argv[3]) : width;
+        benchmark_autotune(width, height);
+        return 0;
+    }
+    if (mode == "bench-convolution") {
+        int width = argc > 2 ? atoi(argv[2]) : 4096;
+        int height = argc > 3 ? atoi(argv[3]) : width;
+        int kernel = argc > 4 ? atoi(argv[4]) : 65;
+        benchmark_convolution(width, height, kernel);
+        return 0;
+    }
+    if (mode == "bench-transpose") {
+        int min_width = argc > 2 ? atoi(argv[2]) : 1024;
+        int max_width = argc > 3 ? atoi(argv[3]) : 16384;
+        int height = argc > 4 ? atoi(argv[4]) : 2048;
+        benchmark_column_pass(min_width, max_width, height);
+        return 0;
+    }
+
+    if (mode == "bench-decode" && argc > 2) {
+        benchmark_decode(argv[2]);
+        return 0;
+    }
+
+    if (argc < 2) {
+        std::cout << "Usage: FFT <image> [spectrum.png] [scale]" << std::endl;
+        return 1;
+    }
+    int scale = argc > 3 ? atoi(argv[3]) : 1;
+    Buffer2D<float> image = read_image(argv[1], scale);
+    std::cout << image.width() << "x" << image.height() << std::endl;
+
+    Buffer2D<float> re(image.width() / 2 + 1, image.height()), im(image.width() / 2 + 1, image.height());
+    fft_plan_real_2d<float>(image.width(), image.height()).forward(image, re, im);
+    std::cout << "DC: " << re.row(0)[0] << std::endl;
+
+    if (argc > 2) {
+        Buffer2D<unsigned char> spectrum(image.width(), image.height());
+        fft_spectrum_image(re, im, spectrum);
+        write_png(argv[2], spectrum);
+    }
     return 0;
+}
+
+int main(int argc, char** argv)
+{
+    executable_path = argv[0];
+    // Unreadable or corrupt images, unwritable outputs, budgets out-of-core cannot work in and
+    // failed rank processes end here with their message.
+    try {
+        return run(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path, Access access, uint64_t size)
+    : access(access)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    granularity = info.dwAllocationGranularity;
+
+    bool write = access == Access::ReadWrite;
+    handle = CreateFileA(path.c_str(), write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, nullptr,
+        write ? CREATE_ALWAYS : OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Failed to open " + path + "!");
+
+    if (write) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        if (!SetFilePointerEx(handle, end, nullptr, FILE_BEGIN) || !SetEndOfFile(handle)) {
+            CloseHandle(handle);
+            throw std::runtime_error("Failed to resize " + path + "!");
+        }
+        fileSize = size;
+    } else {
+        LARGE_INTEGER length;
+        GetFileSizeEx(handle, &length);
+        fileSize = (uint64_t)length.QuadPart;
+    }
+
+    if (fileSize > 0) {
+        mapping = CreateFileMappingA(handle, nullptr, write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            CloseHandle(handle);
+            throw std::runtime_error("Failed to map " + path + "!");
+        }
+    }
+#else
+    granularity = (uint64_t)sysconf(_SC_PAGESIZE);
+
+    bool write = access == Access::ReadWrite;
+    descriptor = write ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        throw std::runtime_error("Failed to open " + path + "!");
+
+    if (write) {
+        if (ftruncate(descriptor, (off_t)size) != 0) {
+            close(descriptor);
+            throw std::runtime_error("Failed to resize " + path + "!");
+        }
+        fileSize = size;
+    } else {
+        struct stat status;
+        fstat(descriptor, &status);
+        fileSize = (uint64_t)status.st_size;
+    }
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    CloseHandle(handle);
+#else
+    close(descriptor);
+#endif
+}
+
+MappedRegion MappedFile::map(uint64_t offset, size_t bytes) const
+{
+    if (offset + bytes > fileSize)
+        throw std::runtime_error("Mapped region is outside the file!");
+
+    MappedRegion region;
+    if (bytes == 0)
+        return region;
+
+    uint64_t start = offset / granularity * granularity;
+    size_t length = (size_t)(offset - start) + bytes;
+#ifdef _WIN32
+    DWORD mode = access == Access::ReadWrite ? FILE_MAP_READ | FILE_MAP_WRITE : FILE_MAP_READ;
+    void* base = MapViewOfFile(mapping, mode, (DWORD)(start >> 32), (DWORD)start, length);
+    if (base == nullptr)
+        throw std::runtime_error("Failed to map file region!");
+#else
+    int protection = access == Access::ReadWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* base = mmap(nullptr, length, protection, MAP_SHARED, descriptor, (off_t)start);
+    if (base == MAP_FAILED)
+        throw std::runtime_error("Failed to map file region!");
+    madvise(base, length, MADV_SEQUENTIAL);
+    madvise(base, length, MADV_WILLNEED);
+#endif
+
+    region.file = this;
+    region.base = base;
+    region.pointer = (char*)base + (offset - start);
+    region.mappedBytes = length;
+    region.bytes = bytes;
+    region.mappedOffset = start;
+    return region;
+}
+
+MappedRegion::MappedRegion(MappedRegion&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedRegion& MappedRegion::operator=(MappedRegion&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        file = other.file;
+        base = other.base;
+        pointer = other.pointer;
+        mappedBytes = other.mappedBytes;
+        bytes = other.bytes;
+        mappedOffset = other.mappedOffset;
+        other.base = nullptr;
+        other.pointer = nullptr;
+    }
+    return *this;
+}
+
+MappedRegion::~MappedRegion()
+{
+    release();
+}
+
+void MappedRegion::release()
+{
+    if (base == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    if (file->writable())
+        msync(base, mappedBytes, MS_ASYNC);
+    munmap(base, mappedBytes);
+#ifdef POSIX_FADV_DONTNEED
+    if (!file->writable())
+        posix_fadvise(file->descriptor, (off_t)mappedOffset, (off_t)mappedBytes, POSIX_FADV_DONTNEED);
+#endif
+#endif
+    base = nullptr;
+    pointer = nullptr;
+}
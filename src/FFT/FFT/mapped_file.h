@@ -0,0 +1,70 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class MappedFile;
+
+// One mapped window of a MappedFile. Windows are meant to live for a single sequential sweep:
+// the pages are announced with madvise(MADV_SEQUENTIAL | MADV_WILLNEED) when mapped and handed
+// back when the window is destroyed (dirty pages are queued for write-back, clean ones dropped
+// from the page cache) so that long sweeps keep a bounded resident set.
+class MappedRegion
+{
+public:
+    MappedRegion() = default;
+    MappedRegion(MappedRegion&& other) noexcept;
+    MappedRegion& operator=(MappedRegion&& other) noexcept;
+    MappedRegion(const MappedRegion&) = delete;
+    MappedRegion& operator=(const MappedRegion&) = delete;
+    ~MappedRegion();
+
+    void* data() const { return pointer; }
+    size_t size() const { return bytes; }
+
+private:
+    friend class MappedFile;
+    void release();
+
+private:
+    const MappedFile* file = nullptr;
+    void* base = nullptr;
+    void* pointer = nullptr;
+    size_t mappedBytes = 0;
+    size_t bytes = 0;
+    uint64_t mappedOffset = 0;
+};
+
+class MappedFile
+{
+public:
+    // Read opens an existing file; ReadWrite creates or truncates the file to size bytes.
+    enum class Access {
+        Read,
+        ReadWrite
+    };
+
+    MappedFile(const std::string& path, Access access, uint64_t size = 0);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    uint64_t size() const { return fileSize; }
+    bool writable() const { return access == Access::ReadWrite; }
+
+    // [offset, offset + bytes) of the file; offset needs no alignment.
+    MappedRegion map(uint64_t offset, size_t bytes) const;
+
+private:
+    friend class MappedRegion;
+
+    Access access;
+    uint64_t fileSize = 0;
+    uint64_t granularity = 0;
+#ifdef _WIN32
+    void* handle = nullptr;
+    void* mapping = nullptr;
+#else
+    int descriptor = -1;
+#endif
+};
@@ -0,0 +1,281 @@
+#include "out_of_core.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdexcept>
+#include <vector>
+
+#include "buffer2d.h"
+#include "fft.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+static const double PI_D = 3.14159265358979323846;
+
+// A window narrower than a page still makes the whole page resident, so column strips are
+// budgeted at no less than this per row.
+static const size_t MIN_STRIP_BYTES = 4096;
+
+// Largest n2 dividing length whose last step (n2 work rows plus n2 output rows) fits the budget;
+// the first step then maps n1 = length / n2 rows at once, as column strips where whole rows do
+// not fit.
+static bool choose_split(int length, size_t row_bytes, size_t budget, int& n1, int& n2)
+{
+    size_t strip_bytes = row_bytes < MIN_STRIP_BYTES ? row_bytes : MIN_STRIP_BYTES;
+    size_t largest = budget / (2 * row_bytes);
+    for (n2 = largest < (size_t)length ? (int)largest : length; n2 >= 1; n2--) {
+        if (length % n2 != 0)
+            continue;
+        n1 = length / n2;
+        return (size_t)n1 * strip_bytes <= budget;
+    }
+    return false;
+}
+
+static int clamp_rows(size_t rows, int limit)
+{
+    if (rows < 1)
+        return 1;
+    return rows < (size_t)limit ? (int)rows : limit;
+}
+
+// Row FFTs of the 8-bit image into the work file, one band of rows at a time.
+static void row_pass(const MappedFile& input, const MappedFile& work, int width, int height, size_t budget,
+    Buffer2D<Complex>& workspaces, int scratch_offset)
+{
+    const FFTPlan1D& plan = fft_plan_1d(width, FFTDirection::Forward);
+    size_t row_bytes = (size_t)width * sizeof(Complex);
+    int band = clamp_rows(budget / (row_bytes + width), height);
+
+    for (int first = 0; first < height; first += band) {
+        int rows = height - first < band ? height - first : band;
+        MappedRegion source = input.map((uint64_t)first * width, (size_t)rows * width);
+        MappedRegion target = work.map((uint64_t)first * row_bytes, (size_t)rows * row_bytes);
+        const unsigned char* pixels = (const unsigned char*)source.data();
+        Complex* spectrum = (Complex*)target.data();
+
+        ThreadPool::global().parallelFor(0, rows, 8, [&](int begin, int end, int worker) {
+            Complex* scratch = workspaces.row(worker) + scratch_offset;
+            for (int x = begin; x < end; x++) {
+                const unsigned char* row = pixels + (size_t)x * width;
+                Complex* line = spectrum + (size_t)x * width;
+                for (int y = 0; y < width; y++)
+                    line[y] = Complex(row[y], 0.0);
+                plan.execute(line, scratch);
+            }
+        });
+    }
+}
+
+// Step one of the column FFT: row r = n2 * i + j of the work file holds x[i][j]. For each j, the
+// n1-point transforms over i, times w^(j * k) with w the length-th root of unity, go back in place.
+// Runs of consecutive j are mapped from all n1 blocks together when n1 whole rows fit the budget;
+// otherwise each j is mapped as strips of as many columns as do.
+static void column_step_one(const MappedFile& work, int width, int length, int n1, int n2,
+    FFTDirection direction, size_t budget, Buffer2D<Complex>& workspaces, int scratch_offset)
+{
+    const FFTPlan1D& plan = fft_plan_1d(n1, direction);
+    size_t row_bytes = (size_t)width * sizeof(Complex);
+    double sign = direction == FFTDirection::Forward ? -1.0 : 1.0;
+    int strip = clamp_rows(budget / ((size_t)n1 * sizeof(Complex)), width);
+    int tile = strip == width ? clamp_rows(budget / ((size_t)n1 * row_bytes), n2) : 1;
+
+    std::vector<MappedRegion> blocks(n1);
+    std::vector<Complex*> block_rows(n1);
+    std::vector<Complex> twiddles((size_t)tile * n1);
+
+    for (int first = 0; first < n2; first += tile) {
+        int rows = n2 - first < tile ? n2 - first : tile;
+        for (int t = 0; t < rows; t++) {
+            for (int k = 0; k < n1; k++) {
+                long long power = (long long)(first + t) * k % length;
+                twiddles[(size_t)t * n1 + k] = std::polar(1.0, sign * 2.0 * PI_D * power / length);
+            }
+        }
+
+        for (int left = 0; left < width; left += strip) {
+            int columns = width - left < strip ? width - left : strip;
+            for (int i = 0; i < n1; i++) {
+                uint64_t offset = ((uint64_t)i * n2 + first) * width + left;
+                blocks[i] = work.map(offset * sizeof(Complex), ((size_t)(rows - 1) * width + columns) * sizeof(Complex));
+                block_rows[i] = (Complex*)blocks[i].data();
+            }
+
+            ThreadPool::global().parallelFor(0, columns, 16, [&](int begin, int end, int worker) {
+                Complex* line = workspaces.row(worker);
+                Complex* scratch = line + scratch_offset;
+                for (int t = 0; t < rows; t++) {
+                    const Complex* w = &twiddles[(size_t)t * n1];
+                    for (int y = begin; y < end; y++) {
+                        size_t at = (size_t)t * width + y;
+                        for (int i = 0; i < n1; i++)
+                            line[i] = block_rows[i][at];
+                        plan.execute(line, scratch);
+                        for (int k = 0; k < n1; k++)
+                            block_rows[k][at] = line[k] * w[k];
+                    }
+                }
+            });
+        }
+    }
+}
+
+// Step two: the n2-point transforms down each block of n2 rows. Block k, row l is X[n1 * l + k],
+// so the results are scattered as whole rows to the output.
+static void column_step_two(const MappedFile& work, const MappedFile& output, int width, int n1, int n2,
+    FFTDirection direction, Buffer2D<Complex>& workspaces, int scratch_offset)
+{
+    const FFTPlan1D& plan = fft_plan_1d(n2, direction);
+    size_t row_bytes = (size_t)width * sizeof(Complex);
+
+    std::vector<MappedRegion> targets(n2);
+    std::vector<Complex*> target_rows(n2);
+
+    for (int k = 0; k < n1; k++) {
+        MappedRegion block = work.map((uint64_t)k * n2 * row_bytes, (size_t)n2 * row_bytes);
+        const Complex* rows = (const Complex*)block.data();
+        for (int l = 0; l < n2; l++) {
+            targets[l] = output.map(((uint64_t)l * n1 + k) * row_bytes, row_bytes);
+            target_rows[l] = (Complex*)targets[l].data();
+        }
+
+        ThreadPool::global().parallelFor(0, width, 16, [&](int begin, int end, int worker) {
+            Complex* line = workspaces.row(worker);
+            Complex* scratch = line + scratch_offset;
+            for (int y = begin; y < end; y++) {
+                for (int l = 0; l < n2; l++)
+                    line[l] = rows[(size_t)l * width + y];
+                plan.execute(line, scratch);
+                for (int l = 0; l < n2; l++)
+                    target_rows[l][y] = line[l];
+            }
+        });
+    }
+}
+
+// Column FFT of length points through the four-step split: step one in place on work, step two
+// into output in natural order.
+static void column_pass(const MappedFile& work, const MappedFile& output, int width, int length, int n1, int n2,
+    FFTDirection direction, size_t budget, Buffer2D<Complex>& workspaces, int scratch_offset)
+{
+    if (n1 > 1)
+        column_step_one(work, width, length, n1, n2, direction, budget, workspaces, scratch_offset);
+    column_step_two(work, output, width, n1, n2, direction, workspaces, scratch_offset);
+}
+
+// Row r of target becomes row r of source times factors[r], for the first factors.size() rows.
+static void scale_rows(const MappedFile& source, const MappedFile& target, int width, const std::vector<Complex>& factors,
+    size_t budget)
+{
+    size_t row_bytes = (size_t)width * sizeof(Complex);
+    int height = (int)factors.size();
+    int band = clamp_rows(budget / (2 * row_bytes), height);
+
+    for (int first = 0; first < height; first += band) {
+        int rows = height - first < band ? height - first : band;
+        MappedRegion from = source.map((uint64_t)first * row_bytes, (size_t)rows * row_bytes);
+        MappedRegion to = &target != &source ? target.map((uint64_t)first * row_bytes, (size_t)rows * row_bytes)
+                                             : MappedRegion();
+        const Complex* in = (const Complex*)from.data();
+        Complex* out = (Complex*)(&target != &source ? to.data() : from.data());
+
+        ThreadPool::global().parallelFor(0, rows, 8, [&](int begin, int end, int) {
+            for (int x = begin; x < end; x++) {
+                Complex factor = factors[first + x];
+                for (int y = 0; y < width; y++)
+                    out[(size_t)x * width + y] = in[(size_t)x * width + y] * factor;
+            }
+        });
+    }
+}
+
+// Smallest smooth length >= 2 * height - 1 that choose_split() can fit, for a Bluestein column
+// pass when height itself cannot be split within the budget.
+static bool choose_bluestein(int height, size_t row_bytes, size_t budget, int& length, int& n1, int& n2)
+{
+    if (height >= (1 << 29))
+        return false;
+    for (length = 2 * height - 1; length <= 4 * height; length++) {
+        if (is_smooth(length) && choose_split(length, row_bytes, budget, n1, n2))
+            return true;
+    }
+    return false;
+}
+
+// exp(-i pi n^2 / height), with n^2 reduced mod 2 * height so the angle stays exact.
+static std::vector<Complex> chirp(int height)
+{
+    std::vector<Complex> factors(height);
+    for (int n = 0; n < height; n++) {
+        long long power = (long long)n * n % (2LL * height);
+        factors[n] = std::polar(1.0, -PI_D * power / height);
+    }
+    return factors;
+}
+
+void fft_2d_out_of_core(const std::string& input_path, const std::string& output_path, int width, int height,
+    size_t memory_budget)
+{
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("Invalid image size!");
+
+    size_t row_bytes = (size_t)width * sizeof(Complex);
+    int length = height, n1, n2;
+    bool bluestein = !choose_split(height, row_bytes, memory_budget, n1, n2);
+    if (bluestein && !choose_bluestein(height, row_bytes, memory_budget, length, n1, n2))
+        throw std::runtime_error("Memory budget is too small for an out-of-core FFT of this size!");
+
+    MappedFile input(input_path, MappedFile::Access::Read);
+    if (input.size() < (uint64_t)width * height)
+        throw std::runtime_error("Input file is smaller than the image!");
+
+    int line_size = n1 > n2 ? n1 : n2;
+    int scratch = fft_plan_1d(width, FFTDirection::Forward).scratchSize();
+    for (FFTDirection direction : { FFTDirection::Forward, FFTDirection::Inverse }) {
+        if (fft_plan_1d(n1, direction).scratchSize() > scratch)
+            scratch = fft_plan_1d(n1, direction).scratchSize();
+        if (fft_plan_1d(n2, direction).scratchSize() > scratch)
+            scratch = fft_plan_1d(n2, direction).scratchSize();
+    }
+    Buffer2D<Complex> workspaces(line_size + scratch, ThreadPool::global().size());
+
+    std::string work_path = output_path + ".work";
+    std::string bluestein_path = output_path + ".bluestein";
+    {
+        MappedFile work(work_path, MappedFile::Access::ReadWrite, (uint64_t)row_bytes * length);
+        MappedFile output(output_path, MappedFile::Access::ReadWrite, (uint64_t)row_bytes * height);
+
+        row_pass(input, work, width, height, memory_budget, workspaces, line_size);
+        if (!bluestein) {
+            column_pass(work, output, width, height, n1, n2, FFTDirection::Forward, memory_budget, workspaces,
+                line_size);
+        } else {
+            // X[k] = c[k] * sum_n (x[n] c[n]) conj(c[k - n]) with c the chirp: a cyclic convolution
+            // of length points, done as a forward column pass, a product with the transformed
+            // conj(c) and an inverse column pass, all through the second work file.
+            MappedFile product(bluestein_path, MappedFile::Access::ReadWrite, (uint64_t)row_bytes * length);
+            std::vector<Complex> factors = chirp(height);
+            scale_rows(work, work, width, factors, memory_budget);
+            column_pass(work, product, width, length, n1, n2, FFTDirection::Forward, memory_budget, workspaces,
+                line_size);
+
+            std::vector<Complex> kernel(length), kernel_scratch(fft_plan_1d(length, FFTDirection::Forward).scratchSize());
+            for (int n = 0; n < height; n++) {
+                kernel[n] = std::conj(factors[n]);
+                if (n > 0)
+                    kernel[length - n] = kernel[n];
+            }
+            fft_plan_1d(length, FFTDirection::Forward).execute(kernel.data(), kernel_scratch.data());
+            scale_rows(product, product, width, kernel, memory_budget);
+            column_pass(product, work, width, length, n1, n2, FFTDirection::Inverse, memory_budget, workspaces,
+                line_size);
+
+            for (Complex& factor : factors)
+                factor /= length;
+            scale_rows(work, output, width, factors, memory_budget);
+        }
+    }
+    remove(work_path.c_str());
+    if (bluestein)
+        remove(bluestein_path.c_str());
+}
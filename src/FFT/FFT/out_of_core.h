@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+#include <string>
+
+// Forward 2D FFT of a raw 8-bit width x height image stored row by row in input_path, for
+// images whose spectrum does not fit in memory. The spectrum goes to output_path as height rows
+// of width interleaved (re, im) doubles, the same values FFTPlan produces.
+//
+// The file is only touched through memory-mapped windows, at most about memory_budget bytes at
+// a time. Rows are transformed band by band; the columns run as a four-step FFT with
+// height = n1 * n2: n1-point transforms across n1 blocks of rows plus a twiddle, over column
+// strips when n1 whole rows do not fit, then n2-point transforms inside each block, whose rows are
+// written out in transposed block order. Heights no split fits (a large prime factor under a
+// tight budget) go through a Bluestein column pass padded to a smooth length m >= 2 * height - 1.
+// A work file the size of the output (m rows for Bluestein) is kept at output_path + ".work"
+// meanwhile, and for Bluestein a second one of m rows at output_path + ".bluestein".
+void fft_2d_out_of_core(const std::string& input_path, const std::string& output_path, int width, int height,
+    size_t memory_budget);
@@ -0,0 +1,538 @@
+#include "png_codec.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+
+#include "thread_pool.h"
+
+static const int INFLATE_FAST_BITS = 9;
+
+// Canonical Huffman code of a deflate block: codes up to INFLATE_FAST_BITS long resolve with
+// one lookup (symbol << 4 | length), longer ones code length by code length as in zlib's puff.
+struct InflateTable {
+    unsigned short fast[1 << INFLATE_FAST_BITS];
+    unsigned short counts[16];
+    unsigned short symbols[288];
+};
+
+static void build_inflate_table(InflateTable& table, const unsigned char* lengths, int count)
+{
+    memset(table.counts, 0, sizeof(table.counts));
+    for (int i = 0; i < count; i++)
+        table.counts[lengths[i]]++;
+    table.counts[0] = 0;
+
+    unsigned short offsets[16];
+    offsets[1] = 0;
+    for (int length = 1; length < 15; length++)
+        offsets[length + 1] = (unsigned short)(offsets[length] + table.counts[length]);
+    int left = 1;
+    for (int length = 1; length < 16; length++) {
+        left = (left << 1) - table.counts[length];
+        if (left < 0)
+            throw std::runtime_error("Corrupt deflate stream!");
+    }
+    for (int i = 0; i < count; i++)
+        if (lengths[i] != 0)
+            table.symbols[offsets[lengths[i]]++] = (unsigned short)i;
+
+    // Deflate codes go LSB first, so the fast table is indexed by the bit-reversed code.
+    memset(table.fast, 0, sizeof(table.fast));
+    int code = 0, index = 0;
+    for (int length = 1; length <= INFLATE_FAST_BITS; length++) {
+        for (int i = 0; i < table.counts[length]; i++, code++, index++) {
+            int reversed = 0;
+            for (int bit = 0; bit < length; bit++)
+                reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+            for (int fill = reversed; fill < (1 << INFLATE_FAST_BITS); fill += 1 << length)
+                table.fast[fill] = (unsigned short)(table.symbols[index] << 4 | length);
+        }
+        code <<= 1;
+    }
+}
+
+class Inflater
+{
+public:
+    Inflater(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+        : position(data), end(data + size), out(out)
+    {
+    }
+
+    void run()
+    {
+        bool last = false;
+        while (!last) {
+            last = bits(1) != 0;
+            int type = bits(2);
+            if (type == 0)
+                stored();
+            else if (type == 1)
+                fixed();
+            else if (type == 2)
+                dynamic();
+            else
+                throw std::runtime_error("Corrupt deflate stream!");
+        }
+    }
+
+private:
+    void refill()
+    {
+        while (available <= 56) {
+            uint64_t byte = 0;
+            if (position < end)
+                byte = *position++;
+            else if (++overrun > 8)
+                throw std::runtime_error("Truncated deflate stream!");
+            window |= byte << available;
+            available += 8;
+        }
+    }
+
+    int bits(int count)
+    {
+        if (available < count)
+            refill();
+        int value = (int)(window & ((1ull << count) - 1));
+        window >>= count;
+        available -= count;
+        return value;
+    }
+
+    int decode(const InflateTable& table)
+    {
+        if (available < 16)
+            refill();
+        int entry = table.fast[window & ((1 << INFLATE_FAST_BITS) - 1)];
+        if (entry != 0) {
+            window >>= entry & 15;
+            available -= entry & 15;
+            return entry >> 4;
+        }
+        int code = 0, first = 0, index = 0;
+        for (int length = 1; length < 16; length++) {
+            code |= (int)(window & 1);
+            window >>= 1;
+            available--;
+            int count = table.counts[length];
+            if (code - count < first)
+                return table.symbols[index + (code - first)];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        throw std::runtime_error("Corrupt deflate stream!");
+    }
+
+    void stored()
+    {
+        // Drop the partial byte; whole bytes still in the window go back to the input.
+        window >>= available & 7;
+        available -= available & 7;
+        size_t pending = available / 8 - (overrun < available / 8 ? overrun : available / 8);
+        position -= pending;
+        window = 0;
+        available = 0;
+        overrun = 0;
+        if (end - position < 4)
+            throw std::runtime_error("Truncated deflate stream!");
+        int length = position[0] | position[1] << 8, complement = position[2] | position[3] << 8;
+        if ((length ^ 0xffff) != complement || end - position - 4 < length)
+            throw std::runtime_error("Corrupt deflate stream!");
+        out.insert(out.end(), position + 4, position + 4 + length);
+        position += 4 + length;
+    }
+
+    void fixed()
+    {
+        struct FixedTables {
+            InflateTable literals, distances;
+            FixedTables()
+            {
+                unsigned char lengths[288];
+                memset(lengths, 8, 144);
+                memset(lengths + 144, 9, 112);
+                memset(lengths + 256, 7, 24);
+                memset(lengths + 280, 8, 8);
+                build_inflate_table(literals, lengths, 288);
+                memset(lengths, 5, 30);
+                build_inflate_table(distances, lengths, 30);
+            }
+        };
+        static const FixedTables tables;
+        codes(tables.literals, tables.distances);
+    }
+
+    void dynamic()
+    {
+        static const unsigned char ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        int literal_count = bits(5) + 257, distance_count = bits(5) + 1, code_count = bits(4) + 4;
+        if (literal_count > 286 || distance_count > 30)
+            throw std::runtime_error("Corrupt deflate stream!");
+        unsigned char lengths[320] = {};
+        for (int i = 0; i < code_count; i++)
+            lengths[ORDER[i]] = (unsigned char)bits(3);
+        InflateTable code_lengths;
+        build_inflate_table(code_lengths, lengths, 19);
+
+        memset(lengths, 0, sizeof(lengths));
+        for (int i = 0; i < literal_count + distance_count;) {
+            int symbol = decode(code_lengths);
+            if (symbol < 16) {
+                lengths[i++] = (unsigned char)symbol;
+                continue;
+            }
+            int repeat, value = 0;
+            if (symbol == 16) {
+                if (i == 0)
+                    throw std::runtime_error("Corrupt deflate stream!");
+                value = lengths[i - 1];
+                repeat = 3 + bits(2);
+            } else if (symbol == 17) {
+                repeat = 3 + bits(3);
+            } else {
+                repeat = 11 + bits(7);
+            }
+            if (i + repeat > literal_count + distance_count)
+                throw std::runtime_error("Corrupt deflate stream!");
+            while (repeat-- > 0)
+                lengths[i++] = (unsigned char)value;
+        }
+        if (lengths[256] == 0)
+            throw std::runtime_error("Corrupt deflate stream!");
+
+        InflateTable literals, distances;
+        build_inflate_table(literals, lengths, literal_count);
+        build_inflate_table(distances, lengths + literal_count, distance_count);
+        codes(literals, distances);
+    }
+
+    void codes(const InflateTable& literals, const InflateTable& distances)
+    {
+        static const unsigned short LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const unsigned char LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const unsigned short DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+            193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const unsigned char DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+            6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        for (;;) {
+            int symbol = decode(literals);
+            if (symbol < 256) {
+                out.push_back((unsigned char)symbol);
+                continue;
+            }
+            if (symbol == 256)
+                return;
+            symbol -= 257;
+            if (symbol >= 29)
+                throw std::runtime_error("Corrupt deflate stream!");
+            int length = LENGTH_BASE[symbol] + bits(LENGTH_EXTRA[symbol]);
+            int distance_symbol = decode(distances);
+            if (distance_symbol >= 30)
+                throw std::runtime_error("Corrupt deflate stream!");
+            size_t distance = DISTANCE_BASE[distance_symbol] + bits(DISTANCE_EXTRA[distance_symbol]);
+            if (distance > out.size())
+                throw std::runtime_error("Corrupt deflate stream!");
+            size_t from = out.size() - distance;
+            for (int i = 0; i < length; i++)
+                out.push_back(out[from + i]);
+        }
+    }
+
+private:
+    const unsigned char* position;
+    const unsigned char* end;
+    std::vector<unsigned char>& out;
+    uint64_t window = 0;
+    int available = 0;
+    int overrun = 0;
+};
+
+std::vector<unsigned char> zlib_inflate(const unsigned char* data, size_t size, size_t expected_size)
+{
+    if (size < 2 || (data[0] & 15) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+        throw std::runtime_error("Corrupt zlib stream!");
+    std::vector<unsigned char> out;
+    out.reserve(expected_size);
+    Inflater(data + 2, size - 2, out).run();
+    return out;
+}
+
+static uint32_t read_u32(const unsigned char* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static int paeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Undoes the filters of one pass (rows of row_bytes plus the filter byte) in place.
+static void unfilter(unsigned char* data, int rows, size_t row_bytes, int pixel_bytes)
+{
+    const unsigned char* previous = nullptr;
+    for (int y = 0; y < rows; y++) {
+        unsigned char* row = data + y * (row_bytes + 1) + 1;
+        int filter = row[-1];
+        for (size_t i = 0; i < row_bytes; i++) {
+            int left = i >= (size_t)pixel_bytes ? row[i - pixel_bytes] : 0;
+            int up = previous ? previous[i] : 0;
+            int corner = previous && i >= (size_t)pixel_bytes ? previous[i - pixel_bytes] : 0;
+            switch (filter) {
+            case 0:
+                break;
+            case 1:
+                row[i] = (unsigned char)(row[i] + left);
+                break;
+            case 2:
+                row[i] = (unsigned char)(row[i] + up);
+                break;
+            case 3:
+                row[i] = (unsigned char)(row[i] + ((left + up) >> 1));
+                break;
+            case 4:
+                row[i] = (unsigned char)(row[i] + paeth(left, up, corner));
+                break;
+            default:
+                throw std::runtime_error("Corrupt PNG filter!");
+            }
+        }
+        previous = row;
+    }
+}
+
+Buffer2D<float> decode_png(const unsigned char* data, size_t size, int scale)
+{
+    static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+        throw std::runtime_error("PNG scale must be 1, 2, 4 or 8!");
+    if (size < 8 || memcmp(data, SIGNATURE, 8) != 0)
+        throw std::runtime_error("Not a PNG file!");
+
+    int width = 0, height = 0, depth = 0, color = -1, interlace = 0;
+    std::vector<unsigned char> palette;
+    std::vector<unsigned char> compressed;
+    for (size_t offset = 8;;) {
+        if (size - offset < 12)
+            throw std::runtime_error("Truncated PNG!");
+        uint32_t length = read_u32(data + offset);
+        const unsigned char* type = data + offset + 4;
+        const unsigned char* body = data + offset + 8;
+        if (length > size - offset - 12)
+            throw std::runtime_error("Truncated PNG!");
+        if (memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+            width = (int)read_u32(body);
+            height = (int)read_u32(body + 4);
+            depth = body[8];
+            color = body[9];
+            interlace = body[12];
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            palette.assign(body, body + length);
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), body, body + length);
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        offset += 12 + length;
+    }
+
+    static const int CHANNELS[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    if (width <= 0 || height <= 0 || color < 0 || color > 6 || CHANNELS[color] == 0 || interlace > 1
+        || (depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16) || (color == 3 && depth == 16)
+        || (color != 0 && color != 3 && depth < 8))
+        throw std::runtime_error("Unsupported PNG format!");
+    if (color == 3 && palette.size() < 3)
+        throw std::runtime_error("PNG without a palette!");
+
+    int channels = CHANNELS[color];
+    int pixel_bits = channels * depth;
+    int pixel_bytes = (pixel_bits + 7) / 8;
+
+    // Adam7 passes: start and step in x and y; a plain image is one pass.
+    static const int ADAM7[7][4] = { { 0, 8, 0, 8 }, { 4, 8, 0, 8 }, { 0, 4, 4, 8 }, { 2, 4, 0, 4 },
+        { 0, 2, 2, 4 }, { 1, 2, 0, 2 }, { 0, 1, 1, 2 } };
+    static const int PLAIN[1][4] = { { 0, 1, 0, 1 } };
+    const int(*passes)[4] = interlace ? ADAM7 : PLAIN;
+    int pass_count = interlace ? 7 : 1;
+
+    size_t expected = 0;
+    for (int p = 0; p < pass_count; p++) {
+        int columns = (width - passes[p][0] + passes[p][1] - 1) / passes[p][1];
+        int rows = (height - passes[p][2] + passes[p][3] - 1) / passes[p][3];
+        if (columns > 0 && rows > 0)
+            expected += rows * (((size_t)columns * pixel_bits + 7) / 8 + 1);
+    }
+    std::vector<unsigned char> raw = zlib_inflate(compressed.data(), compressed.size(), expected);
+    if (raw.size() < expected)
+        throw std::runtime_error("Truncated PNG image data!");
+
+    // Grey levels of the palette entries, or of each sample value for bit depths below 8.
+    float levels[256];
+    if (color == 3) {
+        for (int i = 0; i < 256; i++) {
+            size_t entry = 3 * (size_t)i;
+            levels[i] = entry + 2 < palette.size()
+                ? 0.299f * palette[entry] + 0.587f * palette[entry + 1] + 0.114f * palette[entry + 2]
+                : 0.0f;
+        }
+    } else if (depth < 8) {
+        for (int i = 0; i < (1 << depth); i++)
+            levels[i] = 255.0f * i / ((1 << depth) - 1);
+    }
+
+    Buffer2D<float> grey(width, height);
+    size_t pass_offset = 0;
+    for (int p = 0; p < pass_count; p++) {
+        int x0 = passes[p][0], dx = passes[p][1], y0 = passes[p][2], dy = passes[p][3];
+        int columns = (width - x0 + dx - 1) / dx, rows = (height - y0 + dy - 1) / dy;
+        if (columns <= 0 || rows <= 0)
+            continue;
+        size_t row_bytes = ((size_t)columns * pixel_bits + 7) / 8;
+        unsigned char* pass = raw.data() + pass_offset;
+        pass_offset += rows * (row_bytes + 1);
+        unfilter(pass, rows, row_bytes, pixel_bytes);
+
+        ThreadPool::global().parallelFor(0, rows, 16, [&](int begin, int end, int) {
+            for (int r = begin; r < end; r++) {
+                const unsigned char* row = pass + r * (row_bytes + 1) + 1;
+                float* out = grey.row(y0 + r * dy);
+                for (int c = 0; c < columns; c++) {
+                    float value;
+                    if (depth < 8) {
+                        int bit = c * depth;
+                        int sample = (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1);
+                        value = levels[sample];
+                    } else if (color == 3) {
+                        value = levels[row[c]];
+                    } else {
+                        const unsigned char* pixel = row + (size_t)c * pixel_bytes;
+                        float samples[3];
+                        int colors = color == 2 || color == 6 ? 3 : 1;
+                        for (int i = 0; i < colors; i++)
+                            samples[i] = depth == 16 ? ((pixel[2 * i] << 8) | pixel[2 * i + 1]) / 257.0f : pixel[i];
+                        value = colors == 3 ? 0.299f * samples[0] + 0.587f * samples[1] + 0.114f * samples[2]
+                                            : samples[0];
+                    }
+                    out[x0 + c * dx] = value;
+                }
+            }
+        });
+    }
+    if (scale == 1)
+        return grey;
+
+    int out_width = (width + scale - 1) / scale, out_height = (height + scale - 1) / scale;
+    Buffer2D<float> out(out_width, out_height);
+    ThreadPool::global().parallelFor(0, out_height, 16, [&](int begin, int end, int) {
+        for (int y = begin; y < end; y++) {
+            int rows = height - y * scale < scale ? height - y * scale : scale;
+            float* o = out.row(y);
+            for (int x = 0; x < out_width; x++) {
+                int columns = width - x * scale < scale ? width - x * scale : scale;
+                float sum = 0.0f;
+                for (int r = 0; r < rows; r++) {
+                    const float* in = grey.row(y * scale + r) + x * scale;
+                    for (int c = 0; c < columns; c++)
+                        sum += in[c];
+                }
+                o[x] = sum / (rows * columns);
+            }
+        }
+    });
+    return out;
+}
+
+static uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size)
+{
+    struct Table {
+        uint32_t entries[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    };
+    static const Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_u32(std::vector<unsigned char>& out, uint32_t value)
+{
+    out.push_back((unsigned char)(value >> 24));
+    out.push_back((unsigned char)(value >> 16));
+    out.push_back((unsigned char)(value >> 8));
+    out.push_back((unsigned char)value);
+}
+
+static void put_chunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& body)
+{
+    put_u32(out, (uint32_t)body.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), body.begin(), body.end());
+    put_u32(out, crc32(0, out.data() + start, out.size() - start));
+}
+
+void write_png(const std::string& path, const Buffer2D<unsigned char>& image)
+{
+    static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<unsigned char> file(SIGNATURE, SIGNATURE + 8);
+
+    std::vector<unsigned char> header;
+    put_u32(header, (uint32_t)image.width());
+    put_u32(header, (uint32_t)image.height());
+    header.insert(header.end(), { 8, 0, 0, 0, 0 });
+    put_chunk(file, "IHDR", header);
+
+    // Filter byte 0 and the row, in stored blocks of at most 65535 bytes.
+    std::vector<unsigned char> raw;
+    raw.reserve((size_t)(image.width() + 1) * image.height());
+    for (int y = 0; y < image.height(); y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), image.row(y), image.row(y) + image.width());
+    }
+    std::vector<unsigned char> stream = { 0x78, 0x01 };
+    size_t offset = 0;
+    do {
+        size_t length = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+        stream.push_back(offset + length == raw.size() ? 1 : 0);
+        stream.push_back((unsigned char)length);
+        stream.push_back((unsigned char)(length >> 8));
+        stream.push_back((unsigned char)~length);
+        stream.push_back((unsigned char)(~length >> 8));
+        stream.insert(stream.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32(stream, b << 16 | a);
+    put_chunk(file, "IDAT", stream);
+    put_chunk(file, "IEND", std::vector<unsigned char>());
+
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == nullptr)
+        throw std::runtime_error("Can't open " + path + "!");
+    bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+    written = fclose(out) == 0 && written;
+    if (!written)
+        throw std::runtime_error("Can't write " + path + "!");
+}
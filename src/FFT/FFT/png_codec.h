@@ -0,0 +1,16 @@
+#pragma once
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "buffer2d.h"
+
+// Grey levels (0 - 255) of a PNG held in memory, box-averaged down by scale (1, 2, 4 or 8);
+// colour is converted as 0.299 R + 0.587 G + 0.114 B and alpha is ignored. See read_image().
+Buffer2D<float> decode_png(const unsigned char* data, size_t size, int scale);
+
+// 8-bit greyscale PNG with the image in stored (uncompressed) deflate blocks.
+void write_png(const std::string& path, const Buffer2D<unsigned char>& image);
+
+// zlib stream (RFC 1950) to the bytes it holds; expected_size, when known, sizes the output.
+std::vector<unsigned char> zlib_inflate(const unsigned char* data, size_t size, size_t expected_size = 0);
@@ -0,0 +1,397 @@
+#include "pruned.h"
+
+#include <math.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "thread_pool.h"
+
+static const long double PI_L = 3.141592653589793238462643383279502884L;
+
+template<typename Real>
+static std::complex<Real> unit_root(long double angle)
+{
+    return std::complex<Real>((Real)std::cos(angle), (Real)std::sin(angle));
+}
+
+// Operation counts in complex multiply-adds. One pass of a transform costs about one per point
+// and stage; lengths with a large prime factor pay Bluestein's three transforms of twice the size.
+static double transform_cost(int n)
+{
+    if (n <= 1)
+        return 0.0;
+    double cost = n * log2((double)n);
+    return is_smooth(n) ? cost : 6.0 * cost;
+}
+
+struct PruningChoice {
+    FFTPruning method;
+    int factor;
+    double cost;
+};
+
+static void consider(PruningChoice& best, FFTPruning wanted, FFTPruning method, int factor, double cost)
+{
+    if ((wanted == FFTPruning::Auto || wanted == method) && cost < best.cost)
+        best = { method, factor, cost };
+}
+
+static PruningChoice choose_pruning(int n, int inputs, int outputs, FFTPruning wanted)
+{
+    PruningChoice best = { FFTPruning::Full, 1, 1e300 };
+    consider(best, wanted, FFTPruning::Full, 1, n + transform_cost(n));
+    consider(best, wanted, FFTPruning::Goertzel, 1, (double)outputs * inputs);
+    for (int p = 2; p <= n; p++) {
+        if (n % p != 0)
+            continue;
+        int q = n / p;
+        consider(best, wanted, FFTPruning::OutputPruned, p,
+            n + p * transform_cost(q) + (double)outputs * std::min(p, inputs));
+        consider(best, wanted, FFTPruning::InputPruned, p,
+            std::min(outputs, p) * ((double)inputs + transform_cost(q)));
+    }
+    return best;
+}
+
+// Goertzel's recurrence s[t] = x[t] + 2 cos(theta) s[t - 1] - s[t - 2] for up to goertzel_lanes
+// bins at once, which keeps their independent chains in flight together. Leaves s[count - 1] in
+// last and s[count - 2] in previous.
+static const int goertzel_lanes = 4;
+
+template<typename Acc, typename Load>
+static void goertzel_run(const Acc* coefficients, int lanes, int count, Load load, std::complex<Acc>* last,
+    std::complex<Acc>* previous)
+{
+    Acc c[goertzel_lanes] = {}, s1_re[goertzel_lanes] = {}, s1_im[goertzel_lanes] = {};
+    Acc s2_re[goertzel_lanes] = {}, s2_im[goertzel_lanes] = {};
+    for (int b = 0; b < lanes; b++)
+        c[b] = coefficients[b];
+
+    for (int t = 0; t < count; t++) {
+        std::complex<Acc> x = load(t);
+        Acc x_re = x.real(), x_im = x.imag();
+        for (int b = 0; b < goertzel_lanes; b++) {
+            Acc s0_re = x_re + c[b] * s1_re[b] - s2_re[b];
+            Acc s0_im = x_im + c[b] * s1_im[b] - s2_im[b];
+            s2_re[b] = s1_re[b];
+            s2_im[b] = s1_im[b];
+            s1_re[b] = s0_re;
+            s1_im[b] = s0_im;
+        }
+    }
+
+    for (int b = 0; b < lanes; b++) {
+        last[b] = std::complex<Acc>(s1_re[b], s1_im[b]);
+        previous[b] = std::complex<Acc>(s2_re[b], s2_im[b]);
+    }
+}
+
+// sum x[t] e^(i theta t) = e^(i theta (count - 1)) (s[count - 1] - e^(i theta) s[count - 2]).
+template<typename Acc>
+static void goertzel_setup(int n, int k, int count, long double sign, Acc& coefficient, std::complex<Acc>& step,
+    std::complex<Acc>& phase)
+{
+    long double theta = sign * 2.0L * PI_L * k / n;
+    coefficient = (Acc)(2.0L * std::cos(theta));
+    step = unit_root<Acc>(theta);
+    phase = unit_root<Acc>(sign * 2.0L * PI_L * ((long long)k * (count - 1) % n) / n);
+}
+
+template<typename Acc>
+static std::complex<Acc> goertzel_finish(std::complex<Acc> last, std::complex<Acc> previous, std::complex<Acc> step,
+    std::complex<Acc> phase)
+{
+    return phase * (last - step * previous);
+}
+
+template<typename Real>
+BasicFFTPrunedPlan1D<Real>::BasicFFTPrunedPlan1D(int n, FFTDirection direction, int input_count, FFTWindow output,
+    FFTPruning pruning)
+    : length(n), inputs(input_count), outputs(output.count)
+{
+    if (n < 1 || input_count < 1 || input_count > n || output.count < 1 || output.count > n)
+        throw std::runtime_error("Invalid pruned FFT size!");
+
+    int start = (output.start % n + n) % n;
+    bins.resize(outputs);
+    for (int i = 0; i < outputs; i++)
+        bins[i] = (start + i) % n;
+
+    PruningChoice choice = choose_pruning(n, inputs, outputs, pruning);
+    method = choice.method;
+    factor = choice.factor;
+    subLength = n / factor;
+    long double sign = direction == FFTDirection::Inverse ? 1.0L : -1.0L;
+
+    if (method == FFTPruning::Full || method == FFTPruning::OutputPruned) {
+        subPlan.reset(new BasicFFTPlan1D<Real>(subLength, direction, factor));
+        combineTerms = std::min(factor, inputs);
+        combineTwiddles.resize((size_t)outputs * combineTerms);
+        for (int i = 0; i < outputs; i++)
+            for (int r = 0; r < combineTerms; r++)
+                combineTwiddles[(size_t)i * combineTerms + r] =
+                    unit_root<Real>(sign * 2.0L * PI_L * ((long long)r * bins[i] % n) / n);
+    } else if (method == FFTPruning::InputPruned) {
+        std::vector<int> index(factor, -1);
+        for (int i = 0; i < outputs; i++) {
+            int r = bins[i] % factor;
+            if (index[r] < 0) {
+                index[r] = (int)residues.size();
+                residues.push_back(r);
+            }
+        }
+        int count = (int)residues.size();
+        sources.resize(outputs);
+        for (int i = 0; i < outputs; i++)
+            sources[i] = bins[i] / factor * count + index[bins[i] % factor];
+        roots.resize(n);
+        for (int t = 0; t < n; t++)
+            roots[t] = unit_root<Real>(sign * 2.0L * PI_L * t / n);
+        subPlan.reset(new BasicFFTPlan1D<Real>(subLength, direction, count));
+    } else {
+        goertzelCoefficient.resize(outputs);
+        goertzelStep.resize(outputs);
+        goertzelPhase.resize(outputs);
+        for (int i = 0; i < outputs; i++)
+            goertzel_setup(n, bins[i], inputs, sign, goertzelCoefficient[i], goertzelStep[i], goertzelPhase[i]);
+    }
+}
+
+template<typename Real>
+int BasicFFTPrunedPlan1D<Real>::scratchSize() const
+{
+    if (method == FFTPruning::Goertzel)
+        return 0;
+    if (method == FFTPruning::InputPruned)
+        return (int)residues.size() * subLength + subPlan->scratchSize();
+    return length + subPlan->scratchSize();
+}
+
+template<typename Real>
+void BasicFFTPrunedPlan1D<Real>::execute(const ComplexType* in, ComplexType* out, ComplexType* scratch) const
+{
+    if (method == FFTPruning::Goertzel)
+        executeGoertzel(in, out);
+    else if (method == FFTPruning::InputPruned)
+        executeInputPruned(in, out, scratch);
+    else
+        executeOutputPruned(in, out, scratch);
+}
+
+// Y_r = transform of x[r], x[P + r], x[2P + r], ... is element m * P + r of the zero-padded input
+// run through a plan batched P times; X[k] = sum_r W^(r k) Y_r[k mod Q]. Residues past the input
+// are zero and left out of the sum.
+template<typename Real>
+void BasicFFTPrunedPlan1D<Real>::executeOutputPruned(const ComplexType* in, ComplexType* out,
+    ComplexType* scratch) const
+{
+    ComplexType* work = scratch;
+    std::copy(in, in + inputs, work);
+    std::fill(work + inputs, work + length, ComplexType());
+    subPlan->execute(work, scratch + length);
+
+    if (factor == 1) {
+        for (int i = 0; i < outputs; i++)
+            out[i] = work[bins[i]];
+        return;
+    }
+    for (int i = 0; i < outputs; i++) {
+        const ComplexType* y = work + (size_t)(bins[i] % subLength) * factor;
+        const ComplexType* w = combineTwiddles.data() + (size_t)i * combineTerms;
+        Real sum_re = 0, sum_im = 0;
+        for (int r = 0; r < combineTerms; r++) {
+            sum_re += w[r].real() * y[r].real() - w[r].imag() * y[r].imag();
+            sum_im += w[r].real() * y[r].imag() + w[r].imag() * y[r].real();
+        }
+        out[i] = ComplexType(sum_re, sum_im);
+    }
+}
+
+// X[j P + r] = transform of z_r[b] = sum over t = b (mod Q) of x[t] W^(r t), for the residues r
+// of the wanted bins only, as one plan batched over those residues.
+template<typename Real>
+void BasicFFTPrunedPlan1D<Real>::executeInputPruned(const ComplexType* in, ComplexType* out,
+    ComplexType* scratch) const
+{
+    int count = (int)residues.size();
+    ComplexType* z = scratch;
+    std::fill(z, z + (size_t)count * subLength, ComplexType());
+    for (int i = 0; i < count; i++) {
+        int r = residues[i], index = 0, b = 0;
+        for (int t = 0; t < inputs; t++) {
+            ComplexType x = in[t], w = roots[index];
+            ComplexType& target = z[(size_t)b * count + i];
+            target = ComplexType(target.real() + x.real() * w.real() - x.imag() * w.imag(),
+                target.imag() + x.real() * w.imag() + x.imag() * w.real());
+            index += r;
+            if (index >= length)
+                index -= length;
+            if (++b == subLength)
+                b = 0;
+        }
+    }
+    subPlan->execute(z, scratch + (size_t)count * subLength);
+    for (int i = 0; i < outputs; i++)
+        out[i] = z[sources[i]];
+}
+
+template<typename Real>
+void BasicFFTPrunedPlan1D<Real>::executeGoertzel(const ComplexType* in, ComplexType* out) const
+{
+    typedef std::complex<Accumulator> Value;
+    auto load = [&](int t) { return Value((Accumulator)in[t].real(), (Accumulator)in[t].imag()); };
+    for (int g = 0; g < outputs; g += goertzel_lanes) {
+        int lanes = std::min(goertzel_lanes, outputs - g);
+        Value last[goertzel_lanes], previous[goertzel_lanes];
+        goertzel_run(goertzelCoefficient.data() + g, lanes, inputs, load, last, previous);
+        for (int b = 0; b < lanes; b++) {
+            Value x = goertzel_finish(last[b], previous[b], goertzelStep[g + b], goertzelPhase[g + b]);
+            out[g + b] = ComplexType((Real)x.real(), (Real)x.imag());
+        }
+    }
+}
+
+template<typename Real>
+BasicFFTPrunedPlan<Real>::BasicFFTPrunedPlan(int width, int height, FFTDirection direction, int input_width,
+    int input_height, FFTWindow horizontal, FFTWindow vertical)
+    : inputWidth(input_width), inputHeight(input_height), rows(width, direction, input_width, horizontal),
+    columns(height, direction, input_height, vertical), rowSpectra(horizontal.count, input_height)
+{
+    int line = std::max(input_width, input_height);
+    workspaceSize = line + columns.outputCount() + std::max(rows.scratchSize(), columns.scratchSize());
+}
+
+template<typename Real>
+template<typename Load>
+void BasicFFTPrunedPlan<Real>::executeImpl(Load load, Buffer2D<Real>& out_re, Buffer2D<Real>& out_im)
+{
+    int out_width = rows.outputCount(), out_height = columns.outputCount();
+    if (out_re.width() != out_width || out_re.height() != out_height || out_im.width() != out_width
+        || out_im.height() != out_height)
+        throw std::runtime_error("Buffer size does not match the pruned FFT plan!");
+
+    std::lock_guard<std::mutex> lock(executeMutex);
+    ThreadPool& pool = ThreadPool::global();
+    if (workspaces.height() < pool.size())
+        workspaces = Buffer2D<ComplexType>(workspaceSize, pool.size());
+    int line_size = std::max(inputWidth, inputHeight);
+
+    pool.parallelFor(0, inputHeight, 4, [&](int begin, int end, int worker) {
+        ComplexType* line = workspaces.row(worker);
+        ComplexType* scratch = line + line_size + out_height;
+        for (int x = begin; x < end; x++) {
+            load(x, line);
+            rows.execute(line, rowSpectra.row(x), scratch);
+        }
+    });
+
+    pool.parallelFor(0, out_width, 4, [&](int begin, int end, int worker) {
+        ComplexType* line = workspaces.row(worker);
+        ComplexType* result = line + line_size;
+        ComplexType* scratch = result + out_height;
+        for (int y = begin; y < end; y++) {
+            for (int x = 0; x < inputHeight; x++)
+                line[x] = rowSpectra.row(x)[y];
+            columns.execute(line, result, scratch);
+            for (int i = 0; i < out_height; i++) {
+                out_re.row(i)[y] = result[i].real();
+                out_im.row(i)[y] = result[i].imag();
+            }
+        }
+    });
+}
+
+template<typename Real>
+void BasicFFTPrunedPlan<Real>::execute(const Buffer2D<unsigned char>& in, Buffer2D<Real>& out_re,
+    Buffer2D<Real>& out_im)
+{
+    if (in.width() != inputWidth || in.height() != inputHeight)
+        throw std::runtime_error("Buffer size does not match the pruned FFT plan!");
+
+    executeImpl([&](int x, ComplexType* line) {
+        const unsigned char* row = in.row(x);
+        for (int y = 0; y < inputWidth; y++)
+            line[y] = ComplexType((Real)row[y], Real(0));
+    }, out_re, out_im);
+}
+
+template<typename Real>
+void BasicFFTPrunedPlan<Real>::execute(const Buffer2D<Real>& re, const Buffer2D<Real>& im, Buffer2D<Real>& out_re,
+    Buffer2D<Real>& out_im)
+{
+    if (re.width() != inputWidth || re.height() != inputHeight || im.width() != inputWidth
+        || im.height() != inputHeight)
+        throw std::runtime_error("Buffer size does not match the pruned FFT plan!");
+
+    executeImpl([&](int x, ComplexType* line) {
+        const Real* re_row = re.row(x);
+        const Real* im_row = im.row(x);
+        for (int y = 0; y < inputWidth; y++)
+            line[y] = ComplexType(re_row[y], im_row[y]);
+    }, out_re, out_im);
+}
+
+template<typename Real>
+void fft_2d_bins(const Buffer2D<unsigned char>& image, const int* rows, const int* columns, int count,
+    std::complex<Real>* out)
+{
+    typedef typename BasicFFTPrunedPlan1D<Real>::Accumulator Acc;
+    typedef std::complex<Acc> Value;
+    int width = image.width(), height = image.height();
+    if (width < 1 || height < 1)
+        throw std::runtime_error("Invalid pruned FFT size!");
+
+    std::vector<int> frequencies;
+    for (int i = 0; i < count; i++)
+        frequencies.push_back((columns[i] % width + width) % width);
+    std::sort(frequencies.begin(), frequencies.end());
+    frequencies.erase(std::unique(frequencies.begin(), frequencies.end()), frequencies.end());
+    int distinct = (int)frequencies.size();
+
+    std::vector<Acc> coefficients(distinct);
+    std::vector<Value> steps(distinct), phases(distinct);
+    for (int f = 0; f < distinct; f++)
+        goertzel_setup(width, frequencies[f], width, -1.0L, coefficients[f], steps[f], phases[f]);
+
+    // Row x, column frequency f: sum_y image[x][y] W_width^(f y).
+    std::vector<Value> sums((size_t)height * distinct);
+    ThreadPool::global().parallelFor(0, height, 4, [&](int begin, int end, int) {
+        for (int x = begin; x < end; x++) {
+            const unsigned char* row = image.row(x);
+            auto load = [&](int y) { return Value((Acc)row[y], Acc(0)); };
+            for (int g = 0; g < distinct; g += goertzel_lanes) {
+                int lanes = std::min(goertzel_lanes, distinct - g);
+                Value last[goertzel_lanes], previous[goertzel_lanes];
+                goertzel_run(coefficients.data() + g, lanes, width, load, last, previous);
+                Value* target = sums.data() + (size_t)x * distinct + g;
+                for (int b = 0; b < lanes; b++)
+                    target[b] = goertzel_finish(last[b], previous[b], steps[g + b], phases[g + b]);
+            }
+        }
+    });
+
+    for (int i = 0; i < count; i++) {
+        int f = (int)(std::lower_bound(frequencies.begin(), frequencies.end(), (columns[i] % width + width) % width)
+            - frequencies.begin());
+        Acc coefficient;
+        Value step, phase, last, previous;
+        goertzel_setup(height, (rows[i] % height + height) % height, height, -1.0L, coefficient, step, phase);
+        goertzel_run(&coefficient, 1, height, [&](int x) { return sums[(size_t)x * distinct + f]; }, &last, &previous);
+        Value x = goertzel_finish(last, previous, step, phase);
+        out[i] = std::complex<Real>((Real)x.real(), (Real)x.imag());
+    }
+}
+
+template class BasicFFTPrunedPlan1D<float>;
+template class BasicFFTPrunedPlan1D<double>;
+template class BasicFFTPrunedPlan1D<long double>;
+
+template class BasicFFTPrunedPlan<float>;
+template class BasicFFTPrunedPlan<double>;
+template class BasicFFTPrunedPlan<long double>;
+
+template void fft_2d_bins<float>(const Buffer2D<unsigned char>& image, const int* rows, const int* columns,
+    int count, std::complex<float>* out);
+template void fft_2d_bins<double>(const Buffer2D<unsigned char>& image, const int* rows, const int* columns,
+    int count, std::complex<double>* out);
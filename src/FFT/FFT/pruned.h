@@ -0,0 +1,131 @@
+#pragma once
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "buffer2d.h"
+#include "fft.h"
+
+// Bins start, start + 1, ..., start + count - 1 of a length-n axis, taken modulo n, so a negative
+// start selects a window centred on DC.
+struct FFTWindow {
+    int start;
+    int count;
+};
+
+// How a pruned transform gets its outputs, all from one length-n transform split as n = P * Q:
+//   Full          the whole transform, then the window is picked out;
+//   OutputPruned  P transforms of length Q over the decimated input (one batched plan), then only
+//                 the wanted bins are combined, P terms each;
+//   InputPruned   only the residues (mod P) of the wanted bins are transformed, each a length-Q
+//                 transform of the input folded and twiddled, reading only the nonzero inputs;
+//   Goertzel      one second-order recurrence per bin over the nonzero inputs, four bins at a time.
+// Auto picks the cheapest by operation count, with the best P for each.
+enum class FFTPruning {
+    Auto,
+    Full,
+    OutputPruned,
+    InputPruned,
+    Goertzel
+};
+
+// Length-n transform of a sequence that is zero from input_count on, of which only the bins of
+// output are wanted: execute() reads input_count values and writes output.count, in window order.
+// Same direction and scaling as BasicFFTPlan1D.
+template<typename Real>
+class BasicFFTPrunedPlan1D
+{
+public:
+    typedef std::complex<Real> ComplexType;
+    // Goertzel's recurrence loses about n^2 ulps near DC, so float accumulates in double.
+    typedef typename std::conditional<(sizeof(Real) < sizeof(double)), double, Real>::type Accumulator;
+
+    BasicFFTPrunedPlan1D(int n, FFTDirection direction, int input_count, FFTWindow output,
+        FFTPruning pruning = FFTPruning::Auto);
+
+    int size() const { return length; }
+    int inputCount() const { return inputs; }
+    int outputCount() const { return outputs; }
+    FFTPruning pruning() const { return method; }
+    int scratchSize() const;
+    void execute(const ComplexType* in, ComplexType* out, ComplexType* scratch) const;
+
+private:
+    void executeOutputPruned(const ComplexType* in, ComplexType* out, ComplexType* scratch) const;
+    void executeInputPruned(const ComplexType* in, ComplexType* out, ComplexType* scratch) const;
+    void executeGoertzel(const ComplexType* in, ComplexType* out) const;
+
+private:
+    int length;
+    int inputs;
+    int outputs;
+    FFTPruning method;
+    int factor;         // P
+    int subLength;      // Q
+    std::vector<int> bins;
+    std::unique_ptr<BasicFFTPlan1D<Real>> subPlan;
+
+    // OutputPruned (and Full, P = 1): W^(r * k) for every bin k and residue r < min(P, inputs).
+    std::vector<ComplexType> combineTwiddles;
+    int combineTerms = 0;
+
+    // InputPruned: the residues transformed, W^t for all t < n, and where each bin lands.
+    std::vector<int> residues;
+    std::vector<ComplexType> roots;
+    std::vector<int> sources;
+
+    // Goertzel: 2 cos(theta), e^(i theta) and e^(i theta (inputs - 1)) per bin.
+    std::vector<Accumulator> goertzelCoefficient;
+    std::vector<std::complex<Accumulator>> goertzelStep;
+    std::vector<std::complex<Accumulator>> goertzelPhase;
+};
+
+typedef BasicFFTPrunedPlan1D<float> FFTPrunedPlan1Df;
+typedef BasicFFTPrunedPlan1D<double> FFTPrunedPlan1D;
+
+// Window of the 2D transform of a width x height image that is zero outside its top-left
+// input_width x input_height corner (a zero-padded image): out[i][j] = X[vertical bin i][horizontal
+// bin j]. Rows outside the input are never transformed, each input row keeps only the horizontal
+// window, and only those columns go through the column pass, each a pruned 1D transform. Rows
+// and columns are spread over ThreadPool::global().
+template<typename Real>
+class BasicFFTPrunedPlan
+{
+public:
+    typedef std::complex<Real> ComplexType;
+
+    BasicFFTPrunedPlan(int width, int height, FFTDirection direction, int input_width, int input_height,
+        FFTWindow horizontal, FFTWindow vertical);
+
+    void execute(const Buffer2D<unsigned char>& in, Buffer2D<Real>& out_re, Buffer2D<Real>& out_im);
+    void execute(const Buffer2D<Real>& re, const Buffer2D<Real>& im, Buffer2D<Real>& out_re, Buffer2D<Real>& out_im);
+
+    const BasicFFTPrunedPlan1D<Real>& rowPlan() const { return rows; }
+    const BasicFFTPrunedPlan1D<Real>& columnPlan() const { return columns; }
+
+private:
+    template<typename Load>
+    void executeImpl(Load load, Buffer2D<Real>& out_re, Buffer2D<Real>& out_im);
+
+private:
+    int inputWidth;
+    int inputHeight;
+    BasicFFTPrunedPlan1D<Real> rows;
+    BasicFFTPrunedPlan1D<Real> columns;
+    int workspaceSize;
+    Buffer2D<ComplexType> workspaces;
+    Buffer2D<ComplexType> rowSpectra;
+    std::mutex executeMutex;
+};
+
+typedef BasicFFTPrunedPlan<float> FFTPrunedPlanf;
+typedef BasicFFTPrunedPlan<double> FFTPrunedPlan;
+
+// A few scattered bins X[rows[i]][columns[i]] of the forward 2D DFT of an 8-bit image, by
+// Goertzel's recurrence: one pass over the image for each distinct column frequency (rows
+// spread over ThreadPool::global()), then one pass down a column of row sums per bin.
+template<typename Real>
+void fft_2d_bins(const Buffer2D<unsigned char>& image, const int* rows, const int* columns, int count,
+    std::complex<Real>* out);
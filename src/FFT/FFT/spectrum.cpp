@@ -0,0 +1,169 @@
+#include "spectrum.h"
+
+#include <math.h>
+#include <stdexcept>
+
+#include "fft_kernels.h"
+#include "thread_pool.h"
+#include "workspace.h"
+
+#ifdef FFT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+static inline unsigned char spectrum_level(float re, float im, float scale)
+{
+    float level = log1pf(sqrtf(re * re + im * im)) * scale + 0.5f;
+    return level >= 255.0f ? 255 : (unsigned char)level;
+}
+
+// out[i] = level of (re[i], im[i]) for count bins.
+template<typename Real>
+static void spectrum_run_scalar(const Real* re, const Real* im, unsigned char* out, int count, float scale)
+{
+    for (int i = 0; i < count; i++)
+        out[i] = spectrum_level((float)re[i], (float)im[i], scale);
+}
+
+#ifdef FFT_ARCH_X86
+// ln(x) for x >= 1: x = 2^e * m with m in [sqrt(1/2), sqrt(2)), ln(m) by the Cephes logf polynomial.
+FFT_TARGET("avx2,fma") static inline __m256 log_avx2(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+        _mm256_castps_si256(one)));
+
+    __m256 large = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), large);
+    e = _mm256_add_ps(e, _mm256_and_ps(large, one));
+
+    __m256 f = _mm256_sub_ps(m, one);
+    __m256 z = _mm256_mul_ps(f, f);
+    __m256 y = _mm256_set1_ps(7.0376836292e-2f);
+    y = _mm256_fmadd_ps(y, f, _mm256_set1_ps(-1.1514610310e-1f));
+    y = _mm256_fmadd_ps(y, f, _mm256_set1_ps(1.1676998740e-1f));
+    y = _mm256_fmadd_ps(y, f, _mm256_set1_ps(-1.2420140846e-1f));
+    y = _mm256_fmadd_ps(y, f, _mm256_set1_ps(1.4249322787e-1f));
+    y = _mm256_fmadd_ps(y, f, _mm256_set1_ps(-1.6668057665e-1f));
+    y = _mm256_fmadd_ps(y, f, _mm256_set1_ps(2.0000714765e-1f));
+    y = _mm256_fmadd_ps(y, f, _mm256_set1_ps(-2.4999993993e-1f));
+    y = _mm256_fmadd_ps(y, f, _mm256_set1_ps(3.3333331174e-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, f), z);
+    y = _mm256_fmadd_ps(z, _mm256_set1_ps(-0.5f), y);
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(0.69314718056f), _mm256_add_ps(f, y));
+}
+
+FFT_TARGET("avx2,fma") static inline void store_levels_avx2(__m256 re, __m256 im, __m256 scale, unsigned char* out)
+{
+    __m256 magnitude = _mm256_sqrt_ps(_mm256_fmadd_ps(re, re, _mm256_mul_ps(im, im)));
+    __m256 level = _mm256_fmadd_ps(log_avx2(_mm256_add_ps(magnitude, _mm256_set1_ps(1.0f))), scale,
+        _mm256_set1_ps(0.5f));
+    __m256i levels = _mm256_cvttps_epi32(_mm256_min_ps(level, _mm256_set1_ps(255.0f)));
+    __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(levels), _mm256_extracti128_si256(levels, 1));
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(words, words));
+}
+
+FFT_TARGET("avx2,fma") static void spectrum_run_avx2(const float* re, const float* im, unsigned char* out, int count,
+    float scale)
+{
+    const __m256 factor = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        store_levels_avx2(_mm256_loadu_ps(re + i), _mm256_loadu_ps(im + i), factor, out + i);
+    spectrum_run_scalar(re + i, im + i, out + i, count - i, scale);
+}
+
+FFT_TARGET("avx2,fma") static void spectrum_run_avx2(const double* re, const double* im, unsigned char* out, int count,
+    float scale)
+{
+    const __m256 factor = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 r = _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(re + i + 4)),
+            _mm256_cvtpd_ps(_mm256_loadu_pd(re + i)));
+        __m256 m = _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(im + i + 4)),
+            _mm256_cvtpd_ps(_mm256_loadu_pd(im + i)));
+        store_levels_avx2(r, m, factor, out + i);
+    }
+    spectrum_run_scalar(re + i, im + i, out + i, count - i, scale);
+}
+#endif
+
+template<typename Real>
+static void spectrum_run(const Real* re, const Real* im, unsigned char* out, int count, float scale)
+{
+#ifdef FFT_ARCH_X86
+    if (cpu_features().avx2) {
+        spectrum_run_avx2(re, im, out, count, scale);
+        return;
+    }
+#endif
+    spectrum_run_scalar(re, im, out, count, scale);
+}
+
+template<typename Real>
+static void spectrum_image(const Buffer2D<Real>& re, const Buffer2D<Real>& im, Buffer2D<unsigned char>& out,
+    double max_magnitude)
+{
+    int width = out.width(), height = out.height(), half = width / 2 + 1;
+    bool full = re.width() == width;
+    if ((!full && re.width() != half) || re.height() != height || im.width() != re.width() || im.height() != height)
+        throw std::runtime_error("Spectrum size does not match the image!");
+    if (width == 0 || height == 0)
+        return;
+
+    if (max_magnitude <= 0.0)
+        max_magnitude = sqrt((double)re.row(0)[0] * re.row(0)[0] + (double)im.row(0)[0] * im.row(0)[0]);
+    float scale = max_magnitude > 0.0 ? (float)(255.0 / log1p(max_magnitude)) : 0.0f;
+
+    // Output row r shows source row (r + h) % height, output column c source column (c + w) % width:
+    // two contiguous runs per row.
+    int h = height - height / 2, w = width - width / 2;
+    ThreadPool& pool = ThreadPool::global();
+
+    if (full) {
+        pool.parallelFor(0, height, 16, [&](int begin, int end, int) {
+            for (int r = begin; r < end; r++) {
+                int x = (r + h) % height;
+                unsigned char* row = out.row(r);
+                spectrum_run(re.row(x) + w, im.row(x) + w, row, width - w, scale);
+                spectrum_run(re.row(x), im.row(x), row + (width - w), w, scale);
+            }
+        });
+        return;
+    }
+
+    // Half spectrum: source column y <= width / 2 is stored, the others are bin width - y of the
+    // mirrored row. The bins needed from both rows go through the worker's line and are scattered.
+    WorkspaceScope scope(thread_workspace());
+    Buffer2D<unsigned char> lines = thread_workspace().buffer<unsigned char>(2 * half, pool.size());
+    pool.parallelFor(0, height, 16, [&](int begin, int end, int worker) {
+        unsigned char* stored = lines.row(worker);
+        unsigned char* mirrored = stored + half;
+        for (int r = begin; r < end; r++) {
+            int x = (r + h) % height, mirror = (height - x) % height;
+            spectrum_run(re.row(x), im.row(x), stored, half, scale);
+            spectrum_run(re.row(mirror) + 1, im.row(mirror) + 1, mirrored + 1, width - half, scale);
+
+            unsigned char* row = out.row(r);
+            for (int c = 0; c < width; c++) {
+                int y = (c + w) % width;
+                row[c] = y < half ? stored[y] : mirrored[width - y];
+            }
+        }
+    });
+}
+
+void fft_spectrum_image(const Buffer2D<float>& re, const Buffer2D<float>& im, Buffer2D<unsigned char>& out,
+    double max_magnitude)
+{
+    spectrum_image(re, im, out, max_magnitude);
+}
+
+void fft_spectrum_image(const Buffer2D<double>& re, const Buffer2D<double>& im, Buffer2D<unsigned char>& out,
+    double max_magnitude)
+{
+    spectrum_image(re, im, out, max_magnitude);
+}
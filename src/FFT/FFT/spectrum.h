@@ -0,0 +1,15 @@
+#pragma once
+#include "buffer2d.h"
+
+// 8-bit picture of a spectrum with the zero frequency in the middle:
+//   out[r][c] = 255 * log(1 + |X[r'][c']|) / log(1 + max_magnitude),
+// where (r', c') is (r, c) moved by the fftshift, done as an index remap rather than by
+// modulating the input with (-1)^(x + y), so it is exact for odd sizes too. re/im are either the
+// full width x height spectrum or the width / 2 + 1 columns of an r2c plan, the missing half
+// following from |X[x][y]| = |X[-x][-y]|. max_magnitude <= 0 uses |X[0][0]|, which bounds every
+// bin of a non-negative image. Magnitude, log, scaling and the conversion to 8 bits run in one
+// pass over each row, with an AVX2 log when the CPU has it; rows are spread over ThreadPool::global().
+void fft_spectrum_image(const Buffer2D<float>& re, const Buffer2D<float>& im, Buffer2D<unsigned char>& out,
+    double max_magnitude = 0.0);
+void fft_spectrum_image(const Buffer2D<double>& re, const Buffer2D<double>& im, Buffer2D<unsigned char>& out,
+    double max_magnitude = 0.0);
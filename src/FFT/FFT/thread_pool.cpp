@@ -0,0 +1,185 @@
+#include "thread_pool.h"
+
+static thread_local bool insideWorker = false;
+static thread_local int workerLimit = 0;
+
+ThreadPool::Limit::Limit(int threads)
+    : previous(workerLimit)
+{
+    workerLimit = threads;
+}
+
+ThreadPool::Limit::~Limit()
+{
+    workerLimit = previous;
+}
+
+ThreadPool::ThreadPool(int threadCount)
+    : threadCount(threadCount), pending(0), failed(false)
+{
+    if (this->threadCount <= 0)
+        this->threadCount = (int)std::thread::hardware_concurrency();
+    if (this->threadCount <= 0)
+        this->threadCount = 1;
+
+    for (int i = 0; i < this->threadCount; i++)
+        queues.emplace_back(new WorkerQueue());
+    for (int i = 1; i < this->threadCount; i++)
+        threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const Body& body)
+{
+    if (end <= begin)
+        return;
+    if (grain < 1)
+        grain = 1;
+    int workers = workerLimit > 0 && workerLimit < threadCount ? workerLimit : threadCount;
+    if (workers == 1 || insideWorker || end - begin <= grain) {
+        body(begin, end, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+
+    int count = end - begin;
+    int chunks = (count + grain - 1) / grain;
+    if (chunks > workers * 8)
+        chunks = workers * 8;
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        for (int i = 0; i < chunks; i++) {
+            Range range = { begin + (int)((long long)count * i / chunks),
+                begin + (int)((long long)count * (i + 1) / chunks) };
+            std::lock_guard<std::mutex> queueLock(queues[i % workers]->mutex);
+            queues[i % workers]->ranges.push_back(range);
+        }
+        pending.store(chunks);
+        failed.store(false);
+        error = nullptr;
+        jobWorkers = workers;
+        currentBody = &body;
+        generation++;
+    }
+    wake.notify_all();
+
+    insideWorker = true;
+    runTasks(0, body);
+    insideWorker = false;
+
+    std::unique_lock<std::mutex> lock(stateMutex);
+    done.wait(lock, [this] { return pending.load() == 0 && active == 0; });
+    currentBody = nullptr;
+    if (error) {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        lock.unlock();
+        std::rethrow_exception(thrown);
+    }
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+    insideWorker = true;
+    unsigned long long seen = 0;
+    std::unique_lock<std::mutex> lock(stateMutex);
+
+    while (true) {
+        wake.wait(lock, [&] { return stopping || (currentBody != nullptr && generation != seen); });
+        if (stopping)
+            return;
+
+        seen = generation;
+        if (worker >= jobWorkers)
+            continue;
+        const Body* body = currentBody;
+        active++;
+        lock.unlock();
+
+        runTasks(worker, *body);
+
+        lock.lock();
+        active--;
+        if (active == 0 && pending.load() == 0)
+            done.notify_all();
+    }
+}
+
+void ThreadPool::runTasks(int worker, const Body& body)
+{
+    Range range;
+    while (popRange(worker, range)) {
+        // After a failure the remaining chunks are only drained, so the job still completes.
+        if (!failed.load()) {
+            try {
+                body(range.begin, range.end, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                if (!error)
+                    error = std::current_exception();
+                failed.store(true);
+            }
+        }
+        if (pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            done.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::popRange(int worker, Range& range)
+{
+    {
+        WorkerQueue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.ranges.empty()) {
+            range = own.ranges.back();
+            own.ranges.pop_back();
+            return true;
+        }
+    }
+
+    for (int i = 1; i < threadCount; i++) {
+        WorkerQueue& victim = *queues[(worker + i) % threadCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.ranges.empty()) {
+            range = victim.ranges.front();
+            victim.ranges.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static std::mutex globalMutex;
+static std::unique_ptr<ThreadPool> globalPool;
+
+ThreadPool& ThreadPool::global()
+{
+    std::lock_guard<std::mutex> lock(globalMutex);
+    if (!globalPool)
+        globalPool.reset(new ThreadPool());
+    return *globalPool;
+}
+
+void ThreadPool::setGlobalThreadCount(int threadCount)
+{
+    std::lock_guard<std::mutex> lock(globalMutex);
+    if (globalPool && globalPool->size() == threadCount)
+        return;
+    globalPool.reset();
+    globalPool.reset(new ThreadPool(threadCount));
+}
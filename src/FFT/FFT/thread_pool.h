@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool for data-parallel loops. parallelFor() splits [begin, end) into chunks that
+// are dealt round-robin to per-worker deques; a worker pops its own chunks from the back and
+// steals from the front of the others once it runs dry. The calling thread joins in as worker 0.
+// If body throws, the chunks not yet started are skipped and the first exception is rethrown
+// from parallelFor() once every worker is done with the job.
+class ThreadPool
+{
+public:
+    typedef std::function<void(int begin, int end, int worker)> Body;
+
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    int size() const { return threadCount; }
+    void parallelFor(int begin, int end, int grain, const Body& body);
+
+    // Shared pool used by the FFT entry points. Resize it only while no transform is running.
+    static ThreadPool& global();
+    static void setGlobalThreadCount(int threadCount);
+
+    // While one lives, parallelFor() calls made from this thread use at most threads workers
+    // (0: no limit) of whichever pool they run on; the others stay asleep. Limits nest.
+    class Limit
+    {
+    public:
+        explicit Limit(int threads);
+        ~Limit();
+
+    private:
+        int previous;
+    };
+
+private:
+    struct Range {
+        int begin, end;
+    };
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(int worker);
+    void runTasks(int worker, const Body& body);
+    bool popRange(int worker, Range& range);
+
+private:
+    int threadCount;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    std::mutex jobMutex;
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const Body* currentBody = nullptr;
+    unsigned long long generation = 0;
+    int active = 0;
+    int jobWorkers = 0;
+    bool stopping = false;
+    std::atomic<int> pending;
+    std::atomic<bool> failed;
+    std::exception_ptr error;
+};
@@ -0,0 +1,259 @@
+#include "transpose.h"
+
+#include <stdexcept>
+
+#include "fft_kernels.h"
+#include "thread_pool.h"
+
+#ifdef FFT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+// 32 x 32 tiles of up to 8-byte elements, 16 x 16 of the 16-byte ones.
+template<typename T>
+struct TileTraits {
+    static const int size = sizeof(T) <= 8 ? 32 : 16;
+};
+
+// dst[c][r] = src[r][c] for a rows x cols tile; strides are in elements.
+template<typename T>
+static void transpose_tile_scalar(const T* src, size_t src_stride, T* dst, size_t dst_stride, int rows, int cols)
+{
+    for (int r = 0; r < rows; r++)
+        for (int c = 0; c < cols; c++)
+            dst[c * dst_stride + r] = src[r * src_stride + c];
+}
+
+#ifdef FFT_ARCH_X86
+FFT_TARGET("sse4.2") static void transpose_tile_sse(const float* src, size_t src_stride, float* dst, size_t dst_stride,
+    int rows, int cols)
+{
+    int r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* s = src + r * src_stride;
+        int c = 0;
+        for (; c + 4 <= cols; c += 4) {
+            __m128 r0 = _mm_loadu_ps(s + c);
+            __m128 r1 = _mm_loadu_ps(s + src_stride + c);
+            __m128 r2 = _mm_loadu_ps(s + 2 * src_stride + c);
+            __m128 r3 = _mm_loadu_ps(s + 3 * src_stride + c);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            float* d = dst + c * dst_stride + r;
+            _mm_storeu_ps(d, r0);
+            _mm_storeu_ps(d + dst_stride, r1);
+            _mm_storeu_ps(d + 2 * dst_stride, r2);
+            _mm_storeu_ps(d + 3 * dst_stride, r3);
+        }
+        for (; c < cols; c++)
+            for (int k = 0; k < 4; k++)
+                dst[c * dst_stride + r + k] = s[k * src_stride + c];
+    }
+    transpose_tile_scalar(src + r * src_stride, src_stride, dst + r, dst_stride, rows - r, cols);
+}
+
+FFT_TARGET("avx2") static void transpose_tile_avx(const double* src, size_t src_stride, double* dst, size_t dst_stride,
+    int rows, int cols)
+{
+    int r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const double* s = src + r * src_stride;
+        int c = 0;
+        for (; c + 4 <= cols; c += 4) {
+            __m256d r0 = _mm256_loadu_pd(s + c);
+            __m256d r1 = _mm256_loadu_pd(s + src_stride + c);
+            __m256d r2 = _mm256_loadu_pd(s + 2 * src_stride + c);
+            __m256d r3 = _mm256_loadu_pd(s + 3 * src_stride + c);
+
+            __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+            __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+            __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+            __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+            double* d = dst + c * dst_stride + r;
+            _mm256_storeu_pd(d, _mm256_permute2f128_pd(t0, t2, 0x20));
+            _mm256_storeu_pd(d + dst_stride, _mm256_permute2f128_pd(t1, t3, 0x20));
+            _mm256_storeu_pd(d + 2 * dst_stride, _mm256_permute2f128_pd(t0, t2, 0x31));
+            _mm256_storeu_pd(d + 3 * dst_stride, _mm256_permute2f128_pd(t1, t3, 0x31));
+        }
+        for (; c < cols; c++)
+            for (int k = 0; k < 4; k++)
+                dst[c * dst_stride + r + k] = s[k * src_stride + c];
+    }
+    transpose_tile_scalar(src + r * src_stride, src_stride, dst + r, dst_stride, rows - r, cols);
+}
+
+FFT_TARGET("avx2") static void transpose_tile_avx(const Complex* src, size_t src_stride, Complex* dst, size_t dst_stride,
+    int rows, int cols)
+{
+    int r = 0;
+    for (; r + 2 <= rows; r += 2) {
+        const double* s0 = (const double*)(src + r * src_stride);
+        const double* s1 = (const double*)(src + (r + 1) * src_stride);
+        int c = 0;
+        for (; c + 2 <= cols; c += 2) {
+            __m256d r0 = _mm256_loadu_pd(s0 + 2 * c);
+            __m256d r1 = _mm256_loadu_pd(s1 + 2 * c);
+            _mm256_storeu_pd((double*)(dst + c * dst_stride + r), _mm256_permute2f128_pd(r0, r1, 0x20));
+            _mm256_storeu_pd((double*)(dst + (c + 1) * dst_stride + r), _mm256_permute2f128_pd(r0, r1, 0x31));
+        }
+        for (; c < cols; c++) {
+            dst[c * dst_stride + r] = src[r * src_stride + c];
+            dst[c * dst_stride + r + 1] = src[(r + 1) * src_stride + c];
+        }
+    }
+    transpose_tile_scalar(src + r * src_stride, src_stride, dst + r, dst_stride, rows - r, cols);
+}
+#endif
+
+template<typename T>
+static void transpose_tile(const T* src, size_t src_stride, T* dst, size_t dst_stride, int rows, int cols)
+{
+    transpose_tile_scalar(src, src_stride, dst, dst_stride, rows, cols);
+}
+
+static void transpose_tile(const float* src, size_t src_stride, float* dst, size_t dst_stride, int rows, int cols)
+{
+#ifdef FFT_ARCH_X86
+    if (cpu_features().sse42) {
+        transpose_tile_sse(src, src_stride, dst, dst_stride, rows, cols);
+        return;
+    }
+#endif
+    transpose_tile_scalar(src, src_stride, dst, dst_stride, rows, cols);
+}
+
+static void transpose_tile(const double* src, size_t src_stride, double* dst, size_t dst_stride, int rows, int cols)
+{
+#ifdef FFT_ARCH_X86
+    if (cpu_features().avx2) {
+        transpose_tile_avx(src, src_stride, dst, dst_stride, rows, cols);
+        return;
+    }
+#endif
+    transpose_tile_scalar(src, src_stride, dst, dst_stride, rows, cols);
+}
+
+// A complex float moves as one 8-byte element, exactly like a double.
+static void transpose_tile(const ComplexF* src, size_t src_stride, ComplexF* dst, size_t dst_stride, int rows,
+    int cols)
+{
+    transpose_tile((const double*)src, src_stride, (double*)dst, dst_stride, rows, cols);
+}
+
+static void transpose_tile(const Complex* src, size_t src_stride, Complex* dst, size_t dst_stride, int rows, int cols)
+{
+#ifdef FFT_ARCH_X86
+    if (cpu_features().avx2) {
+        transpose_tile_avx(src, src_stride, dst, dst_stride, rows, cols);
+        return;
+    }
+#endif
+    transpose_tile_scalar(src, src_stride, dst, dst_stride, rows, cols);
+}
+
+template<typename T>
+static void transpose_blocked(const Buffer2D<T>& in, Buffer2D<T>& out)
+{
+    if (out.width() != in.height() || out.height() != in.width())
+        throw std::runtime_error("Transpose output size does not match!");
+
+    const int tile = TileTraits<T>::size;
+    int width = in.width(), height = in.height();
+    int tile_rows = (height + tile - 1) / tile;
+
+    ThreadPool::global().parallelFor(0, tile_rows, 1, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            int r = i * tile;
+            int rows = height - r < tile ? height - r : tile;
+            for (int c = 0; c < width; c += tile) {
+                int cols = width - c < tile ? width - c : tile;
+                transpose_tile(in.row(r) + c, in.stride(), out.row(c) + r, out.stride(), rows, cols);
+            }
+        }
+    });
+}
+
+template<typename T>
+static void transpose_square_in_place(Buffer2D<T>& buffer)
+{
+    if (buffer.width() != buffer.height())
+        throw std::runtime_error("In-place transpose needs a square buffer!");
+
+    const int tile = TileTraits<T>::size;
+    int n = buffer.width();
+    int tiles = (n + tile - 1) / tile;
+    size_t stride = buffer.stride();
+
+    ThreadPool::global().parallelFor(0, tiles, 1, [&](int begin, int end, int) {
+        T saved[tile * tile];
+        for (int i = begin; i < end; i++) {
+            int r = i * tile;
+            int rows = n - r < tile ? n - r : tile;
+            for (int j = i; j < tiles; j++) {
+                int c = j * tile;
+                int cols = n - c < tile ? n - c : tile;
+                T* a = buffer.row(r) + c;
+                T* b = buffer.row(c) + r;
+
+                // saved = A^T (cols x rows); A = B^T; B = saved. On the diagonal A and B coincide.
+                transpose_tile(a, stride, saved, tile, rows, cols);
+                if (i != j)
+                    transpose_tile(b, stride, a, stride, cols, rows);
+                for (int k = 0; k < cols; k++)
+                    for (int l = 0; l < rows; l++)
+                        b[k * stride + l] = saved[k * tile + l];
+            }
+        }
+    });
+}
+
+void transpose(const Buffer2D<float>& in, Buffer2D<float>& out)
+{
+    transpose_blocked(in, out);
+}
+
+void transpose(const Buffer2D<double>& in, Buffer2D<double>& out)
+{
+    transpose_blocked(in, out);
+}
+
+void transpose(const Buffer2D<long double>& in, Buffer2D<long double>& out)
+{
+    transpose_blocked(in, out);
+}
+
+void transpose(const Buffer2D<ComplexF>& in, Buffer2D<ComplexF>& out)
+{
+    transpose_blocked(in, out);
+}
+
+void transpose(const Buffer2D<Complex>& in, Buffer2D<Complex>& out)
+{
+    transpose_blocked(in, out);
+}
+
+void transpose_in_place(Buffer2D<float>& buffer)
+{
+    transpose_square_in_place(buffer);
+}
+
+void transpose_in_place(Buffer2D<double>& buffer)
+{
+    transpose_square_in_place(buffer);
+}
+
+void transpose_in_place(Buffer2D<long double>& buffer)
+{
+    transpose_square_in_place(buffer);
+}
+
+void transpose_in_place(Buffer2D<ComplexF>& buffer)
+{
+    transpose_square_in_place(buffer);
+}
+
+void transpose_in_place(Buffer2D<Complex>& buffer)
+{
+    transpose_square_in_place(buffer);
+}
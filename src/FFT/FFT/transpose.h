@@ -0,0 +1,20 @@
+#pragma once
+#include "buffer2d.h"
+#include "fft.h"
+
+// Cache-blocked transposes spread over ThreadPool::global(). Tiles are small enough for the
+// source and destination tile to stay in L1 and are moved with 4x4 (double) or 2x2 (complex)
+// AVX register transposes when the CPU has them (4x4 SSE for float). out must be
+// in.height() x in.width().
+void transpose(const Buffer2D<float>& in, Buffer2D<float>& out);
+void transpose(const Buffer2D<double>& in, Buffer2D<double>& out);
+void transpose(const Buffer2D<long double>& in, Buffer2D<long double>& out);
+void transpose(const Buffer2D<ComplexF>& in, Buffer2D<ComplexF>& out);
+void transpose(const Buffer2D<Complex>& in, Buffer2D<Complex>& out);
+
+// Square buffers only: mirrored tile pairs are swapped through a stack tile.
+void transpose_in_place(Buffer2D<float>& buffer);
+void transpose_in_place(Buffer2D<double>& buffer);
+void transpose_in_place(Buffer2D<long double>& buffer);
+void transpose_in_place(Buffer2D<ComplexF>& buffer);
+void transpose_in_place(Buffer2D<Complex>& buffer);
@@ -0,0 +1,249 @@
+#include "workspace.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+enum BlockKind {
+    HeapBlock,
+    MappedBlock,
+    HugeBlock
+};
+
+// Blocks below this come from the heap; the first block of an arena is at least this big.
+static const size_t MIN_BLOCK_SIZE = 64 << 10;
+
+static std::atomic<bool> use_huge_pages(true);
+static std::atomic<bool> huge_pages_refused(false);
+
+static std::atomic<size_t> total_reserved(0);
+static std::atomic<size_t> total_used(0);
+static std::atomic<size_t> total_peak(0);
+static std::atomic<size_t> total_huge_pages(0);
+static std::atomic<size_t> total_blocks(0);
+
+static void add_used(size_t bytes)
+{
+    size_t used = total_used.fetch_add(bytes) + bytes;
+    size_t peak = total_peak.load();
+    while (used > peak && !total_peak.compare_exchange_weak(peak, used)) {
+    }
+}
+
+// Blocks of HUGE_PAGE_SIZE and more are mapped directly: explicit huge pages first (once the OS
+// has refused them, they are not asked for again), else ordinary pages 2 MB aligned so that
+// transparent huge pages can back the whole block.
+static char* map_block(size_t bytes, BlockKind& kind)
+{
+    if (bytes < HUGE_PAGE_SIZE) {
+        kind = HeapBlock;
+        return (char*)aligned_malloc(bytes, BUFFER_ALIGNMENT);
+    }
+
+    bool huge = use_huge_pages.load() && !huge_pages_refused.load();
+#ifdef _WIN32
+    if (huge) {
+        size_t large = GetLargePageMinimum();
+        void* pointer = nullptr;
+        if (large > 0 && bytes % large == 0)
+            pointer = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (pointer != nullptr) {
+            kind = HugeBlock;
+            return (char*)pointer;
+        }
+        huge_pages_refused = true;
+    }
+    void* pointer = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    kind = MappedBlock;
+    return (char*)pointer;
+#else
+#ifdef MAP_HUGETLB
+    if (huge) {
+        void* pointer = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (pointer != MAP_FAILED) {
+            kind = HugeBlock;
+            return (char*)pointer;
+        }
+        huge_pages_refused = true;
+    }
+#endif
+    size_t span = bytes + HUGE_PAGE_SIZE;
+    void* mapping = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+        throw std::bad_alloc();
+    char* start = (char*)mapping;
+    char* aligned = (char*)(((uintptr_t)start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+    if (aligned > start)
+        munmap(start, aligned - start);
+    if (start + span > aligned + bytes)
+        munmap(aligned + bytes, start + span - (aligned + bytes));
+#ifdef MADV_HUGEPAGE
+    if (use_huge_pages.load())
+        madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+    kind = MappedBlock;
+    return aligned;
+#endif
+}
+
+static void unmap_block(char* data, size_t bytes, int kind)
+{
+    if (kind == HeapBlock) {
+        aligned_free(data);
+        return;
+    }
+#ifdef _WIN32
+    (void)bytes;
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, bytes);
+#endif
+}
+
+WorkspaceArena::~WorkspaceArena()
+{
+    release();
+}
+
+void WorkspaceArena::addBlock(size_t bytes)
+{
+    size_t size = blocks.empty() ? MIN_BLOCK_SIZE : 2 * blocks.back().size;
+    if (size < bytes)
+        size = bytes;
+    if (size >= HUGE_PAGE_SIZE)
+        size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+    BlockKind kind;
+    char* data = map_block(size, kind);
+    size_t start = blocks.empty() ? 0 : blocks.back().start + blocks.back().size;
+    blocks.push_back({ data, size, start, kind });
+    mapped++;
+    total_reserved += size;
+    total_blocks++;
+    if (kind == HugeBlock)
+        total_huge_pages += size;
+}
+
+void* WorkspaceArena::allocate(size_t bytes)
+{
+    size_t size = (bytes + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+    if (size == 0)
+        size = BUFFER_ALIGNMENT;
+
+    // Pieces never straddle blocks: the rest of a block too small for this one is skipped.
+    size_t previous = offset;
+    while (current < blocks.size() && offset + size > blocks[current].start + blocks[current].size) {
+        current++;
+        if (current < blocks.size())
+            offset = blocks[current].start;
+    }
+    if (current == blocks.size()) {
+        addBlock(size);
+        offset = blocks[current].start;
+    }
+
+    const Block& block = blocks[current];
+    void* pointer = block.data + (offset - block.start);
+    offset += size;
+    if (offset > peak)
+        peak = offset;
+    add_used(offset - previous);
+    return pointer;
+}
+
+void WorkspaceArena::rewind(size_t mark)
+{
+    if (mark > offset)
+        throw std::runtime_error("Invalid workspace mark!");
+    total_used -= offset - mark;
+    offset = mark;
+    while (current > 0 && blocks[current].start > mark)
+        current--;
+
+    if (mark == 0 && blocks.size() > 1) {
+        size_t total = blocks.back().start + blocks.back().size;
+        release();
+        addBlock(total);
+    }
+}
+
+void WorkspaceArena::reserve(size_t bytes)
+{
+    size_t end = blocks.empty() ? 0 : blocks.back().start + blocks.back().size;
+    if (offset + bytes <= end)
+        return;
+    if (offset == 0) {
+        release();
+        addBlock(bytes);
+    } else {
+        addBlock(bytes);
+    }
+}
+
+void WorkspaceArena::release()
+{
+    total_used -= offset;
+    for (const Block& block : blocks) {
+        total_reserved -= block.size;
+        if (block.kind == HugeBlock)
+            total_huge_pages -= block.size;
+        unmap_block(block.data, block.size, block.kind);
+    }
+    blocks.clear();
+    current = 0;
+    offset = 0;
+}
+
+WorkspaceStats WorkspaceArena::stats() const
+{
+    WorkspaceStats stats;
+    for (const Block& block : blocks) {
+        stats.reserved += block.size;
+        if (block.kind == HugeBlock)
+            stats.hugePages += block.size;
+    }
+    stats.used = offset;
+    stats.peak = peak;
+    stats.blocks = mapped;
+    return stats;
+}
+
+WorkspaceArena& thread_workspace()
+{
+    thread_local WorkspaceArena arena;
+    return arena;
+}
+
+bool workspace_huge_pages()
+{
+    return use_huge_pages.load();
+}
+
+void workspace_use_huge_pages(bool enable)
+{
+    use_huge_pages = enable;
+    if (enable)
+        huge_pages_refused = false;
+}
+
+WorkspaceStats workspace_totals()
+{
+    WorkspaceStats stats;
+    stats.reserved = total_reserved.load();
+    stats.used = total_used.load();
+    stats.peak = total_peak.load();
+    stats.hugePages = total_huge_pages.load();
+    stats.blocks = total_blocks.load();
+    return stats;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#include "buffer2d.h"
+
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// Bytes held by one arena, or by all of them (workspace_totals()). reserved counts every block,
+// used what is handed out right now and peak the most ever handed out at once; hugePages is the
+// part of reserved backed by explicit 2 MB pages, blocks the number of blocks ever mapped.
+struct WorkspaceStats {
+    size_t reserved = 0;
+    size_t used = 0;
+    size_t peak = 0;
+    size_t hugePages = 0;
+    size_t blocks = 0;
+};
+
+// Bump allocator for transform scratch and intermediate planes. allocate() hands out 64-byte
+// aligned pieces of the current block and maps a new block only when that runs out; rewind()
+// gives back everything allocated after a mark() without unmapping, and a rewind to an empty
+// arena that spans several blocks replaces them with one of their total size, so a steady
+// per-frame workload allocates from a single block and never reaches the system allocator.
+// Blocks of HUGE_PAGE_SIZE and more are 2 MB aligned and, while workspace_huge_pages() holds,
+// mapped with explicit huge pages where the OS grants them (MAP_HUGETLB, MEM_LARGE_PAGES) or
+// else advised for transparent ones (MADV_HUGEPAGE). Not thread safe: one owner at a time.
+class WorkspaceArena
+{
+public:
+    WorkspaceArena() = default;
+    ~WorkspaceArena();
+
+    WorkspaceArena(const WorkspaceArena&) = delete;
+    WorkspaceArena& operator=(const WorkspaceArena&) = delete;
+
+    void* allocate(size_t bytes);
+
+    // Zero-initialized plane carved from the arena, with the stride an owning Buffer2D would
+    // get. The view is valid until the arena is rewound past it.
+    template<typename T>
+    Buffer2D<T> buffer(int width, int height, bool avoid_aliasing = true)
+    {
+        if (width < 0 || height < 0)
+            throw std::runtime_error("Invalid buffer size!");
+        size_t stride = padded_stride(width, sizeof(T), avoid_aliasing);
+        size_t bytes = stride * height * sizeof(T);
+        T* data = (T*)allocate(bytes);
+        memset((void*)data, 0, bytes);
+        return Buffer2D<T>::view(data, width, height, stride);
+    }
+
+    // What buffer() takes from the arena for such a plane.
+    template<typename T>
+    static size_t bufferBytes(int width, int height, bool avoid_aliasing = true)
+    {
+        size_t bytes = padded_stride(width, sizeof(T), avoid_aliasing) * height * sizeof(T);
+        return bytes > 0 ? (bytes + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT : BUFFER_ALIGNMENT;
+    }
+
+    size_t mark() const { return offset; }
+    void rewind(size_t mark);
+    void reset() { rewind(0); }
+
+    // Makes sure the next bytes of allocations fit without mapping another block.
+    void reserve(size_t bytes);
+
+    // Unmaps every block; all pieces handed out become invalid.
+    void release();
+
+    WorkspaceStats stats() const;
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+        size_t start;   // offset of the block's first byte in the arena
+        int kind;
+    };
+
+    void addBlock(size_t bytes);
+
+private:
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+    size_t peak = 0;
+    size_t mapped = 0;
+};
+
+// Rewinds the arena to where it was on construction.
+class WorkspaceScope
+{
+public:
+    explicit WorkspaceScope(WorkspaceArena& arena)
+        : arena(arena), start(arena.mark())
+    {
+    }
+    ~WorkspaceScope() { arena.rewind(start); }
+
+    WorkspaceScope(const WorkspaceScope&) = delete;
+    WorkspaceScope& operator=(const WorkspaceScope&) = delete;
+
+private:
+    WorkspaceArena& arena;
+    size_t start;
+};
+
+// The calling thread's arena, for temporaries of the free functions; take it under a
+// WorkspaceScope.
+WorkspaceArena& thread_workspace();
+
+// Whether new blocks try huge pages (default on). Blocks already mapped keep their pages.
+bool workspace_huge_pages();
+void workspace_use_huge_pages(bool enable);
+
+// Sums over every arena of the process; peak is the process-wide high-water mark.
+WorkspaceStats workspace_totals();
@@ -0,0 +1,191 @@
+// Shared by fft.comp and fft_subgroup.comp: one row (or column) of the image per workgroup, up to
+// eight complex samples per thread in registers, and the in-register DFTs both build on.
+
+layout (constant_id = 0) const uint N = 1024;
+layout (constant_id = 1) const bool COLUMNS = false;
+layout (local_size_x_id = 2) in;
+// where this direction's N entries start in the twiddle table
+layout (constant_id = 3) const uint TWIDDLE_OFFSET = 0;
+
+layout (binding = 0) uniform sampler2D sampler_real;
+layout (binding = 1) uniform sampler2D sampler_imaginary;
+layout (binding = 2, rgba32f) uniform writeonly image2D image_real;
+layout (binding = 3, rgba32f) uniform writeonly image2D image_imaginary;
+layout (binding = 4) readonly buffer Twiddles {
+	vec2 twiddles[];
+};
+
+layout (push_constant) uniform Parameter {
+	uint inputLength;
+	uint outputLength;
+	uint flags;
+} parameter;
+
+const uint INVERSE = 1u;
+const uint REAL_INPUT = 2u;
+const uint REAL_OUTPUT = 4u;
+
+const float SQRT1_2 = 0.70710678f;
+
+vec4 re[8];
+vec4 im[8];
+float direction;
+
+ivec2 texel(uint i)
+{
+	return COLUMNS ? ivec2(gl_WorkGroupID.x, i) : ivec2(i, gl_WorkGroupID.x);
+}
+
+void butterfly(uint a, uint b)
+{
+	vec4 r = re[b];
+	vec4 i = im[b];
+	re[b] = re[a] - r;
+	im[b] = im[a] - i;
+	re[a] += r;
+	im[a] += i;
+}
+
+// exp(direction * 2 pi i k / N), k < N, from the table the host built for this N
+vec2 twiddleFactor(uint k)
+{
+	vec2 w = twiddles[TWIDDLE_OFFSET + k];
+	return vec2(w.x, direction * w.y);
+}
+
+void twiddle(uint a, vec2 w)
+{
+	vec4 r = re[a];
+	re[a] = r * w.x - im[a] * w.y;
+	im[a] = r * w.y + im[a] * w.x;
+}
+
+void fft2(uint o)
+{
+	butterfly(o, o + 1);
+}
+
+void fft4(uint o)
+{
+	butterfly(o, o + 2);
+	butterfly(o + 1, o + 3);
+	twiddle(o + 3, vec2(0.0f, direction));
+	butterfly(o, o + 1);
+	butterfly(o + 2, o + 3);
+
+	// X0 X2 X1 X3 back to natural order
+	vec4 r = re[o + 1];
+	vec4 i = im[o + 1];
+	re[o + 1] = re[o + 2];
+	im[o + 1] = im[o + 2];
+	re[o + 2] = r;
+	im[o + 2] = i;
+}
+
+void fft8()
+{
+	for (uint k = 0; k < 4; ++k)
+		butterfly(k, k + 4);
+	twiddle(5, vec2(SQRT1_2, direction * SQRT1_2));
+	twiddle(6, vec2(0.0f, direction));
+	twiddle(7, vec2(-SQRT1_2, direction * SQRT1_2));
+	fft4(0);
+	fft4(4);
+
+	// X0 X2 X4 X6 X1 X3 X5 X7 back to natural order
+	vec4 r[8] = re;
+	vec4 i[8] = im;
+	for (uint k = 0; k < 4; ++k)
+	{
+		re[2 * k] = r[k];
+		im[2 * k] = i[k];
+		re[2 * k + 1] = r[k + 4];
+		im[2 * k + 1] = i[k + 4];
+	}
+}
+
+// Radix 3, 5 or 7 over registers o to o + radix - 1, pairing samples m and radix - m so each
+// cosine and sine is applied once per pair.
+void fftOdd(uint o, uint radix)
+{
+	vec4 r[7];
+	vec4 i[7];
+	r[0] = re[o];
+	i[0] = im[o];
+	for (uint m = 1; m <= radix / 2; ++m)
+	{
+		r[0] += re[o + m] + re[o + radix - m];
+		i[0] += im[o + m] + im[o + radix - m];
+	}
+	for (uint k = 1; k <= radix / 2; ++k)
+	{
+		vec4 ar = re[o];
+		vec4 ai = im[o];
+		vec4 br = vec4(0.0f);
+		vec4 bi = vec4(0.0f);
+		for (uint m = 1; m <= radix / 2; ++m)
+		{
+			vec2 w = twiddleFactor(((m * k) % radix) * (N / radix));
+			float c = w.x;
+			float s = w.y;
+			ar += (re[o + m] + re[o + radix - m]) * c;
+			ai += (im[o + m] + im[o + radix - m]) * c;
+			br -= (im[o + m] - im[o + radix - m]) * s;
+			bi += (re[o + m] - re[o + radix - m]) * s;
+		}
+		r[k] = ar + br;
+		i[k] = ai + bi;
+		r[radix - k] = ar - br;
+		i[radix - k] = ai - bi;
+	}
+	for (uint k = 0; k < radix; ++k)
+	{
+		re[o + k] = r[k];
+		im[o + k] = i[k];
+	}
+}
+
+// This thread's b-th butterfly of a stage; threads past N / radix sit the stage out.
+uint butterflyIndex(uint b)
+{
+	return gl_LocalInvocationID.x + b * gl_WorkGroupSize.x;
+}
+
+// Registers b * radix to b * radix + radix - 1 start with samples j + r * N / radix of the line,
+// j the thread's b-th butterfly of the first stage; samples past inputLength are the zero padding
+// up to N.
+void load(uint radix)
+{
+	for (uint b = 0; b < 8 / radix; ++b)
+	{
+		uint j = butterflyIndex(b);
+		for (uint r = 0; r < radix; ++r)
+		{
+			uint i = j + r * (N / radix);
+			uint slot = b * radix + r;
+			re[slot] = vec4(0.0f);
+			im[slot] = vec4(0.0f);
+			if (j < N / radix && i < parameter.inputLength)
+			{
+				re[slot] = texelFetch(sampler_real, texel(i), 0);
+				if ((parameter.flags & REAL_INPUT) == 0)
+					im[slot] = texelFetch(sampler_imaginary, texel(i), 0);
+			}
+		}
+	}
+}
+
+// Register slot as sample i of the transformed line, scaled by 1 / sqrt(N).
+void store(uint i, uint slot)
+{
+	if (i >= parameter.outputLength)
+		return;
+	float scale = inversesqrt(float(N));
+	if ((parameter.flags & REAL_OUTPUT) != 0)
+		imageStore(image_real, texel(i), clamp(re[slot] * scale, 0.0f, 1.0f));
+	else
+	{
+		imageStore(image_real, texel(i), re[slot] * scale);
+		imageStore(image_imaginary, texel(i), im[slot] * scale);
+	}
+}
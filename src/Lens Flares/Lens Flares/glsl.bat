@@ -2,5 +2,6 @@ glslangvalidator -V feature_extraction.vert -o feature_extraction.vert.spv
 glslangvalidator -V feature_extraction.frag -o feature_extraction.frag.spv
 glslangvalidator -V blend.frag -o blend.frag.spv
 glslangvalidator -V blur.frag -o blur.frag.spv
-glslangvalidator -V complexMultiplication.frag -o complexMultiplication.frag.spv
-glslangvalidator -V fft.frag -o fft.frag.spv
\ No newline at end of file
+glslangvalidator -V complexMultiplication.comp -o complexMultiplication.comp.spv
+glslangvalidator -V fft.comp -o fft.comp.spv
+glslangvalidator -V --target-env vulkan1.1 fft_subgroup.comp -o fft_subgroup.comp.spv
\ No newline at end of file
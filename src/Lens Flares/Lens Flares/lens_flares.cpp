@@ -1,7 +1,10 @@
 #include "lens_flares.h"
 
 #include <set>
+#include <algorithm>
 #include <fstream>
+#include <cmath>
+#include <complex>
 
 #include "opencv2/core.hpp"
 #include "opencv2/highgui.hpp"
@@ -19,6 +22,77 @@ const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// fft.comp push constant flags
+const uint32_t FFT_INVERSE = 1;
+const uint32_t FFT_REAL_INPUT = 2;
+const uint32_t FFT_REAL_OUTPUT = 4;
+
+// The radix fft.comp takes for the stage that still has length samples to combine; the two must
+// agree.
+uint32_t fftRadix(uint32_t length)
+{
+	for (uint32_t radix : { 8, 7, 5, 4, 3 })
+		if (length % radix == 0)
+			return radix;
+	return 2;
+}
+
+// Smallest length >= size whose prime factors are all 2, 3, 5 or 7; sizes with a larger prime
+// factor are zero-padded up to it. That keeps 800 at 800 rather than 1024 (64% more texels per
+// pass), but only power-of-two lengths can take fft_subgroup.comp, so powerOfTwo pads to those
+// instead for devices where the shuffle kernel wins back the extra work.
+uint32_t fftLength(uint32_t size, bool powerOfTwo)
+{
+	for (uint32_t length = std::max(size, 8u);; ++length)
+	{
+		if (powerOfTwo)
+		{
+			if ((length & (length - 1)) == 0)
+				return length;
+			continue;
+		}
+		uint32_t m = length;
+		for (uint32_t factor : { 2, 3, 5, 7 })
+			while (m % factor == 0)
+				m /= factor;
+		if (m == 1)
+			return length;
+	}
+}
+
+// Threads per line: each takes as many butterflies of a stage as fit in its eight registers, so
+// the stage with the fewest samples per thread sets the size.
+uint32_t fftWorkGroupSize(uint32_t length)
+{
+	uint32_t size = 0;
+	for (uint32_t stride = 1; stride < length;)
+	{
+		uint32_t radix = fftRadix(length / stride);
+		uint32_t samples = radix * (8 / radix);
+		size = std::max(size, (length + samples - 1) / samples);
+		stride *= radix;
+	}
+	return size;
+}
+
+// The stages fft.comp runs for a transform length, e.g. 8-5-5-4 for 800
+std::string fftPlan(uint32_t length)
+{
+	std::string plan;
+	for (uint32_t stride = 1; stride < length;)
+	{
+		uint32_t radix = fftRadix(length / stride);
+		plan += (plan.empty() ? "" : "-") + std::to_string(radix);
+		stride *= radix;
+	}
+	return plan;
+}
+
+bool isPowerOfTwo(uint32_t n)
+{
+	return (n & (n - 1)) == 0;
+}
+
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT*
 	pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger)
 {
@@ -38,8 +112,8 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, const VkAllocationCallba
 		return func(instance, debugMessenger, pAllocator);
 }
 
-LensFlares::LensFlares(uint32_t width, uint32_t height)
-	: width(width), height(height)
+LensFlares::LensFlares(uint32_t width, uint32_t height, bool powerOfTwoFFT)
+	: width(width), height(height), powerOfTwoFFT(powerOfTwoFFT)
 {
 	initWindow();
 	prepare();
@@ -55,6 +129,190 @@ void LensFlares::run()
 	mainLoop();
 }
 
+void LensFlares::benchmark()
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	std::cout << properties.deviceName << ": subgroup size " << subgroupProperties.subgroupSize
+		<< ", compute subgroup shuffle " << (subgroupShuffle ? "supported" : "not supported") << std::endl;
+	if (!properties.limits.timestampComputeAndGraphics)
+		throw std::runtime_error("Failed to find timestamp support on the graphics queue!");
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = 2
+	};
+	VkQueryPool queryPool;
+	if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create query pool!");
+
+	// one frame first so the transforms read what the bright and blur passes rendered
+	VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &commandBuffers[0]
+	};
+	vkQueueSubmit(graphicQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(graphicQueue);
+
+	std::vector<std::string> shaders = { "./fft.comp.spv" };
+	if (subgroupShuffle && isPowerOfTwo(fftWidth) && isPowerOfTwo(fftHeight))
+		shaders.push_back("./fft_subgroup.comp.spv");
+	else if (subgroupShuffle)
+		std::cout << "fft_subgroup.comp skipped: " << fftWidth << "x" << fftHeight
+			<< " is not a power-of-two transform, run bench with pow2 or a power-of-two size" << std::endl;
+
+	auto framePipelines = pipelines;
+	const int iterations = 20;
+	for (const auto& shader : shaders)
+	{
+		createFFTPipelines(shader);
+		double total = 0.0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			VkCommandBuffer cmdBuffer = getCommandBuffer(true);
+			vkCmdResetQueryPool(cmdBuffer, queryPool, 0, 2);
+			vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+			recordFFT(cmdBuffer, descriptorSets.bright_dft, false);
+			recordFFT(cmdBuffer, descriptorSets.idft, true);
+			vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+			flushCommandBuffer(cmdBuffer);
+
+			uint64_t timestamps[2];
+			vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+			total += (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod;
+		}
+		std::cout << shader << ": " << total / iterations / 1e6 << " ms per forward and inverse "
+			<< fftWidth << "x" << fftHeight << " transform" << std::endl;
+		vkDestroyPipeline(device, pipelines.fft_rows, nullptr);
+		vkDestroyPipeline(device, pipelines.fft_columns, nullptr);
+	}
+	pipelines = framePipelines;
+	vkDestroyQueryPool(device, queryPool, nullptr);
+}
+
+bool LensFlares::check()
+{
+	// The bright pass output is the known image: the forward transform of it is compared with a
+	// direct DFT, and the inverse of that spectrum with the image itself.
+	VkCommandBuffer cmdBuffer = getCommandBuffer(true);
+	recordPass(cmdBuffer, frameBuffers.bright, pipelines.bright, pipelineLayouts.bright, descriptorSets.bright);
+	flushCommandBuffer(cmdBuffer);
+	std::vector<uint8_t> texels = readImage(frameBuffers.bright.color.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		width, height, 4);
+	std::vector<float> image(texels.size());
+	for (size_t i = 0; i < texels.size(); ++i)
+		image[i] = texels[i] / 255.0f;
+
+	// rows, then columns, each with its own table of exp(-2 pi i k / N); fft.comp scales each
+	// pass by 1 / sqrt(N). A direct DFT of the whole spectrum is billions of multiplies, so only
+	// every seventh column of bins is compared; each still depends on every stage of both passes.
+	const uint32_t binStep = 7;
+	typedef std::complex<double> Complex;
+	auto twiddles = [](uint32_t length) {
+		std::vector<Complex> table(length);
+		for (uint32_t k = 0; k < length; ++k)
+			table[k] = std::polar(1.0, -2.0 * 3.14159265358979323846 * k / length);
+		return table;
+	};
+	std::vector<Complex> rowTwiddles = twiddles(fftWidth), columnTwiddles = twiddles(fftHeight);
+	std::vector<Complex> rows((size_t)fftWidth * height * 4), spectrum((size_t)fftWidth * fftHeight * 4);
+	for (uint32_t y = 0; y < height; ++y)
+		for (uint32_t k = 0; k < fftWidth; k += binStep)
+			for (uint32_t x = 0; x < width; ++x)
+				for (uint32_t c = 0; c < 4; ++c)
+					rows[((size_t)y * fftWidth + k) * 4 + c] += (double)image[((size_t)y * width + x) * 4 + c] *
+						rowTwiddles[(size_t)k * x % fftWidth];
+	double scale = 1.0 / sqrt((double)fftWidth * fftHeight), peak = 0.0;
+	for (uint32_t k = 0; k < fftHeight; ++k)
+		for (uint32_t y = 0; y < height; ++y)
+			for (uint32_t x = 0; x < fftWidth; x += binStep)
+				for (uint32_t c = 0; c < 4; ++c)
+					spectrum[((size_t)k * fftWidth + x) * 4 + c] += rows[((size_t)y * fftWidth + x) * 4 + c] *
+						columnTwiddles[(size_t)k * y % fftHeight] * scale;
+	for (const auto& value : spectrum)
+		peak = std::max(peak, std::abs(value));
+	if (peak == 0.0)
+		throw std::runtime_error("Failed to find a non-black bright pass to check the FFT against!");
+
+	std::cout << "rows " << fftWidth << " (" << fftPlan(fftWidth) << "), columns " << fftHeight << " ("
+		<< fftPlan(fftHeight) << ")" << std::endl;
+	std::vector<std::string> shaders = { "./fft.comp.spv" };
+	if (subgroupShuffle && isPowerOfTwo(fftWidth) && isPowerOfTwo(fftHeight))
+		shaders.push_back("./fft_subgroup.comp.spv");
+
+	auto transferBarrier = [](VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+		VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask) {
+		VkMemoryBarrier memoryBarrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = srcAccessMask,
+			.dstAccessMask = dstAccessMask
+		};
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	};
+
+	bool passed = true;
+	auto framePipelines = pipelines;
+	for (const auto& shader : shaders)
+	{
+		createFFTPipelines(shader);
+		cmdBuffer = getCommandBuffer(true);
+		recordFFT(cmdBuffer, descriptorSets.bright_dft, false);
+		// the inverse reads its input from complexMultiplication
+		transferBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+		VkImageCopy imageCopy = {
+			.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.srcOffset = { 0, 0, 0 },
+			.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.dstOffset = { 0, 0, 0 },
+			.extent = { fftWidth, fftHeight, 1 }
+		};
+		vkCmdCopyImage(cmdBuffer, storageImages.bright_dft.real.image, VK_IMAGE_LAYOUT_GENERAL,
+			storageImages.complexMultiplication.real.image, VK_IMAGE_LAYOUT_GENERAL, 1, &imageCopy);
+		vkCmdCopyImage(cmdBuffer, storageImages.bright_dft.imaginary.image, VK_IMAGE_LAYOUT_GENERAL,
+			storageImages.complexMultiplication.imaginary.image, VK_IMAGE_LAYOUT_GENERAL, 1, &imageCopy);
+		transferBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		recordFFT(cmdBuffer, descriptorSets.idft, true);
+		flushCommandBuffer(cmdBuffer);
+		vkDestroyPipeline(device, pipelines.fft_rows, nullptr);
+		vkDestroyPipeline(device, pipelines.fft_columns, nullptr);
+
+		std::vector<uint8_t> real = readImage(storageImages.bright_dft.real.image, VK_IMAGE_LAYOUT_GENERAL,
+			fftWidth, fftHeight, 4 * sizeof(float));
+		std::vector<uint8_t> imaginary = readImage(storageImages.bright_dft.imaginary.image, VK_IMAGE_LAYOUT_GENERAL,
+			fftWidth, fftHeight, 4 * sizeof(float));
+		double forwardError = 0.0;
+		for (size_t i = 0; i < spectrum.size(); ++i)
+		{
+			if (i / 4 % fftWidth % binStep != 0)
+				continue;
+			Complex value(((const float*)real.data())[i], ((const float*)imaginary.data())[i]);
+			forwardError = std::max(forwardError, std::abs(value - spectrum[i]) / peak);
+		}
+
+		std::vector<uint8_t> inverse = readImage(storageImages.idft.image, VK_IMAGE_LAYOUT_GENERAL, width, height,
+			4 * sizeof(float));
+		double inverseError = 0.0;
+		for (size_t i = 0; i < image.size(); ++i)
+			inverseError = std::max(inverseError, (double)fabs(((const float*)inverse.data())[i] - image[i]));
+
+		bool forwardOk = forwardError <= 1e-4, inverseOk = inverseError <= 1e-4;
+		passed = passed && forwardOk && inverseOk;
+		std::cout << shader << " forward: max error " << forwardError << " of the peak" << (forwardOk ? " ok" : " FAILED")
+			<< std::endl;
+		std::cout << shader << " inverse: max error " << inverseError << (inverseOk ? " ok" : " FAILED") << std::endl;
+	}
+	pipelines = framePipelines;
+	return passed;
+}
+
 void LensFlares::initWindow()
 {
 	glfwInit();
@@ -79,11 +337,14 @@ void LensFlares::prepare()
 
 	loadResources();
 	createFrameBuffers();
+	createStorageImages();
+	createTwiddleBuffer();
 	createUniformBuffers();
 	createDescriptorPool();
 	setupDescriptorSetLayout();
 	setupDescriptorSet();
 	createPipeline();
+	computeKernelSpectrum();
 	buildCommandBuffers();
 }
 
@@ -143,7 +404,7 @@ void LensFlares::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_1;
 
 	VkInstanceCreateInfo createInfo;
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -218,6 +479,25 @@ void LensFlares::pickPhysicalDevice()
 
 	if (physicalDevice == VK_NULL_HANDLE)
 		throw std::runtime_error("Failed to find a suitable GPU!");
+
+	// fft_subgroup.comp needs subgroup shuffles in compute shaders, otherwise fft.comp is used
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	subgroupProperties = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+		.pNext = nullptr
+	};
+	subgroupShuffle = false;
+	if (properties.apiVersion >= VK_API_VERSION_1_1)
+	{
+		VkPhysicalDeviceProperties2 properties2 = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+			.pNext = &subgroupProperties
+		};
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+		subgroupShuffle = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+			(subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_SHUFFLE_BIT);
+	}
 }
 
 void LensFlares::createSurface()
@@ -380,88 +660,6 @@ void LensFlares::createRenderPass()
 		}
 	}
 	
-	// bright_dft
-	{
-		std::vector<VkAttachmentDescription> colorAttachmentDescriptions(2); 
-		colorAttachmentDescriptions[0] = {
-			.flags = 0,
-			.format = VK_FORMAT_B8G8R8A8_UNORM,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-		};
-		colorAttachmentDescriptions[1] = {
-			.flags = 0,
-			.format = VK_FORMAT_B8G8R8A8_UNORM,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-		};
-
-		std::vector<VkAttachmentReference> colorAttachmentReferences = {
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
-			{1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
-		};
-
-		VkSubpassDescription subpassDescription = {
-			0,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			0,
-			nullptr,
-			colorAttachmentReferences.size(),
-			&colorAttachmentReferences[0],
-			nullptr,
-			nullptr,
-			0,
-			nullptr
-		};
-
-		std::vector<VkSubpassDependency> dependencies(2);
-		dependencies[0] = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-		dependencies[1] = {
-			.srcSubpass = 0,
-			.dstSubpass = VK_SUBPASS_EXTERNAL,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-
-		VkRenderPassCreateInfo renderPassCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.attachmentCount = (uint32_t)colorAttachmentDescriptions.size(),
-			.pAttachments = colorAttachmentDescriptions.data(),
-			.subpassCount = 1,
-			.pSubpasses = &subpassDescription,
-			.dependencyCount = (uint32_t)dependencies.size(),
-			.pDependencies = dependencies.data()
-		};
-
-		if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &frameBuffers.bright_dft.renderPass) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create render pass!");
-		}
-	}
-
 	// blur
 	{
 		VkAttachmentDescription colorAttachmentDescription = {
@@ -532,89 +730,7 @@ void LensFlares::createRenderPass()
 		}
 	}
 
-	// blur_dft
-	{
-		std::vector<VkAttachmentDescription> colorAttachmentDescriptions(2);
-		colorAttachmentDescriptions[0] = {
-			.flags = 0,
-			.format = VK_FORMAT_B8G8R8A8_UNORM,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-		};
-		colorAttachmentDescriptions[1] = {
-			.flags = 0,
-			.format = VK_FORMAT_B8G8R8A8_UNORM,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-		};
-
-		std::vector<VkAttachmentReference> colorAttachmentReferences = {
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
-			{1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
-		};
-
-		VkSubpassDescription subpassDescription = {
-			0,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			0,
-			nullptr,
-			colorAttachmentReferences.size(),
-			&colorAttachmentReferences[0],
-			nullptr,
-			nullptr,
-			0,
-			nullptr
-		};
-
-		std::vector<VkSubpassDependency> dependencies(2);
-		dependencies[0] = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-		dependencies[1] = {
-			.srcSubpass = 0,
-			.dstSubpass = VK_SUBPASS_EXTERNAL,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-
-		VkRenderPassCreateInfo renderPassCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.attachmentCount = (uint32_t)colorAttachmentDescriptions.size(),
-			.pAttachments = &colorAttachmentDescriptions[0],
-			.subpassCount = 1,
-			.pSubpasses = &subpassDescription,
-			.dependencyCount = (uint32_t)dependencies.size(),
-			.pDependencies = dependencies.data()
-		};
-
-		if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &frameBuffers.blur_dft.renderPass) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create render pass!");
-		}
-	}
-
-	// complexMultiplication
+	// blend
 	{
 		VkAttachmentDescription colorAttachmentDescription = {
 			.flags = 0,
@@ -628,9 +744,9 @@ void LensFlares::createRenderPass()
 			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
 		};
 
-		std::vector<VkAttachmentReference> colorAttachmentReferences = {
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
+		VkAttachmentReference colorAttachmentReference = {
+			0,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
 		};
 
 		VkSubpassDescription subpassDescription = {
@@ -638,8 +754,8 @@ void LensFlares::createRenderPass()
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			0,
 			nullptr,
-			colorAttachmentReferences.size(),
-			colorAttachmentReferences.data(),
+			1,
+			&colorAttachmentReference,
 			nullptr,
 			nullptr,
 			0,
@@ -678,184 +794,44 @@ void LensFlares::createRenderPass()
 			.pDependencies = dependencies.data()
 		};
 
-		if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &frameBuffers.complexMultiplication.renderPass) != VK_SUCCESS)
+		if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &frameBuffers.blend.renderPass) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create render pass!");
 		}
 	}
 
-	// idft
-	{
-		VkAttachmentDescription colorAttachmentDescription = {
-			.flags = 0,
-			.format = VK_FORMAT_B8G8R8A8_UNORM,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-		};
+	// Shared sampler used for all color attachments
+	VkSamplerCreateInfo sampler = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.magFilter = VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_NEAREST,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.mipLodBias = 0.0f,
+		.maxAnisotropy = 1.0f,
+		.minLod = 0.0f,
+		.maxLod = 1.0f,
+		.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE
+	};
+	vkCreateSampler(device, &sampler, nullptr, &colorSampler);
+}
 
-		VkAttachmentReference colorAttachmentReference = {
-			0,
-			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-		};
-
-		VkSubpassDescription subpassDescription = {
-			0,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			0,
-			nullptr,
-			1,
-			&colorAttachmentReference,
-			nullptr,
-			nullptr,
-			0,
-			nullptr
-		};
-
-		std::vector<VkSubpassDependency> dependencies(2);
-		dependencies[0] = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-		dependencies[1] = {
-			.srcSubpass = 0,
-			.dstSubpass = VK_SUBPASS_EXTERNAL,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-
-		VkRenderPassCreateInfo renderPassCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.attachmentCount = 1,
-			.pAttachments = &colorAttachmentDescription,
-			.subpassCount = 1,
-			.pSubpasses = &subpassDescription,
-			.dependencyCount = (uint32_t)dependencies.size(),
-			.pDependencies = dependencies.data()
-		};
-
-		if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &frameBuffers.idft.renderPass) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create render pass!");
-		}
-	}
-
-	// blend
-	{
-		VkAttachmentDescription colorAttachmentDescription = {
-			.flags = 0,
-			.format = VK_FORMAT_B8G8R8A8_UNORM,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-		};
-
-		VkAttachmentReference colorAttachmentReference = {
-			0,
-			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-		};
-
-		VkSubpassDescription subpassDescription = {
-			0,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			0,
-			nullptr,
-			1,
-			&colorAttachmentReference,
-			nullptr,
-			nullptr,
-			0,
-			nullptr
-		};
-
-		std::vector<VkSubpassDependency> dependencies(2);
-		dependencies[0] = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-		dependencies[1] = {
-			.srcSubpass = 0,
-			.dstSubpass = VK_SUBPASS_EXTERNAL,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-
-		VkRenderPassCreateInfo renderPassCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.attachmentCount = 1,
-			.pAttachments = &colorAttachmentDescription,
-			.subpassCount = 1,
-			.pSubpasses = &subpassDescription,
-			.dependencyCount = (uint32_t)dependencies.size(),
-			.pDependencies = dependencies.data()
-		};
-
-		if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &frameBuffers.blend.renderPass) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create render pass!");
-		}
-	}
-
-	// Shared sampler used for all color attachments
-	VkSamplerCreateInfo sampler = {
-		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-		.pNext = nullptr,
-		.flags = 0,
-		.magFilter = VK_FILTER_NEAREST,
-		.minFilter = VK_FILTER_NEAREST,
-		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-		.mipLodBias = 0.0f,
-		.maxAnisotropy = 1.0f,
-		.minLod = 0.0f,
-		.maxLod = 1.0f,
-		.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE
-	};
-	vkCreateSampler(device, &sampler, nullptr, &colorSampler);
-}
-
-void LensFlares::createPipelineCache()
-{
-	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
-		VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
-		nullptr,
-		0,
-		0,
-		nullptr
-	};
-	if (vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create pipeline cache!");
-}
+void LensFlares::createPipelineCache()
+{
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+		VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		nullptr,
+		0,
+		0,
+		nullptr
+	};
+	if (vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create pipeline cache!");
+}
 
 void LensFlares::createPipeline()
 {
@@ -1053,44 +1029,6 @@ void LensFlares::createPipeline()
 			throw std::runtime_error("Failed to create graphics pipelines!");
 	}
 
-	// complexMultiplication
-	{
-		VkShaderModule vertex;
-		VkShaderModule fragment;
-		try {
-			vertex = createShaderModule("./feature_extraction.vert.spv");
-			fragment = createShaderModule("./complexMultiplication.frag.spv");
-		}
-		catch (const std::exception& e) {
-			throw e;
-		}
-		shaderStages[0].module = vertex;
-		shaderStages[1].module = fragment;
-		graphicsPipelineCreateInfo.renderPass = frameBuffers.complexMultiplication.renderPass;
-		graphicsPipelineCreateInfo.layout = pipelineLayouts.complexMultiplication;
-		if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipelines.complexMultiplication) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create graphics pipelines!");
-	}
-
-	// idft
-	{
-		VkShaderModule vertex;
-		VkShaderModule fragment;
-		try {
-			vertex = createShaderModule("./feature_extraction.vert.spv");
-			fragment = createShaderModule("./fft.frag.spv");
-		}
-		catch (const std::exception& e) {
-			throw e;
-		}
-		shaderStages[0].module = vertex;
-		shaderStages[1].module = fragment;
-		graphicsPipelineCreateInfo.renderPass = frameBuffers.idft.renderPass;
-		graphicsPipelineCreateInfo.layout = pipelineLayouts.idft;
-		if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipelines.idft) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create graphics pipelines!");
-	}
-
 	// blend
 	{
 		VkShaderModule vertex;
@@ -1110,33 +1048,89 @@ void LensFlares::createPipeline()
 			throw std::runtime_error("Failed to create graphics pipelines!");
 	}
 
-	// dft
+	// fft
+	// the shuffle variant only handles power-of-two lengths
+	bool subgroupFFT = subgroupShuffle && isPowerOfTwo(fftWidth) && isPowerOfTwo(fftHeight);
+	createFFTPipelines(subgroupFFT ? "./fft_subgroup.comp.spv" : "./fft.comp.spv");
+
+	// complexMultiplication
 	{
-		VkShaderModule vertex;
-		VkShaderModule fragment;
+		VkShaderModule compute;
 		try {
-			vertex = createShaderModule("./feature_extraction.vert.spv");
-			fragment = createShaderModule("./fft.frag.spv");
+			compute = createShaderModule("./complexMultiplication.comp.spv");
 		}
 		catch (const std::exception& e) {
 			throw e;
 		}
-		shaderStages[0].module = vertex;
-		shaderStages[1].module = fragment;
-		graphicsPipelineCreateInfo.renderPass = frameBuffers.bright_dft.renderPass;
-		graphicsPipelineCreateInfo.layout = pipelineLayouts.dft;
-		std::vector<VkPipelineColorBlendAttachmentState> blendAttachmentStates(2);
-		blendAttachmentStates[0] = { .blendEnable = false, .colorWriteMask = 0xf };
-		blendAttachmentStates[1] = { .blendEnable = false, .colorWriteMask = 0xf };
-		pipelineColorBlendStateCreateInfo.attachmentCount = blendAttachmentStates.size();
-		pipelineColorBlendStateCreateInfo.pAttachments = blendAttachmentStates.data();
-		if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipelines.bright_dft) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create graphics pipelines!");
+		VkComputePipelineCreateInfo computePipelineCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.stage = {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.pNext = nullptr,
+				.flags = 0,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = compute,
+				.pName = "main",
+				.pSpecializationInfo = nullptr
+			},
+			.layout = pipelineLayouts.complexMultiplication
+		};
+		if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipelines.complexMultiplication) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create compute pipelines!");
+	}
+}
 
-		graphicsPipelineCreateInfo.renderPass = frameBuffers.blur_dft.renderPass;
-		if(vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipelines.blur_dft) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create graphics pipelines!");
+void LensFlares::createFFTPipelines(const std::string& shader)
+{
+	// One pipeline per direction with the line length and workgroup size (a thread per up to
+	// eight samples) specialized in
+	VkShaderModule compute;
+	try {
+		compute = createShaderModule(shader);
 	}
+	catch (const std::exception& e) {
+		throw e;
+	}
+	std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+		{0, 0, sizeof(uint32_t)},
+		{1, sizeof(uint32_t), sizeof(VkBool32)},
+		{2, 2 * sizeof(uint32_t), sizeof(uint32_t)},
+		{3, 3 * sizeof(uint32_t), sizeof(uint32_t)}
+	};
+	uint32_t specializationData[4] = { fftWidth, VK_FALSE, fftWorkGroupSize(fftWidth), 0 };
+	VkSpecializationInfo specializationInfo = {
+		.mapEntryCount = (uint32_t)specializationMapEntries.size(),
+		.pMapEntries = specializationMapEntries.data(),
+		.dataSize = sizeof(specializationData),
+		.pData = specializationData
+	};
+	VkComputePipelineCreateInfo computePipelineCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = compute,
+			.pName = "main",
+			.pSpecializationInfo = &specializationInfo
+		},
+		.layout = pipelineLayouts.fft
+	};
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipelines.fft_rows) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create compute pipelines!");
+
+	specializationData[0] = fftHeight;
+	specializationData[1] = VK_TRUE;
+	specializationData[2] = fftWorkGroupSize(fftHeight);
+	specializationData[3] = fftWidth;
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipelines.fft_columns) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create compute pipelines!");
+	vkDestroyShaderModule(device, compute, nullptr);
 }
 
 void LensFlares::createCommandPool()
@@ -1161,14 +1155,6 @@ void LensFlares::createFrameBuffers()
 	frameBuffers.blur.height = height;
 	frameBuffers.blend.width = width;
 	frameBuffers.blend.height = height;
-	frameBuffers.bright_dft.width = width;
-	frameBuffers.bright_dft.height = height;
-	frameBuffers.blur_dft.width = width;
-	frameBuffers.blur_dft.height = height;
-	frameBuffers.idft.width = width;
-	frameBuffers.idft.height = height;
-	frameBuffers.complexMultiplication.width = width;
-	frameBuffers.complexMultiplication.height = height;
 
 	// bright
 	{
@@ -1184,7 +1170,7 @@ void LensFlares::createFrameBuffers()
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
 		};
 
 		std::vector<VkAttachmentReference> colorAttachments = {
@@ -1262,7 +1248,7 @@ void LensFlares::createFrameBuffers()
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
 		};
 
 		std::vector<VkAttachmentReference> colorAttachments = {
@@ -1326,28 +1312,15 @@ void LensFlares::createFrameBuffers()
 		vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frameBuffers.blur.framebuffer);
 	}
 	
-	// bright_dft
+	// blend
 	{
-		createAttachment(&frameBuffers.bright_dft.real, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height);
-		createAttachment(&frameBuffers.bright_dft.imaginary, VK_FORMAT_R8G8B8A8_UNORM,
+		createAttachment(&frameBuffers.blend.color, VK_FORMAT_R8G8B8A8_UNORM,
 			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height);
 
-		std::vector<VkAttachmentDescription> attachmentDescriptions(2);
+		std::vector<VkAttachmentDescription> attachmentDescriptions(1);
 		attachmentDescriptions[0] = {
 			.flags = 0,
-			.format = frameBuffers.bright_dft.real.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-		};
-		attachmentDescriptions[1] = {
-			.flags = 0,
-			.format = frameBuffers.bright_dft.imaginary.format,
+			.format = frameBuffers.blend.color.format,
 			.samples = VK_SAMPLE_COUNT_1_BIT,
 			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
 			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
@@ -1358,8 +1331,7 @@ void LensFlares::createFrameBuffers()
 		};
 
 		std::vector<VkAttachmentReference> colorAttachments = {
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
-			{1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
+			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
 		};
 
 		VkSubpassDescription subpass = {
@@ -1402,9 +1374,8 @@ void LensFlares::createFrameBuffers()
 		VkRenderPass renderPass;
 		vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
 
-		std::vector<VkImageView> attachments(2);
-		attachments[0] = frameBuffers.bright_dft.real.view;
-		attachments[1] = frameBuffers.bright_dft.imaginary.view;
+		std::vector<VkImageView> attachments(1);
+		attachments[0] = frameBuffers.blend.color.view;
 
 		VkFramebufferCreateInfo framebufferCreateInfo = {
 			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
@@ -1417,354 +1388,148 @@ void LensFlares::createFrameBuffers()
 			.height = height,
 			.layers = 1
 		};
-		vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frameBuffers.bright_dft.framebuffer);
+		vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frameBuffers.blend.framebuffer);
 	}
+}
 
-	// blur_dft
+void LensFlares::createStorageImages()
+{
+	// The transforms run on the window zero-padded only as far as the next length fft.comp
+	// factors into radix 2, 3, 5 and 7 stages (800 x 800 takes no padding at all), or to powers
+	// of two with powerOfTwoFFT; see fftLength().
+	fftWidth = fftLength(width, powerOfTwoFFT);
+	fftHeight = fftLength(height, powerOfTwoFFT);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	uint32_t length = std::max(fftWidth, fftHeight);
+	uint32_t workGroupSize = std::max(fftWorkGroupSize(fftWidth), fftWorkGroupSize(fftHeight));
+	if (workGroupSize > properties.limits.maxComputeWorkGroupSize[0] ||
+		workGroupSize > properties.limits.maxComputeWorkGroupInvocations ||
+		length * 4 * sizeof(float) > properties.limits.maxComputeSharedMemorySize)
+		throw std::runtime_error("Failed to fit the FFT size in the device compute limits!");
+
+	// transfers are for check(), which reads spectra back and feeds one to the inverse
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	createAttachment(&storageImages.bright_dft.real, VK_FORMAT_R32G32B32A32_SFLOAT, usage, fftWidth, fftHeight);
+	createAttachment(&storageImages.bright_dft.imaginary, VK_FORMAT_R32G32B32A32_SFLOAT, usage, fftWidth, fftHeight);
+	createAttachment(&storageImages.blur_dft.real, VK_FORMAT_R32G32B32A32_SFLOAT, usage, fftWidth, fftHeight);
+	createAttachment(&storageImages.blur_dft.imaginary, VK_FORMAT_R32G32B32A32_SFLOAT, usage, fftWidth, fftHeight);
+	createAttachment(&storageImages.complexMultiplication.real, VK_FORMAT_R32G32B32A32_SFLOAT, usage, fftWidth, fftHeight);
+	createAttachment(&storageImages.complexMultiplication.imaginary, VK_FORMAT_R32G32B32A32_SFLOAT, usage, fftWidth, fftHeight);
+	// rows of the forward transforms before the column pass, and the inverse columns cropped to
+	// the window rows before the row pass
+	createAttachment(&storageImages.temp.real, VK_FORMAT_R32G32B32A32_SFLOAT, usage, fftWidth, height);
+	createAttachment(&storageImages.temp.imaginary, VK_FORMAT_R32G32B32A32_SFLOAT, usage, fftWidth, height);
+	createAttachment(&storageImages.idft, VK_FORMAT_R32G32B32A32_SFLOAT, usage, width, height);
+
+	std::vector<VkImage> images = {
+		storageImages.bright_dft.real.image, storageImages.bright_dft.imaginary.image,
+		storageImages.blur_dft.real.image, storageImages.blur_dft.imaginary.image,
+		storageImages.complexMultiplication.real.image, storageImages.complexMultiplication.imaginary.image,
+		storageImages.temp.real.image, storageImages.temp.imaginary.image,
+		storageImages.idft.image
+	};
+	std::vector<VkImageMemoryBarrier> imageMemoryBarriers(images.size());
+	for (size_t i = 0; i < images.size(); ++i)
 	{
-		createAttachment(&frameBuffers.blur_dft.real, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height);
-		createAttachment(&frameBuffers.blur_dft.imaginary, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height);
-
-		std::vector<VkAttachmentDescription> attachmentDescriptions(2);
-		attachmentDescriptions[0] = {
-			.flags = 0,
-			.format = frameBuffers.blur_dft.real.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-		};
-		attachmentDescriptions[1] = {
-			.flags = 0,
-			.format = frameBuffers.blur_dft.imaginary.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+		imageMemoryBarriers[i] = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = images[i],
+			.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
 		};
+	}
+	VkCommandBuffer cmdBuffer = getCommandBuffer(true);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, (uint32_t)imageMemoryBarriers.size(), imageMemoryBarriers.data());
+	flushCommandBuffer(cmdBuffer);
+}
 
-		std::vector<VkAttachmentReference> colorAttachments = {
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
-			{1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
-		};
-
-		VkSubpassDescription subpass = {
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.colorAttachmentCount = (uint32_t)colorAttachments.size(),
-			.pColorAttachments = colorAttachments.data()
-		};
-
-		std::vector<VkSubpassDependency> subpassDependencys(2);
-		subpassDependencys[0] = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-		subpassDependencys[1] = {
-			.srcSubpass = 0,
-			.dstSubpass = VK_SUBPASS_EXTERNAL,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-
-		VkRenderPassCreateInfo renderPassCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.attachmentCount = (uint32_t)attachmentDescriptions.size(),
-			.pAttachments = attachmentDescriptions.data(),
-			.subpassCount = 1,
-			.pSubpasses = &subpass,
-			.dependencyCount = (uint32_t)subpassDependencys.size(),
-			.pDependencies = subpassDependencys.data()
-		};
-		VkRenderPass renderPass;
-		vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
-
-		std::vector<VkImageView> attachments(2);
-		attachments[0] = frameBuffers.blur_dft.real.view;
-		attachments[1] = frameBuffers.blur_dft.imaginary.view;
-
-		VkFramebufferCreateInfo framebufferCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.renderPass = renderPass,
-			.attachmentCount = (uint32_t)attachments.size(),
-			.pAttachments = attachments.data(),
-			.width = width,
-			.height = height,
-			.layers = 1
-		};
-		vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frameBuffers.blur_dft.framebuffer);
-	}
-	
-	// idft
-	{	
-		createAttachment(&frameBuffers.idft.color, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height);
-
-		std::vector<VkAttachmentDescription> attachmentDescriptions(1);
-		attachmentDescriptions[0] = {
-			.flags = 0,
-			.format = frameBuffers.idft.color.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-		};
-
-		std::vector<VkAttachmentReference> colorAttachments = {
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
-		};
-
-		VkSubpassDescription subpass = {
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.colorAttachmentCount = (uint32_t)colorAttachments.size(),
-			.pColorAttachments = colorAttachments.data()
-		};
-
-		std::vector<VkSubpassDependency> subpassDependencys(2);
-		subpassDependencys[0] = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-		subpassDependencys[1] = {
-			.srcSubpass = 0,
-			.dstSubpass = VK_SUBPASS_EXTERNAL,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-
-		VkRenderPassCreateInfo renderPassCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.attachmentCount = (uint32_t)attachmentDescriptions.size(),
-			.pAttachments = attachmentDescriptions.data(),
-			.subpassCount = 1,
-			.pSubpasses = &subpass,
-			.dependencyCount = (uint32_t)subpassDependencys.size(),
-			.pDependencies = subpassDependencys.data()
-		};
-		VkRenderPass renderPass;
-		vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
-
-		std::vector<VkImageView> attachments(1);
-		attachments[0] = frameBuffers.idft.color.view;
-
-		VkFramebufferCreateInfo framebufferCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.renderPass = renderPass,
-			.attachmentCount = (uint32_t)attachments.size(),
-			.pAttachments = attachments.data(),
-			.width = width,
-			.height = height,
-			.layers = 1
-		};
-		vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frameBuffers.idft.framebuffer);
-	}
-
-	// complexMultiplication
+void LensFlares::createTwiddleBuffer()
+{
+	// Built once per transform size in double precision, so the kernels do no transcendentals
+	std::vector<float> twiddles;
+	for (uint32_t length : { fftWidth, fftHeight })
 	{
-		createAttachment(&frameBuffers.complexMultiplication.real, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height);
-		createAttachment(&frameBuffers.complexMultiplication.imaginary, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height);
-
-		std::vector<VkAttachmentDescription> attachmentDescriptions(2);
-		attachmentDescriptions[0] = {
-			.flags = 0,
-			.format = frameBuffers.complexMultiplication.real.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-		};
-		attachmentDescriptions[1] = {
-			.flags = 0,
-			.format = frameBuffers.complexMultiplication.imaginary.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-		};
-
-		std::vector<VkAttachmentReference> colorAttachments = {
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
-			{1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
-		};
-
-		VkSubpassDescription subpass = {
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.colorAttachmentCount = (uint32_t)colorAttachments.size(),
-			.pColorAttachments = colorAttachments.data()
-		};
-
-		std::vector<VkSubpassDependency> subpassDependencys(2);
-		subpassDependencys[0] = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-		subpassDependencys[1] = {
-			.srcSubpass = 0,
-			.dstSubpass = VK_SUBPASS_EXTERNAL,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-
-		VkRenderPassCreateInfo renderPassCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.attachmentCount = (uint32_t)attachmentDescriptions.size(),
-			.pAttachments = attachmentDescriptions.data(),
-			.subpassCount = 1,
-			.pSubpasses = &subpass,
-			.dependencyCount = (uint32_t)subpassDependencys.size(),
-			.pDependencies = subpassDependencys.data()
-		};
-		VkRenderPass renderPass;
-		vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
-
-		std::vector<VkImageView> attachments(2);
-		attachments[0] = frameBuffers.complexMultiplication.real.view;
-		attachments[1] = frameBuffers.complexMultiplication.imaginary.view;
-
-		VkFramebufferCreateInfo framebufferCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.renderPass = renderPass,
-			.attachmentCount = (uint32_t)attachments.size(),
-			.pAttachments = attachments.data(),
-			.width = width,
-			.height = height,
-			.layers = 1
-		};
-		vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frameBuffers.complexMultiplication.framebuffer);
+		for (uint32_t k = 0; k < length; ++k)
+		{
+			double angle = 2.0 * 3.14159265358979323846 * k / length;
+			twiddles.push_back((float)cos(angle));
+			twiddles.push_back((float)sin(angle));
+		}
 	}
-	
-	// blend
-	{
-		createAttachment(&frameBuffers.blend.color, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height);
+	VkDeviceSize size = twiddles.size() * sizeof(float);
 
-		std::vector<VkAttachmentDescription> attachmentDescriptions(1);
-		attachmentDescriptions[0] = {
-			.flags = 0,
-			.format = frameBuffers.blend.color.format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-		};
-
-		std::vector<VkAttachmentReference> colorAttachments = {
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
-		};
-
-		VkSubpassDescription subpass = {
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.colorAttachmentCount = (uint32_t)colorAttachments.size(),
-			.pColorAttachments = colorAttachments.data()
-		};
-
-		std::vector<VkSubpassDependency> subpassDependencys(2);
-		subpassDependencys[0] = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
-		subpassDependencys[1] = {
-			.srcSubpass = 0,
-			.dstSubpass = VK_SUBPASS_EXTERNAL,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
-		};
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingMemory;
+	VkBufferCreateInfo bufferCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.size = size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	};
+	if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create twiddle buffer!");
+	VkMemoryRequirements memReq;
+	vkGetBufferMemoryRequirements(device, stagingBuffer, &memReq);
+	VkMemoryAllocateInfo memoryAllocateInfo = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = memReq.size,
+		.memoryTypeIndex = getMemoryTypeIndex(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	};
+	if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &stagingMemory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate twiddle buffer memory!");
+	vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
+	void* data;
+	vkMapMemory(device, stagingMemory, 0, size, 0, &data);
+	memcpy(data, twiddles.data(), size);
+	vkUnmapMemory(device, stagingMemory);
 
-		VkRenderPassCreateInfo renderPassCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.attachmentCount = (uint32_t)attachmentDescriptions.size(),
-			.pAttachments = attachmentDescriptions.data(),
-			.subpassCount = 1,
-			.pSubpasses = &subpass,
-			.dependencyCount = (uint32_t)subpassDependencys.size(),
-			.pDependencies = subpassDependencys.data()
-		};
-		VkRenderPass renderPass;
-		vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &twiddleBuffer.buffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create twiddle buffer!");
+	vkGetBufferMemoryRequirements(device, twiddleBuffer.buffer, &memReq);
+	memoryAllocateInfo.allocationSize = memReq.size;
+	memoryAllocateInfo.memoryTypeIndex = getMemoryTypeIndex(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &twiddleBuffer.memory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate twiddle buffer memory!");
+	vkBindBufferMemory(device, twiddleBuffer.buffer, twiddleBuffer.memory, 0);
+	twiddleBuffer.descriptor = {
+		.buffer = twiddleBuffer.buffer,
+		.offset = 0,
+		.range = size
+	};
 
-		std::vector<VkImageView> attachments(1);
-		attachments[0] = frameBuffers.blend.color.view;
+	VkCommandBuffer cmdBuffer = getCommandBuffer(true);
+	VkBufferCopy bufferCopy = { 0, 0, size };
+	vkCmdCopyBuffer(cmdBuffer, stagingBuffer, twiddleBuffer.buffer, 1, &bufferCopy);
+	VkBufferMemoryBarrier bufferMemoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = twiddleBuffer.buffer,
+		.offset = 0,
+		.size = size
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+	flushCommandBuffer(cmdBuffer);
 
-		VkFramebufferCreateInfo framebufferCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.renderPass = renderPass,
-			.attachmentCount = (uint32_t)attachments.size(),
-			.pAttachments = attachments.data(),
-			.width = width,
-			.height = height,
-			.layers = 1
-		};
-		vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frameBuffers.blend.framebuffer);
-	}
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingMemory, nullptr);
 }
 
 void LensFlares::createCommandBuffers()
@@ -1784,7 +1549,9 @@ void LensFlares::createDescriptorPool()
 {
 	std::vector<VkDescriptorPoolSize> descriptorPoolSizes = {
 		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 24}
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 24},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 24},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6}
 	};
 	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
 		VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
@@ -1845,53 +1612,38 @@ void LensFlares::setupDescriptorSetLayout()
 		vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.blur);
 	}
 
-	// dft
+	// fft
 	{
 		std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings = {
 			{
 				.binding = 0,
 				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
 			},
 			{
-				.binding = 2,
-				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				.binding = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-			}
-		};
-
-		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.bindingCount = (uint32_t)descriptorSetLayoutBindings.size(),
-			.pBindings = descriptorSetLayoutBindings.data()
-		};
-		vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.dft);
-	}
-
-	// idft
-	{
-		std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings = {
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			},
 			{
-				.binding = 0,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.binding = 2,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
 			},
 			{
-				.binding = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.binding = 3,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
 			},
 			{
-				.binding = 2,
-				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				.binding = 4,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
 			}
 		};
 
@@ -1902,37 +1654,21 @@ void LensFlares::setupDescriptorSetLayout()
 			.bindingCount = (uint32_t)descriptorSetLayoutBindings.size(),
 			.pBindings = descriptorSetLayoutBindings.data()
 		};
-		vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.idft);
+		vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.fft);
 	}
 
 	// complexMultiplication
 	{
-		std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings = {
-			{
-				.binding = 0,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-			},
-			{
-				.binding = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-			},
-			{
-				.binding = 2,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-			},
-			{
-				.binding = 3,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-			}
-		};
+		std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings(6);
+		for (uint32_t i = 0; i < descriptorSetLayoutBindings.size(); ++i)
+		{
+			descriptorSetLayoutBindings[i] = {
+				.binding = i,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			};
+		}
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -2063,62 +1799,81 @@ void LensFlares::setupDescriptorSet()
 		vkUpdateDescriptorSets(device, 2, &writeDescriptorSets[0], 0, nullptr);
 	}
 
-	// dft
+	// fft
 	{
+		VkPushConstantRange pushConstantRange = {
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.offset = 0,
+			.size = sizeof(FFTParameter)
+		};
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 			.pNext = nullptr,
 			.flags = 0,
 			.setLayoutCount = 1,
-			.pSetLayouts = &descriptorSetLayouts.dft,
-			.pushConstantRangeCount = 0,
-			.pPushConstantRanges = nullptr
+			.pSetLayouts = &descriptorSetLayouts.fft,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
 		};
-		vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.dft);
+		vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.fft);
 
-		// blur
 		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
 			.pNext = nullptr,
 			.descriptorPool = descriptorPool,
 			.descriptorSetCount = 1,
-			.pSetLayouts = &descriptorSetLayouts.dft
-		};
-		vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSets.blur_dft);
-
-		VkDescriptorImageInfo descriptorImageInfo = {
-			.sampler = colorSampler,
-			.imageView = frameBuffers.blur.color.view,
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		};
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets(2);
-		writeDescriptorSets[0] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.blur_dft,
-			.dstBinding = 0,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.pImageInfo = &descriptorImageInfo
-		};
-		writeDescriptorSets[1] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.blur_dft,
-			.dstBinding = 2,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			.pBufferInfo = &uniformBuffers.dft.descriptor
-		};
-		vkUpdateDescriptorSets(device, 2, &writeDescriptorSets[0], 0, nullptr);
-
-		// bright
-		vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSets.bright_dft);
-
-		descriptorImageInfo.imageView = frameBuffers.bright.color.view;
-		writeDescriptorSets[0].dstSet = descriptorSets.bright_dft;
-		writeDescriptorSets[1].dstSet = descriptorSets.bright_dft;
-		vkUpdateDescriptorSets(device, 2, &writeDescriptorSets[0], 0, nullptr);
+			.pSetLayouts = &descriptorSetLayouts.fft
+		};
+
+		// Each pass samples its input (a color attachment or the previous pass) and stores to
+		// storage images; passes with real input or output get the same view in both slots.
+		auto writeDescriptorSet = [&](VkDescriptorSet* descriptorSet, VkImageView real, VkImageView imaginary,
+			VkImageLayout imageLayout, VkImageView outReal, VkImageView outImaginary) {
+			vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, descriptorSet);
+
+			std::vector<VkDescriptorImageInfo> descriptorImageInfos(4);
+			descriptorImageInfos[0] = { colorSampler, real, imageLayout };
+			descriptorImageInfos[1] = { colorSampler, imaginary, imageLayout };
+			descriptorImageInfos[2] = { VK_NULL_HANDLE, outReal, VK_IMAGE_LAYOUT_GENERAL };
+			descriptorImageInfos[3] = { VK_NULL_HANDLE, outImaginary, VK_IMAGE_LAYOUT_GENERAL };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets(5);
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				writeDescriptorSets[i] = {
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.pNext = nullptr,
+					.dstSet = *descriptorSet,
+					.dstBinding = i,
+					.descriptorCount = 1,
+					.descriptorType = i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.pImageInfo = &descriptorImageInfos[i]
+				};
+			}
+			writeDescriptorSets[4] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.pNext = nullptr,
+				.dstSet = *descriptorSet,
+				.dstBinding = 4,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &twiddleBuffer.descriptor
+			};
+			vkUpdateDescriptorSets(device, (uint32_t)writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+		};
+
+		writeDescriptorSet(&descriptorSets.bright_dft.rows, frameBuffers.bright.color.view, frameBuffers.bright.color.view,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, storageImages.temp.real.view, storageImages.temp.imaginary.view);
+		writeDescriptorSet(&descriptorSets.bright_dft.columns, storageImages.temp.real.view, storageImages.temp.imaginary.view,
+			VK_IMAGE_LAYOUT_GENERAL, storageImages.bright_dft.real.view, storageImages.bright_dft.imaginary.view);
+		writeDescriptorSet(&descriptorSets.blur_dft.rows, frameBuffers.blur.color.view, frameBuffers.blur.color.view,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, storageImages.temp.real.view, storageImages.temp.imaginary.view);
+		writeDescriptorSet(&descriptorSets.blur_dft.columns, storageImages.temp.real.view, storageImages.temp.imaginary.view,
+			VK_IMAGE_LAYOUT_GENERAL, storageImages.blur_dft.real.view, storageImages.blur_dft.imaginary.view);
+		writeDescriptorSet(&descriptorSets.idft.columns, storageImages.complexMultiplication.real.view,
+			storageImages.complexMultiplication.imaginary.view, VK_IMAGE_LAYOUT_GENERAL,
+			storageImages.temp.real.view, storageImages.temp.imaginary.view);
+		writeDescriptorSet(&descriptorSets.idft.rows, storageImages.temp.real.view, storageImages.temp.imaginary.view,
+			VK_IMAGE_LAYOUT_GENERAL, storageImages.idft.view, storageImages.idft.view);
 	}
 
 	// complexMultiplication
@@ -2143,129 +1898,34 @@ void LensFlares::setupDescriptorSet()
 		};
 		vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSets.complexMultiplication);
 
-		std::vector<VkDescriptorImageInfo> descriptorImageInfos(4);
-		descriptorImageInfos[0] = {
-			.sampler = colorSampler,
-			.imageView = frameBuffers.bright_dft.real.view,
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		};
-		descriptorImageInfos[1] = {
-			.sampler = colorSampler,
-			.imageView = frameBuffers.bright_dft.imaginary.view,
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		};
-		descriptorImageInfos[2] = {
-			.sampler = colorSampler,
-			.imageView = frameBuffers.blur_dft.real.view,
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		};
-		descriptorImageInfos[3] = {
-			.sampler = colorSampler,
-			.imageView = frameBuffers.blur_dft.imaginary.view,
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		};
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets(4);
-		writeDescriptorSets[0] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.complexMultiplication,
-			.dstBinding = 0,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.pImageInfo = &descriptorImageInfos[0]
-		};
-		writeDescriptorSets[1] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.complexMultiplication,
-			.dstBinding = 1,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.pImageInfo = &descriptorImageInfos[1]
-		};
-		writeDescriptorSets[2] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.complexMultiplication,
-			.dstBinding = 2,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.pImageInfo = &descriptorImageInfos[2]
-		};
-		writeDescriptorSets[3] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.complexMultiplication,
-			.dstBinding = 3,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.pImageInfo = &descriptorImageInfos[3]
-		};
-		vkUpdateDescriptorSets(device, 4, &writeDescriptorSets[0], 0, nullptr);
-	}
-
-	// idft
-	{
-		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.setLayoutCount = 1,
-			.pSetLayouts = &descriptorSetLayouts.idft,
-			.pushConstantRangeCount = 0,
-			.pPushConstantRanges = nullptr
-		};
-		vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.idft);
-
-		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			.pNext = nullptr,
-			.descriptorPool = descriptorPool,
-			.descriptorSetCount = 1,
-			.pSetLayouts = &descriptorSetLayouts.idft
-		};
-		vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSets.idft);
-
-		std::vector<VkDescriptorImageInfo> descriptorImageInfos(2);
-		descriptorImageInfos[0] = {
-			.sampler = colorSampler,
-			.imageView = frameBuffers.complexMultiplication.real.view,
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		};
-		descriptorImageInfos[1] = {
-			.sampler = colorSampler,
-			.imageView = frameBuffers.complexMultiplication.imaginary.view,
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		};
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets(3);
-		writeDescriptorSets[0] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.idft,
-			.dstBinding = 0,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.pImageInfo = &descriptorImageInfos[0]
-		};
-		writeDescriptorSets[1] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.idft,
-			.dstBinding = 1,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.pImageInfo = &descriptorImageInfos[1]
-		};
-		writeDescriptorSets[2] = {
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = descriptorSets.idft,
-			.dstBinding = 2,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			.pBufferInfo = &uniformBuffers.idft.descriptor
-		};
-		vkUpdateDescriptorSets(device, 3, &writeDescriptorSets[0], 0, nullptr);
+		std::vector<VkImageView> views = {
+			storageImages.bright_dft.real.view,
+			storageImages.bright_dft.imaginary.view,
+			storageImages.blur_dft.real.view,
+			storageImages.blur_dft.imaginary.view,
+			storageImages.complexMultiplication.real.view,
+			storageImages.complexMultiplication.imaginary.view
+		};
+		std::vector<VkDescriptorImageInfo> descriptorImageInfos(views.size());
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets(views.size());
+		for (uint32_t i = 0; i < views.size(); ++i)
+		{
+			descriptorImageInfos[i] = {
+				.sampler = VK_NULL_HANDLE,
+				.imageView = views[i],
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+			};
+			writeDescriptorSets[i] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.pNext = nullptr,
+				.dstSet = descriptorSets.complexMultiplication,
+				.dstBinding = i,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.pImageInfo = &descriptorImageInfos[i]
+			};
+		}
+		vkUpdateDescriptorSets(device, (uint32_t)writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
 	}
 
 	// blend
@@ -2298,8 +1958,8 @@ void LensFlares::setupDescriptorSet()
 		};
 		descriptorImageInfos[1] = {
 			.sampler = colorSampler,
-			.imageView = frameBuffers.idft.color.view,
-			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			.imageView = storageImages.idft.view,
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL
 		};
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets(2);
 		writeDescriptorSets[0] = {
@@ -2472,246 +2132,134 @@ void LensFlares::buildCommandBuffers()
 	{
 		vkBeginCommandBuffer(commandBuffers[i], &commandBufferBeginInfo);
 		// bright
-		{
-			std::vector<VkClearValue> clearValues(1);
-			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = {
-				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-				.pNext = nullptr,
-				.renderPass = frameBuffers.bright.renderPass,
-				.framebuffer = frameBuffers.bright.framebuffer,
-				.clearValueCount = 1,
-				.pClearValues = clearValues.data()
-			};
-			renderPassBeginInfo.renderArea.extent = { width, height };
-
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = {
-				.x = (float)0,
-				.y = (float)0,
-				.width = (float)width,
-				.height = (float)height,
-				.minDepth = 0.0f,
-				.maxDepth = 1.0f
-			};
-			vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-			VkRect2D scissor = { 
-				.offset = {0, 0},
-				.extent = {width, height},
-			};
-			vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bright);
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.bright,
-				0, 1, &descriptorSets.bright, 0, 0);
-			vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-			vkCmdEndRenderPass(commandBuffers[i]);
-		}
-		
-		// blur
-		{
-			std::vector<VkClearValue> clearValues(1);
-			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = {
-				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-				.pNext = nullptr,
-				.renderPass = frameBuffers.blur.renderPass,
-				.framebuffer = frameBuffers.blur.framebuffer,
-				.clearValueCount = 1,
-				.pClearValues = clearValues.data()
-			};
-			renderPassBeginInfo.renderArea.extent = { width, height };
+		recordPass(commandBuffers[i], frameBuffers.bright, pipelines.bright, pipelineLayouts.bright, descriptorSets.bright);
+		recordComputeBarrier(commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = {
-				.x = (float)0,
-				.y = (float)0,
-				.width = (float)width,
-				.height = (float)height,
-				.minDepth = 0.0f,
-				.maxDepth = 1.0f
-			};
-			vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-			VkRect2D scissor = {
-				.offset = {0, 0},
-				.extent = {width, height},
-			};
-			vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blur);
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur,
-				0, 1, &descriptorSets.blur, 0, 0);
-			vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-			vkCmdEndRenderPass(commandBuffers[i]);
-		}
+		// bright_dft; the blur_dft operand is the fixed flare kernel, transformed once by
+		// computeKernelSpectrum()
+		recordFFT(commandBuffers[i], descriptorSets.bright_dft, false);
 
-		// blur_dft
+		// complexMultiplication
 		{
-			std::vector<VkClearValue> clearValues(2);
-			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-			clearValues[1].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = {
-				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-				.pNext = nullptr,
-				.renderPass = frameBuffers.blur_dft.renderPass,
-				.framebuffer = frameBuffers.blur_dft.framebuffer,
-				.clearValueCount = 2,
-				.pClearValues = clearValues.data()
-			};
-			renderPassBeginInfo.renderArea.extent = { width, height };
-
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = {
-				.x = (float)0,
-				.y = (float)0,
-				.width = (float)width,
-				.height = (float)height,
-				.minDepth = 0.0f,
-				.maxDepth = 1.0f
-			};
-			vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-			VkRect2D scissor = {
-				.offset = {0, 0},
-				.extent = {width, height},
-			};
-			vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blur_dft);
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.dft,
-				0, 1, &descriptorSets.blur_dft, 0, 0);
-			vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-			vkCmdEndRenderPass(commandBuffers[i]);
+			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.complexMultiplication);
+			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.complexMultiplication,
+				0, 1, &descriptorSets.complexMultiplication, 0, 0);
+			vkCmdDispatch(commandBuffers[i], (fftWidth + 15) / 16, (fftHeight + 15) / 16, 1);
+			recordComputeBarrier(commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 		}
 
-		// bright_dft
-		{
-			std::vector<VkClearValue> clearValues(2);
-			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-			clearValues[1].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = {
-				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-				.pNext = nullptr,
-				.renderPass = frameBuffers.bright_dft.renderPass,
-				.framebuffer = frameBuffers.bright_dft.framebuffer,
-				.clearValueCount = 2,
-				.pClearValues = clearValues.data()
-			};
-			renderPassBeginInfo.renderArea.extent = { width, height };
-
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = {
-				.x = (float)0,
-				.y = (float)0,
-				.width = (float)width,
-				.height = (float)height,
-				.minDepth = 0.0f,
-				.maxDepth = 1.0f
-			};
-			vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-			VkRect2D scissor = {
-				.offset = {0, 0},
-				.extent = {width, height},
-			};
-			vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bright_dft);
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.dft,
-				0, 1, &descriptorSets.bright_dft, 0, 0);
-			vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-			vkCmdEndRenderPass(commandBuffers[i]);
-		}
+		// idft
+		recordFFT(commandBuffers[i], descriptorSets.idft, true);
+		recordComputeBarrier(commandBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
-		// complexMultiplication
-		{
-			std::vector<VkClearValue> clearValues(2);
-			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-			clearValues[1].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		// blend
+		recordPass(commandBuffers[i], frameBuffers.blend, pipelines.blend, pipelineLayouts.blend, descriptorSets.blend);
+		vkEndCommandBuffer(commandBuffers[i]);
+	}
+}
 
-			VkRenderPassBeginInfo renderPassBeginInfo = {
-				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-				.pNext = nullptr,
-				.renderPass = frameBuffers.complexMultiplication.renderPass,
-				.framebuffer = frameBuffers.complexMultiplication.framebuffer,
-				.clearValueCount = 2,
-				.pClearValues = clearValues.data()
-			};
-			renderPassBeginInfo.renderArea.extent = { width, height };
+void LensFlares::recordPass(VkCommandBuffer cmdBuffer, const FrameBuffer& frameBuffer, VkPipeline pipeline,
+	VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet)
+{
+	std::vector<VkClearValue> clearValues(1);
+	clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
 
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	VkRenderPassBeginInfo renderPassBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.pNext = nullptr,
+		.renderPass = frameBuffer.renderPass,
+		.framebuffer = frameBuffer.framebuffer,
+		.clearValueCount = 1,
+		.pClearValues = clearValues.data()
+	};
+	renderPassBeginInfo.renderArea.extent = { width, height };
 
-			VkViewport viewport = {
-				.x = (float)0,
-				.y = (float)0,
-				.width = (float)width,
-				.height = (float)height,
-				.minDepth = 0.0f,
-				.maxDepth = 1.0f
-			};
-			vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-			VkRect2D scissor = {
-				.offset = {0, 0},
-				.extent = {width, height},
-			};
-			vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.complexMultiplication);
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.complexMultiplication,
-				0, 1, &descriptorSets.complexMultiplication, 0, 0);
-			vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-			vkCmdEndRenderPass(commandBuffers[i]);
-		}
+	vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		// blend
-		{
-			std::vector<VkClearValue> clearValues(1);
-			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+	VkViewport viewport = {
+		.x = (float)0,
+		.y = (float)0,
+		.width = (float)width,
+		.height = (float)height,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
+	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+	VkRect2D scissor = {
+		.offset = {0, 0},
+		.extent = {width, height},
+	};
+	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+		0, 1, &descriptorSet, 0, 0);
+	vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+	vkCmdEndRenderPass(cmdBuffer);
+}
 
-			VkRenderPassBeginInfo renderPassBeginInfo = {
-				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-				.pNext = nullptr,
-				.renderPass = frameBuffers.blend.renderPass,
-				.framebuffer = frameBuffers.blend.framebuffer,
-				.clearValueCount = 1,
-				.pClearValues = clearValues.data()
-			};
-			renderPassBeginInfo.renderArea.extent = { width, height };
+void LensFlares::computeKernelSpectrum()
+{
+	// The flare kernel is the blurred highlights of the loaded image, which stays the same from
+	// frame to frame: render and transform it once into blur_dft.
+	VkCommandBuffer cmdBuffer = getCommandBuffer(true);
+	recordPass(cmdBuffer, frameBuffers.bright, pipelines.bright, pipelineLayouts.bright, descriptorSets.bright);
+	recordPass(cmdBuffer, frameBuffers.blur, pipelines.blur, pipelineLayouts.blur, descriptorSets.blur);
+	recordComputeBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	recordFFT(cmdBuffer, descriptorSets.blur_dft, false);
+	recordComputeBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	flushCommandBuffer(cmdBuffer);
+}
 
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+void LensFlares::recordFFT(VkCommandBuffer cmdBuffer, const FFTDescriptorSets& sets, bool inverse)
+{
+	// Forward: rows of the window into temp, then every column of temp into the spectrum.
+	// Inverse: every column of the spectrum into temp, keeping the window rows, then those rows.
+	std::vector<FFTParameter> parameters(2);
+	if (!inverse)
+	{
+		parameters[0] = { width, fftWidth, FFT_REAL_INPUT };
+		parameters[1] = { height, fftHeight, 0 };
+	}
+	else
+	{
+		parameters[0] = { fftHeight, height, FFT_INVERSE };
+		parameters[1] = { fftWidth, width, FFT_INVERSE | FFT_REAL_OUTPUT };
+	}
 
-			VkViewport viewport = {
-				.x = (float)0,
-				.y = (float)0,
-				.width = (float)width,
-				.height = (float)height,
-				.minDepth = 0.0f,
-				.maxDepth = 1.0f
-			};
-			vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-			VkRect2D scissor = {
-				.offset = {0, 0},
-				.extent = {width, height},
-			};
-			vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blend);
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blend,
-				0, 1, &descriptorSets.blend, 0, 0);
-			vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-			vkCmdEndRenderPass(commandBuffers[i]);
-		}
-		vkEndCommandBuffer(commandBuffers[i]);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		bool rows = (pass == 0) != inverse;
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rows ? pipelines.fft_rows : pipelines.fft_columns);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.fft,
+			0, 1, rows ? &sets.rows : &sets.columns, 0, 0);
+		vkCmdPushConstants(cmdBuffer, pipelineLayouts.fft, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+			sizeof(FFTParameter), &parameters[pass]);
+		vkCmdDispatch(cmdBuffer, rows ? height : fftWidth, 1, 1);
+		recordComputeBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 	}
 }
 
+void LensFlares::recordComputeBarrier(VkCommandBuffer cmdBuffer, VkPipelineStageFlags dstStageMask)
+{
+	// Everything before (color attachments or compute passes) is visible to the next reader, and
+	// the next compute pass does not overwrite temp while the previous one still reads it.
+	VkMemoryBarrier memoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		dstStageMask, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
 void LensFlares::createUniformBuffers()
 {
 	VkBufferCreateInfo bufferCreateInfo = {
 	.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 	.pNext = nullptr,
 	.flags = 0,
-	.size = uint32_t(192),
+	.size = uint32_t(64),
 	.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 	.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
 	};
@@ -2732,30 +2280,12 @@ void LensFlares::createUniformBuffers()
 		.offset = 0,
 		.range = sizeof(blurUboVS)
 	};
-	uniformBuffers.dft.descriptor = {
-		.buffer = uniformBuffers.buffer,
-		.offset = 64,
-		.range = sizeof(fftUboVS)
-	};
-	uniformBuffers.idft.descriptor = {
-		.buffer = uniformBuffers.buffer,
-		.offset = 128,
-		.range = sizeof(fftUboVS)
-	};
 
 	void* data;
 	blurUboVS = { 1.0f / width, 1.0f / height };
 	vkMapMemory(device, uniformBuffers.memory, 0, sizeof(blurUboVS), 0, &data);
 	memcpy(data, &blurUboVS, sizeof(blurUboVS));
 	vkUnmapMemory(device, uniformBuffers.memory);
-	fftUboVS = { glm::vec2(1.0f / width, 1.0f / height), false };
-	vkMapMemory(device, uniformBuffers.memory, 64, sizeof(fftUboVS), 0, &data);
-	memcpy(data, &fftUboVS, sizeof(fftUboVS));
-	vkUnmapMemory(device, uniformBuffers.memory);
-	vkMapMemory(device, uniformBuffers.memory, 128, sizeof(fftUboVS), 0, &data);
-	fftUboVS.isInverse = true;
-	memcpy(data, &fftUboVS, sizeof(fftUboVS));
-	vkUnmapMemory(device, uniformBuffers.memory);
 }
 
 bool LensFlares::isDeviceSuitable(VkPhysicalDevice device)
@@ -2834,6 +2364,11 @@ void LensFlares::createAttachment(FrameBufferAttachment* attachment, VkFormat fo
 
 	VkImageAspectFlags aspectFlag = 0;
 	VkImageLayout imageLayout;
+	if (usage & VK_IMAGE_USAGE_STORAGE_BIT)
+	{
+		aspectFlag = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
 	if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
 	{
 		aspectFlag = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -2856,7 +2391,7 @@ void LensFlares::createAttachment(FrameBufferAttachment* attachment, VkFormat fo
 		.arrayLayers = 1,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.tiling = VK_IMAGE_TILING_OPTIMAL,
-		.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT,
+		.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
 		.queueFamilyIndexCount = 0,
 		.pQueueFamilyIndices = nullptr,
@@ -2896,12 +2431,23 @@ void LensFlares::createAttachment(FrameBufferAttachment* attachment, VkFormat fo
 
 VkShaderModule LensFlares::createShaderModule(const std::string& filepath)
 {
+	// The .spv files are built by glsl.bat and loaded from the working directory.
 	std::ifstream ifs(filepath.c_str(), std::ios::binary);
+	if (!ifs)
+		throw std::runtime_error("Failed to open shader " + filepath + "!");
 	ifs.seekg(0, ifs.end);
-	uint32_t codeSize = ifs.tellg();
+	std::streamoff fileSize = ifs.tellg();
+	if (fileSize <= 0 || fileSize % 4 != 0)
+		throw std::runtime_error("Failed to read SPIR-V from shader " + filepath + "!");
+	uint32_t codeSize = (uint32_t)fileSize;
 	ifs.seekg(0, ifs.beg);
 	char* codeBuffer = (char*)malloc(codeSize);
 	ifs.read(codeBuffer, codeSize);
+	if (!ifs)
+	{
+		free(codeBuffer);
+		throw std::runtime_error("Failed to read SPIR-V from shader " + filepath + "!");
+	}
 	VkShaderModule shaderModule;
 	VkShaderModuleCreateInfo vertexShaderModuleCreateInfo = {
 		VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -2915,6 +2461,7 @@ VkShaderModule LensFlares::createShaderModule(const std::string& filepath)
 		free(codeBuffer);
 		throw std::runtime_error("Failed to create vertex shader module!");
 	}
+	free(codeBuffer);
 	return shaderModule;
 }
 
@@ -2975,6 +2522,89 @@ void LensFlares::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInf
 	createInfo.pfnUserCallback = debugCallback;
 }
 
+std::vector<uint8_t> LensFlares::readImage(VkImage image, VkImageLayout imageLayout, uint32_t width, uint32_t height,
+	uint32_t texelSize)
+{
+	VkDeviceSize size = (VkDeviceSize)width * height * texelSize;
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	VkBufferCreateInfo bufferCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.size = size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	};
+	if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create readback buffer!");
+	VkMemoryRequirements memReq;
+	vkGetBufferMemoryRequirements(device, buffer, &memReq);
+	VkMemoryAllocateInfo memoryAllocateInfo = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = memReq.size,
+		.memoryTypeIndex = getMemoryTypeIndex(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	};
+	if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate readback buffer memory!");
+	vkBindBufferMemory(device, buffer, memory, 0);
+
+	// Images outside VK_IMAGE_LAYOUT_GENERAL go to TRANSFER_SRC for the copy and back after it.
+	VkCommandBuffer cmdBuffer = getCommandBuffer(true);
+	VkImageMemoryBarrier imageMemoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.oldLayout = imageLayout,
+		.newLayout = imageLayout == VK_IMAGE_LAYOUT_GENERAL ? imageLayout : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	VkBufferImageCopy bufferImageCopy = {
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.imageOffset = { 0, 0, 0 },
+		.imageExtent = { width, height, 1 }
+	};
+	vkCmdCopyImageToBuffer(cmdBuffer, image, imageMemoryBarrier.newLayout, buffer, 1, &bufferImageCopy);
+	std::swap(imageMemoryBarrier.oldLayout, imageMemoryBarrier.newLayout);
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	VkBufferMemoryBarrier bufferMemoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = buffer,
+		.offset = 0,
+		.size = size
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+	flushCommandBuffer(cmdBuffer);
+
+	std::vector<uint8_t> texels(size);
+	void* data;
+	vkMapMemory(device, memory, 0, size, 0, &data);
+	memcpy(texels.data(), data, size);
+	vkUnmapMemory(device, memory);
+	vkDestroyBuffer(device, buffer, nullptr);
+	vkFreeMemory(device, memory, nullptr);
+	return texels;
+}
+
 void LensFlares::flushCommandBuffer(VkCommandBuffer cmdBuffer)
 {
 	vkEndCommandBuffer(cmdBuffer);
@@ -20,9 +20,11 @@ struct QueueFamilyIndices {
 class LensFlares
 {
 public:
-	LensFlares(uint32_t width, uint32_t height);
+	LensFlares(uint32_t width, uint32_t height, bool powerOfTwoFFT = false);
 	~LensFlares();
 	void run();
+	void benchmark();
+	bool check();
 
 private:
 	void initWindow();
@@ -39,13 +41,17 @@ private:
 	void createRenderPass();
 	void createPipelineCache();
 	void createPipeline();
+	void createFFTPipelines(const std::string& shader);
 	void createCommandPool();
 	void createFrameBuffers();
+	void createStorageImages();
+	void createTwiddleBuffer();
 	void createCommandBuffers();
 	void createDescriptorPool();
 	void setupDescriptorSetLayout();
 	void setupDescriptorSet();
 	void loadResources();
+	void computeKernelSpectrum();
 	void buildCommandBuffers();
 	void createUniformBuffers();
 
@@ -55,6 +61,7 @@ private:
 	uint32_t getMemoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties);
 	VkCommandBuffer getCommandBuffer(bool begin);
 	struct FrameBufferAttachment;
+	struct FrameBuffer;
 	void createAttachment(FrameBufferAttachment *attachment, VkFormat format, VkImageUsageFlags usage,
 		float width, float height);
 	VkShaderModule	createShaderModule(const std::string& filepath);
@@ -67,12 +74,21 @@ private:
 		void* pUserData);
 	void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 	void flushCommandBuffer(VkCommandBuffer cmdBuffer);
+	std::vector<uint8_t> readImage(VkImage image, VkImageLayout imageLayout, uint32_t width, uint32_t height,
+		uint32_t texelSize);
+	struct FFTDescriptorSets;
+	void recordPass(VkCommandBuffer cmdBuffer, const FrameBuffer& frameBuffer, VkPipeline pipeline,
+		VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet);
+	void recordFFT(VkCommandBuffer cmdBuffer, const FFTDescriptorSets& sets, bool inverse);
+	void recordComputeBarrier(VkCommandBuffer cmdBuffer, VkPipelineStageFlags dstStageMask);
 
 private:
 	GLFWwindow*						window;
 	VkInstance						instance;
 	VkDebugUtilsMessengerEXT		debugMessenger;
 	VkPhysicalDevice				physicalDevice;
+	VkPhysicalDeviceSubgroupProperties	subgroupProperties;
+	bool							subgroupShuffle;
 	VkSurfaceKHR					surfaceKHR;
 	QueueFamilyIndices				indices;
 	VkQueue							graphicQueue;
@@ -91,16 +107,20 @@ private:
 
 	uint32_t						width;
 	uint32_t						height;
+	uint32_t						fftWidth;
+	uint32_t						fftHeight;
+	bool							powerOfTwoFFT;
 	
 	struct {
 		glm::mat4 model;
 		glm::mat4 view;
 		glm::mat4 porjection;
 	} uboVS;
-	struct {
-		glm::vec2 uv;
-		bool isInverse;
-	} fftUboVS;
+	struct FFTParameter {
+		uint32_t inputLength;
+		uint32_t outputLength;
+		uint32_t flags;
+	};
 	struct {
 		float u;
 		float v;
@@ -108,7 +128,7 @@ private:
 	struct {
 		struct {
 			VkDescriptorBufferInfo descriptor;
-		} blur, dft, idft;
+		} blur;
 		VkDeviceMemory memory;
 		VkBuffer buffer;
 	} uniformBuffers;
@@ -120,34 +140,35 @@ private:
 	struct {
 		VkPipeline	bright;
 		VkPipeline	blur;
-		VkPipeline	bright_dft;
-		VkPipeline	blur_dft;
-		VkPipeline	idft;
+		VkPipeline	fft_rows;
+		VkPipeline	fft_columns;
 		VkPipeline	complexMultiplication;
 		VkPipeline	blend;
 	} pipelines;
 	struct {
 		VkPipelineLayout	bright;
 		VkPipelineLayout	blur;
-		VkPipelineLayout	dft;
-		VkPipelineLayout	idft;
+		VkPipelineLayout	fft;
 		VkPipelineLayout	complexMultiplication;
 		VkPipelineLayout	blend;
 	} pipelineLayouts;
+	struct FFTDescriptorSets {
+		VkDescriptorSet	rows;
+		VkDescriptorSet	columns;
+	};
 	struct {
 		VkDescriptorSet		bright;
 		VkDescriptorSet		blur;
-		VkDescriptorSet		bright_dft;
-		VkDescriptorSet		blur_dft;
-		VkDescriptorSet		idft;
+		FFTDescriptorSets	bright_dft;
+		FFTDescriptorSets	blur_dft;
+		FFTDescriptorSets	idft;
 		VkDescriptorSet		complexMultiplication;
 		VkDescriptorSet		blend;
 	} descriptorSets;
 	struct {
 		VkDescriptorSetLayout	bright;
 		VkDescriptorSetLayout	blur;
-		VkDescriptorSetLayout	dft;
-		VkDescriptorSetLayout	idft;
+		VkDescriptorSetLayout	fft;
 		VkDescriptorSetLayout	complexMultiplication;
 		VkDescriptorSetLayout	blend;
 	} descriptorSetLayouts;
@@ -165,9 +186,20 @@ private:
 	struct {
 		struct : public FrameBuffer {
 			FrameBufferAttachment color;
-		} bright, blur, idft, blend;
-		struct : public FrameBuffer {
-			FrameBufferAttachment real, imaginary;
-		} bright_dft, blur_dft, complexMultiplication;
+		} bright, blur, blend;
 	} frameBuffers;
+	// Spectra and transform intermediates, fftWidth x fftHeight or cropped to the rows the window
+	// needs, kept in VK_IMAGE_LAYOUT_GENERAL for the compute passes.
+	struct {
+		struct {
+			FrameBufferAttachment real, imaginary;
+		} bright_dft, blur_dft, complexMultiplication, temp;
+		FrameBufferAttachment idft;
+	} storageImages;
+	// cos and sin of 2 pi k / fftWidth, then of 2 pi k / fftHeight, for the transforms to look up
+	struct {
+		VkDescriptorBufferInfo descriptor;
+		VkDeviceMemory memory;
+		VkBuffer buffer;
+	} twiddleBuffer;
 };
\ No newline at end of file
@@ -1,8 +1,38 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
 #include "lens_flares.h"
 
-int main()
+// Lens Flares [bench|check [width height]] [pow2]
+// bench times the FFT kernels at the given window size. check reads the GPU transforms back and
+// compares them with a direct DFT; its default 800 x 630 takes every radix fft.comp has. pow2 pads
+// the transforms to powers of two, the only lengths fft_subgroup.comp runs at; without it 800 x 800
+// transforms at 800.
+int main(int argc, char** argv)
 {
-	LensFlares lensFlares(800, 800);
-	lensFlares.run();
+	std::string mode = argc > 1 ? argv[1] : "";
+	bool powerOfTwoFFT = std::string(argv[argc - 1]) == "pow2";
+	int sizeArguments = powerOfTwoFFT ? argc - 1 : argc;
+	uint32_t width = 800, height = mode == "check" ? 630 : 800;
+	if ((mode == "bench" || mode == "check") && sizeArguments > 3)
+	{
+		width = (uint32_t)atoi(argv[2]);
+		height = (uint32_t)atoi(argv[3]);
+	}
+
+	try {
+		LensFlares lensFlares(width, height, powerOfTwoFFT);
+		if (mode == "check")
+			return lensFlares.check() ? 0 : 1;
+		if (mode == "bench")
+			lensFlares.benchmark();
+		else
+			lensFlares.run();
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
 	return 0;
-}
\ No newline at end of file
+}